@@ -0,0 +1,160 @@
+#include "BenchContext.h"
+
+#include <glad/glad.h>
+#include <GLFW/glfw3.h>
+
+#include <stdexcept>
+
+#ifdef BENCH_HAS_EGL
+#include <EGL/egl.h>
+#include <EGL/eglext.h>
+#endif
+
+
+BenchContext::BenchContext (Api api, int width, int height, const char *title)
+    : m_window (nullptr), m_display (nullptr), m_context (nullptr), m_framebuffer (0),
+      m_renderbuffers(), m_backend ("")
+{
+    const bool isCreated = (api != Api::Surfaceless && createWindow (api, width, height, title)) ||
+                           ((api == Api::Surfaceless || api == Api::Auto) && createSurfaceless (width, height));
+    if (!isCreated)
+        throw std::runtime_error ("Can't create a GL 4.5 context");
+
+    glViewport (0, 0, width, height);
+}
+
+BenchContext::~BenchContext()
+{
+    if (m_framebuffer)
+    {
+        glDeleteFramebuffers (1, &m_framebuffer);
+        glDeleteRenderbuffers (2, m_renderbuffers);
+    }
+
+    if (m_window)
+    {
+        glfwDestroyWindow (m_window);
+        glfwTerminate();
+    }
+
+#ifdef BENCH_HAS_EGL
+    if (m_context)
+    {
+        eglMakeCurrent (m_display, EGL_NO_SURFACE, EGL_NO_SURFACE, EGL_NO_CONTEXT);
+        eglDestroyContext (m_display, m_context);
+        eglTerminate (m_display);
+    }
+#endif
+}
+
+// Without a window there is nothing to present, the flush keeps the
+// driver's queue from growing without bound
+void BenchContext::swapBuffers()
+{
+    if (m_window)
+        glfwSwapBuffers (m_window);
+    else
+        glFlush();
+}
+
+const char *BenchContext::backend() const
+{
+    return m_backend;
+}
+
+BenchContext::Api BenchContext::parseApi (const std::string &name)
+{
+    if (name == "native")      return Api::Native;
+    if (name == "egl")         return Api::Egl;
+    if (name == "osmesa")      return Api::OSMesa;
+    if (name == "surfaceless") return Api::Surfaceless;
+    return Api::Auto;
+}
+
+bool BenchContext::createWindow (Api api, int width, int height, const char *title)
+{
+    if (!glfwInit())
+        return false;
+
+    glfwWindowHint (GLFW_VISIBLE, GLFW_FALSE);
+    glfwWindowHint (GLFW_CONTEXT_VERSION_MAJOR, 4);
+    glfwWindowHint (GLFW_CONTEXT_VERSION_MINOR, 5);
+    glfwWindowHint (GLFW_OPENGL_PROFILE, GLFW_OPENGL_CORE_PROFILE);
+    if (api == Api::Egl)
+        glfwWindowHint (GLFW_CONTEXT_CREATION_API, GLFW_EGL_CONTEXT_API);
+    else if (api == Api::OSMesa)
+        glfwWindowHint (GLFW_CONTEXT_CREATION_API, GLFW_OSMESA_CONTEXT_API);
+
+    m_window = glfwCreateWindow (width, height, title, nullptr, nullptr);
+    if (!m_window)
+    {
+        glfwTerminate();
+        return false;
+    }
+
+    glfwMakeContextCurrent (m_window);
+    glfwSwapInterval (0);
+
+    if (!gladLoadGLLoader ((GLADloadproc)glfwGetProcAddress))
+        throw std::runtime_error ("Can't init glad");
+
+    m_backend = "glfw";
+    return true;
+}
+
+bool BenchContext::createSurfaceless (int width, int height)
+{
+#ifdef BENCH_HAS_EGL
+    auto getPlatformDisplay = reinterpret_cast <PFNEGLGETPLATFORMDISPLAYEXTPROC> (
+        eglGetProcAddress ("eglGetPlatformDisplayEXT"));
+    if (!getPlatformDisplay)
+        return false;
+
+    EGLDisplay display = getPlatformDisplay (EGL_PLATFORM_SURFACELESS_MESA, EGL_DEFAULT_DISPLAY, nullptr);
+    if (display == EGL_NO_DISPLAY || !eglInitialize (display, nullptr, nullptr))
+        return false;
+
+    const EGLint attributes[] =
+    {
+        EGL_CONTEXT_MAJOR_VERSION,       4,
+        EGL_CONTEXT_MINOR_VERSION,       5,
+        EGL_CONTEXT_OPENGL_PROFILE_MASK, EGL_CONTEXT_OPENGL_CORE_PROFILE_BIT,
+        EGL_NONE
+    };
+
+    EGLContext context = EGL_NO_CONTEXT;
+    if (eglBindAPI (EGL_OPENGL_API))
+        context = eglCreateContext (display, EGL_NO_CONFIG_KHR, EGL_NO_CONTEXT, attributes);
+
+    if (context == EGL_NO_CONTEXT || !eglMakeCurrent (display, EGL_NO_SURFACE, EGL_NO_SURFACE, context))
+    {
+        if (context != EGL_NO_CONTEXT)
+            eglDestroyContext (display, context);
+        eglTerminate (display);
+        return false;
+    }
+
+    m_display = display;
+    m_context = context;
+
+    if (!gladLoadGLLoader ((GLADloadproc)eglGetProcAddress))
+        throw std::runtime_error ("Can't init glad");
+
+    // There is no default framebuffer without a surface
+    glCreateRenderbuffers (2, m_renderbuffers);
+    glNamedRenderbufferStorage (m_renderbuffers[0], GL_RGBA8, width, height);
+    glNamedRenderbufferStorage (m_renderbuffers[1], GL_DEPTH24_STENCIL8, width, height);
+
+    glCreateFramebuffers (1, &m_framebuffer);
+    glNamedFramebufferRenderbuffer (m_framebuffer, GL_COLOR_ATTACHMENT0, GL_RENDERBUFFER, m_renderbuffers[0]);
+    glNamedFramebufferRenderbuffer (m_framebuffer, GL_DEPTH_STENCIL_ATTACHMENT, GL_RENDERBUFFER, m_renderbuffers[1]);
+    glBindFramebuffer (GL_FRAMEBUFFER, m_framebuffer);
+
+    m_backend = "egl-surfaceless";
+    return true;
+#else
+    (void)width;
+    (void)height;
+    return false;
+#endif
+}
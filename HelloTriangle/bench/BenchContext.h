@@ -0,0 +1,48 @@
+#ifndef BENCH_CONTEXT_INCLUDED
+#define BENCH_CONTEXT_INCLUDED
+
+#include <string>
+
+struct GLFWwindow;
+
+// A GL 4.5 core context for the benchmarks that never shows a window.
+// Native/Egl/OSMesa go through a hidden GLFW window with that context API;
+// Surfaceless uses EGL_MESA_platform_surfaceless directly and renders into
+// an offscreen framebuffer, for machines with Mesa but no display at all.
+// Auto tries GLFW first and falls back to Surfaceless
+class BenchContext
+{
+public:
+    enum class Api
+    {
+        Auto,
+        Native,
+        Egl,
+        OSMesa,
+        Surfaceless
+    };
+
+    BenchContext (Api api, int width, int height, const char *title);
+   ~BenchContext();
+
+    void        swapBuffers();
+    const char *backend() const;
+
+    static Api  parseApi (const std::string &name);
+
+private:
+    GLFWwindow *m_window;
+    void       *m_display;
+    void       *m_context;
+    unsigned    m_framebuffer;
+    unsigned    m_renderbuffers[2];
+    const char *m_backend;
+
+    bool        createWindow      (Api api, int width, int height, const char *title);
+    bool        createSurfaceless (int width, int height);
+
+    BenchContext             (const BenchContext &other) = delete;
+    BenchContext &operator = (const BenchContext &other) = delete;
+};
+
+#endif // !BENCH_CONTEXT_INCLUDED
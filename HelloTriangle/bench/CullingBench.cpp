@@ -0,0 +1,183 @@
+#include <iostream>
+#include <chrono>
+#include <random>
+#include <string>
+#include <vector>
+#include <functional>
+#include <cstdlib>
+#include <cstring>
+#include <cstdint>
+#include <algorithm>
+
+#include <glm/gtc/matrix_transform.hpp>
+
+#include "FrustumCuller.h"
+
+using Clock = std::chrono::steady_clock;
+
+struct Options
+{
+    size_t maxObjects = 1000000;
+    size_t passes     = 15;
+};
+
+static const float  WORLD_SIZE = 1000.0f;   // objects fill a cube this far either side of the camera
+static const float  NEAR_RANGE = 125.0f;    // far plane of the short range view
+static const size_t VIEW_COUNT = 8;         // directions the camera turns through, one a pass
+static const float  MOVE_SHARE = 0.1f;      // of the objects moved a frame in the dynamic run
+
+static Options                   parseOptions  (int argc, char **argv);
+static std::vector <BoundingBox> makeBoxes     (size_t count, std::mt19937 &random);
+static Frustum                   makeView      (size_t view, float range = WORLD_SIZE);
+static void                      run           (size_t count, size_t passes);
+static double                    medianSeconds (size_t passes, const std::function <void (size_t)> &work);
+
+
+// Culls boxes spread through a cube around a camera that turns a step a
+// pass, from a thousand objects to --max, flat with SIMD, one at a time and
+// through the BVH, then with a tenth of the objects moving every frame.
+// Prints the median cull time and objects culled a millisecond
+int main (int argc, char **argv)
+{
+    const Options options = parseOptions (argc, argv);
+
+    std::cout << "SIMD width " << FrustumCuller::simdWidth() << ", median of " << options.passes << " views\n";
+
+    for (size_t count = 1000; count <= options.maxObjects; count *= 10)
+        run (count, options.passes);
+    return 0;
+}
+
+static Options parseOptions (int argc, char **argv)
+{
+    Options options;
+    for (int i = 1; i + 1 < argc; i += 2)
+    {
+        const size_t value = strtoul (argv[i + 1], nullptr, 10);
+
+        if      (strcmp (argv[i], "--max")    == 0) options.maxObjects = value;
+        else if (strcmp (argv[i], "--passes") == 0) options.passes     = value;
+    }
+    options.passes = std::max <size_t> (options.passes, 1);
+    return options;
+}
+
+// Boxes from half a unit to five across, centers uniform in the world cube
+static std::vector <BoundingBox> makeBoxes (size_t count, std::mt19937 &random)
+{
+    std::uniform_real_distribution <float> position (-WORLD_SIZE, WORLD_SIZE);
+    std::uniform_real_distribution <float> size (0.25f, 2.5f);
+
+    std::vector <BoundingBox> boxes (count);
+    for (BoundingBox &box : boxes)
+    {
+        const glm::vec3 center (position (random), position (random), position (random));
+        const glm::vec3 extent (size (random), size (random), size (random));
+        box = { center - extent, center + extent };
+    }
+    return boxes;
+}
+
+// A 60 degree camera at the origin. Seeing as far as the world reaches it
+// takes in about a tenth of it, at NEAR_RANGE a five thousandth
+static Frustum makeView (size_t view, float range)
+{
+    const float     yaw       = glm::two_pi <float>() * (view % VIEW_COUNT) / VIEW_COUNT;
+    const glm::vec3 direction (std::sin (yaw), 0.2f, -std::cos (yaw));
+    const glm::mat4 projection = glm::perspective (glm::radians (60.0f), 16.0f / 9.0f, 0.1f, range);
+    const glm::mat4 viewMatrix = glm::lookAt (glm::vec3 (0.0f), direction, glm::vec3 (0.0f, 1.0f, 0.0f));
+    return Frustum::fromViewProjection (projection * viewMatrix);
+}
+
+static void run (size_t count, size_t passes)
+{
+    std::mt19937 random (static_cast <std::mt19937::result_type> (count));
+    std::vector <BoundingBox> boxes = makeBoxes (count, random);
+
+    FrustumCuller flat;
+    FrustumCuller hierarchical (FrustumCuller::Hierarchy::Bvh);
+    FrustumCuller moving (FrustumCuller::Hierarchy::Bvh, 1.0f);
+
+    Clock::time_point start = Clock::now();
+    for (const BoundingBox &box : boxes)
+        flat.add (box);
+    Clock::time_point flatBuilt = Clock::now();
+    for (const BoundingBox &box : boxes)
+        hierarchical.add (box);
+    Clock::time_point inserted = Clock::now();
+    hierarchical.rebuild();
+    Clock::time_point rebuilt = Clock::now();
+
+    for (const BoundingBox &box : boxes)
+        moving.add (box);
+    moving.rebuild();
+
+    std::vector <uint32_t> visible (flat.capacity());
+    size_t visibleCount = 0;
+
+    const double scalar = medianSeconds (passes, [&] (size_t pass)
+    {
+        visibleCount = flat.cullScalar (makeView (pass), visible.data());
+    });
+    const double simd = medianSeconds (passes, [&] (size_t pass)
+    {
+        visibleCount = flat.cull (makeView (pass), visible.data());
+    });
+    const double bvh = medianSeconds (passes, [&] (size_t pass)
+    {
+        visibleCount = hierarchical.cull (makeView (pass), visible.data());
+    });
+
+    size_t nearCount = 0;
+    const double simdNear = medianSeconds (passes, [&] (size_t pass)
+    {
+        nearCount = flat.cull (makeView (pass, NEAR_RANGE), visible.data());
+    });
+    const double bvhNear = medianSeconds (passes, [&] (size_t pass)
+    {
+        nearCount = hierarchical.cull (makeView (pass, NEAR_RANGE), visible.data());
+    });
+
+    // Each frame moves a tenth of the objects up to a unit each way, then culls
+    std::uniform_int_distribution <size_t> pick (0, count - 1);
+    std::uniform_real_distribution <float> step (-1.0f, 1.0f);
+    const size_t moves = std::max <size_t> (size_t (count * MOVE_SHARE), 1);
+    const double dynamic = medianSeconds (passes, [&] (size_t pass)
+    {
+        for (size_t i = 0; i < moves; ++i)
+        {
+            const size_t    object = pick (random);
+            const glm::vec3 offset (step (random), step (random), step (random));
+            boxes[object] = { boxes[object].min + offset, boxes[object].max + offset };
+            moving.update (static_cast <uint32_t> (object), boxes[object]);
+        }
+        visibleCount = moving.cull (makeView (pass), visible.data());
+    });
+
+    const double ms = 1000.0;
+    std::cout << count << " objects, " << visibleCount << " visible in the last view, " << nearCount
+              << " at short range, BVH height " << hierarchical.hierarchy()->height() << ":\n"
+              << "  build: flat " << std::chrono::duration <double> (flatBuilt - start).count() * ms
+              << " ms, BVH inserts " << std::chrono::duration <double> (inserted - flatBuilt).count() * ms
+              << " ms, rebuild " << std::chrono::duration <double> (rebuilt - inserted).count() * ms << " ms\n"
+              << "  scalar  " << scalar  * ms << " ms, " << count / (scalar  * ms) << " objects/ms\n"
+              << "  SIMD    " << simd    * ms << " ms, " << count / (simd    * ms) << " objects/ms\n"
+              << "  BVH     " << bvh     * ms << " ms, " << count / (bvh     * ms) << " objects/ms\n"
+              << "  short range: SIMD " << simdNear * ms << " ms, " << count / (simdNear * ms) << " objects/ms, BVH "
+              << bvhNear * ms << " ms, " << count / (bvhNear * ms) << " objects/ms\n"
+              << "  dynamic " << dynamic * ms << " ms, " << count / (dynamic * ms) << " objects/ms, "
+              << moves << " moves a frame included\n";
+}
+
+static double medianSeconds (size_t passes, const std::function <void (size_t)> &work)
+{
+    std::vector <double> seconds;
+    for (size_t pass = 0; pass < passes; ++pass)
+    {
+        Clock::time_point start = Clock::now();
+        work (pass);
+        seconds.push_back (std::chrono::duration <double> (Clock::now() - start).count());
+    }
+    std::sort (seconds.begin(), seconds.end());
+    return seconds[seconds.size() / 2];
+}
@@ -0,0 +1,173 @@
+#include <iostream>
+#include <fstream>
+#include <chrono>
+#include <string>
+#include <vector>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <cstdint>
+#include <algorithm>
+#include <filesystem>
+#include <sys/stat.h>
+
+#include "MappedFile.h"
+
+#ifdef _WIN32
+#define fileno _fileno
+#endif
+
+namespace fs = std::filesystem;
+using Clock  = std::chrono::steady_clock;
+
+struct Options
+{
+    size_t smallFiles = 2000;
+    size_t smallSize  = 2 * 1024;
+    size_t largeFiles = 4;
+    size_t largeSize  = 32 * 1024 * 1024;
+    size_t passes     = 5;
+};
+
+using Loader = uint64_t (*) (const std::string &path);
+
+static Options  parseOptions  (int argc, char **argv);
+static std::vector <std::string> writeFiles (const fs::path &dir, const char *prefix,
+                                             size_t count, size_t size);
+static void     run           (const char *name, const std::vector <std::string> &files,
+                               size_t bytes, size_t passes, Loader loader);
+static uint64_t loadWithFread (const std::string &path);
+static uint64_t loadWithFile  (const std::string &path);
+static uint64_t loadWithMmap  (const std::string &path);
+static uint64_t loadWithCache (const std::string &path);
+static uint64_t checksum      (const char *data, size_t size);
+
+
+int main (int argc, char **argv)
+{
+    const Options options = parseOptions (argc, argv);
+    const fs::path dir = fs::temp_directory_path() / "file_load_bench";
+
+    fs::remove_all (dir);
+    fs::create_directories (dir);
+
+    const auto small = writeFiles (dir, "small", options.smallFiles, options.smallSize);
+    const auto large = writeFiles (dir, "large", options.largeFiles, options.largeSize);
+
+    std::cout << options.smallFiles << " small files of " << options.smallSize << " bytes:\n";
+    run ("fread",      small, options.smallFiles * options.smallSize, options.passes, loadWithFread);
+    run ("MappedFile", small, options.smallFiles * options.smallSize, options.passes, loadWithFile);
+    run ("mmap",       small, options.smallFiles * options.smallSize, options.passes, loadWithMmap);
+    run ("cached",     small, options.smallFiles * options.smallSize, options.passes, loadWithCache);
+
+    std::cout << options.largeFiles << " large files of " << options.largeSize << " bytes:\n";
+    run ("fread",      large, options.largeFiles * options.largeSize, options.passes, loadWithFread);
+    run ("MappedFile", large, options.largeFiles * options.largeSize, options.passes, loadWithFile);
+    run ("mmap",       large, options.largeFiles * options.largeSize, options.passes, loadWithMmap);
+    run ("cached",     large, options.largeFiles * options.largeSize, options.passes, loadWithCache);
+
+    MappedFileCache::global().clear();
+    fs::remove_all (dir);
+    return 0;
+}
+
+static Options parseOptions (int argc, char **argv)
+{
+    Options options;
+    for (int i = 1; i + 1 < argc; i += 2)
+    {
+        const size_t value = strtoul (argv[i + 1], nullptr, 10);
+
+        if      (strcmp (argv[i], "--small-files") == 0) options.smallFiles = value;
+        else if (strcmp (argv[i], "--small-size")  == 0) options.smallSize  = value;
+        else if (strcmp (argv[i], "--large-files") == 0) options.largeFiles = value;
+        else if (strcmp (argv[i], "--large-size")  == 0) options.largeSize  = value;
+        else if (strcmp (argv[i], "--passes")      == 0) options.passes     = value;
+    }
+    options.passes = std::max <size_t> (options.passes, 1);
+    return options;
+}
+
+static std::vector <std::string> writeFiles (const fs::path &dir, const char *prefix,
+                                             size_t count, size_t size)
+{
+    std::vector <std::string> files;
+    std::string contents (size, '\0');
+    for (size_t i = 0; i < size; ++i)
+        contents[i] = static_cast <char> ('a' + i % 26);
+
+    for (size_t i = 0; i < count; ++i)
+    {
+        files.push_back ((dir / (std::string (prefix) + std::to_string (i) + ".glsl")).string());
+        std::ofstream (files.back(), std::ios::binary).write (contents.data(), contents.size());
+    }
+    return files;
+}
+
+// The first pass warms the page cache, the rest are timed
+static void run (const char *name, const std::vector <std::string> &files, size_t bytes,
+                 size_t passes, Loader loader)
+{
+    if (files.empty())
+        return;
+
+    uint64_t sum = 0;
+    for (const auto &file : files)
+        sum += loader (file);
+
+    Clock::time_point start = Clock::now();
+    for (size_t pass = 0; pass < passes; ++pass)
+        for (const auto &file : files)
+            sum += loader (file);
+    const double seconds = std::chrono::duration <double> (Clock::now() - start).count() / passes;
+
+    std::cout << "  " << name << ": " << seconds * 1000.0 << " ms per pass, "
+              << bytes / (1024.0 * 1024.0) / seconds << " MB/s (checksum " << sum % 1000 << ")\n";
+}
+
+// The loading path GLSLProgram used before: fstat, zeroed heap copy, fread
+static uint64_t loadWithFread (const std::string &path)
+{
+    FILE *file = fopen (path.c_str(), "rb");
+    if (!file)
+        return 0;
+
+    struct stat info = {};
+    fstat (fileno (file), &info);
+
+    char *data = new char [info.st_size + 1] {};
+    const size_t size = fread (data, 1, info.st_size, file);
+    fclose (file);
+
+    const uint64_t sum = checksum (data, size);
+    delete [] data;
+    return sum;
+}
+
+// What shaders get: a heap copy below SMALL_FILE_SIZE, a mapping above
+static uint64_t loadWithFile (const std::string &path)
+{
+    MappedFile file (path);
+    return checksum (file.data(), file.size());
+}
+
+// A real mapping whatever the size
+static uint64_t loadWithMmap (const std::string &path)
+{
+    MappedFile file (path, MappedFile::Access::ReadOnly, 0);
+    return checksum (file.data(), file.size());
+}
+
+static uint64_t loadWithCache (const std::string &path)
+{
+    std::shared_ptr <const MappedFile> file = MappedFileCache::global().open (path);
+    return file ? checksum (file->data(), file->size()) : 0;
+}
+
+static uint64_t checksum (const char *data, size_t size)
+{
+    uint64_t sum = 0;
+    for (size_t i = 0; i < size; ++i)
+        sum += static_cast <unsigned char> (data[i]);
+    return sum;
+}
@@ -0,0 +1,381 @@
+#include <glad/glad.h>
+
+#include <iostream>
+#include <chrono>
+#include <random>
+#include <memory>
+#include <string>
+#include <vector>
+#include <thread>
+#include <cmath>
+#include <cstdlib>
+#include <cstring>
+#include <cstddef>
+#include <cstdint>
+#include <algorithm>
+#include <stdexcept>
+
+#include <glm/gtc/matrix_transform.hpp>
+
+#include "GLSLProgram.h"
+#include "GLStateCache.h"
+#include "VertexLayout.h"
+#include "DrawQueue.h"
+#include "FrustumCuller.h"
+#include "JobSystem.h"
+#include "BenchContext.h"
+
+using Clock = std::chrono::steady_clock;
+
+struct Options
+{
+    size_t      objects = 100000;
+    size_t      frames  = 120;
+    size_t      warmup  = 10;
+    size_t      threads = JobSystem::defaultThreadCount();
+    std::string api     = "auto";
+};
+
+static const size_t OBJECTS_PER_JOB = 4096;
+static const int    PROGRAMS        = 4;
+static const int    VERTEX_ARRAYS   = 16;
+static const float  WORLD_SIZE      = 500.0f;       // objects orbit the camera this far out at most
+static const float  FRAME_SECONDS   = 1.0f / 60.0f;
+
+// Position and color, 3 floats each
+static const VertexLayout TRIANGLE_LAYOUT = { { 0, 3, VertexEncoding::Float }, { 1, 3, VertexEncoding::Float } };
+
+// One frame in flight: the camera, then what every job thread recorded
+struct Frame
+{
+    size_t                      index = 0;
+    glm::vec3                   eye;
+    Frustum                     frustum;
+    std::vector <CommandBuffer> commands;
+    JobSystem::Counter          viewed;
+    JobSystem::Counter          done;
+};
+
+struct RunResult
+{
+    double serialMs;
+    double pipelinedMs;
+    double buildMs;
+    size_t steals;
+};
+
+// Objects circling the camera at their own speeds. Every frame each job
+// takes OBJECTS_PER_JOB of them, moves them, updates their boxes in its own
+// culler, culls and records the visible ones. The triangles drawn are the
+// small fixed ones of RenderBench's state-sort scene, only the CPU side
+// follows the objects
+class PipelineScene
+{
+public:
+    explicit PipelineScene (size_t count);
+   ~PipelineScene();
+
+    // Starts frame.index's jobs, done once frame.done is
+    void       build (JobSystem &jobs, Frame &frame);
+    // Issues the frame's commands
+    void       replay (const Frame &frame);
+
+private:
+    struct Object
+    {
+        float     radius;
+        float     angle;
+        float     speed;
+        float     height;
+        glm::vec3 extent;
+        uint32_t  variant;
+    };
+
+    struct Chunk
+    {
+        size_t                  first;
+        size_t                  count;
+        FrustumCuller           culler;
+        std::vector <glm::vec3> centers;
+        std::vector <uint32_t>  visible;
+    };
+
+    std::vector <Object>                  m_objects;
+    std::vector <std::unique_ptr <Chunk>> m_chunks;
+    GLSLProgram                           m_programs [PROGRAMS];
+    GLuint                                m_vaos     [VERTEX_ARRAYS] = {};
+    GLuint                                m_vbo = 0;
+    DrawQueue                             m_queue;
+
+    void       view (Frame &frame) const;
+    void       update (Chunk &chunk, const Frame &frame, CommandBuffer &commands);
+};
+
+static Options   parseOptions (int argc, char **argv);
+static RunResult run (BenchContext &context, PipelineScene &scene, size_t threads, const Options &options);
+static double    median (std::vector <double> samples);
+static double    millisecondsSince (Clock::time_point start);
+
+
+// Renders the same animated scene with 1 to --threads job threads, first
+// building each frame and then drawing it, then building frame N + 1 on the
+// jobs while the GL thread draws frame N. Prints the median frame time of
+// both, the median time to build a frame on its own, its speedup over one
+// thread and how many jobs were stolen
+int main (int argc, char **argv)
+{
+    const Options options = parseOptions (argc, argv);
+
+    try
+    {
+        BenchContext context (BenchContext::parseApi (options.api), 640, 360, "FramePipelineBench");
+        std::cout << "GL_RENDERER: " << glGetString (GL_RENDERER) << " (" << context.backend() << "), "
+                  << options.objects << " objects, " << std::thread::hardware_concurrency() << " cores\n";
+
+        PipelineScene scene (options.objects);
+
+        double singleBuildMs = 0.0;
+        for (size_t threads = 1; threads <= options.threads; ++threads)
+        {
+            const RunResult result = run (context, scene, threads, options);
+            if (threads == 1)
+                singleBuildMs = result.buildMs;
+
+            std::cout << threads << " thread" << (threads > 1 ? "s: " : ":  ")
+                      << "frame p50 serial " << result.serialMs << " ms, pipelined " << result.pipelinedMs
+                      << " ms, build " << result.buildMs << " ms (x" << singleBuildMs / result.buildMs
+                      << "), " << result.steals << " steals\n";
+        }
+    }
+    catch (const GLSLProgramException &e)
+    {
+        std::cerr << e.what() << std::endl;
+        return 1;
+    }
+    catch (const std::exception &e)
+    {
+        std::cerr << e.what() << std::endl;
+        return 1;
+    }
+
+    return 0;
+}
+
+PipelineScene::PipelineScene (size_t count)
+{
+    for (GLSLProgram &program : m_programs)
+    {
+        program.compileShader (SHADER_DIR "/triangle.vert");
+        program.compileShader (SHADER_DIR "/triangle.frag");
+        program.link();
+    }
+
+    std::mt19937 random (7);
+    std::uniform_real_distribution <float> unit (0.0f, 1.0f);
+
+    std::vector <float> vertices;
+    for (int i = 0; i < 64; ++i)
+    {
+        const float x = 1.9f * unit (random) - 0.95f, y = 1.9f * unit (random) - 0.95f;
+        for (int k = 0; k < 3; ++k)
+            vertices.insert (vertices.end(), { x + 0.05f * unit (random), y + 0.05f * unit (random), unit (random),
+                                               unit (random), unit (random), unit (random) });
+    }
+
+    glCreateBuffers (1, &m_vbo);
+    glNamedBufferStorage (m_vbo, vertices.size() * sizeof (float), vertices.data(), 0);
+
+    glCreateVertexArrays (VERTEX_ARRAYS, m_vaos);
+    for (GLuint vao : m_vaos)
+    {
+        glVertexArrayVertexBuffer (vao, 0, m_vbo, 0, TRIANGLE_LAYOUT.stride());
+        TRIANGLE_LAYOUT.apply (vao);
+    }
+
+    std::uniform_int_distribution <uint32_t> pick (0, 1 << 20);
+    for (size_t i = 0; i < count; ++i)
+    {
+        const float size = 0.5f + 2.0f * unit (random);
+        m_objects.push_back ({ WORLD_SIZE * std::sqrt (unit (random)), glm::two_pi <float>() * unit (random),
+                               unit (random) - 0.5f, 100.0f * unit (random) - 50.0f,
+                               glm::vec3 (size), pick (random) });
+    }
+
+    for (size_t first = 0; first < count; first += OBJECTS_PER_JOB)
+    {
+        std::unique_ptr <Chunk> chunk (new Chunk);
+        chunk->first = first;
+        chunk->count = std::min (OBJECTS_PER_JOB, count - first);
+        chunk->centers.resize (chunk->count);
+        for (size_t i = 0; i < chunk->count; ++i)
+            chunk->culler.add ({ glm::vec3 (0.0f), glm::vec3 (0.0f) });
+        chunk->visible.resize (chunk->culler.capacity());
+        m_chunks.push_back (std::move (chunk));
+    }
+}
+
+PipelineScene::~PipelineScene()
+{
+    GLStateCache::current().invalidate();
+    glDeleteVertexArrays (VERTEX_ARRAYS, m_vaos);
+    glDeleteBuffers (1, &m_vbo);
+}
+
+// The camera job first, then a job a chunk after it
+void PipelineScene::build (JobSystem &jobs, Frame &frame)
+{
+    for (CommandBuffer &commands : frame.commands)
+        commands.clear();
+
+    PipelineScene *scene  = this;
+    Frame         *work   = &frame;
+    JobSystem     *system = &jobs;
+
+    jobs.run ([scene, work] { scene->view (*work); }, &frame.viewed);
+    for (const std::unique_ptr <Chunk> &owned : m_chunks)
+    {
+        Chunk *chunk = owned.get();
+        jobs.run ([scene, work, system, chunk]
+        {
+            scene->update (*chunk, *work, work->commands[system->currentThread()]);
+        }, &frame.done, &frame.viewed);
+    }
+}
+
+void PipelineScene::replay (const Frame &frame)
+{
+    for (const CommandBuffer &commands : frame.commands)
+        m_queue.submit (commands);
+    m_queue.execute();
+}
+
+// A 60 degree camera at the origin turning a full circle every 20 seconds
+void PipelineScene::view (Frame &frame) const
+{
+    const float     time       = frame.index * FRAME_SECONDS;
+    const float     yaw        = glm::two_pi <float>() * time / 20.0f;
+    const glm::vec3 direction (std::sin (yaw), -0.1f, -std::cos (yaw));
+    const glm::mat4 projection = glm::perspective (glm::radians (60.0f), 16.0f / 9.0f, 0.1f, WORLD_SIZE);
+
+    frame.eye     = glm::vec3 (0.0f, 10.0f, 0.0f);
+    frame.frustum = Frustum::fromViewProjection (
+        projection * glm::lookAt (frame.eye, frame.eye + direction, glm::vec3 (0.0f, 1.0f, 0.0f)));
+}
+
+void PipelineScene::update (Chunk &chunk, const Frame &frame, CommandBuffer &commands)
+{
+    const float time = frame.index * FRAME_SECONDS;
+    for (size_t i = 0; i < chunk.count; ++i)
+    {
+        const Object   &object = m_objects[chunk.first + i];
+        const float     angle  = object.angle + object.speed * time;
+        const glm::vec3 center (object.radius * std::cos (angle), object.height, object.radius * std::sin (angle));
+
+        chunk.centers[i] = center;
+        chunk.culler.update (static_cast <uint32_t> (i), { center - object.extent, center + object.extent });
+    }
+
+    const size_t visibleCount = chunk.culler.cull (frame.frustum, chunk.visible.data());
+
+    for (size_t i = 0; i < visibleCount; ++i)
+    {
+        const uint32_t id      = chunk.visible[i];
+        const uint32_t variant = m_objects[chunk.first + id].variant;
+        const GLuint   program = m_programs[variant % PROGRAMS].getHandle();
+        const GLuint   vao     = m_vaos[(variant / PROGRAMS) % VERTEX_ARRAYS];
+        const float    depth   = glm::distance (chunk.centers[id], frame.eye) / WORLD_SIZE;
+        const uint64_t key     = DrawQueue::makeKey (program, vao, depth);
+
+        commands.record (key, { { program, vao, 0, false, false }, GL_TRIANGLES, 3, 0, 3 * (variant % 64), 0, 1 });
+    }
+}
+
+static Options parseOptions (int argc, char **argv)
+{
+    Options options;
+    for (int i = 1; i + 1 < argc; i += 2)
+    {
+        const char *name  = argv[i];
+        const char *value = argv[i + 1];
+
+        if      (strcmp (name, "--objects") == 0) options.objects = std::max <size_t> (strtoul (value, nullptr, 10), 1);
+        else if (strcmp (name, "--frames")  == 0) options.frames  = std::max <size_t> (strtoul (value, nullptr, 10), 1);
+        else if (strcmp (name, "--warmup")  == 0) options.warmup  = strtoul (value, nullptr, 10);
+        else if (strcmp (name, "--threads") == 0) options.threads = std::max <size_t> (strtoul (value, nullptr, 10), 1);
+        else if (strcmp (name, "--api")     == 0) options.api     = value;
+    }
+    return options;
+}
+
+// The serial pass times each frame from the start of its build to its swap,
+// the pipelined one from starting the next frame's build to having it done,
+// the current frame drawn in between. Both render the same frame indices
+static RunResult run (BenchContext &context, PipelineScene &scene, size_t threads, const Options &options)
+{
+    JobSystem jobs (threads);
+    Frame     frames[2];
+    for (Frame &frame : frames)
+        frame.commands.resize (jobs.threadCount());
+
+    const size_t total  = options.warmup + options.frames;
+    RunResult    result = { 0.0, 0.0, 0.0, 0 };
+
+    std::vector <double> serial, pipelined, build;
+    for (size_t index = 0; index < total; ++index)
+    {
+        Frame &frame = frames[0];
+        frame.index = index;
+
+        Clock::time_point start = Clock::now();
+        scene.build (jobs, frame);
+        jobs.wait (frame.done);
+        const double buildMs = millisecondsSince (start);
+
+        scene.replay (frame);
+        context.swapBuffers();
+
+        if (index >= options.warmup)
+        {
+            serial.push_back (millisecondsSince (start));
+            build.push_back (buildMs);
+        }
+    }
+
+    jobs.resetStats();
+    frames[0].index = 0;
+    scene.build (jobs, frames[0]);
+    jobs.wait (frames[0].done);
+
+    for (size_t index = 0; index < total; ++index)
+    {
+        Frame &frame = frames[index % 2];
+        Frame &next  = frames[(index + 1) % 2];
+        next.index = index + 1;
+
+        Clock::time_point start = Clock::now();
+        scene.build (jobs, next);
+        scene.replay (frame);
+        context.swapBuffers();
+        jobs.wait (next.done);
+
+        if (index >= options.warmup)
+            pipelined.push_back (millisecondsSince (start));
+    }
+
+    result.serialMs    = median (serial);
+    result.pipelinedMs = median (pipelined);
+    result.buildMs     = median (build);
+    result.steals      = jobs.stats().steals;
+    return result;
+}
+
+static double median (std::vector <double> samples)
+{
+    std::sort (samples.begin(), samples.end());
+    return samples[samples.size() / 2];
+}
+
+static double millisecondsSince (Clock::time_point start)
+{
+    return std::chrono::duration <double, std::milli> (Clock::now() - start).count();
+}
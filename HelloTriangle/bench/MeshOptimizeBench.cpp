@@ -0,0 +1,165 @@
+#include <iostream>
+#include <chrono>
+#include <random>
+#include <string>
+#include <vector>
+#include <array>
+#include <cstdlib>
+#include <cstring>
+#include <cstdint>
+#include <algorithm>
+
+#include "MeshOptimizer.h"
+
+using Clock = std::chrono::steady_clock;
+
+struct Options
+{
+    size_t grid   = 700;    // quads a side, two triangles each
+    size_t passes = 3;
+};
+
+// A mesh as the steps hand it on
+struct Mesh
+{
+    std::vector <char>     vertices;   // position and color, 3 floats each
+    std::vector <uint32_t> indices;
+};
+
+static const size_t STRIDE = 6 * sizeof (float);
+
+static Options parseOptions  (int argc, char **argv);
+static Mesh    makeGridSoup  (size_t grid, bool isShuffled);
+static void    run           (const char *name, const Mesh &soup, size_t passes);
+
+
+// Welds, cache-orders and fetch-orders a grid sent as a triangle soup, the
+// worst case of an unindexed mesh, once in row order and once shuffled.
+// Prints the time of each step and ACMR/ATVR for FIFO caches of 16 and 32
+int main (int argc, char **argv)
+{
+    const Options options = parseOptions (argc, argv);
+
+    std::cout << options.grid << "x" << options.grid << " grid, " << 2 * options.grid * options.grid << " triangles\n";
+
+    run ("row order", makeGridSoup (options.grid, false), options.passes);
+    run ("shuffled",  makeGridSoup (options.grid, true),  options.passes);
+    return 0;
+}
+
+static Options parseOptions (int argc, char **argv)
+{
+    Options options;
+    for (int i = 1; i + 1 < argc; i += 2)
+    {
+        const size_t value = strtoul (argv[i + 1], nullptr, 10);
+
+        if      (strcmp (argv[i], "--grid")   == 0) options.grid   = value;
+        else if (strcmp (argv[i], "--passes") == 0) options.passes = value;
+    }
+    options.grid   = std::max <size_t> (options.grid,   1);
+    options.passes = std::max <size_t> (options.passes, 1);
+    return options;
+}
+
+// Every triangle carries its own three vertices, no indices
+static Mesh makeGridSoup (size_t grid, bool isShuffled)
+{
+    std::vector <std::array <uint32_t, 3>> order;
+    for (uint32_t y = 0; y < grid; ++y)
+    {
+        for (uint32_t x = 0; x < grid; ++x)
+        {
+            const uint32_t corner = y * static_cast <uint32_t> (grid + 1) + x;
+            const uint32_t below  = corner + static_cast <uint32_t> (grid + 1);
+            order.push_back ({ corner, below, corner + 1 });
+            order.push_back ({ corner + 1, below, below + 1 });
+        }
+    }
+    if (isShuffled)
+        std::shuffle (order.begin(), order.end(), std::mt19937 (42));
+
+    Mesh mesh;
+    for (const std::array <uint32_t, 3> &triangle : order)
+    {
+        for (uint32_t vertex : triangle)
+        {
+            const float x = float (vertex % (grid + 1)) / grid;
+            const float y = float (vertex / (grid + 1)) / grid;
+            const float values[6] = { x, y, 0.0f, x, y, 1.0f - x };
+            mesh.vertices.insert (mesh.vertices.end(), reinterpret_cast <const char *> (values),
+                                  reinterpret_cast <const char *> (values + 6));
+        }
+    }
+    return mesh;
+}
+
+static void run (const char *name, const Mesh &soup, size_t passes)
+{
+    const size_t vertexCount = soup.vertices.size() / STRIDE;
+    const size_t indexCount  = vertexCount;
+
+    double weldSeconds = 1e9, cacheSeconds = 1e9, fetchSeconds = 1e9;
+    Mesh   mesh;
+    for (size_t pass = 0; pass < passes; ++pass)
+    {
+        Clock::time_point start = Clock::now();
+        const MeshStream stream = { soup.vertices.data(), STRIDE, STRIDE };
+        std::vector <uint32_t> remap (vertexCount);
+        const size_t unique = generateVertexRemap (remap.data(), nullptr, indexCount, vertexCount, &stream, 1);
+
+        mesh.indices.resize (indexCount);
+        remapIndexBuffer (mesh.indices.data(), nullptr, indexCount, remap.data());
+        mesh.vertices.resize (unique * STRIDE);
+        remapVertexBuffer (mesh.vertices.data(), soup.vertices.data(), vertexCount, STRIDE, remap.data());
+        Clock::time_point welded = Clock::now();
+
+        optimizeVertexCache (mesh.indices.data(), mesh.indices.data(), indexCount, unique);
+        Clock::time_point ordered = Clock::now();
+
+        std::vector <uint32_t> fetch (unique);
+        optimizeVertexFetchRemap (fetch.data(), mesh.indices.data(), indexCount, unique);
+        remapIndexBuffer (mesh.indices.data(), mesh.indices.data(), indexCount, fetch.data());
+        std::vector <char> fetched (unique * STRIDE);
+        remapVertexBuffer (fetched.data(), mesh.vertices.data(), unique, STRIDE, fetch.data());
+        mesh.vertices.swap (fetched);
+        Clock::time_point end = Clock::now();
+
+        weldSeconds  = std::min (weldSeconds,  std::chrono::duration <double> (welded - start).count());
+        cacheSeconds = std::min (cacheSeconds, std::chrono::duration <double> (ordered - welded).count());
+        fetchSeconds = std::min (fetchSeconds, std::chrono::duration <double> (end - ordered).count());
+    }
+
+    const size_t unique   = mesh.vertices.size() / STRIDE;
+    const double megaTris = indexCount / 3 / 1e6;
+    std::cout << name << ":\n"
+              << "  weld " << weldSeconds * 1000.0 << " ms (" << megaTris / weldSeconds << " M triangles/s), "
+              << vertexCount << " -> " << unique << " vertices\n"
+              << "  vertex cache " << cacheSeconds * 1000.0 << " ms (" << megaTris / cacheSeconds << " M triangles/s)\n"
+              << "  vertex fetch " << fetchSeconds * 1000.0 << " ms\n";
+
+    // Before is the soup itself: every corner its own vertex
+    std::vector <uint32_t> sequential (indexCount);
+    for (size_t i = 0; i < indexCount; ++i)
+        sequential[i] = static_cast <uint32_t> (i);
+
+    // The welded mesh in the soup's triangle order, to tell the reordering's share
+    std::vector <uint32_t> welded (indexCount);
+    {
+        const MeshStream stream = { soup.vertices.data(), STRIDE, STRIDE };
+        std::vector <uint32_t> remap (vertexCount);
+        generateVertexRemap (remap.data(), nullptr, indexCount, vertexCount, &stream, 1);
+        remapIndexBuffer (welded.data(), nullptr, indexCount, remap.data());
+    }
+
+    for (unsigned cacheSize : { 16u, 32u })
+    {
+        const VertexCacheStats soupStats      = analyzeVertexCache (sequential.data(),   indexCount, vertexCount, cacheSize);
+        const VertexCacheStats weldedStats    = analyzeVertexCache (welded.data(),       indexCount, unique, cacheSize);
+        const VertexCacheStats optimizedStats = analyzeVertexCache (mesh.indices.data(), indexCount, unique, cacheSize);
+
+        std::cout << "  FIFO " << cacheSize << ": ACMR " << soupStats.acmr << " soup, " << weldedStats.acmr
+                  << " welded, " << optimizedStats.acmr << " optimized; ATVR " << weldedStats.atvr << " -> "
+                  << optimizedStats.atvr << "\n";
+    }
+}
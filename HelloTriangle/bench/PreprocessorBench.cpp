@@ -0,0 +1,150 @@
+#include <iostream>
+#include <fstream>
+#include <chrono>
+#include <random>
+#include <string>
+#include <vector>
+#include <cstdlib>
+#include <cstring>
+#include <algorithm>
+#include <filesystem>
+
+#include "ShaderPreprocessor.h"
+
+namespace fs = std::filesystem;
+using Clock  = std::chrono::steady_clock;
+
+struct Options
+{
+    size_t includeFiles = 2000;
+    size_t rootShaders  = 64;
+    size_t fanOut       = 4;
+    size_t iterations   = 20;
+};
+
+static Options     parseOptions    (int argc, char **argv);
+static void        writeIncludeGraph (const fs::path &dir, const Options &options);
+static double      secondsSince    (Clock::time_point start);
+
+
+int main (int argc, char **argv)
+{
+    const Options options = parseOptions (argc, argv);
+    const fs::path dir = fs::temp_directory_path() / "preprocessor_bench";
+
+    fs::remove_all (dir);
+    fs::create_directories (dir / "include");
+    writeIncludeGraph (dir, options);
+
+    ShaderPreprocessor preprocessor ((dir / "include").string());
+    ShaderDefines defines;
+    defines.set ("LIGHTING").set ("SKINNING").set ("UNUSED_FLAG");
+
+    size_t outputBytes = 0, files = 0;
+
+    Clock::time_point start = Clock::now();
+    for (size_t i = 0; i < options.rootShaders; ++i)
+    {
+        auto result = preprocessor.process ((dir / ("root" + std::to_string (i) + ".vert")).string(), defines);
+        outputBytes += result.source.size();
+        files       += result.files.size();
+    }
+    const double cold = secondsSince (start);
+
+    start = Clock::now();
+    for (size_t iteration = 0; iteration < options.iterations; ++iteration)
+        for (size_t i = 0; i < options.rootShaders; ++i)
+            preprocessor.process ((dir / ("root" + std::to_string (i) + ".vert")).string(), defines);
+    const double warm = secondsSince (start) / options.iterations;
+
+    ShaderPermutations permutations;
+    permutations.addSwitch ("LIGHTING").addSwitch ("SKINNING").addSwitch ("FOG")
+                .addAxis ("UNUSED_FLAG", { "", "1", "2" });
+
+    size_t variants = 0, unique = 0;
+    start = Clock::now();
+    for (size_t i = 0; i < options.rootShaders; ++i)
+    {
+        auto set = preprocessor.processPermutations ((dir / ("root" + std::to_string (i) + ".vert")).string(),
+                                                     permutations);
+        variants += set.variants.size();
+        unique   += set.sources.size();
+    }
+    const double permuted = secondsSince (start);
+
+    const double megabytes = outputBytes / (1024.0 * 1024.0);
+    std::cout << "include graph: " << options.includeFiles << " files, " << options.rootShaders
+              << " roots, " << files / options.rootShaders << " files per root on average\n"
+              << "cold expand:   " << cold * 1000.0 << " ms (" << megabytes / cold << " MB/s)\n"
+              << "warm expand:   " << warm * 1000.0 << " ms (" << megabytes / warm << " MB/s)\n"
+              << "permutations:  " << variants << " variants, " << unique << " unique, "
+              << permuted * 1000.0 << " ms" << std::endl;
+
+    fs::remove_all (dir);
+    return 0;
+}
+
+static Options parseOptions (int argc, char **argv)
+{
+    Options options;
+    for (int i = 1; i + 1 < argc; i += 2)
+    {
+        const size_t value = strtoul (argv[i + 1], nullptr, 10);
+
+        if      (strcmp (argv[i], "--files")      == 0) options.includeFiles = value;
+        else if (strcmp (argv[i], "--roots")      == 0) options.rootShaders  = value;
+        else if (strcmp (argv[i], "--fan-out")    == 0) options.fanOut       = value;
+        else if (strcmp (argv[i], "--iterations") == 0) options.iterations   = value;
+    }
+    options.includeFiles = std::max <size_t> (options.includeFiles, 1);
+    options.rootShaders  = std::max <size_t> (options.rootShaders,  1);
+    options.iterations   = std::max <size_t> (options.iterations,   1);
+    return options;
+}
+
+// Every include file pulls in a few earlier ones, half guarded with
+// #pragma once and half with #ifndef, so the graph is a wide DAG
+static void writeIncludeGraph (const fs::path &dir, const Options &options)
+{
+    std::mt19937 random (42);
+
+    for (size_t i = 0; i < options.includeFiles; ++i)
+    {
+        std::ofstream file (dir / "include" / ("lib" + std::to_string (i) + ".glsl"));
+        const std::string guard = "LIB" + std::to_string (i) + "_GLSL";
+
+        if (i % 2)
+            file << "#pragma once\n";
+        else
+            file << "#ifndef " << guard << "\n#define " << guard << "\n";
+
+        for (size_t j = 0; j < options.fanOut && i > 0; ++j)
+            file << "#include \"lib" << random() % i << ".glsl\"\n";
+
+        file << "/* helper " << i << " */\n"
+             << "vec4 helper" << i << " (vec4 v)\n{\n"
+             << "#ifdef LIGHTING\n    v.rgb *= 0.5 + 0.5 * v.a;\n#endif\n"
+             << "    // keep the optimizer busy\n"
+             << "    return v * " << i << ".0 + vec4 (1.0e-3);\n}\n";
+
+        if (i % 2 == 0)
+            file << "#endif\n";
+    }
+
+    for (size_t i = 0; i < options.rootShaders; ++i)
+    {
+        std::ofstream file (dir / ("root" + std::to_string (i) + ".vert"));
+        file << "#version 330 core\n";
+        for (size_t j = 0; j < 8; ++j)
+            file << "#include <lib" << random() % options.includeFiles << ".glsl>\n";
+        file << "layout (location = 0) in vec3 aPos;\n"
+             << "void main()\n{\n"
+             << "#ifdef SKINNING\n    vec3 pos = aPos * 2.0;\n#else\n    vec3 pos = aPos;\n#endif\n"
+             << "    gl_Position = vec4 (pos, 1.0);\n}\n";
+    }
+}
+
+static double secondsSince (Clock::time_point start)
+{
+    return std::chrono::duration <double> (Clock::now() - start).count();
+}
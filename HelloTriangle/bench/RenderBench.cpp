@@ -0,0 +1,1010 @@
+#include <glad/glad.h>
+
+#include <iostream>
+#include <fstream>
+#include <chrono>
+#include <random>
+#include <memory>
+#include <string>
+#include <vector>
+#include <utility>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <cstddef>
+#include <algorithm>
+#include <stdexcept>
+#include <filesystem>
+
+#include <glm/gtc/matrix_transform.hpp>
+
+#include <rapidjson/document.h>
+#include <rapidjson/prettywriter.h>
+#include <rapidjson/stringbuffer.h>
+
+#include "GLSLProgram.h"
+#include "ProgramBinaryCache.h"
+#include "GLStateCache.h"
+#include "GpuTimer.h"
+#include "StreamBuffer.h"
+#include "BatchRenderer.h"
+#include "InstanceRenderer.h"
+#include "VertexLayout.h"
+#include "DrawQueue.h"
+#include "MappedFile.h"
+#include "BenchContext.h"
+#include "Profiler.h"
+
+using Clock    = std::chrono::steady_clock;
+using Counters = std::vector <std::pair <const char *, double>>;
+using Writer   = rapidjson::PrettyWriter <rapidjson::StringBuffer>;
+
+// Differences below this are timer noise whatever their percentage
+static const double MIN_REGRESSION_MS = 0.02;
+
+// Position and color, 3 floats each
+static const VertexLayout TRIANGLE_LAYOUT = { { 0, 3, VertexEncoding::Float }, { 1, 3, VertexEncoding::Float } };
+
+struct Options
+{
+    std::string scene     = "all";
+    std::string output;
+    std::string baseline;
+    std::string api       = "auto";
+    std::string trace;                // Chrome trace output, HELLOTRIANGLE_PROFILE builds only
+    size_t      frames    = 300;
+    size_t      warmup    = 30;
+    size_t      meshes    = 100000;
+    size_t      instances = 1000000;
+    int         width     = 1280;
+    int         height    = 720;
+    double      threshold = 0.10;
+};
+
+struct Summary
+{
+    double mean;
+    double p50;
+    double p95;
+    double p99;
+    double max;
+};
+
+struct SceneResult
+{
+    std::string name;
+    size_t      frames;
+    Summary     cpu;
+    Summary     gpu;
+    size_t      gpuSamples;
+    double      glCallsIssued;
+    double      glCallsElided;
+    Counters    counters;
+};
+
+class BenchScene
+{
+public:
+    virtual ~BenchScene() = default;
+
+    virtual const char *name() const = 0;
+    virtual void setup  (const Options &options) = 0;
+    virtual void render (size_t frame) = 0;
+    virtual void addCounters (Counters &) const {}
+};
+
+static Options     parseOptions (int argc, char **argv);
+static std::vector <std::unique_ptr <BenchScene>> createScenes();
+static SceneResult runScene (BenchContext &context, BenchScene &scene, const Options &options);
+static Summary     summarize (std::vector <double> samples);
+static std::string writeJson (const std::vector <SceneResult> &results, const char *backend);
+static void        writeSummary (Writer &writer, const char *name, const Summary &summary);
+static bool        compareWithBaseline (const std::vector <SceneResult> &results, const Options &options);
+static void        linkProgram (GLSLProgram &program, const char *vertex, const char *fragment);
+static void        makeFan     (int sides, float radius, std::mt19937 &random,
+                                std::vector <float> &vertices, std::vector <GLuint> &indices);
+
+
+// Renders scripted scenes offscreen for a fixed number of frames and writes
+// CPU and GPU frame-time percentiles as JSON. --baseline compares against an
+// earlier run and exits with 2 if any percentile regressed past --threshold
+int main (int argc, char **argv)
+{
+    const Options options = parseOptions (argc, argv);
+    std::vector <SceneResult> results;
+    std::string json;
+
+    try
+    {
+        BenchContext context (BenchContext::parseApi (options.api), options.width, options.height, "RenderBench");
+        {
+            std::vector <std::unique_ptr <BenchScene>> scenes = createScenes();
+            for (auto &scene : scenes)
+            {
+                if (options.scene != "all" && options.scene != scene->name())
+                    continue;
+
+                scene->setup (options);
+                results.push_back (runScene (context, *scene, options));
+                scene.reset();
+                std::cerr << results.back().name << ": cpu p50 " << results.back().cpu.p50
+                          << " ms, gpu p50 " << results.back().gpu.p50 << " ms" << std::endl;
+            }
+        }
+
+        if (!results.empty())
+            json = writeJson (results, context.backend());
+        if (!options.trace.empty())
+            PROFILE_EXPORT (options.trace);
+    }
+    catch (const GLSLProgramException &e)
+    {
+        std::cerr << e.what() << std::endl;
+        return 1;
+    }
+    catch (const std::exception &e)
+    {
+        std::cerr << e.what() << std::endl;
+        return 1;
+    }
+
+    if (results.empty())
+    {
+        std::cerr << "No scene called " << options.scene << std::endl;
+        return 1;
+    }
+
+    if (options.output.empty())
+        std::cout << json << std::endl;
+    else
+        std::ofstream (options.output) << json << std::endl;
+
+    if (!options.baseline.empty() && !compareWithBaseline (results, options))
+        return 2;
+    return 0;
+}
+
+// Two static triangles through the draw queue, the smallest possible frame
+class TrianglesScene : public BenchScene
+{
+public:
+    ~TrianglesScene() override
+    {
+        GLStateCache::current().invalidate();
+        glDeleteVertexArrays (1, &m_vao);
+        glDeleteBuffers (1, &m_vbo);
+    }
+
+    const char *name() const override { return "triangles"; }
+
+    void setup (const Options &) override
+    {
+        const float vertices[] =
+        {
+            -0.5f, -0.5f, 1.0f,   1.0f, 0.0f, 0.0f,
+             0.5f, -0.5f, 0.0f,   0.0f, 1.0f, 0.0f,
+            -0.5f,  0.5f, 1.0f,   0.0f, 0.0f, 1.0f,
+            -0.5f,  0.5f, 1.0f,   0.0f, 0.0f, 1.0f,
+             0.5f,  0.5f, 0.0f,   1.0f, 0.0f, 0.0f,
+             0.5f, -0.5f, 1.0f,   0.0f, 1.0f, 0.0f,
+        };
+
+        linkProgram (m_program, "triangle.vert", "triangle.frag");
+
+        glCreateBuffers (1, &m_vbo);
+        glNamedBufferStorage (m_vbo, sizeof (vertices), vertices, 0);
+
+        glCreateVertexArrays (1, &m_vao);
+        glVertexArrayVertexBuffer (m_vao, 0, m_vbo, 0, TRIANGLE_LAYOUT.stride());
+        TRIANGLE_LAYOUT.apply (m_vao);
+    }
+
+    void render (size_t) override
+    {
+        const GLuint program = m_program.getHandle();
+        for (GLint first = 0; first < 6; first += 3)
+            m_queue.submit (DrawQueue::makeKey (program, 0, 0.5f),
+                            { { program, m_vao, 0, false, false }, GL_TRIANGLES, 3, 0, first, 0, 1 });
+        m_queue.execute();
+    }
+
+private:
+    GLSLProgram m_program;
+    DrawQueue   m_queue;
+    GLuint      m_vao = 0;
+    GLuint      m_vbo = 0;
+};
+
+// A 128x128 grid of animated vertices rewritten into the stream buffer every frame
+class StreamScene : public BenchScene
+{
+public:
+    ~StreamScene() override
+    {
+        GLStateCache::current().invalidate();
+        glDeleteVertexArrays (1, &m_vao);
+    }
+
+    const char *name() const override { return "stream"; }
+
+    void setup (const Options &) override
+    {
+        linkProgram (m_program, "triangle.vert", "triangle.frag");
+
+        const GLsizeiptr vertexBytes = GRID * GRID * 6 * sizeof (float);
+        const GLsizeiptr indexBytes  = (GRID - 1) * (GRID - 1) * 6 * sizeof (GLuint);
+        m_stream.reset (new StreamBuffer (vertexBytes + indexBytes + 1024));
+
+        glCreateVertexArrays (1, &m_vao);
+        TRIANGLE_LAYOUT.apply (m_vao);
+        glVertexArrayElementBuffer (m_vao, m_stream->handle());
+    }
+
+    void render (size_t frame) override
+    {
+        const GLsizei stride = 6 * sizeof (float);
+        const float   time   = frame / 60.0f;
+
+        m_stream->beginFrame();
+
+        StreamBuffer::Allocation vertices = m_stream->allocate (GRID * GRID * stride, stride);
+        StreamBuffer::Allocation indices  = m_stream->allocate ((GRID - 1) * (GRID - 1) * 6 * sizeof (GLuint),
+                                                                sizeof (GLuint));
+        float *vertex = vertices.as <float>();
+        for (int y = 0; y < GRID; ++y)
+            for (int x = 0; x < GRID; ++x)
+            {
+                const float u = x / (GRID - 1.0f), v = y / (GRID - 1.0f);
+                const float h = 0.5f + 0.5f * std::sin (10.0f * u + 7.0f * v + time);
+
+                *vertex++ = 2.0f * u - 1.0f;
+                *vertex++ = 2.0f * v - 1.0f + 0.02f * h;
+                *vertex++ = h;
+                *vertex++ = h;
+                *vertex++ = u;
+                *vertex++ = v;
+            }
+
+        GLuint *index = indices.as <GLuint>();
+        for (GLuint y = 0; y + 1 < GRID; ++y)
+            for (GLuint x = 0; x + 1 < GRID; ++x)
+            {
+                const GLuint corner = y * GRID + x;
+                *index++ = corner;
+                *index++ = corner + 1;
+                *index++ = corner + GRID;
+                *index++ = corner + 1;
+                *index++ = corner + GRID + 1;
+                *index++ = corner + GRID;
+            }
+
+        glVertexArrayVertexBuffer (m_vao, 0, m_stream->handle(), vertices.offset, stride);
+        m_program.use();
+        GLStateCache::current().bindVertexArray (m_vao);
+        glDrawElements (GL_TRIANGLES, (GRID - 1) * (GRID - 1) * 6, GL_UNSIGNED_INT,
+                        reinterpret_cast <void *> (indices.offset));
+
+        m_stream->endFrame();
+    }
+
+    void addCounters (Counters &counters) const override
+    {
+        const StreamBuffer::Stats &total = m_stream->totalStats();
+        counters.emplace_back ("stream_mb_per_frame", m_stream->frameStats().bytesStreamed / (1024.0 * 1024.0));
+        counters.emplace_back ("fence_waits", static_cast <double> (total.fenceWaits));
+        counters.emplace_back ("stall_ms", total.stallSeconds * 1000.0);
+    }
+
+private:
+    static const int GRID = 128;
+
+    GLSLProgram                    m_program;
+    std::unique_ptr <StreamBuffer> m_stream;
+    GLuint                         m_vao = 0;
+};
+
+// --meshes tiny fans packed by the batch renderer, one multi-draw per frame,
+// or one draw call per fan as the baseline
+class BatchScene : public BenchScene
+{
+public:
+    explicit BatchScene (BatchRenderer::SubmitMode mode)
+        : m_mode (mode) {}
+
+    const char *name() const override
+    {
+        return m_mode == BatchRenderer::SubmitMode::PerDraw ? "batch-per-draw" : "batch";
+    }
+
+    void setup (const Options &options) override
+    {
+        linkProgram (m_program, "batch.vert", "triangle.frag");
+
+        m_stream.reset (new StreamBuffer (options.meshes * (sizeof (DrawElementsIndirectCommand) +
+                                                            sizeof (glm::vec4)) + 4096));
+        m_renderer.reset (new BatchRenderer (*m_stream));
+
+        std::mt19937 random (42);
+        std::uniform_int_distribution  <int>   sides (3, 8);
+        std::uniform_real_distribution <float> unit  (0.0f, 1.0f);
+
+        Clock::time_point start = Clock::now();
+        std::vector <float>  vertices;
+        std::vector <GLuint> indices;
+        for (size_t i = 0; i < options.meshes; ++i)
+        {
+            const int   n      = sides (random);
+            const float radius = 0.004f + 0.006f * unit (random);
+
+            makeFan (n, radius, random, vertices, indices);
+            m_meshes.push_back (m_renderer->addMesh (TRIANGLE_LAYOUT.format(), vertices.data(), n,
+                                                     indices.data(), indices.size()));
+            m_placements.emplace_back (2.0f * unit (random) - 1.0f, 2.0f * unit (random) - 1.0f, 1.0f, 0.0f);
+        }
+        glFinish();
+        m_packSeconds = std::chrono::duration <double> (Clock::now() - start).count();
+    }
+
+    void render (size_t) override
+    {
+        m_stream->beginFrame();
+        for (size_t i = 0; i < m_meshes.size(); ++i)
+            m_renderer->draw (m_meshes[i], m_program, m_placements[i]);
+        m_renderer->flush (m_mode);
+        m_stream->endFrame();
+
+        m_submitSeconds += m_renderer->frameStats().submitSeconds;
+        ++m_frames;
+    }
+
+    void addCounters (Counters &counters) const override
+    {
+        counters.emplace_back ("meshes",         static_cast <double> (m_meshes.size()));
+        counters.emplace_back ("draw_calls",     static_cast <double> (m_renderer->frameStats().drawCalls));
+        counters.emplace_back ("pack_ms",        m_packSeconds * 1000.0);
+        counters.emplace_back ("submit_ms_mean", m_frames ? m_submitSeconds / m_frames * 1000.0 : 0.0);
+    }
+
+private:
+    BatchRenderer::SubmitMode         m_mode;
+    GLSLProgram                       m_program;
+    std::unique_ptr <StreamBuffer>    m_stream;
+    std::unique_ptr <BatchRenderer>   m_renderer;
+    std::vector <BatchRenderer::Mesh> m_meshes;
+    std::vector <glm::vec4>           m_placements;
+    double                            m_packSeconds   = 0.0;
+    double                            m_submitSeconds = 0.0;
+    size_t                            m_frames        = 0;
+};
+
+// --instances copies of one unit fan per side count, 3 to 8, each with a 3x4
+// transform and a tint, placed and sized like the batch scene's fans. One
+// instanced draw per fan, or one draw call per instance as the baseline
+class InstancedScene : public BenchScene
+{
+public:
+    explicit InstancedScene (InstanceRenderer::SubmitMode mode)
+        : m_mode (mode) {}
+
+    const char *name() const override
+    {
+        return m_mode == InstanceRenderer::SubmitMode::PerDraw ? "instanced-per-draw" : "instanced";
+    }
+
+    void setup (const Options &options) override
+    {
+        linkProgram (m_program, "instance.vert", "triangle.frag");
+
+        m_stream.reset (new StreamBuffer (options.instances * sizeof (InstanceRenderer::Instance) + 4096));
+        m_renderer.reset (new InstanceRenderer (*m_stream));
+
+        std::mt19937 random (42);
+        std::uniform_int_distribution  <int>   sides (3, 8);
+        std::uniform_real_distribution <float> unit  (0.0f, 1.0f);
+
+        std::vector <float>  vertices;
+        std::vector <GLuint> indices;
+        for (int n = 3; n <= 8; ++n)
+        {
+            makeFan (n, 1.0f, random, vertices, indices);
+            m_fans.push_back (m_renderer->addMesh (TRIANGLE_LAYOUT.format(), vertices.data(), n,
+                                                   indices.data(), indices.size()));
+        }
+
+        for (size_t i = 0; i < options.instances; ++i)
+        {
+            const int       n      = sides (random);
+            const float     radius = 0.004f + 0.006f * unit (random);
+            const glm::vec3 offset (2.0f * unit (random) - 1.0f, 2.0f * unit (random) - 1.0f, 0.0f);
+            const glm::vec4 tint   (unit (random), unit (random), unit (random), 1.0f);
+
+            m_shapes.push_back (static_cast <unsigned> (n - 3));
+            m_instances.push_back (InstanceRenderer::Instance::make (
+                glm::scale (glm::translate (glm::mat4 (1.0f), offset), glm::vec3 (radius)), tint));
+        }
+    }
+
+    void render (size_t) override
+    {
+        m_stream->beginFrame();
+        for (size_t i = 0; i < m_instances.size(); ++i)
+            m_renderer->draw (m_fans[m_shapes[i]], m_program, m_instances[i]);
+        m_renderer->flush (m_mode);
+        m_stream->endFrame();
+
+        m_submitSeconds += m_renderer->frameStats().submitSeconds;
+        ++m_frames;
+    }
+
+    void addCounters (Counters &counters) const override
+    {
+        counters.emplace_back ("instances",      static_cast <double> (m_instances.size()));
+        counters.emplace_back ("draw_calls",     static_cast <double> (m_renderer->frameStats().drawCalls));
+        counters.emplace_back ("dropped",        static_cast <double> (m_renderer->frameStats().droppedInstances));
+        counters.emplace_back ("instance_bytes", static_cast <double> (sizeof (InstanceRenderer::Instance)));
+        counters.emplace_back ("submit_ms_mean", m_frames ? m_submitSeconds / m_frames * 1000.0 : 0.0);
+    }
+
+private:
+    InstanceRenderer::SubmitMode             m_mode;
+    GLSLProgram                              m_program;
+    std::unique_ptr <StreamBuffer>           m_stream;
+    std::unique_ptr <InstanceRenderer>       m_renderer;
+    std::vector <InstanceRenderer::Mesh>     m_fans;
+    std::vector <unsigned>                   m_shapes;      // index into m_fans per instance
+    std::vector <InstanceRenderer::Instance> m_instances;
+    double                                   m_submitSeconds = 0.0;
+    size_t                                   m_frames        = 0;
+};
+
+// 20000 draws over 4 programs and 16 vertex arrays submitted in random order,
+// sorted by the draw queue so the state cache can elide most binds
+class StateSortScene : public BenchScene
+{
+public:
+    ~StateSortScene() override
+    {
+        GLStateCache::current().invalidate();
+        glDeleteVertexArrays (VERTEX_ARRAYS, m_vaos);
+        glDeleteBuffers (1, &m_vbo);
+    }
+
+    const char *name() const override { return "state-sort"; }
+
+    void setup (const Options &) override
+    {
+        for (GLSLProgram &program : m_programs)
+            linkProgram (program, "triangle.vert", "triangle.frag");
+
+        std::mt19937 random (7);
+        std::uniform_real_distribution <float> unit (0.0f, 1.0f);
+
+        std::vector <float> vertices;
+        // Small triangles, the scene is about state changes rather than fill rate
+        for (int i = 0; i < 64; ++i)
+        {
+            const float x = 1.9f * unit (random) - 0.95f, y = 1.9f * unit (random) - 0.95f;
+            for (int k = 0; k < 3; ++k)
+                vertices.insert (vertices.end(), { x + 0.05f * unit (random), y + 0.05f * unit (random), unit (random),
+                                                   unit (random), unit (random), unit (random) });
+        }
+
+        glCreateBuffers (1, &m_vbo);
+        glNamedBufferStorage (m_vbo, vertices.size() * sizeof (float), vertices.data(), 0);
+
+        glCreateVertexArrays (VERTEX_ARRAYS, m_vaos);
+        for (GLuint vao : m_vaos)
+        {
+            glVertexArrayVertexBuffer (vao, 0, m_vbo, 0, TRIANGLE_LAYOUT.stride());
+            TRIANGLE_LAYOUT.apply (vao);
+        }
+
+        std::uniform_int_distribution <int> pick (0, 1 << 20);
+        for (int i = 0; i < DRAWS; ++i)
+        {
+            const int    variant = pick (random);
+            const GLuint program = m_programs[variant % PROGRAMS].getHandle();
+            const GLuint vao     = m_vaos[(variant / PROGRAMS) % VERTEX_ARRAYS];
+
+            const bool   blend   = (variant & 64) != 0;
+
+            m_draws.push_back ({ DrawQueue::makeKey (program, (vao << 1) | blend, unit (random)),
+                                 { { program, vao, 0, blend, false },
+                                   GL_TRIANGLES, 3, 0, 3 * (variant % 64), 0, 1 } });
+        }
+    }
+
+    void render (size_t) override
+    {
+        for (const auto &draw : m_draws)
+            m_queue.submit (draw.first, draw.second);
+        m_queue.execute();
+
+        m_sortSeconds += m_queue.stats().sortSeconds;
+        ++m_frames;
+    }
+
+    void addCounters (Counters &counters) const override
+    {
+        counters.emplace_back ("draws",        static_cast <double> (DRAWS));
+        counters.emplace_back ("sort_ms_mean", m_frames ? m_sortSeconds / m_frames * 1000.0 : 0.0);
+    }
+
+private:
+    static const int PROGRAMS      = 4;
+    static const int VERTEX_ARRAYS = 16;
+    static const int DRAWS         = 20000;
+
+    GLSLProgram m_programs [PROGRAMS];
+    GLuint      m_vaos     [VERTEX_ARRAYS] = {};
+    GLuint      m_vbo = 0;
+    DrawQueue   m_queue;
+    std::vector <std::pair <uint64_t, DrawCommand>> m_draws;
+    double      m_sortSeconds = 0.0;
+    size_t      m_frames      = 0;
+};
+
+// 2000 small triangles a frame, each drawn after setting four uniforms,
+// either by name through the sorted uniform table or through handles
+// resolved in setup(). The transform and offset change every draw, the
+// tint every 16 draws and the scale never, so most tint and all scale
+// writes are skipped as redundant
+class UniformScene : public BenchScene
+{
+public:
+    explicit UniformScene (bool isByHandle)
+        : m_isByHandle (isByHandle) {}
+
+    ~UniformScene() override
+    {
+        GLStateCache::current().invalidate();
+        glDeleteVertexArrays (1, &m_vao);
+        glDeleteBuffers (1, &m_vbo);
+    }
+
+    const char *name() const override { return m_isByHandle ? "uniforms-handle" : "uniforms-name"; }
+
+    void setup (const Options &) override
+    {
+        const float vertices[] =
+        {
+            -0.02f, -0.02f, 0.0f,   1.0f, 0.0f, 0.0f,
+             0.02f, -0.02f, 0.0f,   0.0f, 1.0f, 0.0f,
+             0.00f,  0.02f, 0.0f,   0.0f, 0.0f, 1.0f,
+        };
+
+        linkProgram (m_program, "uniforms.vert", "triangle.frag");
+        m_transform = m_program.getUniformHandle <glm::mat4> ("transform");
+        m_tint      = m_program.getUniformHandle <glm::vec4> ("tint");
+        m_offset    = m_program.getUniformHandle <glm::vec2> ("offset");
+        m_scale     = m_program.getUniformHandle <float>     ("scale");
+
+        glCreateBuffers (1, &m_vbo);
+        glNamedBufferStorage (m_vbo, sizeof (vertices), vertices, 0);
+
+        glCreateVertexArrays (1, &m_vao);
+        glVertexArrayVertexBuffer (m_vao, 0, m_vbo, 0, TRIANGLE_LAYOUT.stride());
+        TRIANGLE_LAYOUT.apply (m_vao);
+    }
+
+    void render (size_t frame) override
+    {
+        m_program.use();
+        GLStateCache::current().bindVertexArray (m_vao);
+        m_program.resetUniformStats();
+
+        double setSeconds = 0.0;
+        for (int i = 0; i < DRAWS; ++i)
+        {
+            const float     angle     = 0.01f * (frame + i);
+            const glm::mat4 transform = glm::mat4 (glm::vec4 ( std::cos (angle), std::sin (angle), 0.0f, 0.0f),
+                                                   glm::vec4 (-std::sin (angle), std::cos (angle), 0.0f, 0.0f),
+                                                   glm::vec4 (0.0f, 0.0f, 1.0f, 0.0f),
+                                                   glm::vec4 (0.0f, 0.0f, 0.0f, 1.0f));
+            const glm::vec4 tint   = glm::vec4 (((i / 16) % 4) / 3.0f, 1.0f, 1.0f, 1.0f);
+            const glm::vec2 offset = glm::vec2 ((i % 50) / 25.0f - 0.98f, (i / 50) / 20.0f - 0.98f);
+
+            Clock::time_point start = Clock::now();
+            if (m_isByHandle)
+            {
+                m_program.setUniform (m_transform, transform);
+                m_program.setUniform (m_tint,      tint);
+                m_program.setUniform (m_offset,    offset);
+                m_program.setUniform (m_scale,     1.0f);
+            }
+            else
+            {
+                m_program.setUniform ("transform", transform);
+                m_program.setUniform ("tint",      tint);
+                m_program.setUniform ("offset",    offset);
+                m_program.setUniform ("scale",     1.0f);
+            }
+            setSeconds += std::chrono::duration <double> (Clock::now() - start).count();
+
+            glDrawArrays (GL_TRIANGLES, 0, 3);
+        }
+
+        m_setSeconds += setSeconds;
+        ++m_frames;
+    }
+
+    void addCounters (Counters &counters) const override
+    {
+        const GLSLProgram::UniformStats &stats = m_program.getUniformStats();
+        counters.emplace_back ("draws",             static_cast <double> (DRAWS));
+        counters.emplace_back ("set_ms_mean",       m_frames ? m_setSeconds / m_frames * 1000.0 : 0.0);
+        counters.emplace_back ("writes_per_frame",  static_cast <double> (stats.writes));
+        counters.emplace_back ("skipped_per_frame", static_cast <double> (stats.skipped));
+    }
+
+private:
+    static const int DRAWS = 2000;
+
+    bool                          m_isByHandle;
+    GLSLProgram                   m_program;
+    UniformHandle <glm::mat4>     m_transform;
+    UniformHandle <glm::vec4>     m_tint;
+    UniformHandle <glm::vec2>     m_offset;
+    UniformHandle <float>         m_scale;
+    GLuint                        m_vao = 0;
+    GLuint                        m_vbo = 0;
+    double                        m_setSeconds = 0.0;
+    size_t                        m_frames     = 0;
+};
+
+// One program linked every frame through a ProgramBinaryCache. Cold, every
+// frame's sources differ by a comment, salted per run so neither the cache
+// nor the driver's own shader cache has seen them; cached, the same sources
+// are linked every frame and come back from the cache after the first.
+// Only the link is timed, a driver may still compile at the first draw
+class LinkScene : public BenchScene
+{
+public:
+    explicit LinkScene (bool isCached)
+        : m_isCached (isCached) {}
+
+    ~LinkScene() override
+    {
+        m_cache.reset();
+        std::error_code error;
+        std::filesystem::remove_all (m_directory, error);
+    }
+
+    const char *name() const override { return m_isCached ? "link-cached" : "link-cold"; }
+
+    void setup (const Options &) override
+    {
+        MappedFile vertex   (SHADER_DIR "/triangle.vert");
+        MappedFile fragment (SHADER_DIR "/triangle.frag");
+        if (!vertex.isOpen() || !fragment.isOpen())
+            throw std::runtime_error ("Can't read the triangle shaders");
+
+        m_vertex   = std::string (vertex.view());
+        m_fragment = std::string (fragment.view());
+        m_salt     = std::to_string (Clock::now().time_since_epoch().count());
+
+        m_directory = (std::filesystem::temp_directory_path() / ("RenderBench-" + m_salt)).string();
+        m_cache.reset (new ProgramBinaryCache (m_directory));
+        if (!m_cache->isSupported())
+            std::cerr << name() << ": the driver has no program binary formats, every link is cold" << std::endl;
+    }
+
+    void render (size_t frame) override
+    {
+        const std::string variant = "// " + m_salt + " " + std::to_string (m_isCached ? 0 : frame) + "\n";
+
+        Clock::time_point start = Clock::now();
+
+        GLSLProgram program;
+        program.setBinaryCache (m_cache.get());
+        program.addShaderSource (withComment (m_vertex,   variant), GL_VERTEX_SHADER,   "triangle.vert");
+        program.addShaderSource (withComment (m_fragment, variant), GL_FRAGMENT_SHADER, "triangle.frag");
+        program.link();
+
+        m_linkSeconds += std::chrono::duration <double> (Clock::now() - start).count();
+        ++m_frames;
+    }
+
+    void addCounters (Counters &counters) const override
+    {
+        const ProgramBinaryCache::Stats &stats = m_cache->stats();
+        counters.emplace_back ("link_ms_mean", m_frames ? m_linkSeconds / m_frames * 1000.0 : 0.0);
+        counters.emplace_back ("cache_hits",   static_cast <double> (stats.hits));
+        counters.emplace_back ("cache_misses", static_cast <double> (stats.misses));
+    }
+
+private:
+    bool                                 m_isCached;
+    std::string                          m_vertex;
+    std::string                          m_fragment;
+    std::string                          m_salt;
+    std::string                          m_directory;
+    std::unique_ptr <ProgramBinaryCache> m_cache;
+    double                               m_linkSeconds = 0.0;
+    size_t                               m_frames      = 0;
+
+    // After the #version line, which has to stay first
+    static std::string withComment (const std::string &source, const std::string &comment)
+    {
+        const size_t line = source.find ('\n');
+        return line == std::string::npos ? source + "\n" + comment
+                                         : source.substr (0, line + 1) + comment + source.substr (line + 1);
+    }
+};
+
+static Options parseOptions (int argc, char **argv)
+{
+    Options options;
+    for (int i = 1; i + 1 < argc; i += 2)
+    {
+        const char *name  = argv[i];
+        const char *value = argv[i + 1];
+
+        if      (strcmp (name, "--scene")     == 0) options.scene     = value;
+        else if (strcmp (name, "--output")    == 0) options.output    = value;
+        else if (strcmp (name, "--baseline")  == 0) options.baseline  = value;
+        else if (strcmp (name, "--api")       == 0) options.api       = value;
+        else if (strcmp (name, "--trace")     == 0) options.trace     = value;
+        else if (strcmp (name, "--frames")    == 0) options.frames    = std::max <size_t> (strtoul (value, nullptr, 10), 1);
+        else if (strcmp (name, "--warmup")    == 0) options.warmup    = strtoul (value, nullptr, 10);
+        else if (strcmp (name, "--meshes")    == 0) options.meshes    = std::max <size_t> (strtoul (value, nullptr, 10), 1);
+        else if (strcmp (name, "--instances") == 0) options.instances = std::max <size_t> (strtoul (value, nullptr, 10), 1);
+        else if (strcmp (name, "--width")     == 0) options.width     = atoi (value);
+        else if (strcmp (name, "--height")    == 0) options.height    = atoi (value);
+        else if (strcmp (name, "--threshold") == 0) options.threshold = atof (value) / 100.0;
+    }
+    return options;
+}
+
+static std::vector <std::unique_ptr <BenchScene>> createScenes()
+{
+    std::vector <std::unique_ptr <BenchScene>> scenes;
+    scenes.emplace_back (new TrianglesScene);
+    scenes.emplace_back (new StreamScene);
+    scenes.emplace_back (new BatchScene (BatchRenderer::SubmitMode::MultiDrawIndirect));
+    scenes.emplace_back (new BatchScene (BatchRenderer::SubmitMode::PerDraw));
+    scenes.emplace_back (new InstancedScene (InstanceRenderer::SubmitMode::Instanced));
+    scenes.emplace_back (new InstancedScene (InstanceRenderer::SubmitMode::PerDraw));
+    scenes.emplace_back (new StateSortScene);
+    scenes.emplace_back (new UniformScene (false));
+    scenes.emplace_back (new UniformScene (true));
+    scenes.emplace_back (new LinkScene (false));
+    scenes.emplace_back (new LinkScene (true));
+    return scenes;
+}
+
+// CPU time covers recording and swapping a frame; GPU time comes back a few
+// frames later from the query ring, so the GPU is never waited on mid-run
+static SceneResult runScene (BenchContext &context, BenchScene &scene, const Options &options)
+{
+    GLStateCache &state = GLStateCache::current();
+    GpuTimer      gpuTimer (16);
+
+    std::vector <double>             cpuSamples;
+    std::vector <GpuTimer::Interval> gpuIntervals;
+    size_t issued = 0, elided = 0;
+
+    const size_t total = options.warmup + options.frames;
+    for (size_t frame = 0; frame < total; ++frame)
+    {
+        Clock::time_point start = Clock::now();
+        state.resetStats();
+
+        const int slot = gpuTimer.begin (frame);
+        {
+            PROFILE_GPU_SCOPE ("Render");
+            glClearColor (0.2f, 0.3f, 0.3f, 1.0f);
+            glClear (GL_COLOR_BUFFER_BIT);
+            scene.render (frame);
+        }
+        gpuTimer.end (slot);
+
+        {
+            PROFILE_SCOPE ("swapBuffers");
+            context.swapBuffers();
+        }
+        gpuTimer.collect (gpuIntervals);
+        PROFILE_FRAME();
+
+        if (frame < options.warmup)
+            continue;
+
+        cpuSamples.push_back (std::chrono::duration <double, std::milli> (Clock::now() - start).count());
+        issued += state.stats().issued;
+        elided += state.stats().elided;
+    }
+
+    glFinish();
+    gpuTimer.drain (gpuIntervals);
+
+    std::vector <double> gpuSamples;
+    for (const GpuTimer::Interval &interval : gpuIntervals)
+        if (interval.tag >= options.warmup)
+            gpuSamples.push_back (interval.milliseconds());
+
+    SceneResult result;
+    result.name          = scene.name();
+    result.frames        = options.frames;
+    result.cpu           = summarize (cpuSamples);
+    result.gpu           = summarize (gpuSamples);
+    result.gpuSamples    = gpuSamples.size();
+    result.glCallsIssued = static_cast <double> (issued) / options.frames;
+    result.glCallsElided = static_cast <double> (elided) / options.frames;
+    scene.addCounters (result.counters);
+
+    return result;
+}
+
+// Nearest-rank percentiles
+static Summary summarize (std::vector <double> samples)
+{
+    Summary summary = {};
+    if (samples.empty())
+        return summary;
+
+    std::sort (samples.begin(), samples.end());
+    auto percentile = [&samples] (double p)
+    {
+        const size_t rank = static_cast <size_t> (std::ceil (p * samples.size()));
+        return samples[std::min (std::max <size_t> (rank, 1), samples.size()) - 1];
+    };
+
+    double sum = 0.0;
+    for (double sample : samples)
+        sum += sample;
+
+    summary.mean = sum / samples.size();
+    summary.p50  = percentile (0.50);
+    summary.p95  = percentile (0.95);
+    summary.p99  = percentile (0.99);
+    summary.max  = samples.back();
+    return summary;
+}
+
+static std::string writeJson (const std::vector <SceneResult> &results, const char *backend)
+{
+    rapidjson::StringBuffer buffer;
+    Writer writer (buffer);
+
+    writer.StartObject();
+    writer.Key ("backend");
+    writer.String (backend);
+    writer.Key ("renderer");
+    writer.String (reinterpret_cast <const char *> (glGetString (GL_RENDERER)));
+    writer.Key ("version");
+    writer.String (reinterpret_cast <const char *> (glGetString (GL_VERSION)));
+
+    writer.Key ("scenes");
+    writer.StartArray();
+    for (const SceneResult &result : results)
+    {
+        writer.StartObject();
+        writer.Key ("name");
+        writer.String (result.name.c_str());
+        writer.Key ("frames");
+        writer.Uint64 (result.frames);
+        writeSummary (writer, "cpu_ms", result.cpu);
+        writeSummary (writer, "gpu_ms", result.gpu);
+        writer.Key ("gpu_samples");
+        writer.Uint64 (result.gpuSamples);
+        writer.Key ("gl_calls_issued");
+        writer.Double (result.glCallsIssued);
+        writer.Key ("gl_calls_elided");
+        writer.Double (result.glCallsElided);
+
+        writer.Key ("counters");
+        writer.StartObject();
+        for (const auto &counter : result.counters)
+        {
+            writer.Key (counter.first);
+            writer.Double (counter.second);
+        }
+        writer.EndObject();
+
+        writer.EndObject();
+    }
+    writer.EndArray();
+    writer.EndObject();
+
+    return buffer.GetString();
+}
+
+static void writeSummary (Writer &writer, const char *name, const Summary &summary)
+{
+    writer.Key (name);
+    writer.StartObject();
+    writer.Key ("mean"); writer.Double (summary.mean);
+    writer.Key ("p50");  writer.Double (summary.p50);
+    writer.Key ("p95");  writer.Double (summary.p95);
+    writer.Key ("p99");  writer.Double (summary.p99);
+    writer.Key ("max");  writer.Double (summary.max);
+    writer.EndObject();
+}
+
+// Prints every percentile next to the baseline's, false if any got slower than the threshold allows
+static bool compareWithBaseline (const std::vector <SceneResult> &results, const Options &options)
+{
+    MappedFile file (options.baseline);
+    rapidjson::Document baseline;
+    if (!file.isOpen() || baseline.Parse (file.data(), file.size()).HasParseError() ||
+        !baseline.IsObject() || !baseline.HasMember ("scenes") || !baseline["scenes"].IsArray())
+    {
+        std::cerr << "Can't read the baseline " << options.baseline << std::endl;
+        return false;
+    }
+
+    bool isClean = true;
+    for (const SceneResult &result : results)
+    {
+        const rapidjson::Value *previous = nullptr;
+        for (const rapidjson::Value &scene : baseline["scenes"].GetArray())
+            if (scene.IsObject() && scene.HasMember ("name") && scene["name"].IsString() &&
+                result.name == scene["name"].GetString())
+                previous = &scene;
+
+        if (!previous)
+        {
+            std::cerr << result.name << ": not in the baseline" << std::endl;
+            continue;
+        }
+
+        const std::pair <const char *, const Summary *> timings[] = { { "cpu_ms", &result.cpu },
+                                                                      { "gpu_ms", &result.gpu } };
+        for (const auto &timing : timings)
+        {
+            if (!previous->HasMember (timing.first) || !(*previous)[timing.first].IsObject())
+                continue;
+
+            const rapidjson::Value &old = (*previous)[timing.first];
+            const std::pair <const char *, double> percentiles[] = { { "p50", timing.second->p50 },
+                                                                     { "p95", timing.second->p95 },
+                                                                     { "p99", timing.second->p99 } };
+            for (const auto &percentile : percentiles)
+            {
+                if (!old.HasMember (percentile.first) || !old[percentile.first].IsNumber())
+                    continue;
+
+                const double before  = old[percentile.first].GetDouble();
+                const double change  = before > 0.0 ? (percentile.second - before) / before : 0.0;
+                const bool   isWorse = change > options.threshold &&
+                                       percentile.second - before > MIN_REGRESSION_MS;
+
+                char line[160] = {};
+                snprintf (line, sizeof (line), "%-12s %s %s: %8.3f -> %8.3f ms (%+.1f%%)%s",
+                          result.name.c_str(), timing.first, percentile.first, before,
+                          percentile.second, change * 100.0, isWorse ? "  REGRESSION" : "");
+                std::cerr << line << std::endl;
+
+                isClean = isClean && !isWorse;
+            }
+        }
+    }
+    return isClean;
+}
+
+static void linkProgram (GLSLProgram &program, const char *vertex, const char *fragment)
+{
+    program.compileShader ((std::string (SHADER_DIR "/") + vertex).c_str());
+    program.compileShader ((std::string (SHADER_DIR "/") + fragment).c_str());
+    program.link();
+}
+
+// A convex polygon around the origin in TRIANGLE_LAYOUT, random colors at
+// the corners, as a fan of sides - 2 triangles
+static void makeFan (int sides, float radius, std::mt19937 &random,
+                     std::vector <float> &vertices, std::vector <GLuint> &indices)
+{
+    std::uniform_real_distribution <float> unit (0.0f, 1.0f);
+
+    vertices.clear();
+    indices.clear();
+    for (int k = 0; k < sides; ++k)
+    {
+        const float angle = 6.2831853f * k / sides;
+        vertices.insert (vertices.end(), { radius * std::cos (angle), radius * std::sin (angle), 0.0f,
+                                           unit (random), unit (random), unit (random) });
+    }
+    for (int k = 1; k + 1 < sides; ++k)
+        indices.insert (indices.end(), { 0u, GLuint (k), GLuint (k + 1) });
+}
@@ -0,0 +1,46 @@
+#include "SceneGenerator.h"
+
+#include <random>
+#include <cstdio>
+#include <cstdint>
+
+
+size_t writeSceneJson (const std::string &path, size_t meshes, size_t vertices)
+{
+    FILE *file = fopen (path.c_str(), "wb");
+    if (!file)
+        return 0;
+
+    std::mt19937 random (42);
+    std::uniform_real_distribution <float> unit (-1.0f, 1.0f);
+    std::uniform_int_distribution <uint32_t> vertex (0, static_cast <uint32_t> (vertices - 1));
+
+    fprintf (file, "{\n\"programs\": [ { \"name\": \"p\", \"vertex\": \"triangle.vert\", \"fragment\": \"triangle.frag\" } ],\n");
+    fprintf (file, "\"materials\": [ { \"name\": \"m\", \"program\": \"p\", \"color\": [1, 1, 1, 1] } ],\n");
+    fprintf (file, "\"meshes\": [\n");
+    for (size_t mesh = 0; mesh < meshes; ++mesh)
+    {
+        fprintf (file, "%s{ \"name\": \"mesh%zu\",\n\"positions\": [", mesh ? ",\n" : "", mesh);
+        for (size_t i = 0; i < vertices * 3; ++i)
+            fprintf (file, i ? ", %.6f" : "%.6f", unit (random));
+
+        fprintf (file, "],\n\"colors\": [");
+        for (size_t i = 0; i < vertices * 3; ++i)
+            fprintf (file, i ? ", %.4f" : "%.4f", 0.5f + 0.5f * unit (random));
+
+        fprintf (file, "],\n\"indices\": [");
+        for (size_t i = 0; i < vertices / 3 * 3; ++i)
+            fprintf (file, i ? ", %u" : "%u", vertex (random));
+        fprintf (file, "] }");
+    }
+    fprintf (file, "\n],\n\"nodes\": [\n");
+    for (size_t mesh = 0; mesh < meshes; ++mesh)
+    {
+        fprintf (file, "%s{ \"mesh\": \"mesh%zu\", \"material\": \"m\", \"translation\": [%zu, 0, 0] }",
+                 mesh ? ",\n" : "", mesh, mesh);
+    }
+    fprintf (file, "\n]\n}\n");
+
+    const long size = ftell (file);
+    return fclose (file) == 0 && size > 0 ? static_cast <size_t> (size) : 0;
+}
@@ -0,0 +1,11 @@
+#ifndef SCENE_GENERATOR_INCLUDED
+#define SCENE_GENERATOR_INCLUDED
+
+#include <string>
+#include <cstddef>
+
+// Writes a scene JSON of random meshes, one node each, with as many
+// indices as vertices. Returns the file size, 0 if it can't be written
+size_t writeSceneJson (const std::string &path, size_t meshes, size_t vertices);
+
+#endif // !SCENE_GENERATOR_INCLUDED
@@ -0,0 +1,225 @@
+#include <iostream>
+#include <chrono>
+#include <string>
+#include <vector>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <cstdint>
+#include <algorithm>
+#include <filesystem>
+#include <unistd.h>
+#include <sys/wait.h>
+#include <sys/resource.h>
+
+#include <rapidjson/document.h>
+
+#include "Scene.h"
+#include "SceneGenerator.h"
+
+namespace fs = std::filesystem;
+using Clock  = std::chrono::steady_clock;
+
+struct Options
+{
+    size_t meshes   = 500;
+    size_t vertices = 4096;   // a mesh, with as many indices
+    size_t passes   = 3;
+};
+
+// What a load leaves behind, compared between the loaders
+struct LoadResult
+{
+    double   seconds;
+    uint64_t checksum;
+    size_t   keptBytes;
+};
+
+using Loader = LoadResult (*) (const std::string &path);
+
+static Options    parseOptions (int argc, char **argv);
+static void       run          (const char *name, const std::string &path, size_t passes, Loader loader);
+static LoadResult loadWithSax  (const std::string &path);
+static LoadResult loadWithDom  (const std::string &path);
+static LoadResult loadNothing  (const std::string &path);
+
+
+// Loads a generated scene with Scene::load (SAX, in-situ, arena) and with a
+// rapidjson Document copied into vectors. Every load runs in a child
+// process so its peak RSS comes back clean through wait4()
+int main (int argc, char **argv)
+{
+    const Options options = parseOptions (argc, argv);
+    const std::string path = (fs::temp_directory_path() / "scene_load_bench.json").string();
+
+    const size_t bytes = writeSceneJson (path, options.meshes, options.vertices);
+    if (bytes == 0)
+    {
+        std::cerr << "Can't write " << path << std::endl;
+        return 1;
+    }
+    std::cout << options.meshes << " meshes of " << options.vertices << " vertices, "
+              << bytes / (1024.0 * 1024.0) << " MB of JSON:\n";
+
+    run ("empty", path, 1,              loadNothing);
+    run ("dom",   path, options.passes, loadWithDom);
+    run ("sax",   path, options.passes, loadWithSax);
+
+    fs::remove (path);
+    return 0;
+}
+
+static Options parseOptions (int argc, char **argv)
+{
+    Options options;
+    for (int i = 1; i + 1 < argc; i += 2)
+    {
+        const size_t value = strtoul (argv[i + 1], nullptr, 10);
+
+        if      (strcmp (argv[i], "--meshes")   == 0) options.meshes   = value;
+        else if (strcmp (argv[i], "--vertices") == 0) options.vertices = value;
+        else if (strcmp (argv[i], "--passes")   == 0) options.passes   = value;
+    }
+    options.meshes   = std::max <size_t> (options.meshes,   1);
+    options.vertices = std::max <size_t> (options.vertices, 3);
+    options.passes   = std::max <size_t> (options.passes,   1);
+    return options;
+}
+
+// The child sends its result through a pipe; the peak RSS comes from the kernel
+static void run (const char *name, const std::string &path, size_t passes, Loader loader)
+{
+    std::vector <double> seconds;
+    long     peakKilobytes = 0;
+    uint64_t checksum      = 0;
+    size_t   keptBytes     = 0;
+
+    for (size_t pass = 0; pass < passes; ++pass)
+    {
+        int channel[2];
+        if (pipe (channel) != 0)
+            return;
+
+        const pid_t child = fork();
+        if (child == 0)
+        {
+            close (channel[0]);
+            LoadResult result = {};
+            try
+            {
+                result = loader (path);
+            }
+            catch (const std::exception &e)
+            {
+                std::cerr << e.what() << std::endl;
+            }
+            const bool isSent = write (channel[1], &result, sizeof (result)) == sizeof (result);
+            _exit (isSent ? 0 : 1);
+        }
+
+        close (channel[1]);
+        LoadResult result = {};
+        const bool isReceived = read (channel[0], &result, sizeof (result)) == sizeof (result);
+        close (channel[0]);
+
+        int           status = 0;
+        struct rusage usage  = {};
+        wait4 (child, &status, 0, &usage);
+        if (!isReceived || !WIFEXITED (status) || WEXITSTATUS (status) != 0)
+        {
+            std::cout << "  " << name << ": failed\n";
+            return;
+        }
+
+        seconds.push_back (result.seconds);
+        peakKilobytes = std::max (peakKilobytes, usage.ru_maxrss);   // kilobytes on Linux
+        checksum      = result.checksum;
+        keptBytes     = result.keptBytes;
+    }
+
+    std::sort (seconds.begin(), seconds.end());
+    std::cout << "  " << name << ": " << seconds[seconds.size() / 2] * 1000.0 << " ms, peak RSS "
+              << peakKilobytes / 1024.0 << " MB, kept " << keptBytes / (1024.0 * 1024.0)
+              << " MB (checksum " << checksum % 1000003 << ")\n";
+}
+
+static LoadResult loadWithSax (const std::string &path)
+{
+    Clock::time_point start = Clock::now();
+    const Scene scene = Scene::load (path);
+    const double seconds = std::chrono::duration <double> (Clock::now() - start).count();
+
+    uint64_t checksum = 0;
+    for (const SceneMesh &mesh : scene.meshes())
+    {
+        for (uint32_t i = 0; i < mesh.vertexCount * 3; ++i)
+            checksum += static_cast <uint64_t> (mesh.positions[i] * 1000.0f + 1000.0f);
+        for (uint32_t i = 0; i < mesh.indexCount; ++i)
+            checksum += mesh.indices[i];
+    }
+    return { seconds, checksum, scene.stats().arenaBytes };
+}
+
+// The usual way: read the file, build a Document, copy the arrays out of it
+static LoadResult loadWithDom (const std::string &path)
+{
+    struct Mesh
+    {
+        std::string            name;
+        std::vector <float>    positions;
+        std::vector <float>    colors;
+        std::vector <uint32_t> indices;
+    };
+
+    Clock::time_point start = Clock::now();
+
+    FILE *file = fopen (path.c_str(), "rb");
+    if (!file)
+        throw std::runtime_error ("Can't open " + path);
+    fseek (file, 0, SEEK_END);
+    std::string json (static_cast <size_t> (ftell (file)), '\0');
+    fseek (file, 0, SEEK_SET);
+    const size_t read = fread (&json[0], 1, json.size(), file);
+    fclose (file);
+    json.resize (read);
+
+    rapidjson::Document document;
+    document.Parse (json.data(), json.size());
+    if (document.HasParseError() || !document.IsObject() || !document.HasMember ("meshes"))
+        throw std::runtime_error ("Can't parse " + path);
+
+    std::vector <Mesh> meshes;
+    size_t keptBytes = 0;
+    for (const auto &value : document["meshes"].GetArray())
+    {
+        Mesh mesh;
+        mesh.name = value["name"].GetString();
+        for (const auto &number : value["positions"].GetArray())
+            mesh.positions.push_back (number.GetFloat());
+        for (const auto &number : value["colors"].GetArray())
+            mesh.colors.push_back (number.GetFloat());
+        for (const auto &number : value["indices"].GetArray())
+            mesh.indices.push_back (number.GetUint());
+
+        keptBytes += (mesh.positions.size() + mesh.colors.size()) * sizeof (float) +
+                     mesh.indices.size() * sizeof (uint32_t);
+        meshes.push_back (std::move (mesh));
+    }
+    const double seconds = std::chrono::duration <double> (Clock::now() - start).count();
+
+    uint64_t checksum = 0;
+    for (const Mesh &mesh : meshes)
+    {
+        for (float position : mesh.positions)
+            checksum += static_cast <uint64_t> (position * 1000.0f + 1000.0f);
+        for (uint32_t index : mesh.indices)
+            checksum += index;
+    }
+    return { seconds, checksum, keptBytes };
+}
+
+// The cost of the process itself, to read the other peaks against
+static LoadResult loadNothing (const std::string &)
+{
+    return { 0.0, 0, 0 };
+}
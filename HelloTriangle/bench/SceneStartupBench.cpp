@@ -0,0 +1,178 @@
+#include <iostream>
+#include <chrono>
+#include <string>
+#include <vector>
+#include <cstdlib>
+#include <cstring>
+#include <cstdint>
+#include <algorithm>
+#include <filesystem>
+
+#ifndef _WIN32
+#include <fcntl.h>
+#include <unistd.h>
+#endif
+
+#include "Scene.h"
+#include "BakedScene.h"
+#include "SceneGenerator.h"
+
+namespace fs = std::filesystem;
+using Clock  = std::chrono::steady_clock;
+
+struct Options
+{
+    size_t meshes   = 200;
+    size_t vertices = 4096;
+    size_t passes   = 5;
+};
+
+// Returns something derived from the data so the work can't be skipped
+using Startup = uint64_t (*) (const std::string &path);
+
+static Options  parseOptions   (int argc, char **argv);
+static void     run            (const char *name, const std::string &path, size_t passes, bool isCold,
+                                Startup startup);
+static void     dropPageCache  (const std::string &path);
+static uint64_t startFromText  (const std::string &path);
+static uint64_t startFromBaked (const std::string &path);
+static uint64_t startFromBakedUnchecked (const std::string &path);
+static uint64_t touchPages     (const BakedScene &scene);
+
+
+// Time from a scene file to vertex and index data ready to upload, through
+// the JSON loader plus the flattening main() needed before baking, and
+// through the baked file. Warm runs read from the page cache, cold runs
+// drop the file from it first
+int main (int argc, char **argv)
+{
+    const Options options = parseOptions (argc, argv);
+    const fs::path dir = fs::temp_directory_path();
+    const std::string json  = (dir / "scene_startup_bench.json").string();
+    const std::string baked = (dir / "scene_startup_bench.scene").string();
+
+    const size_t jsonBytes = writeSceneJson (json, options.meshes, options.vertices);
+    if (jsonBytes == 0)
+    {
+        std::cerr << "Can't write " << json << std::endl;
+        return 1;
+    }
+
+    Clock::time_point start = Clock::now();
+    BakedScene::bake (Scene::load (json), baked);
+    const double bakeSeconds = std::chrono::duration <double> (Clock::now() - start).count();
+
+    std::cout << options.meshes << " meshes of " << options.vertices << " vertices: "
+              << jsonBytes / (1024.0 * 1024.0) << " MB of JSON, " << fs::file_size (baked) / (1024.0 * 1024.0)
+              << " MB baked in " << bakeSeconds * 1000.0 << " ms\n";
+
+    for (bool isCold : { false, true })
+    {
+        std::cout << (isCold ? "cold:\n" : "warm:\n");
+        run ("text",            json,  options.passes, isCold, startFromText);
+        run ("baked",           baked, options.passes, isCold, startFromBaked);
+        run ("baked, no check", baked, options.passes, isCold, startFromBakedUnchecked);
+    }
+
+    fs::remove (json);
+    fs::remove (baked);
+    return 0;
+}
+
+static Options parseOptions (int argc, char **argv)
+{
+    Options options;
+    for (int i = 1; i + 1 < argc; i += 2)
+    {
+        const size_t value = strtoul (argv[i + 1], nullptr, 10);
+
+        if      (strcmp (argv[i], "--meshes")   == 0) options.meshes   = value;
+        else if (strcmp (argv[i], "--vertices") == 0) options.vertices = value;
+        else if (strcmp (argv[i], "--passes")   == 0) options.passes   = value;
+    }
+    options.meshes   = std::max <size_t> (options.meshes,   1);
+    options.vertices = std::max <size_t> (options.vertices, 3);
+    options.passes   = std::max <size_t> (options.passes,   1);
+    return options;
+}
+
+static void run (const char *name, const std::string &path, size_t passes, bool isCold, Startup startup)
+{
+    std::vector <double> seconds;
+    uint64_t sum = 0;
+    for (size_t pass = 0; pass < passes; ++pass)
+    {
+        if (isCold)
+            dropPageCache (path);
+
+        Clock::time_point start = Clock::now();
+        sum += startup (path);
+        seconds.push_back (std::chrono::duration <double> (Clock::now() - start).count());
+    }
+
+    std::sort (seconds.begin(), seconds.end());
+    std::cout << "  " << name << ": " << seconds[seconds.size() / 2] * 1000.0 << " ms"
+              << " (checksum " << sum % 1000 << ")\n";
+}
+
+// Clean pages of a file can be dropped without privileges
+static void dropPageCache (const std::string &path)
+{
+#ifndef _WIN32
+    const int fd = open (path.c_str(), O_RDONLY);
+    if (fd < 0)
+        return;
+    posix_fadvise (fd, 0, 0, POSIX_FADV_DONTNEED);
+    close (fd);
+#else
+    (void)path;
+#endif
+}
+
+// What main() did before the baked path: load, then interleave every node
+// with its transform and tint applied
+static uint64_t startFromText (const std::string &path)
+{
+    const Scene scene = Scene::load (path);
+
+    std::vector <float>    vertices;
+    std::vector <uint32_t> indices;
+    for (const SceneNode &node : scene.nodes())
+    {
+        const SceneMesh &mesh      = scene.meshes()[node.mesh];
+        const glm::mat4  transform = node.transform();
+        const glm::vec3  tint      = glm::vec3 (scene.materials()[node.material].color);
+
+        for (uint32_t i = 0; i < mesh.vertexCount; ++i)
+        {
+            const glm::vec4 position = transform * glm::vec4 (mesh.positions[3 * i], mesh.positions[3 * i + 1],
+                                                              mesh.positions[3 * i + 2], 1.0f);
+            const glm::vec3 color    = tint * glm::vec3 (mesh.colors[3 * i], mesh.colors[3 * i + 1], mesh.colors[3 * i + 2]);
+            vertices.insert (vertices.end(), { position.x, position.y, position.z, color.r, color.g, color.b });
+        }
+        indices.insert (indices.end(), mesh.indices, mesh.indices + mesh.indexCount);
+    }
+    return vertices.size() + indices.size();
+}
+
+// Both baked variants touch every page once, like the upload would
+static uint64_t touchPages (const BakedScene &scene)
+{
+    const size_t PAGE = 4096;
+    uint64_t sum = 0;
+    for (size_t i = 0; i < scene.vertexBytes(); i += PAGE)
+        sum += static_cast <const unsigned char *> (scene.vertices())[i];
+    for (size_t i = 0; i < scene.indexBytes(); i += PAGE)
+        sum += static_cast <const unsigned char *> (scene.indices())[i];
+    return sum + scene.vertexBytes() / sizeof (float) + scene.indexBytes() / sizeof (uint32_t);
+}
+
+static uint64_t startFromBaked (const std::string &path)
+{
+    return touchPages (BakedScene::load (path));
+}
+
+static uint64_t startFromBakedUnchecked (const std::string &path)
+{
+    return touchPages (BakedScene::load (path, BakedScene::Verify::HeaderOnly));
+}
@@ -0,0 +1,284 @@
+#include <glad/glad.h>
+
+#include <iostream>
+#include <fstream>
+#include <chrono>
+#include <string>
+#include <vector>
+#include <filesystem>
+#include <functional>
+#include <cstdlib>
+#include <cstring>
+#include <algorithm>
+#include <stdexcept>
+
+#include "GLSLProgram.h"
+#include "GLStateCache.h"
+#include "AsyncShaderCompiler.h"
+#include "ShaderPreprocessor.h"
+#include "ShaderReloader.h"
+#include "ThreadPool.h"
+#include "BenchContext.h"
+
+namespace fs = std::filesystem;
+
+using Clock = std::chrono::steady_clock;
+
+struct Options
+{
+    size_t      frames = 120;
+    std::string api    = "auto";
+};
+
+struct ReloadResult
+{
+    bool   isSeen;
+    double waitMs;          // from the write to the frame that reported the reload
+    double worstFrameMs;
+    double worstPollMs;     // of the frame's time, spent in the reloader's and compiler's poll()
+    size_t frames;
+};
+
+// Frames a reload gets to show up in before it counts as missed
+static const size_t MAX_RELOAD_FRAMES = 2000;
+
+static const char *VERTEX_SOURCE =
+    "#version 330 core\n"
+    "#include \"tint.glsl\"\n"
+    "layout (location = 0) in vec2 position;\n"
+    "out vec4 color;\n"
+    "void main()\n"
+    "{\n"
+    "    gl_Position = vec4 (position, 0.0, 1.0);\n"
+    "    color       = tint();\n"
+    "}\n";
+
+static const char *FRAGMENT_SOURCE =
+    "#version 330 core\n"
+    "in  vec4 color;\n"
+    "out vec4 fragColor;\n"
+    "void main()\n"
+    "{\n"
+    "    fragColor = color;\n"
+    "}\n";
+
+// The second program's, sharing no file with the first
+static const char *PLAIN_VERTEX_SOURCE =
+    "#version 330 core\n"
+    "layout (location = 0) in vec2 position;\n"
+    "void main()\n"
+    "{\n"
+    "    gl_Position = vec4 (0.5 * position, 0.0, 1.0);\n"
+    "}\n";
+
+static const char *PLAIN_FRAGMENT_SOURCE =
+    "#version 330 core\n"
+    "out vec4 fragColor;\n"
+    "void main()\n"
+    "{\n"
+    "    fragColor = vec4 (1.0);\n"
+    "}\n";
+
+static Options      parseOptions (int argc, char **argv);
+static std::string  tintSource (float red);
+static void         writeFile (const fs::path &path, const std::string &text);
+static ReloadResult waitForReload (const std::function <void()> &edit,
+                                   const std::function <bool (double &, double &)> &frame);
+static double       millisecondsSince (Clock::time_point start);
+
+
+// Builds two programs through AsyncShaderCompiler, one of them including
+// tint.glsl, and draws with them every frame while ShaderReloader watches
+// their files. Then edits the include, breaks it, and fixes it again
+// through a rename the way editors save, printing how long each reload
+// took to show up and the worst frame while it was under way against the
+// median frame, with the part of it spent polling; the rest is the driver,
+// which may only compile a program for real at its first draw
+int main (int argc, char **argv)
+{
+    const Options options = parseOptions (argc, argv);
+
+    const fs::path directory = fs::temp_directory_path() / "ShaderReloadBench";
+    fs::create_directories (directory);
+    writeFile (directory / "tint.glsl",   tintSource (1.0f));
+    writeFile (directory / "reload.vert", VERTEX_SOURCE);
+    writeFile (directory / "reload.frag", FRAGMENT_SOURCE);
+    writeFile (directory / "plain.vert",  PLAIN_VERTEX_SOURCE);
+    writeFile (directory / "plain.frag",  PLAIN_FRAGMENT_SOURCE);
+
+    try
+    {
+        BenchContext context (BenchContext::parseApi (options.api), 256, 256, "ShaderReloadBench");
+        std::cout << "GL_RENDERER: " << glGetString (GL_RENDERER) << " (" << context.backend() << ")\n";
+
+        ThreadPool          pool;
+        ShaderPreprocessor  preprocessor (directory.generic_string());
+        AsyncShaderCompiler compiler (pool, nullptr, nullptr, &preprocessor);
+        ShaderReloader      reloader (compiler, &preprocessor);
+        std::cout << "Parallel shader compile: " << (compiler.hasParallelCompile() ? "yes" : "no") << "\n";
+
+        const AsyncShaderCompiler::Handle tinted = compiler.submit (
+            { (directory / "reload.vert").generic_string(), (directory / "reload.frag").generic_string() });
+        const AsyncShaderCompiler::Handle plain = compiler.submit (
+            { (directory / "plain.vert").generic_string(), (directory / "plain.frag").generic_string() });
+        reloader.track (tinted);
+        reloader.track (plain);
+        compiler.finishAll();
+
+        const float triangle[] = { -0.5f, -0.5f, 0.5f, -0.5f, 0.0f, 0.5f };
+        GLuint vbo = 0, vao = 0;
+        glCreateBuffers (1, &vbo);
+        glNamedBufferStorage (vbo, sizeof (triangle), triangle, 0);
+        glCreateVertexArrays (1, &vao);
+        glVertexArrayVertexBuffer (vao, 0, vbo, 0, 2 * sizeof (float));
+        glEnableVertexArrayAttrib (vao, 0);
+        glVertexArrayAttribFormat (vao, 0, 2, GL_FLOAT, GL_FALSE, 0);
+        glVertexArrayAttribBinding (vao, 0, 0);
+
+        std::vector <ShaderReloader::Reload> reloads;
+
+        // One frame as the application runs it: reloads, compiler, draws, swap.
+        // True once a reload has finished, with the frame and poll times in ms
+        const std::function <bool (double &, double &)> frame = [&] (double &milliseconds, double &pollMs)
+        {
+            Clock::time_point start = Clock::now();
+
+            std::vector <ShaderReloader::Reload> finished = reloader.poll();
+            compiler.poll();
+            pollMs = millisecondsSince (start);
+
+            glClear (GL_COLOR_BUFFER_BIT);
+            GLStateCache::current().bindVertexArray (vao);
+            for (const AsyncShaderCompiler::Handle &program : { tinted, plain })
+            {
+                if (!program->isReady())
+                    continue;
+                GLStateCache::current().useProgram (program->program()->getHandle());
+                glDrawArrays (GL_TRIANGLES, 0, 3);
+            }
+            context.swapBuffers();
+
+            milliseconds = millisecondsSince (start);
+            reloads.insert (reloads.end(), finished.begin(), finished.end());
+            return !finished.empty();
+        };
+
+        // The first frame starts watching the includes
+        std::vector <double> steady;
+        for (size_t i = 0; i < options.frames; ++i)
+        {
+            double milliseconds = 0.0, pollMs = 0.0;
+            frame (milliseconds, pollMs);
+            steady.push_back (milliseconds);
+        }
+        std::sort (steady.begin(), steady.end());
+        std::cout << reloader.watchedFileCount() << " files watched, median frame " << steady[steady.size() / 2]
+                  << " ms\n";
+
+        if (!tinted->program() || !plain->program())
+            throw std::runtime_error ("The programs didn't build: " + tinted->error() + plain->error());
+
+        const struct
+        {
+            const char            *name;
+            std::function <void()> edit;
+        }
+        edits[] =
+        {
+            { "edit",   [&] { writeFile (directory / "tint.glsl", tintSource (0.5f)); } },
+            { "break",  [&] { writeFile (directory / "tint.glsl", "vec4 tint() { return oops; }\n"); } },
+            { "rename", [&] { writeFile (directory / "tint.tmp", tintSource (0.25f));
+                              fs::rename (directory / "tint.tmp", directory / "tint.glsl"); } },
+        };
+
+        for (const auto &edit : edits)
+        {
+            reloads.clear();
+            const ReloadResult result = waitForReload (edit.edit, frame);
+            std::cout << edit.name << ": " << (result.isSeen ? "reloaded" : "NOT SEEN") << " after " << result.waitMs
+                      << " ms over " << result.frames << " frames, worst frame " << result.worstFrameMs
+                      << " ms, of which polling " << result.worstPollMs << " ms\n";
+
+            for (const ShaderReloader::Reload &reload : reloads)
+            {
+                if (!reload.isFailed)
+                    continue;
+                const std::string &log   = reload.error;
+                const size_t       error = std::min (log.find ("error"), log.size());
+                const size_t       begin = log.rfind ('\n', error) == std::string::npos ? 0 : log.rfind ('\n', error) + 1;
+                std::cout << "  reported: " << log.substr (begin, log.find ('\n', begin) - begin) << "\n";
+            }
+        }
+
+        GLStateCache::current().invalidate();
+        glDeleteVertexArrays (1, &vao);
+        glDeleteBuffers (1, &vbo);
+        compiler.finishAll();
+    }
+    catch (const GLSLProgramException &e)
+    {
+        std::cerr << e.what() << std::endl;
+        return 1;
+    }
+    catch (const std::exception &e)
+    {
+        std::cerr << e.what() << std::endl;
+        return 1;
+    }
+
+    std::error_code error;
+    fs::remove_all (directory, error);
+    return 0;
+}
+
+static Options parseOptions (int argc, char **argv)
+{
+    Options options;
+    for (int i = 1; i + 1 < argc; i += 2)
+    {
+        const char *name  = argv[i];
+        const char *value = argv[i + 1];
+
+        if      (strcmp (name, "--frames") == 0) options.frames = std::max <size_t> (strtoul (value, nullptr, 10), 1);
+        else if (strcmp (name, "--api")    == 0) options.api    = value;
+    }
+    return options;
+}
+
+static std::string tintSource (float red)
+{
+    return "vec4 tint() { return vec4 (" + std::to_string (red) + ", 0.5, 0.5, 1.0); }\n";
+}
+
+static void writeFile (const fs::path &path, const std::string &text)
+{
+    std::ofstream file (path, std::ios::binary | std::ios::trunc);
+    file << text;
+    if (!file)
+        throw std::runtime_error ("Can't write " + path.string());
+}
+
+static ReloadResult waitForReload (const std::function <void()> &edit,
+                                   const std::function <bool (double &, double &)> &frame)
+{
+    ReloadResult result = { false, 0.0, 0.0, 0.0, 0 };
+
+    Clock::time_point start = Clock::now();
+    edit();
+
+    while (!result.isSeen && result.frames < MAX_RELOAD_FRAMES)
+    {
+        double milliseconds = 0.0, pollMs = 0.0;
+        result.isSeen       = frame (milliseconds, pollMs);
+        result.worstPollMs  = std::max (result.worstPollMs, pollMs);
+        result.worstFrameMs = std::max (result.worstFrameMs, milliseconds);
+        ++result.frames;
+    }
+    result.waitMs = millisecondsSince (start);
+    return result;
+}
+
+static double millisecondsSince (Clock::time_point start)
+{
+    return std::chrono::duration <double, std::milli> (Clock::now() - start).count();
+}
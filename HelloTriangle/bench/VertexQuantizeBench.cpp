@@ -0,0 +1,171 @@
+#include <iostream>
+#include <chrono>
+#include <random>
+#include <string>
+#include <vector>
+#include <functional>
+#include <cmath>
+#include <cstdlib>
+#include <cstring>
+#include <cstdint>
+#include <algorithm>
+
+#include "VertexLayout.h"
+#include "VertexQuantize.h"
+
+using Clock = std::chrono::steady_clock;
+
+struct Options
+{
+    size_t vertices = 1 << 20;
+    size_t passes   = 5;
+};
+
+// Source streams of a generated mesh, one per attribute
+struct Streams
+{
+    std::vector <float> positions;   // 3 a vertex, within +-50
+    std::vector <float> normals;     // 3, unit length
+    std::vector <float> colors;      // 4, in [0, 1]
+};
+
+static Options parseOptions  (int argc, char **argv);
+static Streams makeStreams   (size_t count);
+static double  medianSeconds (size_t passes, const std::function <void ()> &work);
+static void    timeKernels   (const Streams &streams, size_t passes);
+static void    timeLayout    (const char *name, const VertexLayout &layout, const Streams &streams, size_t passes,
+                              GLsizei floatStride);
+
+
+// Times the quantize kernels, vectorized and scalar, then whole layouts.
+// Their precision is checked by the VertexQuantize tests
+int main (int argc, char **argv)
+{
+    const Options options = parseOptions (argc, argv);
+    const Streams streams = makeStreams (options.vertices);
+
+    VertexElement fittedPosition = { 0, 3, VertexEncoding::Snorm16 };
+    VertexLayout::fitRange (fittedPosition, streams.positions.data(), options.vertices);
+
+    const VertexLayout floats  = { { 0, 3, VertexEncoding::Float },
+                                   { 1, 3, VertexEncoding::Float },
+                                   { 2, 4, VertexEncoding::Float } };
+    const VertexLayout halves  = { { 0, 3, VertexEncoding::Half },
+                                   { 1, 3, VertexEncoding::Octahedral },
+                                   { 2, 4, VertexEncoding::Unorm8 } };
+    const VertexLayout snorms  = { fittedPosition,
+                                   { 1, 3, VertexEncoding::Octahedral },
+                                   { 2, 4, VertexEncoding::Unorm8 } };
+
+    std::cout << options.vertices << " vertices, " << (isQuantizeVectorized() ? "SSE2" : "scalar") << " kernels\n";
+
+    timeKernels (streams, options.passes);
+
+    std::cout << "layouts (position, normal, color):\n";
+    timeLayout ("float",   floats, streams, options.passes, floats.stride());
+    timeLayout ("half",    halves, streams, options.passes, floats.stride());
+    timeLayout ("snorm16", snorms, streams, options.passes, floats.stride());
+    return 0;
+}
+
+static Options parseOptions (int argc, char **argv)
+{
+    Options options;
+    for (int i = 1; i + 1 < argc; i += 2)
+    {
+        const size_t value = strtoul (argv[i + 1], nullptr, 10);
+
+        if      (strcmp (argv[i], "--vertices") == 0) options.vertices = value;
+        else if (strcmp (argv[i], "--passes")   == 0) options.passes   = value;
+    }
+    options.vertices = std::max <size_t> (options.vertices, 1);
+    options.passes   = std::max <size_t> (options.passes,   1);
+    return options;
+}
+
+static Streams makeStreams (size_t count)
+{
+    std::mt19937 random (42);
+    std::uniform_real_distribution <float> position (-50.0f, 50.0f);
+    std::uniform_real_distribution <float> unit     (0.0f, 1.0f);
+    std::normal_distribution <float>       gaussian;
+
+    Streams streams;
+    for (size_t i = 0; i < count; ++i)
+    {
+        const glm::vec3 normal = glm::normalize (glm::vec3 (gaussian (random), gaussian (random), gaussian (random)));
+        streams.positions.insert (streams.positions.end(), { position (random), position (random), position (random) });
+        streams.normals.insert   (streams.normals.end(),   { normal.x, normal.y, normal.z });
+        streams.colors.insert    (streams.colors.end(),    { unit (random), unit (random), unit (random), unit (random) });
+    }
+    return streams;
+}
+
+static double medianSeconds (size_t passes, const std::function <void ()> &work)
+{
+    std::vector <double> seconds;
+    for (size_t pass = 0; pass < passes; ++pass)
+    {
+        Clock::time_point start = Clock::now();
+        work();
+        seconds.push_back (std::chrono::duration <double> (Clock::now() - start).count());
+    }
+    std::sort (seconds.begin(), seconds.end());
+    return seconds[seconds.size() / 2];
+}
+
+static void timeKernels (const Streams &streams, size_t passes)
+{
+    const float *input = streams.positions.data();
+    const size_t count = streams.positions.size();
+
+    std::vector <uint16_t> halves (count);
+    std::vector <int16_t>  snorms (count);
+    std::vector <uint8_t>  unorms (count);
+
+    struct Kernel
+    {
+        const char              *name;
+        size_t                   values;
+        std::function <void ()>  vectorized;
+        std::function <void ()>  scalar;
+    };
+    const Kernel kernels[] =
+    {
+        { "half",       count,
+          [&] { quantizeHalf (input, halves.data(), count); },
+          [&] { quantizeHalfScalar (input, halves.data(), count); } },
+        { "snorm16",    count,
+          [&] { quantizeSnorm16 (input, snorms.data(), count); },
+          [&] { quantizeSnorm16Scalar (input, snorms.data(), count); } },
+        { "unorm8",     count,
+          [&] { quantizeUnorm8 (streams.colors.data(), unorms.data(), count); },
+          [&] { quantizeUnorm8Scalar (streams.colors.data(), unorms.data(), count); } },
+        { "octahedral", count / 3,
+          [&] { quantizeOctahedral (streams.normals.data(), snorms.data(), count / 3); },
+          [&] { quantizeOctahedralScalar (streams.normals.data(), snorms.data(), count / 3); } }
+    };
+
+    std::cout << "kernels, M values/s (vectorized, scalar):\n";
+    for (const Kernel &kernel : kernels)
+    {
+        const double vectorized = medianSeconds (passes, kernel.vectorized);
+        const double scalar     = medianSeconds (passes, kernel.scalar);
+        std::cout << "  " << kernel.name << ": " << kernel.values / vectorized / 1e6 << ", "
+                  << kernel.values / scalar / 1e6 << " (" << scalar / vectorized << "x)\n";
+    }
+}
+
+static void timeLayout (const char *name, const VertexLayout &layout, const Streams &streams, size_t passes,
+                        GLsizei floatStride)
+{
+    const size_t count = streams.positions.size() / 3;
+    const float *sources[] = { streams.positions.data(), streams.normals.data(), streams.colors.data() };
+
+    std::vector <char> vertices (count * layout.stride());
+    const double seconds = medianSeconds (passes, [&] { layout.encode (sources, count, vertices.data()); });
+
+    std::cout << "  " << name << ": " << layout.stride() << " bytes a vertex ("
+              << double (floatStride) / layout.stride() << "x smaller), " << count / seconds / 1e6 << " M vertices/s, "
+              << vertices.size() / seconds / (1024.0 * 1024.0) << " MB/s written\n";
+}
@@ -0,0 +1,12 @@
+#version 330 core
+
+layout (location = 0) in vec3 aPos;
+layout (location = 1) in vec3 color;
+layout (location = 7) in vec4 drawData;   // xy offset, z scale
+out vec4 vertColor;
+
+void main()
+{
+    gl_Position = vec4 (aPos.xy * drawData.z + drawData.xy, aPos.z, 1.0);
+    vertColor   = vec4 (color, 1.0);
+}
@@ -0,0 +1,16 @@
+#version 330 core
+
+layout (location = 0)  in vec3 aPos;
+layout (location = 1)  in vec3 color;
+layout (location = 8)  in vec4 row0;      // the instance's transform, 3 rows of 4
+layout (location = 9)  in vec4 row1;
+layout (location = 10) in vec4 row2;
+layout (location = 11) in vec4 tint;
+out vec4 vertColor;
+
+void main()
+{
+    vec4 position = vec4 (aPos, 1.0);
+    gl_Position   = vec4 (dot (row0, position), dot (row1, position), dot (row2, position), 1.0);
+    vertColor     = vec4 (color, 1.0) * tint;
+}
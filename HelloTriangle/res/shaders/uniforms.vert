@@ -0,0 +1,15 @@
+#version 330 core
+
+layout (location = 0) in vec3 aPos;
+layout (location = 1) in vec3 color;
+uniform mat4  transform;
+uniform vec4  tint;
+uniform vec2  offset;
+uniform float scale;
+out vec4 vertColor;
+
+void main()
+{
+    gl_Position = transform * vec4 (aPos.xy * scale + offset, aPos.z, 1.0);
+    vertColor   = vec4 (color, 1.0) * tint;
+}
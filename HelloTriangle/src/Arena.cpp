@@ -0,0 +1,116 @@
+#include "Arena.h"
+
+#include <string>
+#include <utility>
+#include <cstring>
+#include <stdexcept>
+#include <algorithm>
+
+#ifdef _WIN32
+#ifndef NOMINMAX
+#define NOMINMAX
+#endif
+#include <windows.h>
+#else
+#include <sys/mman.h>
+#endif
+
+// Pages are committed in steps of this, so streaming a float at a time
+// doesn't turn into a system call every page
+static const size_t COMMIT_GRANULARITY = 64 * 1024;
+
+static size_t roundUp (size_t value, size_t granularity);
+
+
+Arena::Arena (size_t reserveBytes)
+    : m_base (nullptr), m_reserved (roundUp (std::max <size_t> (reserveBytes, 1), COMMIT_GRANULARITY)),
+      m_committed (0), m_used (0)
+{
+#ifdef _WIN32
+    m_base = static_cast <char *> (VirtualAlloc (nullptr, m_reserved, MEM_RESERVE, PAGE_NOACCESS));
+    if (!m_base)
+        throw std::runtime_error ("Can't reserve the arena");
+#else
+    void *base = mmap (nullptr, m_reserved, PROT_NONE, MAP_PRIVATE | MAP_ANONYMOUS | MAP_NORESERVE, -1, 0);
+    if (base == MAP_FAILED)
+        throw std::runtime_error ("Can't reserve the arena");
+    m_base = static_cast <char *> (base);
+#endif
+}
+
+Arena::~Arena()
+{
+    release();
+}
+
+Arena::Arena (Arena &&other) noexcept
+    : m_base      (std::exchange (other.m_base,      nullptr)),
+      m_reserved  (std::exchange (other.m_reserved,  0)),
+      m_committed (std::exchange (other.m_committed, 0)),
+      m_used      (std::exchange (other.m_used,      0))
+{
+}
+
+Arena &Arena::operator = (Arena &&other) noexcept
+{
+    if (this == &other)
+        return *this;
+
+    release();
+
+    m_base      = std::exchange (other.m_base,      nullptr);
+    m_reserved  = std::exchange (other.m_reserved,  0);
+    m_committed = std::exchange (other.m_committed, 0);
+    m_used      = std::exchange (other.m_used,      0);
+    return *this;
+}
+
+char *Arena::copyString (const char *string, size_t length)
+{
+    char *copy = allocate <char> (length + 1);
+    memcpy (copy, string, length);
+    copy[length] = '\0';
+    return copy;
+}
+
+void Arena::reset()
+{
+    m_used = 0;
+}
+
+void Arena::release()
+{
+    if (!m_base)
+        return;
+
+#ifdef _WIN32
+    VirtualFree (m_base, 0, MEM_RELEASE);
+#else
+    munmap (m_base, m_reserved);
+#endif
+    m_base = nullptr;
+}
+
+void Arena::commit (size_t bytes)
+{
+    if (bytes > m_reserved)
+        throw std::runtime_error ("Arena reservation of " + std::to_string (m_reserved) + " bytes is used up");
+
+    const size_t committed = std::min (roundUp (bytes, COMMIT_GRANULARITY), m_reserved);
+#ifdef _WIN32
+    const bool isCommitted = VirtualAlloc (m_base + m_committed, committed - m_committed,
+                                           MEM_COMMIT, PAGE_READWRITE) != nullptr;
+#else
+    const bool isCommitted = mprotect (m_base + m_committed, committed - m_committed,
+                                       PROT_READ | PROT_WRITE) == 0;
+#endif
+    if (!isCommitted)
+        throw std::runtime_error ("Can't commit arena memory");
+
+    m_committed = committed;
+}
+
+static size_t roundUp (size_t value, size_t granularity)
+{
+    return (value + granularity - 1) / granularity * granularity;
+}
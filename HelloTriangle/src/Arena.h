@@ -0,0 +1,63 @@
+#ifndef ARENA_INCLUDED
+#define ARENA_INCLUDED
+
+#include <cstddef>
+#include <cstdint>
+
+// Bump allocator over one reserved range of address space. Pages are
+// committed as the top moves, so a generous reservation costs address space
+// rather than memory, and nothing handed out ever moves until reset().
+// Back to back allocations of the same type are contiguous, which is how
+// arrays of unknown length are streamed into it
+class Arena
+{
+public:
+    explicit Arena (size_t reserveBytes);
+   ~Arena();
+
+    Arena             (Arena &&other) noexcept;
+    Arena &operator = (Arena &&other) noexcept;
+
+    // Throws std::runtime_error once the reservation is used up
+    void *allocate (size_t size, size_t alignment = alignof (std::max_align_t));
+
+    template <class T>
+    T    *allocate (size_t count = 1) { return static_cast <T *> (allocate (sizeof (T) * count, alignof (T))); }
+
+    template <class T>
+    T    *push (const T &value) { return &(*allocate <T>() = value); }
+
+    // Null terminated copy
+    char *copyString (const char *string, size_t length);
+
+    // Keeps the committed pages for reuse
+    void   reset();
+
+    size_t used() const      { return m_used; }
+    size_t committed() const { return m_committed; }
+    size_t reserved() const  { return m_reserved; }
+
+private:
+    char  *m_base;
+    size_t m_reserved;
+    size_t m_committed;
+    size_t m_used;
+
+    void   release();
+    void   commit (size_t bytes);
+
+    Arena             (const Arena &other) = delete;
+    Arena &operator = (const Arena &other) = delete;
+};
+
+inline void *Arena::allocate (size_t size, size_t alignment)
+{
+    const size_t offset = (m_used + alignment - 1) & ~(alignment - 1);
+    if (offset + size > m_committed)
+        commit (offset + size);
+
+    m_used = offset + size;
+    return m_base + offset;
+}
+
+#endif // !ARENA_INCLUDED
@@ -0,0 +1,294 @@
+#include "AsyncShaderCompiler.h"
+#include "Profiler.h"
+
+#include <chrono>
+#include <cstring>
+#include <algorithm>
+
+typedef void (APIENTRYP PFNGLMAXSHADERCOMPILERTHREADSKHRPROC) (GLuint count);
+
+static bool isSourceReady (const std::future <std::vector <ShaderProgramRequest::StageSource>> &sources);
+
+
+ShaderProgramRequest::Status ShaderProgramRequest::status() const
+{
+    return m_status;
+}
+
+bool ShaderProgramRequest::isDone() const
+{
+    return m_status == Status::Ready || m_status == Status::Failed;
+}
+
+bool ShaderProgramRequest::isReady() const
+{
+    return m_status == Status::Ready;
+}
+
+bool ShaderProgramRequest::isFailed() const
+{
+    return m_status == Status::Failed;
+}
+
+std::shared_ptr <GLSLProgram> ShaderProgramRequest::program() const
+{
+    return isReady() ? m_program : nullptr;
+}
+
+const std::string &ShaderProgramRequest::error() const
+{
+    return m_error;
+}
+
+const std::vector <std::string> &ShaderProgramRequest::files() const
+{
+    return m_files;
+}
+
+const std::vector <std::string> &ShaderProgramRequest::dependencies() const
+{
+    return m_dependencies;
+}
+
+AsyncShaderCompiler::AsyncShaderCompiler (ThreadPool &pool, GLADloadproc loader,
+                                          ProgramBinaryCache *cache, ShaderPreprocessor *preprocessor)
+    : m_pool (pool), m_binaryCache (cache), m_preprocessor (preprocessor),
+      m_hasParallelCompile (false), m_frame (0)
+{
+    m_hasParallelCompile = hasGLExtension ("GL_KHR_parallel_shader_compile") ||
+                           hasGLExtension ("GL_ARB_parallel_shader_compile");
+    if (!m_hasParallelCompile || !loader)
+        return;
+
+    auto maxCompilerThreads = reinterpret_cast <PFNGLMAXSHADERCOMPILERTHREADSKHRPROC> (
+        loader ("glMaxShaderCompilerThreadsKHR"));
+    if (!maxCompilerThreads)
+        maxCompilerThreads = reinterpret_cast <PFNGLMAXSHADERCOMPILERTHREADSKHRPROC> (
+            loader ("glMaxShaderCompilerThreadsARB"));
+
+    // 0xFFFFFFFF lets the driver pick its own number of compiler threads
+    if (maxCompilerThreads)
+        maxCompilerThreads (0xFFFFFFFF);
+}
+
+AsyncShaderCompiler::Handle AsyncShaderCompiler::submit (const std::vector <std::string> &shaderFiles,
+                                                         const ShaderDefines &defines)
+{
+    auto request = std::make_shared <Request>();
+    request->m_files        = shaderFiles;
+    request->m_dependencies = shaderFiles;
+    request->m_defines      = defines;
+    request->m_status       = Request::Status::Loading;
+    request->m_linkFrame = 0;
+
+    ShaderPreprocessor *preprocessor = m_preprocessor;
+    request->m_sources = m_pool.submit ([shaderFiles, defines, preprocessor] {
+        std::vector <Request::StageSource> sources;
+        sources.reserve (shaderFiles.size());
+
+        for (const auto &file : shaderFiles)
+        {
+            Request::StageSource stage;
+            stage.type = ShaderInfo::translateFileExtension (file.c_str());
+
+            if (preprocessor)
+            {
+                ShaderPreprocessor::Result result = preprocessor->process (file, defines);
+                stage.fileName = result.label();
+                stage.source   = std::move (result.source);
+                stage.files    = std::move (result.files);
+            }
+            else
+            {
+                stage.fileName = file;
+                stage.files    = { file };
+                stage.file     = MappedFileCache::global().open (file);
+                if (!stage.file)
+                    throw GLSLProgramException ("Can't open the file " + file);
+            }
+            sources.push_back (std::move (stage));
+        }
+        return sources;
+    });
+
+    m_pending.push_back (request);
+    return request;
+}
+
+// The handles given out are const to their users only, the requests behind
+// them are the compiler's own
+AsyncShaderCompiler::Handle AsyncShaderCompiler::reload (const Handle &program)
+{
+    assert (program && program->isDone() && "reload a program once its build is done");
+
+    Handle reloaded = submit (program->m_files, program->m_defines);
+    m_pending.back()->m_target = std::const_pointer_cast <Request> (program);
+    return reloaded;
+}
+
+void AsyncShaderCompiler::poll (size_t maxBlockingLinks)
+{
+    PROFILE_SCOPE ("AsyncShaderCompiler::poll");
+
+    ++m_frame;
+    size_t blockingLinks = 0;
+
+    for (auto &request : m_pending)
+    {
+        if (request->m_status == Request::Status::Loading && isSourceReady (request->m_sources))
+        {
+            startLink (*request);
+        }
+        else if (request->m_status == Request::Status::Linking)
+        {
+            // Without the extension the driver gets at least one frame before we block on it
+            bool isComplete = m_hasParallelCompile
+                ? request->m_program->isLinkComplete()
+                : request->m_linkFrame < m_frame && blockingLinks++ < maxBlockingLinks;
+
+            if (isComplete)
+                finishLink (*request);
+        }
+
+        if (request->isDone() && request->m_target)
+            replace (*request);
+    }
+
+    m_pending.erase (std::remove_if (m_pending.begin(), m_pending.end(),
+        [] (const std::shared_ptr <Request> &request) { return request->isDone(); }), m_pending.end());
+}
+
+void AsyncShaderCompiler::finishAll()
+{
+    for (auto &request : m_pending)
+    {
+        if (request->m_status == Request::Status::Loading)
+        {
+            request->m_sources.wait();
+            startLink (*request);
+        }
+    }
+
+    for (auto &request : m_pending)
+    {
+        if (request->m_status == Request::Status::Linking)
+            finishLink (*request);
+        if (request->m_target)
+            replace (*request);
+    }
+
+    m_pending.clear();
+}
+
+size_t AsyncShaderCompiler::pendingCount() const
+{
+    return m_pending.size();
+}
+
+bool AsyncShaderCompiler::hasParallelCompile() const
+{
+    return m_hasParallelCompile;
+}
+
+// The preprocessor and the binary cache throw std::exception, the program
+// GLSLProgramException; either way the request fails with the message
+void AsyncShaderCompiler::startLink (Request &request)
+{
+    try
+    {
+        std::vector <Request::StageSource> sources = request.m_sources.get();
+
+        request.m_dependencies.clear();
+        for (const auto &stage : sources)
+            request.m_dependencies.insert (request.m_dependencies.end(), stage.files.begin(), stage.files.end());
+
+        request.m_program = std::make_shared <GLSLProgram>();
+        request.m_program->setBinaryCache (m_binaryCache);
+        for (const auto &stage : sources)
+        {
+            if (stage.file)
+                request.m_program->addShaderSource (stage.file, stage.type, stage.fileName.c_str());
+            else
+                request.m_program->addShaderSource (stage.source, stage.type, stage.fileName.c_str());
+        }
+
+        request.m_program->beginLink();
+    }
+    catch (const GLSLProgramException &ex)
+    {
+        fail (request, ex.what());
+        return;
+    }
+    catch (const std::exception &ex)
+    {
+        fail (request, ex.what());
+        return;
+    }
+
+    request.m_linkFrame = m_frame;
+    request.m_status    = request.m_program->isLinked() ? Request::Status::Ready
+                                                        : Request::Status::Linking;
+}
+
+void AsyncShaderCompiler::finishLink (Request &request)
+{
+    try
+    {
+        request.m_program->finishLink();
+    }
+    catch (const GLSLProgramException &ex)
+    {
+        fail (request, ex.what());
+        return;
+    }
+    catch (const std::exception &ex)
+    {
+        fail (request, ex.what());
+        return;
+    }
+
+    request.m_status = Request::Status::Ready;
+}
+
+void AsyncShaderCompiler::fail (Request &request, const std::string &error)
+{
+    request.m_program.reset();
+    request.m_error  = error;
+    request.m_status = Request::Status::Failed;
+}
+
+// A reload that linked takes its target's place, the target's last good
+// program is released here on the GL thread. One that failed leaves it be
+void AsyncShaderCompiler::replace (Request &request)
+{
+    Request &target = *request.m_target;
+    if (request.isReady())
+    {
+        target.m_program      = request.m_program;
+        target.m_dependencies = request.m_dependencies;
+        target.m_error.clear();
+        target.m_status       = Request::Status::Ready;
+    }
+    request.m_target.reset();
+}
+
+bool hasGLExtension (const char *name)
+{
+    assert (name);
+
+    GLint count = 0;
+    glGetIntegerv (GL_NUM_EXTENSIONS, &count);
+
+    for (GLint i = 0; i < count; ++i)
+    {
+        const GLubyte *extension = glGetStringi (GL_EXTENSIONS, i);
+        if (extension && strcmp (reinterpret_cast <const char *> (extension), name) == 0)
+            return true;
+    }
+    return false;
+}
+
+static bool isSourceReady (const std::future <std::vector <ShaderProgramRequest::StageSource>> &sources)
+{
+    return sources.wait_for (std::chrono::seconds (0)) == std::future_status::ready;
+}
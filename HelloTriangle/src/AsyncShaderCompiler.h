@@ -0,0 +1,115 @@
+#ifndef ASYNC_SHADER_COMPILER_INCLUDED
+#define ASYNC_SHADER_COMPILER_INCLUDED
+
+#include <string>
+#include <vector>
+#include <memory>
+#include <future>
+#include <glad/glad.h>
+
+#include "GLSLProgram.h"
+#include "ThreadPool.h"
+
+#ifndef GL_MAX_SHADER_COMPILER_THREADS_KHR
+#define GL_MAX_SHADER_COMPILER_THREADS_KHR 0x91B0
+#endif
+
+class ProgramBinaryCache;
+class ShaderPreprocessor;
+
+class ShaderProgramRequest
+{
+public:
+    struct StageSource
+    {
+        std::string                        fileName;
+        GLenum                             type;
+        std::string                        source;
+        std::shared_ptr <const MappedFile> file;    // used instead of source when set
+        std::vector <std::string>          files;   // the file and everything it included
+    };
+
+    enum class Status
+    {
+        Loading,    // sources are being read on a worker thread
+        Linking,    // handed to the driver, waiting for the link result
+        Ready,
+        Failed
+    };
+
+    Status status()   const;
+    bool   isDone()   const;
+    bool   isReady()  const;
+    bool   isFailed() const;
+
+    // Valid once the request is ready
+    std::shared_ptr <GLSLProgram> program() const;
+    const std::string &error() const;
+    const std::vector <std::string> &files() const;
+    // Every file the program was built from, includes too. Just files()
+    // until the sources have been read
+    const std::vector <std::string> &dependencies() const;
+
+private:
+    std::vector <std::string>                   m_files;
+    std::vector <std::string>                   m_dependencies;
+    ShaderDefines                               m_defines;
+    std::future <std::vector <StageSource>>     m_sources;
+    std::shared_ptr <GLSLProgram>               m_program;
+    Status                                      m_status;
+    std::string                                 m_error;
+    size_t                                      m_linkFrame;
+    std::shared_ptr <ShaderProgramRequest>      m_target;       // the program a reload replaces
+
+    friend class AsyncShaderCompiler;
+};
+
+// Batches program builds: file reading runs on a thread pool, compiling and
+// linking is left to the driver and polled once per frame from the GL thread
+class AsyncShaderCompiler
+{
+public:
+    using Handle = std::shared_ptr <const ShaderProgramRequest>;
+
+    // loader is used to reach glMaxShaderCompilerThreadsKHR, it may be null;
+    // with a preprocessor the sources are expanded on the worker threads too
+    AsyncShaderCompiler (ThreadPool &pool, GLADloadproc loader = nullptr,
+                         ProgramBinaryCache *cache = nullptr,
+                         ShaderPreprocessor *preprocessor = nullptr);
+
+    Handle submit (const std::vector <std::string> &shaderFiles,
+                   const ShaderDefines &defines = ShaderDefines());
+
+    // Builds program again from its files, which must be done. When the
+    // rebuild links, poll() puts it in program's place, between frames;
+    // when it fails program keeps what it had. The returned request tells
+    // which and carries the error
+    Handle reload (const Handle &program);
+
+    // Must be called on the GL thread; without the parallel compile extension
+    // at most maxBlockingLinks programs per call may wait on the driver
+    void   poll (size_t maxBlockingLinks = 1);
+    void   finishAll();
+
+    size_t pendingCount() const;
+    bool   hasParallelCompile() const;
+
+private:
+    using Request = ShaderProgramRequest;
+
+    ThreadPool                          &m_pool;
+    ProgramBinaryCache                  *m_binaryCache;
+    ShaderPreprocessor                  *m_preprocessor;
+    bool                                 m_hasParallelCompile;
+    size_t                               m_frame;
+    std::vector <std::shared_ptr <Request>> m_pending;
+
+    void   startLink  (Request &request);
+    void   finishLink (Request &request);
+    void   fail       (Request &request, const std::string &error);
+    void   replace    (Request &request);
+};
+
+bool hasGLExtension (const char *name);
+
+#endif // !ASYNC_SHADER_COMPILER_INCLUDED
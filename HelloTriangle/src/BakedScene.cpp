@@ -0,0 +1,419 @@
+#include "BakedScene.h"
+#include "Scene.h"
+#include "Profiler.h"
+#include "VertexLayout.h"
+#include "MeshOptimizer.h"
+
+#include <vector>
+#include <numeric>
+#include <cstdio>
+#include <cstring>
+#include <stdexcept>
+#include <filesystem>
+
+#include <glad/glad.h>
+
+namespace fs = std::filesystem;
+
+static const char     MAGIC[8]         = "HTSCENE";
+static const uint32_t MAX_SECTIONS     = 64;
+static const uint64_t FNV_OFFSET_BASIS = 0xcbf29ce484222325ull;
+static const uint64_t FNV_PRIME        = 0x100000001b3ull;
+
+// Baked vertices: float position and unorm8 tinted color, 16 bytes where
+// the floats took 24. Positions are flattened into world space, where half
+// floats would lose precision away from the origin
+static const VertexLayout BAKED_LAYOUT =
+{
+    { 0, 3, VertexEncoding::Float },
+    { 1, 3, VertexEncoding::Unorm8 }
+};
+
+static void     check (bool condition, const std::string &path, const char *problem);
+static uint64_t alignUp (uint64_t value, uint64_t alignment);
+static void     computeBounds (BakedMesh &mesh, const std::vector <char> &vertices);
+
+
+BakedScene::BakedScene()
+    : m_sections()
+{
+}
+
+BakedScene BakedScene::load (const std::string &path, Verify verify)
+{
+    PROFILE_SCOPE ("BakedScene::load");
+
+    BakedScene scene;
+    if (!scene.m_file.open (path))
+        throw std::runtime_error ("Can't open the baked scene " + path);
+
+    const char  *data = scene.m_file.data();
+    const size_t size = scene.m_file.size();
+
+    check (size >= sizeof (BakedHeader), path, "is truncated");
+    const BakedHeader &header = *reinterpret_cast <const BakedHeader *> (data);
+    check (memcmp (header.magic, MAGIC, sizeof (MAGIC)) == 0, path, "is not a baked scene");
+    check (header.version == VERSION, path, "was baked for another version");
+    check (header.fileSize == size, path, "is truncated");
+    check (header.sectionCount <= MAX_SECTIONS &&
+           sizeof (BakedHeader) + header.sectionCount * sizeof (BakedSection) <= size, path, "has a broken section table");
+
+    const BakedSection *table = reinterpret_cast <const BakedSection *> (data + sizeof (BakedHeader));
+    for (uint32_t i = 0; i < header.sectionCount; ++i)
+    {
+        const BakedSection &section = table[i];
+        check (section.offset % SECTION_ALIGNMENT == 0 && section.offset <= size &&
+               section.size <= size - section.offset, path, "has a section out of bounds");
+
+        // Unknown sections are left for newer readers
+        if (section.type < static_cast <uint32_t> (Section::Count))
+            scene.m_sections[section.type] = &section;
+    }
+    for (const BakedSection *section : scene.m_sections)
+        check (section != nullptr, path, "misses a section");
+
+    if (verify == Verify::Checksum)
+    {
+        check (checksum (data + sizeof (BakedHeader), size - sizeof (BakedHeader)) == header.checksum,
+               path, "fails its checksum");
+    }
+
+    check (scene.section (Section::Programs).size  % sizeof (BakedProgram)  == 0 &&
+           scene.section (Section::Materials).size % sizeof (BakedMaterial) == 0 &&
+           scene.section (Section::Meshes).size    % sizeof (BakedMesh)     == 0 &&
+           scene.section (Section::Draws).size     % sizeof (BakedDraw)     == 0, path, "has a torn record");
+
+    // The records are few, their references are checked here so users can
+    // index with them; the bulk data is trusted to the checksum
+    const BakedSection &strings = scene.section (Section::Strings);
+    check (strings.size > 0 && scene.sectionData (Section::Strings)[strings.size - 1] == '\0',
+           path, "has unterminated strings");
+
+    for (const BakedProgram &program : scene.programs())
+        check (program.name < strings.size && program.vertex < strings.size && program.fragment < strings.size,
+               path, "has a program out of bounds");
+
+    for (const BakedMaterial &material : scene.materials())
+        check (material.name < strings.size && material.program < scene.programs().size(),
+               path, "has a material out of bounds");
+
+    const uint64_t vertexBytes = scene.section (Section::Vertices).size;
+    const uint64_t indexBytes  = scene.section (Section::Indices).size;
+    for (const BakedMesh &mesh : scene.meshes())
+    {
+        check (mesh.name < strings.size && mesh.stride > 0 && mesh.vertexOffset % mesh.stride == 0 &&
+               mesh.attributeCount <= BakedMesh::MAX_ATTRIBUTES &&
+               mesh.vertexOffset + uint64_t (mesh.vertexCount) * mesh.stride <= vertexBytes &&
+               mesh.indexOffset % sizeof (uint32_t) == 0 &&
+               mesh.indexOffset + uint64_t (mesh.indexCount) * sizeof (uint32_t) <= indexBytes,
+               path, "has a mesh out of bounds");
+    }
+
+    for (const BakedDraw &draw : scene.draws())
+        check (draw.mesh < scene.meshes().size() && draw.material < scene.materials().size(),
+               path, "has a draw out of bounds");
+
+    return scene;
+}
+
+void BakedScene::bake (const Scene &scene, const std::string &path)
+{
+    PROFILE_SCOPE ("BakedScene::bake");
+
+    std::string strings (1, '\0');
+    auto addString = [&strings] (const char *string)
+    {
+        const uint32_t offset = static_cast <uint32_t> (strings.size());
+        strings.append (string, strlen (string) + 1);
+        return offset;
+    };
+
+    std::vector <BakedProgram> programs;
+    for (const SceneProgram &program : scene.programs())
+        programs.push_back ({ addString (program.name), addString (program.vertex), addString (program.fragment) });
+
+    std::vector <BakedMaterial> materials;
+    for (const SceneMaterial &material : scene.materials())
+    {
+        materials.push_back ({ addString (material.name), material.program,
+                               { material.color.r, material.color.g, material.color.b, material.color.a } });
+    }
+
+    std::vector <BakedMesh> meshes;
+    std::vector <BakedDraw> draws;
+    std::vector <char>      vertices;
+    std::vector <uint32_t>  indices;
+    std::vector <float>     positions;
+    std::vector <float>     colors;
+    std::vector <char>      meshVertices;
+    std::vector <uint32_t>  meshIndices;
+    for (const SceneNode &node : scene.nodes())
+    {
+        const SceneMesh     &source    = scene.meshes()[node.mesh];
+        const glm::mat4      transform = node.transform();
+        const glm::vec3      tint      = glm::vec3 (scene.materials()[node.material].color);
+
+        BakedMesh mesh = {};
+        mesh.name           = addString (source.name);
+        mesh.stride         = static_cast <uint32_t> (BAKED_LAYOUT.stride());
+        mesh.vertexOffset   = vertices.size();
+        mesh.indexOffset    = indices.size() * sizeof (uint32_t);
+        mesh.attributeCount = static_cast <uint32_t> (BAKED_LAYOUT.format().attributes.size());
+        for (uint32_t i = 0; i < mesh.attributeCount; ++i)
+        {
+            const VertexAttribute &attribute = BAKED_LAYOUT.format().attributes[i];
+            mesh.attributes[i] = { attribute.location, static_cast <uint32_t> (attribute.components), attribute.type,
+                                   attribute.normalized, attribute.offset };
+        }
+
+        positions.clear();
+        colors.clear();
+        for (uint32_t i = 0; i < source.vertexCount; ++i)
+        {
+            const float    *p        = source.positions + 3 * i;
+            const glm::vec4 position = transform * glm::vec4 (p[0], p[1], p[2], 1.0f);
+            const glm::vec3 color    = tint * (source.colors ? glm::vec3 (source.colors[3 * i], source.colors[3 * i + 1],
+                                                                          source.colors[3 * i + 2]) : glm::vec3 (1.0f));
+
+            positions.insert (positions.end(), { position.x, position.y, position.z });
+            colors.insert    (colors.end(),    { color.r, color.g, color.b });
+        }
+
+        const float *streams[] = { positions.data(), colors.data() };
+        meshVertices.resize (size_t (source.vertexCount) * mesh.stride);
+        BAKED_LAYOUT.encode (streams, source.vertexCount, meshVertices.data());
+
+        // Welded after quantizing, so vertices that only differed below
+        // the encoding's precision become one
+        if (source.indices)
+        {
+            meshIndices.assign (source.indices, source.indices + source.indexCount);
+        }
+        else
+        {
+            meshIndices.resize (source.vertexCount);
+            std::iota (meshIndices.begin(), meshIndices.end(), 0u);
+        }
+        if (meshIndices.size() % 3 == 0)
+            optimizeMesh (meshVertices, mesh.stride, meshIndices);
+
+        mesh.vertexCount = static_cast <uint32_t> (meshVertices.size() / mesh.stride);
+        mesh.indexCount  = static_cast <uint32_t> (meshIndices.size());
+        computeBounds (mesh, meshVertices);
+        vertices.insert (vertices.end(), meshVertices.begin(), meshVertices.end());
+        indices.insert  (indices.end(),  meshIndices.begin(),  meshIndices.end());
+
+        draws.push_back ({ static_cast <uint32_t> (meshes.size()), node.material });
+        meshes.push_back (mesh);
+    }
+
+    const std::pair <const void *, size_t> payloads[] =
+    {
+        { strings.data(),   strings.size() },
+        { programs.data(),  programs.size()  * sizeof (BakedProgram) },
+        { materials.data(), materials.size() * sizeof (BakedMaterial) },
+        { meshes.data(),    meshes.size()    * sizeof (BakedMesh) },
+        { draws.data(),     draws.size()     * sizeof (BakedDraw) },
+        { vertices.data(),  vertices.size() },
+        { indices.data(),   indices.size()   * sizeof (uint32_t) }
+    };
+    const uint32_t sectionCount = static_cast <uint32_t> (Section::Count);
+
+    BakedSection table[sectionCount] = {};
+    uint64_t     offset = alignUp (sizeof (BakedHeader) + sizeof (table), SECTION_ALIGNMENT);
+    for (uint32_t i = 0; i < sectionCount; ++i)
+    {
+        table[i] = { i, 0, offset, payloads[i].second };
+        offset   = alignUp (offset + payloads[i].second, SECTION_ALIGNMENT);
+    }
+
+    std::vector <char> file (offset, '\0');
+    memcpy (file.data() + sizeof (BakedHeader), table, sizeof (table));
+    for (uint32_t i = 0; i < sectionCount; ++i)
+    {
+        if (payloads[i].second > 0)
+            memcpy (file.data() + table[i].offset, payloads[i].first, payloads[i].second);
+    }
+
+    BakedHeader header = {};
+    memcpy (header.magic, MAGIC, sizeof (MAGIC));
+    header.version      = VERSION;
+    header.sectionCount = sectionCount;
+    header.fileSize     = file.size();
+    header.checksum     = checksum (file.data() + sizeof (BakedHeader), file.size() - sizeof (BakedHeader));
+    memcpy (file.data(), &header, sizeof (header));
+
+    // Written aside and renamed over, a reader never sees half a file
+    const fs::path target (path);
+    if (target.has_parent_path())
+        fs::create_directories (target.parent_path());
+
+    const std::string temporary = path + ".tmp";
+    FILE *output = fopen (temporary.c_str(), "wb");
+    if (!output)
+        throw std::runtime_error ("Can't write " + temporary);
+
+    const bool isWritten = fwrite (file.data(), 1, file.size(), output) == file.size();
+    if (fclose (output) != 0 || !isWritten)
+    {
+        fs::remove (temporary);
+        throw std::runtime_error ("Can't write " + temporary);
+    }
+    fs::rename (temporary, target);
+}
+
+BakedScene BakedScene::loadOrBake (const std::string &jsonPath, const std::string &bakedPath)
+{
+    std::error_code sourceError, bakedError;
+    const auto sourceTime = fs::last_write_time (jsonPath,  sourceError);
+    const auto bakedTime  = fs::last_write_time (bakedPath, bakedError);
+
+    if (!bakedError && (sourceError || bakedTime >= sourceTime))
+    {
+        try
+        {
+            return load (bakedPath);
+        }
+        catch (const std::runtime_error &)
+        {
+            // Stale format or damaged, baked again below
+        }
+    }
+
+    bake (Scene::load (jsonPath), bakedPath);
+    return load (bakedPath);
+}
+
+uint64_t BakedScene::checksum (const void *data, size_t size)
+{
+    const unsigned char *bytes = static_cast <const unsigned char *> (data);
+
+    uint64_t lanes[4] = { FNV_OFFSET_BASIS, FNV_OFFSET_BASIS ^ 1, FNV_OFFSET_BASIS ^ 2, FNV_OFFSET_BASIS ^ 3 };
+    size_t   i = 0;
+    for (; i + 32 <= size; i += 32)
+    {
+        for (int lane = 0; lane < 4; ++lane)
+        {
+            uint64_t word;
+            memcpy (&word, bytes + i + 8 * lane, sizeof (word));
+            lanes[lane] = (lanes[lane] ^ word) * FNV_PRIME;
+        }
+    }
+    for (; i < size; ++i)
+        lanes[0] = (lanes[0] ^ bytes[i]) * FNV_PRIME;
+
+    uint64_t hash = FNV_OFFSET_BASIS ^ size;
+    for (uint64_t lane : lanes)
+    {
+        for (int shift = 0; shift < 64; shift += 8)
+            hash = (hash ^ ((lane >> shift) & 0xff)) * FNV_PRIME;
+    }
+    return hash;
+}
+
+template <class T>
+BakedArray <T> BakedScene::records (Section type) const
+{
+    return { reinterpret_cast <const T *> (sectionData (type)), static_cast <size_t> (section (type).size / sizeof (T)) };
+}
+
+VertexFormat BakedScene::vertexFormat (const BakedMesh &mesh)
+{
+    VertexFormat format = { {}, static_cast <GLsizei> (mesh.stride) };
+    for (uint32_t i = 0; i < mesh.attributeCount; ++i)
+    {
+        const BakedAttribute &attribute = mesh.attributes[i];
+        format.attributes.push_back ({ attribute.location, static_cast <GLint> (attribute.components), attribute.type,
+                                       static_cast <GLboolean> (attribute.normalized ? GL_TRUE : GL_FALSE),
+                                       attribute.offset });
+    }
+    return format;
+}
+
+BakedArray <BakedProgram> BakedScene::programs() const
+{
+    return records <BakedProgram> (Section::Programs);
+}
+
+BakedArray <BakedMaterial> BakedScene::materials() const
+{
+    return records <BakedMaterial> (Section::Materials);
+}
+
+BakedArray <BakedMesh> BakedScene::meshes() const
+{
+    return records <BakedMesh> (Section::Meshes);
+}
+
+BakedArray <BakedDraw> BakedScene::draws() const
+{
+    return records <BakedDraw> (Section::Draws);
+}
+
+const char *BakedScene::string (uint32_t offset) const
+{
+    return sectionData (Section::Strings) + offset;
+}
+
+const void *BakedScene::vertices() const
+{
+    return sectionData (Section::Vertices);
+}
+
+size_t BakedScene::vertexBytes() const
+{
+    return static_cast <size_t> (section (Section::Vertices).size);
+}
+
+const void *BakedScene::indices() const
+{
+    return sectionData (Section::Indices);
+}
+
+size_t BakedScene::indexBytes() const
+{
+    return static_cast <size_t> (section (Section::Indices).size);
+}
+
+const BakedSection &BakedScene::section (Section type) const
+{
+    return *m_sections[static_cast <size_t> (type)];
+}
+
+const char *BakedScene::sectionData (Section type) const
+{
+    return m_file.data() + section (type).offset;
+}
+
+static void check (bool condition, const std::string &path, const char *problem)
+{
+    if (!condition)
+        throw std::runtime_error (path + " " + problem);
+}
+
+static uint64_t alignUp (uint64_t value, uint64_t alignment)
+{
+    return (value + alignment - 1) / alignment * alignment;
+}
+
+// From the half float positions the GL will read, so rounding can't push a
+// vertex outside
+static void computeBounds (BakedMesh &mesh, const std::vector <char> &vertices)
+{
+    const GLuint offset = BAKED_LAYOUT.format().attributes[0].offset;
+
+    glm::vec3 low (0.0f), high (0.0f);
+    for (uint32_t i = 0; i < mesh.vertexCount; ++i)
+    {
+        glm::vec3 position;
+        memcpy (&position.x, vertices.data() + size_t (i) * mesh.stride + offset, sizeof (position));
+
+        low  = i == 0 ? position : glm::min (low,  position);
+        high = i == 0 ? position : glm::max (high, position);
+    }
+    for (int axis = 0; axis < 3; ++axis)
+    {
+        mesh.boundsMin[axis] = low[axis];
+        mesh.boundsMax[axis] = high[axis];
+    }
+}
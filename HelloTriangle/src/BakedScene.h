@@ -0,0 +1,158 @@
+#ifndef BAKED_SCENE_INCLUDED
+#define BAKED_SCENE_INCLUDED
+
+#include <string>
+#include <cstdint>
+#include <cstddef>
+
+#include "MappedFile.h"
+#include "VertexLayout.h"
+
+class Scene;
+
+// On-disk layout, little endian. A header, a section table, then the
+// sections, each aligned to SECTION_ALIGNMENT. Names are offsets into the
+// Strings section; vertex and index offsets are bytes into Vertices and
+// Indices, which hold the data exactly as the vertex attribute formats
+// describe it, so they go to the GL as they are
+struct BakedHeader
+{
+    char     magic[8];
+    uint32_t version;
+    uint32_t sectionCount;
+    uint64_t fileSize;
+    uint64_t checksum;      // of everything after the header
+};
+
+struct BakedSection
+{
+    uint32_t type;
+    uint32_t reserved;
+    uint64_t offset;
+    uint64_t size;
+};
+
+struct BakedProgram
+{
+    uint32_t name;
+    uint32_t vertex;
+    uint32_t fragment;
+};
+
+struct BakedMaterial
+{
+    uint32_t name;
+    uint32_t program;
+    float    color[4];
+};
+
+struct BakedAttribute
+{
+    uint32_t location;
+    uint32_t components;
+    uint32_t type;          // GLenum
+    uint32_t normalized;
+    uint32_t offset;
+};
+
+struct BakedMesh
+{
+    static const uint32_t MAX_ATTRIBUTES = 8;
+
+    uint32_t       name;
+    uint32_t       vertexCount;
+    uint32_t       indexCount;     // 32 bit indices, always present
+    uint32_t       stride;
+    uint64_t       vertexOffset;   // a multiple of stride
+    uint64_t       indexOffset;
+    float          boundsMin[3];   // of the positions as stored, for culling
+    float          boundsMax[3];
+    uint32_t       attributeCount;
+    BakedAttribute attributes[MAX_ATTRIBUTES];
+};
+
+struct BakedDraw
+{
+    uint32_t mesh;
+    uint32_t material;
+};
+
+template <class T>
+struct BakedArray
+{
+    const T *data;
+    size_t   count;
+
+    const T *begin() const { return data; }
+    const T *end() const   { return data + count; }
+    size_t   size() const  { return count; }
+    const T &operator [] (size_t i) const { return data[i]; }
+};
+
+// A baked scene mapped into memory. Nothing is parsed or converted on load:
+// the header and the section table are validated, the checksum is checked
+// unless skipped, and everything else points into the mapping.
+// bake() flattens a Scene for it: every node becomes its own mesh with the
+// node transform and the material tint applied to the vertices, which are
+// then welded and reordered for the vertex caches with optimizeMesh()
+class BakedScene
+{
+public:
+    static const uint32_t VERSION           = 4;
+    static const uint32_t SECTION_ALIGNMENT = 64;
+
+    enum class Section : uint32_t
+    {
+        Strings, Programs, Materials, Meshes, Draws, Vertices, Indices, Count
+    };
+
+    enum class Verify
+    {
+        Checksum,
+        HeaderOnly
+    };
+
+    // Throw std::runtime_error
+    static BakedScene load (const std::string &path, Verify verify = Verify::Checksum);
+    static void       bake (const Scene &scene, const std::string &path);
+
+    // Rebakes jsonPath into bakedPath when the baked file is missing, older
+    // than the source or doesn't load
+    static BakedScene loadOrBake (const std::string &jsonPath, const std::string &bakedPath);
+
+    // FNV-1a over 64 bit words in four lanes, fast enough to check on load
+    static uint64_t   checksum (const void *data, size_t size);
+
+    // The attribute table of a mesh as setVertexFormat takes it
+    static VertexFormat vertexFormat (const BakedMesh &mesh);
+
+    BakedScene             (BakedScene &&other) = default;
+    BakedScene &operator = (BakedScene &&other) = default;
+
+    BakedArray <BakedProgram>  programs() const;
+    BakedArray <BakedMaterial> materials() const;
+    BakedArray <BakedMesh>     meshes() const;
+    BakedArray <BakedDraw>     draws() const;
+
+    const char *string (uint32_t offset) const;
+
+    // Whole sections, for uploading in one go
+    const void *vertices() const;
+    size_t      vertexBytes() const;
+    const void *indices() const;
+    size_t      indexBytes() const;
+
+private:
+    MappedFile          m_file;
+    const BakedSection *m_sections[static_cast <size_t> (Section::Count)];
+
+    BakedScene();
+
+    const BakedSection &section (Section type) const;
+    const char         *sectionData (Section type) const;
+
+    template <class T>
+    BakedArray <T> records (Section type) const;
+};
+
+#endif // !BAKED_SCENE_INCLUDED
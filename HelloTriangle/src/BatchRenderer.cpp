@@ -0,0 +1,170 @@
+#include "BatchRenderer.h"
+#include "Profiler.h"
+
+#include <chrono>
+#include <cassert>
+#include <cstring>
+#include <algorithm>
+
+using Clock = std::chrono::steady_clock;
+
+static const GLuint     DRAW_DATA_BINDING  = 1;
+static const GLsizeiptr MIN_VERTEX_BYTES   = 1 << 20;
+static const GLsizeiptr MIN_INDEX_COUNT    = 1 << 18;
+
+
+BatchRenderer::BatchRenderer (StreamBuffer &stream)
+    : m_stream (stream), m_pools (MIN_VERTEX_BYTES, MIN_INDEX_COUNT), m_meshCount (0), m_stats()
+{
+}
+
+BatchRenderer::Mesh BatchRenderer::addMesh (const VertexFormat &format, const void *vertices,
+                                            size_t vertexCount, const GLuint *indices, size_t indexCount)
+{
+    assert (vertices && indices && vertexCount > 0 && indexCount > 0);
+    PROFILE_SCOPE ("BatchRenderer::addMesh");
+
+    const unsigned         pool  = findPool (format);
+    const MeshPools::Range range = m_pools.add (pool, vertices, vertexCount, indices, indexCount);
+
+    Mesh mesh = { pool, range.firstIndex, range.indexCount, range.baseVertex };
+    ++m_meshCount;
+
+    return mesh;
+}
+
+void BatchRenderer::draw (const Mesh &mesh, const GLSLProgram &program, const glm::vec4 &drawData)
+{
+    assert (mesh.isValid() && mesh.pool < m_pools.size());
+
+    auto key = std::make_pair (&program, mesh.pool);
+    auto it  = m_bucketIndex.find (key);
+    if (it == m_bucketIndex.end())
+    {
+        it = m_bucketIndex.emplace (key, m_buckets.size()).first;
+        m_buckets.push_back ({ &program, mesh.pool, {}, {} });
+    }
+
+    Bucket &bucket = m_buckets[it->second];
+    bucket.commands.push_back ({ mesh.indexCount, 1, mesh.firstIndex, mesh.baseVertex,
+                                 static_cast <GLuint> (bucket.drawData.size()) });
+    bucket.drawData.push_back (drawData);
+}
+
+void BatchRenderer::flush (SubmitMode mode)
+{
+    PROFILE_SCOPE ("BatchRenderer::flush");
+
+    Clock::time_point start = Clock::now();
+    m_stats = Stats();
+
+    for (Bucket &bucket : m_buckets)
+    {
+        if (bucket.commands.empty())
+            continue;
+
+        ++m_stats.buckets;
+        flushBucket (bucket, mode);
+
+        bucket.commands.clear();
+        bucket.drawData.clear();
+    }
+
+    m_stats.submitSeconds = std::chrono::duration <double> (Clock::now() - start).count();
+}
+
+size_t BatchRenderer::meshCount() const
+{
+    return m_meshCount;
+}
+
+const BatchRenderer::Stats &BatchRenderer::frameStats() const
+{
+    return m_stats;
+}
+
+// A new pool gets the draw data attribute next to the vertices
+unsigned BatchRenderer::findPool (const VertexFormat &format)
+{
+    unsigned pool = 0;
+    if (m_pools.find (format, pool))
+        return pool;
+
+    assert (std::none_of (format.attributes.begin(), format.attributes.end(),
+                          [] (const VertexAttribute &attribute) { return attribute.location == DRAW_DATA_LOCATION; }) &&
+            "the mesh format overlaps the draw data attribute");
+    pool = m_pools.create (format);
+
+    const GLuint vao = m_pools.vertexArray (pool);
+    glVertexArrayAttribFormat    (vao, DRAW_DATA_LOCATION, 4, GL_FLOAT, GL_FALSE, 0);
+    glVertexArrayAttribBinding   (vao, DRAW_DATA_LOCATION, DRAW_DATA_BINDING);
+    glVertexArrayBindingDivisor  (vao, DRAW_DATA_BINDING, 1);
+    glEnableVertexArrayAttrib    (vao, DRAW_DATA_LOCATION);
+    return pool;
+}
+
+// Draws are split into chunks when the stream region can't take them all at once
+void BatchRenderer::flushBucket (Bucket &bucket, SubmitMode mode)
+{
+    const GLuint vao        = m_pools.vertexArray (bucket.pool);
+    const bool   isIndirect = mode == SubmitMode::MultiDrawIndirect;
+
+    const GLsizeiptr drawBytes = sizeof (glm::vec4) + (isIndirect ? sizeof (DrawElementsIndirectCommand) : 0);
+    const GLsizeiptr slack     = 2 * sizeof (glm::vec4);
+
+    GLStateCache &state = GLStateCache::current();
+    bucket.program->use();
+    state.bindVertexArray (vao);
+    if (isIndirect)
+        state.bindBuffer (GL_DRAW_INDIRECT_BUFFER, m_stream.handle());
+
+    const size_t total = bucket.commands.size();
+    for (size_t first = 0; first < total; )
+    {
+        const GLsizeiptr fits  = std::max <GLsizeiptr> (m_stream.bytesFree() - slack, 0) / drawBytes;
+        const size_t     count = std::min (total - first, static_cast <size_t> (fits));
+        if (count == 0)
+        {
+            m_stats.droppedDraws += total - first;
+            break;
+        }
+
+        StreamBuffer::Allocation data = m_stream.allocate (count * sizeof (glm::vec4), sizeof (glm::vec4));
+        memcpy (data.data, &bucket.drawData[first], data.size);
+        glVertexArrayVertexBuffer (vao, DRAW_DATA_BINDING, m_stream.handle(), data.offset, sizeof (glm::vec4));
+
+        // baseInstance is relative to the data just bound, rebase the chunk to zero
+        const GLuint baseInstance = static_cast <GLuint> (first);
+        if (isIndirect)
+        {
+            StreamBuffer::Allocation commands = m_stream.allocate (count * sizeof (DrawElementsIndirectCommand),
+                                                                   sizeof (GLuint));
+            DrawElementsIndirectCommand *command = commands.as <DrawElementsIndirectCommand>();
+            for (size_t i = 0; i < count; ++i)
+            {
+                command[i] = bucket.commands[first + i];
+                command[i].baseInstance -= baseInstance;
+            }
+
+            glMultiDrawElementsIndirect (GL_TRIANGLES, GL_UNSIGNED_INT, reinterpret_cast <void *> (commands.offset),
+                                         static_cast <GLsizei> (count), 0);
+            ++m_stats.drawCalls;
+        }
+        else
+        {
+            for (size_t i = first; i < first + count; ++i)
+            {
+                const DrawElementsIndirectCommand &command = bucket.commands[i];
+                glDrawElementsInstancedBaseVertexBaseInstance (GL_TRIANGLES, command.count, GL_UNSIGNED_INT,
+                    reinterpret_cast <void *> (command.firstIndex * sizeof (GLuint)), 1,
+                    command.baseVertex, command.baseInstance - baseInstance);
+            }
+            m_stats.drawCalls += count;
+        }
+
+        for (size_t i = first; i < first + count; ++i)
+            m_stats.triangles += bucket.commands[i].count / 3;
+        m_stats.meshes += count;
+        first += count;
+    }
+}
@@ -0,0 +1,98 @@
+#ifndef BATCH_RENDERER_INCLUDED
+#define BATCH_RENDERER_INCLUDED
+
+#include <map>
+#include <vector>
+#include <utility>
+#include <cstddef>
+#include <glm/glm.hpp>
+#include <glad/glad.h>
+
+#include "GLSLProgram.h"
+#include "StreamBuffer.h"
+#include "GLStateCache.h"
+#include "VertexLayout.h"
+#include "MeshPools.h"
+
+// Layout glMultiDrawElementsIndirect reads from the indirect buffer
+struct DrawElementsIndirectCommand
+{
+    GLuint count;
+    GLuint instanceCount;
+    GLuint firstIndex;
+    GLint  baseVertex;
+    GLuint baseInstance;
+};
+
+// Packs meshes of the same vertex format into shared MeshPools buffers and
+// draws everything submitted during a frame with one multi-draw per
+// (program, format) bucket. Each draw carries a vec4 of per-draw data, fed to
+// DRAW_DATA_LOCATION as an instanced attribute selected by baseInstance.
+// Commands and per-draw data are written into the frame's StreamBuffer region
+class BatchRenderer
+{
+public:
+    static const GLuint DRAW_DATA_LOCATION = 7;
+
+    enum class SubmitMode
+    {
+        MultiDrawIndirect,
+        PerDraw              // one draw call per mesh, kept as a baseline
+    };
+
+    struct Mesh
+    {
+        unsigned pool;
+        GLuint   firstIndex;
+        GLuint   indexCount;
+        GLint    baseVertex;
+
+        bool isValid() const { return indexCount > 0; }
+    };
+
+    struct Stats
+    {
+        size_t meshes;
+        size_t drawCalls;
+        size_t buckets;
+        size_t triangles;
+        size_t droppedDraws;   // didn't fit into the stream buffer region
+        double submitSeconds;
+    };
+
+    explicit BatchRenderer (StreamBuffer &stream);
+
+    Mesh   addMesh (const VertexFormat &format, const void *vertices, size_t vertexCount,
+                    const GLuint *indices, size_t indexCount);
+
+    void   draw  (const Mesh &mesh, const GLSLProgram &program, const glm::vec4 &drawData);
+    // Needs the stream buffer to be inside a frame
+    void   flush (SubmitMode mode = SubmitMode::MultiDrawIndirect);
+
+    size_t meshCount() const;
+    const Stats &frameStats() const;
+
+private:
+    struct Bucket
+    {
+        const GLSLProgram *program;
+        unsigned           pool;
+        std::vector <DrawElementsIndirectCommand> commands;
+        std::vector <glm::vec4>                   drawData;
+    };
+
+    StreamBuffer            &m_stream;
+    MeshPools                m_pools;
+    std::vector <Bucket>     m_buckets;
+    std::map <std::pair <const GLSLProgram *, unsigned>, size_t> m_bucketIndex;
+    size_t                   m_meshCount;
+    Stats                    m_stats;
+
+    unsigned findPool    (const VertexFormat &format);
+    void     flushBucket (Bucket &bucket, SubmitMode mode);
+
+    BatchRenderer             (const BatchRenderer &other) = delete;
+    BatchRenderer &operator = (const BatchRenderer &other) = delete;
+};
+
+#endif // !BATCH_RENDERER_INCLUDED
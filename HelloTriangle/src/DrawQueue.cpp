@@ -0,0 +1,142 @@
+#include "DrawQueue.h"
+#include "Profiler.h"
+
+#include <chrono>
+#include <algorithm>
+
+using Clock = std::chrono::steady_clock;
+
+static const uint64_t DEPTH_BITS    = 24;
+static const uint64_t MATERIAL_BITS = 24;
+static const uint64_t PROGRAM_BITS  = 16;
+
+static double secondsSince (Clock::time_point start);
+
+
+uint64_t DrawQueue::makeKey (uint32_t program, uint32_t material, float depth)
+{
+    const float    clamped   = std::min (std::max (depth, 0.0f), 1.0f);
+    const uint64_t depthBits = static_cast <uint64_t> (clamped * ((1u << DEPTH_BITS) - 1));
+
+    return (static_cast <uint64_t> (program  & ((1u << PROGRAM_BITS)  - 1)) << (MATERIAL_BITS + DEPTH_BITS)) |
+           (static_cast <uint64_t> (material & ((1u << MATERIAL_BITS) - 1)) << DEPTH_BITS) |
+           depthBits;
+}
+
+void DrawQueue::submit (uint64_t key, const DrawCommand &command)
+{
+    m_entries.push_back ({ key, static_cast <uint32_t> (m_commands.size()) });
+    m_commands.push_back (command);
+}
+
+void DrawQueue::submit (const CommandBuffer &commands)
+{
+    const uint32_t first = static_cast <uint32_t> (m_commands.size());
+    m_commands.insert (m_commands.end(), commands.m_commands.begin(), commands.m_commands.end());
+
+    m_entries.reserve (m_entries.size() + commands.m_keys.size());
+    for (size_t i = 0; i < commands.m_keys.size(); ++i)
+        m_entries.push_back ({ commands.m_keys[i], first + static_cast <uint32_t> (i) });
+}
+
+void DrawQueue::execute (GLStateCache &state)
+{
+    PROFILE_SCOPE ("DrawQueue::execute");
+
+    Clock::time_point start = Clock::now();
+    sort();
+    m_stats.sortSeconds = secondsSince (start);
+
+    start = Clock::now();
+    for (const Entry &entry : m_entries)
+    {
+        const DrawCommand &command = m_commands[entry.command];
+
+        state.useProgram      (command.state.program);
+        state.bindVertexArray (command.state.vertexArray);
+        state.bindTexture     (0, command.state.texture);
+        state.setBlend        (command.state.blend);
+        state.setDepthTest    (command.state.depthTest);
+
+        if (command.indexType == 0)
+            glDrawArraysInstanced (command.mode, static_cast <GLint> (command.first), command.count,
+                                   command.instanceCount);
+        else
+            glDrawElementsInstancedBaseVertex (command.mode, command.count, command.indexType,
+                                               reinterpret_cast <const void *> (command.first),
+                                               command.instanceCount, command.baseVertex);
+    }
+    m_stats.executeSeconds = secondsSince (start);
+    m_stats.draws          = m_entries.size();
+
+    m_commands.clear();
+    m_entries.clear();
+}
+
+size_t DrawQueue::size() const
+{
+    return m_entries.size();
+}
+
+const DrawQueue::Stats &DrawQueue::stats() const
+{
+    return m_stats;
+}
+
+void CommandBuffer::record (uint64_t key, const DrawCommand &command)
+{
+    m_keys.push_back (key);
+    m_commands.push_back (command);
+}
+
+void CommandBuffer::clear()
+{
+    m_keys.clear();
+    m_commands.clear();
+}
+
+size_t CommandBuffer::size() const
+{
+    return m_keys.size();
+}
+
+// 8 passes of 8 bits; a pass whose byte is the same in every key is skipped,
+// which with few programs and materials is most of them
+void DrawQueue::sort()
+{
+    const size_t count = m_entries.size();
+    if (count < 2)
+        return;
+
+    size_t histograms[8][256] = {};
+    for (const Entry &entry : m_entries)
+        for (int pass = 0; pass < 8; ++pass)
+            ++histograms[pass][(entry.key >> (pass * 8)) & 0xFF];
+
+    m_scratch.resize (count);
+    for (int pass = 0; pass < 8; ++pass)
+    {
+        size_t *histogram = histograms[pass];
+        const size_t firstByte = (m_entries[0].key >> (pass * 8)) & 0xFF;
+        if (histogram[firstByte] == count)
+            continue;
+
+        size_t offset = 0;
+        for (size_t i = 0; i < 256; ++i)
+        {
+            const size_t bucket = histogram[i];
+            histogram[i] = offset;
+            offset += bucket;
+        }
+
+        for (const Entry &entry : m_entries)
+            m_scratch[histogram[(entry.key >> (pass * 8)) & 0xFF]++] = entry;
+
+        m_entries.swap (m_scratch);
+    }
+}
+
+static double secondsSince (Clock::time_point start)
+{
+    return std::chrono::duration <double> (Clock::now() - start).count();
+}
@@ -0,0 +1,90 @@
+#ifndef DRAW_QUEUE_INCLUDED
+#define DRAW_QUEUE_INCLUDED
+
+#include <vector>
+#include <cstdint>
+#include <cstddef>
+#include <glad/glad.h>
+
+#include "GLStateCache.h"
+
+struct DrawState
+{
+    GLuint program;
+    GLuint vertexArray;
+    GLuint texture;       // bound to unit 0, 0 for none
+    bool   blend;
+    bool   depthTest;
+};
+
+struct DrawCommand
+{
+    DrawState state;
+    GLenum    mode;
+    GLsizei   count;
+    GLenum    indexType;      // 0 draws arrays, first is then a vertex index
+    GLintptr  first;          // byte offset into the element buffer otherwise
+    GLint     baseVertex;
+    GLsizei   instanceCount;
+};
+
+// One thread's draws for a frame, recorded away from GL and replayed into a
+// DrawQueue on the GL thread. Each worker keeps its own, so recording takes
+// no lock, and the alignment keeps neighbours in an array off its cache line
+class alignas (64) CommandBuffer
+{
+public:
+    void   record (uint64_t key, const DrawCommand &command);
+    void   clear();
+
+    size_t size() const;
+
+private:
+    std::vector <uint64_t>    m_keys;
+    std::vector <DrawCommand> m_commands;
+
+    friend class DrawQueue;
+};
+
+// Collects a frame's draws, sorts them by key with an LSD radix sort and
+// issues them through a GLStateCache so consecutive draws sharing state
+// don't rebind it. makeKey() orders by program, then material, then depth
+class DrawQueue
+{
+public:
+    struct Stats
+    {
+        size_t draws;
+        double sortSeconds;
+        double executeSeconds;
+    };
+
+    // program and material are truncated to 16 and 24 bits,
+    // depth is clamped to [0, 1] and drawn front to back
+    static uint64_t makeKey (uint32_t program, uint32_t material, float depth);
+
+    void   submit (uint64_t key, const DrawCommand &command);
+    // Appends every draw recorded in commands, which is left as it was
+    void   submit (const CommandBuffer &commands);
+    // Sorts, issues and clears the queue
+    void   execute (GLStateCache &state = GLStateCache::current());
+
+    size_t size() const;
+    const Stats &stats() const;
+
+private:
+    struct Entry
+    {
+        uint64_t key;
+        uint32_t command;
+    };
+
+    std::vector <DrawCommand> m_commands;
+    std::vector <Entry>       m_entries;
+    std::vector <Entry>       m_scratch;
+    Stats                     m_stats = {};
+
+    void   sort();
+};
+
+#endif // !DRAW_QUEUE_INCLUDED
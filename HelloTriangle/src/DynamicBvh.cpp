@@ -0,0 +1,363 @@
+#include "DynamicBvh.h"
+#include "Profiler.h"
+
+#include <algorithm>
+#include <utility>
+#include <cassert>
+
+const int32_t DynamicBvh::NULL_NODE;
+
+
+DynamicBvh::DynamicBvh (float margin)
+    : m_root      (NULL_NODE)
+    , m_free      (NULL_NODE)
+    , m_leafCount (0)
+    , m_margin    (margin)
+{
+}
+
+int32_t DynamicBvh::insert (uint32_t object, const BoundingBox &box)
+{
+    const int32_t leaf = allocateNode();
+    Node &node = m_nodes[leaf];
+    node.box    = { box.min - glm::vec3 (m_margin), box.max + glm::vec3 (m_margin) };
+    node.object = object;
+    node.height = 0;
+
+    insertLeaf (leaf);
+    ++m_leafCount;
+    return leaf;
+}
+
+void DynamicBvh::remove (int32_t leaf)
+{
+    assert (leaf >= 0 && size_t (leaf) < m_nodes.size() && isLeaf (leaf) && "not a leaf of this tree");
+
+    removeLeaf (leaf);
+    freeNode (leaf);
+    --m_leafCount;
+}
+
+bool DynamicBvh::update (int32_t leaf, const BoundingBox &box)
+{
+    assert (leaf >= 0 && size_t (leaf) < m_nodes.size() && isLeaf (leaf) && "not a leaf of this tree");
+
+    if (m_nodes[leaf].box.contains (box))
+        return false;
+
+    removeLeaf (leaf);
+    m_nodes[leaf].box = { box.min - glm::vec3 (m_margin), box.max + glm::vec3 (m_margin) };
+    insertLeaf (leaf);
+    return true;
+}
+
+void DynamicBvh::rebuild (std::vector <int32_t> &leaves)
+{
+    PROFILE_SCOPE ("DynamicBvh::rebuild");
+
+    std::vector <Node> leafNodes;
+    leafNodes.reserve (m_leafCount);
+    for (const Node &node : m_nodes)
+    {
+        if (node.height == 0)
+            leafNodes.push_back (node);
+    }
+
+    std::vector <BuildItem> items (leafNodes.size());
+    for (size_t i = 0; i < items.size(); ++i)
+        items[i] = { leafNodes[i].box.center(), static_cast <uint32_t> (i) };
+
+    m_nodes.clear();
+    m_nodes.reserve (items.empty() ? 0 : 2 * items.size() - 1);
+    m_free = NULL_NODE;
+    m_root = items.empty() ? NULL_NODE : buildRange (leafNodes, items.data(), items.size(), NULL_NODE);
+
+    for (size_t i = 0; i < m_nodes.size(); ++i)
+    {
+        if (isLeaf (static_cast <int32_t> (i)))
+        {
+            assert (m_nodes[i].object < leaves.size() && "leaves has no entry for an object");
+            leaves[m_nodes[i].object] = static_cast <int32_t> (i);
+        }
+    }
+}
+
+size_t DynamicBvh::cull (const Frustum &frustum, uint32_t *inside, std::vector <uint32_t> &straddling) const
+{
+    PROFILE_SCOPE ("DynamicBvh::cull");
+
+    size_t insideCount = 0;
+    if (m_root == NULL_NODE)
+        return insideCount;
+
+    // Each node carries the planes its ancestors didn't settle; once none
+    // are left the node is inside and classify() tests nothing
+    std::vector <std::pair <int32_t, uint32_t>> stack;
+    stack.reserve (m_nodes[m_root].height + 1);
+    stack.push_back ({ m_root, Frustum::ALL_PLANES });
+
+    while (!stack.empty())
+    {
+        const int32_t index     = stack.back().first;
+        uint32_t      planeMask = stack.back().second;
+        stack.pop_back();
+
+        const Node &node = m_nodes[index];
+        if (frustum.classify (node.box, planeMask) == Frustum::Side::Outside)
+            continue;
+
+        if (!isLeaf (index))
+        {
+            stack.push_back ({ node.right, planeMask });
+            stack.push_back ({ node.left,  planeMask });
+        }
+        else if (planeMask == 0 || m_margin == 0.0f)
+        {
+            inside[insideCount++] = node.object;
+        }
+        else
+        {
+            straddling.push_back (node.object);
+        }
+    }
+    return insideCount;
+}
+
+uint32_t DynamicBvh::object (int32_t leaf) const
+{
+    return m_nodes[leaf].object;
+}
+
+size_t DynamicBvh::leafCount() const
+{
+    return m_leafCount;
+}
+
+int32_t DynamicBvh::height() const
+{
+    return m_root == NULL_NODE ? -1 : m_nodes[m_root].height;
+}
+
+int32_t DynamicBvh::allocateNode()
+{
+    int32_t index = m_free;
+    if (index == NULL_NODE)
+    {
+        index = static_cast <int32_t> (m_nodes.size());
+        m_nodes.push_back ({});
+    }
+    else
+    {
+        m_free = m_nodes[index].parent;
+    }
+
+    Node &node = m_nodes[index];
+    node.parent = NULL_NODE;
+    node.left   = NULL_NODE;
+    node.right  = NULL_NODE;
+    node.height = 0;
+    node.object = 0;
+    return index;
+}
+
+void DynamicBvh::freeNode (int32_t node)
+{
+    m_nodes[node].parent = m_free;
+    m_nodes[node].height = -1;
+    m_free = node;
+}
+
+// Walks down to the sibling whose box grows the least, as Box2D does: the
+// cost of stopping here is the area of the new parent, going further down
+// adds what every node on the way has to grow
+void DynamicBvh::insertLeaf (int32_t leaf)
+{
+    if (m_root == NULL_NODE)
+    {
+        m_root = leaf;
+        m_nodes[leaf].parent = NULL_NODE;
+        return;
+    }
+
+    const BoundingBox box = m_nodes[leaf].box;
+    int32_t sibling = m_root;
+    while (!isLeaf (sibling))
+    {
+        const Node &node         = m_nodes[sibling];
+        const float area         = node.box.area();
+        const float combinedArea = BoundingBox::merge (node.box, box).area();
+        const float cost         = 2.0f * combinedArea;
+        const float inheritance  = 2.0f * (combinedArea - area);
+
+        auto descentCost = [&] (int32_t child)
+        {
+            const Node &childNode = m_nodes[child];
+            const float grown     = BoundingBox::merge (box, childNode.box).area();
+            return (isLeaf (child) ? grown : grown - childNode.box.area()) + inheritance;
+        };
+        const float leftCost  = descentCost (node.left);
+        const float rightCost = descentCost (node.right);
+
+        if (cost < leftCost && cost < rightCost)
+            break;
+        sibling = leftCost < rightCost ? node.left : node.right;
+    }
+
+    const int32_t oldParent = m_nodes[sibling].parent;
+    const int32_t newParent = allocateNode();
+    Node &parent = m_nodes[newParent];
+    parent.parent = oldParent;
+    parent.left   = sibling;
+    parent.right  = leaf;
+    parent.box    = BoundingBox::merge (box, m_nodes[sibling].box);
+    parent.height = m_nodes[sibling].height + 1;
+
+    if (oldParent == NULL_NODE)
+        m_root = newParent;
+    else
+        replaceChild (oldParent, sibling, newParent);
+    m_nodes[sibling].parent = newParent;
+    m_nodes[leaf].parent    = newParent;
+
+    refit (oldParent);
+}
+
+void DynamicBvh::removeLeaf (int32_t leaf)
+{
+    if (leaf == m_root)
+    {
+        m_root = NULL_NODE;
+        return;
+    }
+
+    const int32_t parent      = m_nodes[leaf].parent;
+    const int32_t grandParent = m_nodes[parent].parent;
+    const int32_t sibling     = m_nodes[parent].left == leaf ? m_nodes[parent].right : m_nodes[parent].left;
+
+    if (grandParent == NULL_NODE)
+        m_root = sibling;
+    else
+        replaceChild (grandParent, parent, sibling);
+    m_nodes[sibling].parent = grandParent;
+    freeNode (parent);
+
+    refit (grandParent);
+}
+
+// Rebalances and recomputes the boxes and heights from node up to the root
+void DynamicBvh::refit (int32_t node)
+{
+    while (node != NULL_NODE)
+    {
+        node = balance (node);
+
+        Node       &current = m_nodes[node];
+        const Node &left    = m_nodes[current.left];
+        const Node &right   = m_nodes[current.right];
+        current.box    = BoundingBox::merge (left.box, right.box);
+        current.height = 1 + std::max (left.height, right.height);
+
+        node = current.parent;
+    }
+}
+
+// Rotates the taller child of a up when the heights of a's children differ
+// by more than one, returns the node now in a's place
+int32_t DynamicBvh::balance (int32_t a)
+{
+    Node &nodeA = m_nodes[a];
+    if (isLeaf (a) || nodeA.height < 2)
+        return a;
+
+    const int32_t b  = nodeA.left;
+    const int32_t c  = nodeA.right;
+    const int32_t difference = m_nodes[c].height - m_nodes[b].height;
+    if (difference >= -1 && difference <= 1)
+        return a;
+
+    // up is the taller child, stay the other; up's taller child stays with
+    // it and its shorter one moves over to a
+    const int32_t up      = difference > 1 ? c : b;
+    const int32_t stay    = difference > 1 ? b : c;
+    Node         &nodeUp  = m_nodes[up];
+    const int32_t taller  = m_nodes[nodeUp.left].height > m_nodes[nodeUp.right].height ? nodeUp.left : nodeUp.right;
+    const int32_t shorter = taller == nodeUp.left ? nodeUp.right : nodeUp.left;
+
+    nodeUp.parent = nodeA.parent;
+    if (nodeUp.parent == NULL_NODE)
+        m_root = up;
+    else
+        replaceChild (nodeUp.parent, a, up);
+
+    nodeUp.left  = a;
+    nodeUp.right = taller;
+    nodeA.parent = up;
+
+    if (up == c)
+        nodeA.right = shorter;
+    else
+        nodeA.left  = shorter;
+    m_nodes[shorter].parent = a;
+
+    nodeA.box     = BoundingBox::merge (m_nodes[stay].box, m_nodes[shorter].box);
+    nodeA.height  = 1 + std::max (m_nodes[stay].height, m_nodes[shorter].height);
+    nodeUp.box    = BoundingBox::merge (nodeA.box, m_nodes[taller].box);
+    nodeUp.height = 1 + std::max (nodeA.height, m_nodes[taller].height);
+    return up;
+}
+
+void DynamicBvh::replaceChild (int32_t parent, int32_t oldChild, int32_t newChild)
+{
+    Node &node = m_nodes[parent];
+    if (node.left == oldChild)
+        node.left  = newChild;
+    else
+        node.right = newChild;
+}
+
+// Appends the subtree over items in depth first order, a node's left child
+// right after it, and returns its root. Sorts the centers alone, the nodes
+// are only copied in as leaves
+int32_t DynamicBvh::buildRange (const std::vector <Node> &leaves, BuildItem *items, size_t count, int32_t parent)
+{
+    const int32_t index = static_cast <int32_t> (m_nodes.size());
+    if (count == 1)
+    {
+        m_nodes.push_back (leaves[items[0].leaf]);
+        m_nodes[index].parent = parent;
+        return index;
+    }
+
+    glm::vec3 low = items[0].center, high = items[0].center;
+    for (size_t i = 1; i < count; ++i)
+    {
+        low  = glm::min (low,  items[i].center);
+        high = glm::max (high, items[i].center);
+    }
+
+    const glm::vec3 size = high - low;
+    const int       axis = size.x > size.y ? (size.x > size.z ? 0 : 2) : (size.y > size.z ? 1 : 2);
+    const size_t    half = count / 2;
+    std::nth_element (items, items + half, items + count, [axis] (const BuildItem &lhs, const BuildItem &rhs)
+    {
+        return lhs.center[axis] < rhs.center[axis];
+    });
+
+    m_nodes.push_back ({});
+    const int32_t left  = buildRange (leaves, items, half, index);
+    const int32_t right = buildRange (leaves, items + half, count - half, index);
+
+    Node &node = m_nodes[index];
+    node.parent = parent;
+    node.left   = left;
+    node.right  = right;
+    node.box    = BoundingBox::merge (m_nodes[left].box, m_nodes[right].box);
+    node.height = 1 + std::max (m_nodes[left].height, m_nodes[right].height);
+    node.object = 0;
+    return index;
+}
+
+bool DynamicBvh::isLeaf (int32_t node) const
+{
+    return m_nodes[node].left == NULL_NODE;
+}
@@ -0,0 +1,81 @@
+#ifndef DYNAMIC_BVH_INCLUDED
+#define DYNAMIC_BVH_INCLUDED
+
+#include <vector>
+#include <cstdint>
+#include <cstddef>
+
+#include "Frustum.h"
+
+// A bounding volume hierarchy that takes objects coming, going and moving,
+// after Box2D's dynamic tree. Leaves hold an object's box grown by a margin,
+// so moves that stay inside it leave the tree alone; a new leaf goes next to
+// the node whose box grows the least in area, and AVL style rotations on the
+// way back up keep the tree balanced
+class DynamicBvh
+{
+public:
+    static const int32_t NULL_NODE = -1;
+
+    explicit DynamicBvh (float margin = 0.0f);
+
+    // Returns the leaf, the handle for update() and remove()
+    int32_t  insert (uint32_t object, const BoundingBox &box);
+    void     remove (int32_t leaf);
+    // Reinserts the leaf when box has left its grown box, returns whether it did
+    bool     update (int32_t leaf, const BoundingBox &box);
+
+    // Builds the tree again top down, splitting at the median of the longest
+    // axis, with the nodes laid out depth first so a cull reads them mostly
+    // in order. Worth it after a bulk load or many moves. Every leaf changes:
+    // leaves[object] is set to the new one, so leaves needs an entry for
+    // every object in the tree
+    void     rebuild (std::vector <int32_t> &leaves);
+
+    // Writes the objects whose leaves lie entirely in the frustum to inside,
+    // which needs room for leafCount() of them, and returns their count.
+    // Those whose leaves straddle a plane go to straddling, for the caller
+    // to test exactly; with no margin a leaf's box is its object's and none
+    // do. Whole subtrees are taken or dropped at the top-most node that
+    // decides them
+    size_t   cull (const Frustum &frustum, uint32_t *inside, std::vector <uint32_t> &straddling) const;
+
+    uint32_t object (int32_t leaf) const;
+    size_t   leafCount() const;
+    int32_t  height() const;     // 0 for a single leaf, -1 when empty
+
+private:
+    struct Node
+    {
+        BoundingBox box;
+        int32_t     parent;    // next free node while on the free list
+        int32_t     left;      // NULL_NODE for leaves
+        int32_t     right;
+        int32_t     height;    // 0 for leaves, -1 while free
+        uint32_t    object;
+    };
+
+    std::vector <Node> m_nodes;
+    int32_t            m_root;
+    int32_t            m_free;
+    size_t             m_leafCount;
+    float              m_margin;
+
+    int32_t  allocateNode();
+    void     freeNode (int32_t node);
+    void     insertLeaf (int32_t leaf);
+    void     removeLeaf (int32_t leaf);
+    void     refit (int32_t node);
+    int32_t  balance (int32_t node);
+    void     replaceChild (int32_t parent, int32_t oldChild, int32_t newChild);
+    struct BuildItem
+    {
+        glm::vec3 center;
+        uint32_t  leaf;
+    };
+
+    int32_t  buildRange (const std::vector <Node> &leaves, BuildItem *items, size_t count, int32_t parent);
+    bool     isLeaf (int32_t node) const;
+};
+
+#endif // !DYNAMIC_BVH_INCLUDED
@@ -0,0 +1,157 @@
+#include "FileWatcher.h"
+
+#include <filesystem>
+#include <algorithm>
+
+#ifdef __linux__
+#include <unistd.h>
+#include <sys/inotify.h>
+#endif
+
+namespace fs = std::filesystem;
+
+using Clock = std::chrono::steady_clock;
+
+const int FileWatcher::POLL_INTERVAL_MS;
+
+#ifndef __linux__
+static int64_t modificationTime (const std::string &path);
+#endif
+
+
+#ifdef __linux__
+
+// Written and closed, or renamed into place
+static const uint32_t WATCH_EVENTS = IN_CLOSE_WRITE | IN_MOVED_TO;
+
+FileWatcher::FileWatcher()
+    : m_fd (inotify_init1 (IN_NONBLOCK | IN_CLOEXEC))
+{
+}
+
+FileWatcher::~FileWatcher()
+{
+    if (m_fd >= 0)
+        close (m_fd);
+}
+
+// The directory is watched rather than the file, whose inode an editor's
+// rename replaces. inotify hands out one watch a directory, however it's
+// spelled, so each spelling is kept to build the changed files' paths
+bool FileWatcher::watch (const std::string &path)
+{
+    const std::string file = normalize (path);
+    if (m_fd < 0 || m_files.count (file))
+        return m_fd >= 0;
+
+    std::string directory = fs::path (file).parent_path().generic_string();
+    if (directory.empty())
+        directory = ".";
+
+    const int watch = inotify_add_watch (m_fd, directory.c_str(), WATCH_EVENTS);
+    if (watch < 0)
+        return false;
+
+    std::vector <std::string> &spellings = m_directories[watch];
+    if (std::find (spellings.begin(), spellings.end(), directory) == spellings.end())
+        spellings.push_back (directory);
+
+    m_files.emplace (file, 0);
+    return true;
+}
+
+std::vector <std::string> FileWatcher::poll()
+{
+    std::vector <std::string> changed;
+    if (m_fd < 0)
+        return changed;
+
+    alignas (inotify_event) char buffer[4096];
+    for (;;)
+    {
+        const ssize_t length = read (m_fd, buffer, sizeof (buffer));
+        if (length <= 0)
+            break;
+
+        for (ssize_t offset = 0; offset < length; )
+        {
+            const inotify_event *event = reinterpret_cast <const inotify_event *> (buffer + offset);
+            offset += sizeof (inotify_event) + event->len;
+
+            auto directory = m_directories.find (event->wd);
+            if (event->len == 0 || directory == m_directories.end())
+                continue;
+
+            for (const std::string &spelling : directory->second)
+            {
+                const std::string file = normalize (spelling + '/' + event->name);
+                if (m_files.count (file) && std::find (changed.begin(), changed.end(), file) == changed.end())
+                    changed.push_back (file);
+            }
+        }
+    }
+    return changed;
+}
+
+#else
+
+FileWatcher::FileWatcher()
+{
+}
+
+FileWatcher::~FileWatcher()
+{
+}
+
+bool FileWatcher::watch (const std::string &path)
+{
+    const std::string file = normalize (path);
+    if (!m_files.count (file))
+        m_files.emplace (file, modificationTime (file));
+    return true;
+}
+
+std::vector <std::string> FileWatcher::poll()
+{
+    std::vector <std::string> changed;
+
+    const Clock::time_point now = Clock::now();
+    if (now - m_lastPoll < std::chrono::milliseconds (POLL_INTERVAL_MS))
+        return changed;
+    m_lastPoll = now;
+
+    for (auto &file : m_files)
+    {
+        const int64_t modified = modificationTime (file.first);
+        if (modified != file.second)
+        {
+            file.second = modified;
+            changed.push_back (file.first);
+        }
+    }
+    return changed;
+}
+
+#endif
+
+size_t FileWatcher::size() const
+{
+    return m_files.size();
+}
+
+std::string FileWatcher::normalize (const std::string &path)
+{
+    return fs::path (path).lexically_normal().generic_string();
+}
+
+#ifndef __linux__
+
+// 0 for a file that isn't there, so its reappearance counts as a change
+static int64_t modificationTime (const std::string &path)
+{
+    std::error_code error;
+    const fs::file_time_type time = fs::last_write_time (path, error);
+    return error ? 0 : static_cast <int64_t> (time.time_since_epoch().count());
+}
+
+#endif
@@ -0,0 +1,46 @@
+#ifndef FILE_WATCHER_INCLUDED
+#define FILE_WATCHER_INCLUDED
+
+#include <string>
+#include <vector>
+#include <chrono>
+#include <cstdint>
+#include <unordered_map>
+
+// Tells which of a set of files changed since the last poll. On Linux it
+// watches their directories with inotify, so an editor that saves through
+// a temporary file and a rename is seen too; elsewhere it compares
+// modification times, at most every POLL_INTERVAL_MS. Paths are kept and
+// returned lexically normalized, with forward slashes
+class FileWatcher
+{
+public:
+    FileWatcher();
+   ~FileWatcher();
+
+    // Watching a file twice is fine. False if its directory can't be watched
+    bool   watch (const std::string &path);
+
+    // Never blocks. Every file written since the last call, once each
+    std::vector <std::string> poll();
+
+    size_t size() const;
+
+    static std::string normalize (const std::string &path);
+
+private:
+    static const int POLL_INTERVAL_MS = 250;
+
+    std::unordered_map <std::string, int64_t> m_files;          // path -> modification time when polling
+#ifdef __linux__
+    int                                       m_fd;
+    std::unordered_map <int, std::vector <std::string>> m_directories;  // watch -> every spelling of its path
+#else
+    std::chrono::steady_clock::time_point     m_lastPoll;
+#endif
+
+    FileWatcher             (const FileWatcher &other) = delete;
+    FileWatcher &operator = (const FileWatcher &other) = delete;
+};
+
+#endif // !FILE_WATCHER_INCLUDED
@@ -0,0 +1,44 @@
+#include "Frustum.h"
+
+const int      Frustum::PLANE_COUNT;
+const uint32_t Frustum::ALL_PLANES;
+
+float BoundingBox::area() const
+{
+    const glm::vec3 size = max - min;
+    return size.x * size.y + size.y * size.z + size.z * size.x;
+}
+
+bool BoundingBox::contains (const BoundingBox &other) const
+{
+    return glm::all (glm::lessThanEqual (min, other.min)) && glm::all (glm::greaterThanEqual (max, other.max));
+}
+
+BoundingBox BoundingBox::merge (const BoundingBox &lhs, const BoundingBox &rhs)
+{
+    return { glm::min (lhs.min, rhs.min), glm::max (lhs.max, rhs.max) };
+}
+
+// Gribb and Hartmann: each plane is the last row of the matrix plus or
+// minus one of the others
+Frustum Frustum::fromViewProjection (const glm::mat4 &viewProjection)
+{
+    const glm::mat4 rows = glm::transpose (viewProjection);
+
+    Frustum frustum;
+    frustum.planes[0] = rows[3] + rows[0];
+    frustum.planes[1] = rows[3] - rows[0];
+    frustum.planes[2] = rows[3] + rows[1];
+    frustum.planes[3] = rows[3] - rows[1];
+    frustum.planes[4] = rows[3] + rows[2];
+    frustum.planes[5] = rows[3] - rows[2];
+
+    // An infinite far plane has no normal and stays as it is, w >= 0 passes everything
+    for (glm::vec4 &plane : frustum.planes)
+    {
+        const float length = glm::length (glm::vec3 (plane));
+        if (length > 0.0f)
+            plane /= length;
+    }
+    return frustum;
+}
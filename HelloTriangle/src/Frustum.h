@@ -0,0 +1,83 @@
+#ifndef FRUSTUM_INCLUDED
+#define FRUSTUM_INCLUDED
+
+#include <cstdint>
+#include <glm/glm.hpp>
+
+struct BoundingBox
+{
+    glm::vec3 min;
+    glm::vec3 max;
+
+    glm::vec3 center() const { return 0.5f * (min + max); }
+    glm::vec3 extent() const { return 0.5f * (max - min); }
+
+    // Half the surface area, all the BVH cost needs
+    float     area() const;
+    bool      contains (const BoundingBox &other) const;
+
+    static BoundingBox merge (const BoundingBox &lhs, const BoundingBox &rhs);
+};
+
+// The six clip planes of a view-projection, normals pointing inwards and
+// normalized, so dot (plane.xyz, point) + plane.w is the signed distance
+struct Frustum
+{
+    static const int      PLANE_COUNT = 6;
+    static const uint32_t ALL_PLANES  = (1u << PLANE_COUNT) - 1;
+
+    enum class Side
+    {
+        Outside,
+        Intersecting,
+        Inside
+    };
+
+    glm::vec4 planes[PLANE_COUNT];     // left, right, bottom, top, near, far
+
+    // GL clip space, -w <= z <= w
+    static Frustum fromViewProjection (const glm::mat4 &viewProjection);
+
+    // Tests box against the planes set in planeMask and clears the planes
+    // it lies entirely inside of, so children of a box need only test the rest
+    Side classify (const BoundingBox &box, uint32_t &planeMask) const;
+
+    // The test the culler runs on every object: false only when the box is
+    // entirely outside some plane. A NaN center is never visible
+    bool isVisible (const glm::vec3 &center, const glm::vec3 &extent) const;
+};
+
+inline Frustum::Side Frustum::classify (const BoundingBox &box, uint32_t &planeMask) const
+{
+    const glm::vec3 center = box.center();
+    const glm::vec3 extent = box.extent();
+
+    for (int i = 0; i < PLANE_COUNT; ++i)
+    {
+        if ((planeMask & (1u << i)) == 0)
+            continue;
+
+        const float distance = glm::dot (glm::vec3 (planes[i]), center) + planes[i].w;
+        const float radius   = glm::dot (glm::abs (glm::vec3 (planes[i])), extent);
+        if (distance + radius < 0.0f)
+            return Side::Outside;
+        if (distance - radius >= 0.0f)
+            planeMask &= ~(1u << i);
+    }
+    return planeMask == 0 ? Side::Inside : Side::Intersecting;
+}
+
+inline bool Frustum::isVisible (const glm::vec3 &center, const glm::vec3 &extent) const
+{
+    for (const glm::vec4 &plane : planes)
+    {
+        const float distance = glm::dot (glm::vec3 (plane), center) + plane.w;
+        const float radius   = glm::dot (glm::abs (glm::vec3 (plane)), extent);
+        // Written so a NaN fails it, like the SIMD compare
+        if (!(distance + radius >= 0.0f))
+            return false;
+    }
+    return true;
+}
+
+#endif // !FRUSTUM_INCLUDED
@@ -0,0 +1,322 @@
+#include "FrustumCuller.h"
+#include "Profiler.h"
+
+#include <cmath>
+#include <limits>
+#include <cassert>
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define CULL_SSE2
+#include <emmintrin.h>
+#endif
+
+#if defined(__AVX__)
+#define CULL_AVX
+#include <immintrin.h>
+#endif
+
+// The arrays grow in blocks of this many objects, a whole AVX block or two SSE2 ones
+static const size_t BLOCK_SIZE = 8;
+
+struct BoxArrays
+{
+    const float *centers[3];
+    const float *extents[3];
+};
+
+static size_t cullRange     (const Frustum &frustum, const BoxArrays &boxes, size_t count, uint32_t *visible);
+static size_t cullObjects   (const Frustum &frustum, const BoxArrays &boxes, const uint32_t *objects, size_t count,
+                             uint32_t *visible);
+static bool   isVisible     (const Frustum &frustum, const BoxArrays &boxes, size_t object);
+
+#ifdef CULL_SSE2
+// The planes with every float in all four lanes
+struct PlaneLanes
+{
+    __m128 normals[Frustum::PLANE_COUNT][3];
+    __m128 absNormals[Frustum::PLANE_COUNT][3];
+    __m128 offsets[Frustum::PLANE_COUNT];
+};
+
+static PlaneLanes planeLanes  (const Frustum &frustum);
+static unsigned   visibleMask (const PlaneLanes &planes, const __m128 center[3], const __m128 extent[3]);
+#endif
+
+
+FrustumCuller::FrustumCuller (Hierarchy hierarchy, float margin)
+    : m_bvh   (hierarchy == Hierarchy::Bvh ? new DynamicBvh (margin) : nullptr)
+    , m_count (0)
+{
+}
+
+uint32_t FrustumCuller::add (const BoundingBox &box)
+{
+    uint32_t object;
+    if (!m_freeIds.empty())
+    {
+        object = m_freeIds.back();
+        m_freeIds.pop_back();
+    }
+    else
+    {
+        object = static_cast <uint32_t> (m_count++);
+        if (m_count > m_centers[0].size())
+        {
+            for (int axis = 0; axis < 3; ++axis)
+            {
+                m_centers[axis].resize (m_centers[0].size() + BLOCK_SIZE, std::numeric_limits <float>::quiet_NaN());
+                m_extents[axis].resize (m_extents[0].size() + BLOCK_SIZE, 0.0f);
+            }
+        }
+        m_leaves.push_back (DynamicBvh::NULL_NODE);
+    }
+
+    store (object, box.center(), box.extent());
+    if (m_bvh)
+        m_leaves[object] = m_bvh->insert (object, box);
+    return object;
+}
+
+void FrustumCuller::update (uint32_t object, const BoundingBox &box)
+{
+    assert (object < m_count && !std::isnan (m_centers[0][object]) && "not an object of this culler");
+
+    store (object, box.center(), box.extent());
+    if (m_bvh)
+        m_bvh->update (m_leaves[object], box);
+}
+
+void FrustumCuller::remove (uint32_t object)
+{
+    assert (object < m_count && !std::isnan (m_centers[0][object]) && "not an object of this culler");
+
+    const float nan = std::numeric_limits <float>::quiet_NaN();
+    store (object, glm::vec3 (nan), glm::vec3 (0.0f));
+    if (m_bvh)
+    {
+        m_bvh->remove (m_leaves[object]);
+        m_leaves[object] = DynamicBvh::NULL_NODE;
+    }
+    m_freeIds.push_back (object);
+}
+
+size_t FrustumCuller::size() const
+{
+    return m_count - m_freeIds.size();
+}
+
+size_t FrustumCuller::capacity() const
+{
+    return m_centers[0].size();
+}
+
+void FrustumCuller::rebuild()
+{
+    if (m_bvh)
+        m_bvh->rebuild (m_leaves);
+}
+
+size_t FrustumCuller::cull (const Frustum &frustum, uint32_t *visible)
+{
+    PROFILE_SCOPE ("FrustumCuller::cull");
+
+    const BoxArrays boxes = { { m_centers[0].data(), m_centers[1].data(), m_centers[2].data() },
+                              { m_extents[0].data(), m_extents[1].data(), m_extents[2].data() } };
+    if (!m_bvh)
+        return cullRange (frustum, boxes, m_centers[0].size(), visible);
+
+    m_straddling.clear();
+    const size_t inside = m_bvh->cull (frustum, visible, m_straddling);
+    return inside + cullObjects (frustum, boxes, m_straddling.data(), m_straddling.size(), visible + inside);
+}
+
+size_t FrustumCuller::cullScalar (const Frustum &frustum, uint32_t *visible) const
+{
+    const BoxArrays boxes = { { m_centers[0].data(), m_centers[1].data(), m_centers[2].data() },
+                              { m_extents[0].data(), m_extents[1].data(), m_extents[2].data() } };
+
+    size_t count = 0;
+    for (size_t i = 0; i < m_count; ++i)
+    {
+        if (isVisible (frustum, boxes, i))
+            visible[count++] = static_cast <uint32_t> (i);
+    }
+    return count;
+}
+
+const DynamicBvh *FrustumCuller::hierarchy() const
+{
+    return m_bvh.get();
+}
+
+unsigned FrustumCuller::simdWidth()
+{
+#if defined(CULL_AVX)
+    return 8;
+#elif defined(CULL_SSE2)
+    return 4;
+#else
+    return 1;
+#endif
+}
+
+void FrustumCuller::store (uint32_t object, const glm::vec3 &center, const glm::vec3 &extent)
+{
+    for (int axis = 0; axis < 3; ++axis)
+    {
+        m_centers[axis][object] = center[axis];
+        m_extents[axis][object] = extent[axis];
+    }
+}
+
+// count is a whole number of blocks. The ids of the visible objects are
+// written to every lane and the count only moves past the ones that pass,
+// which keeps the compaction free of branches
+static size_t cullRange (const Frustum &frustum, const BoxArrays &boxes, size_t count, uint32_t *visible)
+{
+    size_t found = 0;
+#if defined(CULL_AVX)
+    __m256 normals[Frustum::PLANE_COUNT][3], absNormals[Frustum::PLANE_COUNT][3], offsets[Frustum::PLANE_COUNT];
+    for (int p = 0; p < Frustum::PLANE_COUNT; ++p)
+    {
+        for (int axis = 0; axis < 3; ++axis)
+        {
+            normals[p][axis]    = _mm256_set1_ps (frustum.planes[p][axis]);
+            absNormals[p][axis] = _mm256_set1_ps (std::fabs (frustum.planes[p][axis]));
+        }
+        offsets[p] = _mm256_set1_ps (frustum.planes[p].w);
+    }
+
+    // Summed in the order of Frustum::isVisible(), so both agree to the bit
+    const __m256 zero = _mm256_setzero_ps();
+    for (size_t i = 0; i < count; i += 8)
+    {
+        const __m256 x  = _mm256_loadu_ps (boxes.centers[0] + i);
+        const __m256 y  = _mm256_loadu_ps (boxes.centers[1] + i);
+        const __m256 z  = _mm256_loadu_ps (boxes.centers[2] + i);
+        const __m256 ex = _mm256_loadu_ps (boxes.extents[0] + i);
+        const __m256 ey = _mm256_loadu_ps (boxes.extents[1] + i);
+        const __m256 ez = _mm256_loadu_ps (boxes.extents[2] + i);
+
+        __m256 isIn = _mm256_castsi256_ps (_mm256_set1_epi32 (-1));
+        for (int p = 0; p < Frustum::PLANE_COUNT; ++p)
+        {
+            const __m256 distance = _mm256_add_ps (_mm256_add_ps (_mm256_add_ps (_mm256_mul_ps (x, normals[p][0]),
+                                                                                 _mm256_mul_ps (y, normals[p][1])),
+                                                                  _mm256_mul_ps (z, normals[p][2])), offsets[p]);
+            const __m256 radius   = _mm256_add_ps (_mm256_add_ps (_mm256_mul_ps (ex, absNormals[p][0]),
+                                                                  _mm256_mul_ps (ey, absNormals[p][1])),
+                                                   _mm256_mul_ps (ez, absNormals[p][2]));
+            isIn = _mm256_and_ps (isIn, _mm256_cmp_ps (_mm256_add_ps (distance, radius), zero, _CMP_GE_OQ));
+        }
+
+        const unsigned mask = static_cast <unsigned> (_mm256_movemask_ps (isIn));
+        for (unsigned lane = 0; lane < 8; ++lane)
+        {
+            visible[found] = static_cast <uint32_t> (i + lane);
+            found += (mask >> lane) & 1;
+        }
+    }
+#elif defined(CULL_SSE2)
+    const PlaneLanes planes = planeLanes (frustum);
+    for (size_t i = 0; i < count; i += 4)
+    {
+        const __m128 center[3] = { _mm_loadu_ps (boxes.centers[0] + i), _mm_loadu_ps (boxes.centers[1] + i),
+                                   _mm_loadu_ps (boxes.centers[2] + i) };
+        const __m128 extent[3] = { _mm_loadu_ps (boxes.extents[0] + i), _mm_loadu_ps (boxes.extents[1] + i),
+                                   _mm_loadu_ps (boxes.extents[2] + i) };
+
+        const unsigned mask = visibleMask (planes, center, extent);
+        for (unsigned lane = 0; lane < 4; ++lane)
+        {
+            visible[found] = static_cast <uint32_t> (i + lane);
+            found += (mask >> lane) & 1;
+        }
+    }
+#else
+    for (size_t i = 0; i < count; ++i)
+    {
+        visible[found] = static_cast <uint32_t> (i);
+        found += isVisible (frustum, boxes, i);
+    }
+#endif
+    return found;
+}
+
+// The objects the BVH left undecided, gathered four at a time
+static size_t cullObjects (const Frustum &frustum, const BoxArrays &boxes, const uint32_t *objects, size_t count,
+                           uint32_t *visible)
+{
+    size_t found = 0, i = 0;
+#ifdef CULL_SSE2
+    const PlaneLanes planes = planeLanes (frustum);
+    auto gather = [objects] (const float *values, size_t i)
+    {
+        return _mm_set_ps (values[objects[i + 3]], values[objects[i + 2]], values[objects[i + 1]], values[objects[i]]);
+    };
+
+    for (; i + 4 <= count; i += 4)
+    {
+        const __m128 center[3] = { gather (boxes.centers[0], i), gather (boxes.centers[1], i),
+                                   gather (boxes.centers[2], i) };
+        const __m128 extent[3] = { gather (boxes.extents[0], i), gather (boxes.extents[1], i),
+                                   gather (boxes.extents[2], i) };
+
+        const unsigned mask = visibleMask (planes, center, extent);
+        for (unsigned lane = 0; lane < 4; ++lane)
+        {
+            visible[found] = objects[i + lane];
+            found += (mask >> lane) & 1;
+        }
+    }
+#endif
+    for (; i < count; ++i)
+    {
+        visible[found] = objects[i];
+        found += isVisible (frustum, boxes, objects[i]);
+    }
+    return found;
+}
+
+static bool isVisible (const Frustum &frustum, const BoxArrays &boxes, size_t object)
+{
+    return frustum.isVisible (glm::vec3 (boxes.centers[0][object], boxes.centers[1][object], boxes.centers[2][object]),
+                              glm::vec3 (boxes.extents[0][object], boxes.extents[1][object], boxes.extents[2][object]));
+}
+
+#ifdef CULL_SSE2
+
+static PlaneLanes planeLanes (const Frustum &frustum)
+{
+    PlaneLanes planes;
+    for (int p = 0; p < Frustum::PLANE_COUNT; ++p)
+    {
+        for (int axis = 0; axis < 3; ++axis)
+        {
+            planes.normals[p][axis]    = _mm_set1_ps (frustum.planes[p][axis]);
+            planes.absNormals[p][axis] = _mm_set1_ps (std::fabs (frustum.planes[p][axis]));
+        }
+        planes.offsets[p] = _mm_set1_ps (frustum.planes[p].w);
+    }
+    return planes;
+}
+
+// Summed in the order of Frustum::isVisible(), so both agree to the bit
+static unsigned visibleMask (const PlaneLanes &planes, const __m128 center[3], const __m128 extent[3])
+{
+    __m128 isIn = _mm_castsi128_ps (_mm_set1_epi32 (-1));
+    for (int p = 0; p < Frustum::PLANE_COUNT; ++p)
+    {
+        const __m128 distance = _mm_add_ps (_mm_add_ps (_mm_add_ps (_mm_mul_ps (center[0], planes.normals[p][0]),
+                                                                    _mm_mul_ps (center[1], planes.normals[p][1])),
+                                                        _mm_mul_ps (center[2], planes.normals[p][2])),
+                                            planes.offsets[p]);
+        const __m128 radius   = _mm_add_ps (_mm_add_ps (_mm_mul_ps (extent[0], planes.absNormals[p][0]),
+                                                        _mm_mul_ps (extent[1], planes.absNormals[p][1])),
+                                            _mm_mul_ps (extent[2], planes.absNormals[p][2]));
+        isIn = _mm_and_ps (isIn, _mm_cmpge_ps (_mm_add_ps (distance, radius), _mm_setzero_ps()));
+    }
+    return static_cast <unsigned> (_mm_movemask_ps (isIn));
+}
+
+#endif
@@ -0,0 +1,67 @@
+#ifndef FRUSTUM_CULLER_INCLUDED
+#define FRUSTUM_CULLER_INCLUDED
+
+#include <vector>
+#include <memory>
+#include <cstdint>
+#include <cstddef>
+
+#include "Frustum.h"
+#include "DynamicBvh.h"
+
+// Object bounding boxes kept as structure of arrays, a center and an extent
+// component to an array, and tested against a frustum 8 at a time with AVX
+// or 4 with SSE2, whichever the compiler targets. With Hierarchy::Bvh a
+// DynamicBvh first takes or drops whole groups of objects and only the ones
+// straddling a plane get the exact test. Objects are ids handed out by add(),
+// reused once removed
+class FrustumCuller
+{
+public:
+    enum class Hierarchy
+    {
+        None,
+        Bvh
+    };
+
+    // margin grows the BVH leaves, objects moving less than it don't touch the tree
+    explicit FrustumCuller (Hierarchy hierarchy = Hierarchy::None, float margin = 0.0f);
+
+    uint32_t add    (const BoundingBox &box);
+    void     update (uint32_t object, const BoundingBox &box);
+    void     remove (uint32_t object);
+    size_t   size() const;
+    // Objects a cull can return at most
+    size_t   capacity() const;
+
+    // DynamicBvh::rebuild(), worth it after adding many objects at once
+    void     rebuild();
+
+    // Writes the objects the frustum may see to visible, which needs room
+    // for capacity() of them, in no particular order, and returns their
+    // count. An object is visible unless some plane has it entirely outside
+    size_t   cull (const Frustum &frustum, uint32_t *visible);
+
+    // Every object tested on its own, the reference cull() agrees with
+    size_t   cullScalar (const Frustum &frustum, uint32_t *visible) const;
+
+    const DynamicBvh *hierarchy() const;
+
+    // Objects a SIMD test takes, 1 without SIMD
+    static unsigned simdWidth();
+
+private:
+    // Padded to a whole number of SIMD blocks with NaN centers, which no
+    // test passes; removed objects get one too
+    std::vector <float>          m_centers[3];
+    std::vector <float>          m_extents[3];
+    std::vector <int32_t>        m_leaves;
+    std::vector <uint32_t>       m_freeIds;
+    std::vector <uint32_t>       m_straddling;
+    std::unique_ptr <DynamicBvh> m_bvh;
+    size_t                       m_count;       // ids handed out, removed ones included
+
+    void store (uint32_t object, const glm::vec3 &center, const glm::vec3 &extent);
+};
+
+#endif // !FRUSTUM_CULLER_INCLUDED
@@ -1,14 +1,25 @@
 #include "GLSLProgram.h"
+#include "Profiler.h"
+
+#include <chrono>
+
+using Clock = std::chrono::steady_clock;
 
 static GLint SUCCESS = false;
 
+static const GLenum STAGE_TYPES[ShaderInfo::nShaderTypes] = {
+    GL_VERTEX_SHADER, GL_FRAGMENT_SHADER, GL_GEOMETRY_SHADER,
+    GL_TESS_CONTROL_SHADER, GL_TESS_EVALUATION_SHADER, GL_COMPUTE_SHADER
+};
+
 static std::string matchTypeToError (GLenum type);
-static char       *readFile    (FILE *file);
-static size_t      getFileSize (FILE *file);
+static double      secondsSince     (Clock::time_point start);
 
 
 GLSLProgram::GLSLProgram()
-    : m_programHandle (glCreateProgram()), m_isLinked (false), m_shaderHandels()
+    : m_programHandle (glCreateProgram()), m_isLinked (false), m_shaderHandels(),
+      m_uniformStats(), m_preprocessor (nullptr), m_binaryCache (nullptr), m_binaryKey (0), m_hasPendingSource(),
+      m_linkPending (false), m_buildSeconds (0.0)
 {
     if (m_programHandle == 0)
         throw GLSLProgramException ("Can't create a program");
@@ -20,6 +31,7 @@ GLSLProgram::~GLSLProgram()
         if (handle)
             glDeleteShader (handle);
     
+    GLStateCache::current().forgetProgram (m_programHandle);
     glDeleteProgram (m_programHandle);
 }
 
@@ -32,53 +44,243 @@ void GLSLProgram::compileShader (const char *fileName)
 void GLSLProgram::compileShader (const char *fileName, GLenum type)
 {
     assert (fileName);
+    PROFILE_SCOPE ("GLSLProgram::compileShader");
 
-    FILE *shaderFile = fopen (fileName, "rb");
+    if (m_preprocessor)
+    {
+        ShaderPreprocessor::Result result = m_preprocessor->process (fileName, m_defines);
+        compileShader (result.source.c_str(), type, result.label().c_str());
+        return;
+    }
+
+    std::shared_ptr <const MappedFile> shaderFile = MappedFileCache::global().open (fileName);
     if (!shaderFile)
         throw GLSLProgramException ("Can't open the file " + std::string (fileName));
 
-    char *shaderSourse = readFile (shaderFile);
-    assert (shaderSourse);
-    
-    fclose (shaderFile);
+    // The mapping is handed to the driver as is, with an explicit length
+    if (m_binaryCache)
+    {
+        addShaderSource (shaderFile, type, fileName);
+        return;
+    }
 
-    compileShader (shaderSourse, type, fileName);
+    int index = getShaderIndex (type);
+    if (index < 0)
+        throw GLSLProgramException ("Invalid shader type value");
 
-    delete [] shaderSourse;
+    m_shaderFiles[index] = fileName;
+    compileStage (index, shaderFile->data(), static_cast <GLint> (shaderFile->size()), type, fileName, true);
 }
 
-void GLSLProgram::compileShader (const char *sourse, GLenum type, const char *fileName) 
+void GLSLProgram::compileShader (const char *sourse, GLenum type, const char *fileName)
 {
     assert (sourse);
     assert (fileName);
+    PROFILE_SCOPE ("GLSLProgram::compileShader");
+
+    // With a binary cache the stages are only compiled on a cache miss in link()
+    if (m_binaryCache)
+    {
+        addShaderSource (sourse, type, fileName);
+        return;
+    }
 
     int index = getShaderIndex (type);
     if (index < 0)
         throw GLSLProgramException ("Invalid shader type value");
 
-    m_shaderHandels[index] = glCreateShader (type);
-    if (m_shaderHandels[index] == 0)
-        throw GLSLProgramException (std::string (fileName) + "\nCan't create a shader");
-    
-    glShaderSource (m_shaderHandels[index], 1, &sourse, nullptr);
-    glCompileShader (m_shaderHandels[index]);
-    
-    glGetShaderiv (m_shaderHandels[index], GL_COMPILE_STATUS, &SUCCESS);
-    if (SUCCESS == GL_FALSE)
-        throw GLSLProgramException (m_shaderHandels[index], type, fileName);
-    
-    glAttachShader (m_programHandle, m_shaderHandels[index]);
+    m_shaderFiles[index] = fileName;
+    compileStage (index, sourse, -1, type, fileName, true);
+}
+
+void GLSLProgram::addShaderSource (const std::string &sourse, GLenum type, const char *fileName)
+{
+    auto owner = std::make_shared <const std::string> (sourse);
+    addShaderSource (*owner, owner, type, fileName);
+}
+
+void GLSLProgram::addShaderSource (std::shared_ptr <const MappedFile> file, GLenum type,
+                                   const char *fileName)
+{
+    assert (file);
+
+    const std::string_view sourse = file->view();
+    addShaderSource (sourse, std::move (file), type, fileName);
+}
+
+void GLSLProgram::addShaderSource (std::string_view sourse, std::shared_ptr <const void> owner,
+                                   GLenum type, const char *fileName)
+{
+    assert (fileName);
+
+    int index = getShaderIndex (type);
+    if (index < 0)
+        throw GLSLProgramException ("Invalid shader type value");
+
+    m_shaderSources[index]    = sourse;
+    m_sourceOwners[index]     = std::move (owner);
+    m_shaderFiles[index]      = fileName;
+    m_hasPendingSource[index] = true;
+}
+
+void GLSLProgram::setBinaryCache (ProgramBinaryCache *cache)
+{
+    m_binaryCache = cache;
+}
+
+void GLSLProgram::setPreprocessor (ShaderPreprocessor *preprocessor, const ShaderDefines &defines)
+{
+    m_preprocessor = preprocessor;
+    m_defines      = defines;
 }
 
 void GLSLProgram::link()
 {
+    PROFILE_SCOPE ("GLSLProgram::link");
+
+    beginLink();
+    finishLink();
+}
+
+void GLSLProgram::beginLink()
+{
+    PROFILE_SCOPE ("GLSLProgram::beginLink");
+
+    m_isLinked    = false;
+    m_linkPending = false;
+
+    if (m_binaryCache)
+    {
+        m_binaryKey = binaryCacheKey();
+        if (m_binaryCache->load (m_programHandle, m_binaryKey))
+        {
+            dropPendingShaders();
+            m_isLinked = true;
+            findUniformLocations();
+            return;
+        }
+    }
+
+    Clock::time_point start = Clock::now();
+
+    // Compile errors are picked up by finishLink() so nothing here waits on the driver
+    compilePendingShaders();
+    if (m_binaryCache)
+        glProgramParameteri (m_programHandle, GL_PROGRAM_BINARY_RETRIEVABLE_HINT, GL_TRUE);
     glLinkProgram (m_programHandle);
 
+    m_linkPending  = true;
+    m_buildSeconds = secondsSince (start);
+}
+
+bool GLSLProgram::isLinkComplete() const
+{
+    if (!m_linkPending)
+        return true;
+
+    GLint isComplete = GL_FALSE;
+    glGetProgramiv (m_programHandle, GL_COMPLETION_STATUS_KHR, &isComplete);
+    return isComplete == GL_TRUE;
+}
+
+void GLSLProgram::finishLink()
+{
+    if (!m_linkPending)
+        return;
+
+    PROFILE_SCOPE ("GLSLProgram::finishLink");
+    m_linkPending = false;
+
+    Clock::time_point start = Clock::now();
+
     glGetProgramiv (m_programHandle, GL_LINK_STATUS, &SUCCESS);
     if (SUCCESS == GL_FALSE)
+    {
+        for (size_t i = 0; i < ShaderInfo::nShaderTypes; ++i)
+        {
+            if (!m_shaderHandels[i])
+                continue;
+
+            glGetShaderiv (m_shaderHandels[i], GL_COMPILE_STATUS, &SUCCESS);
+            if (SUCCESS == GL_FALSE)
+                throw GLSLProgramException (m_shaderHandels[i], STAGE_TYPES[i], m_shaderFiles[i].c_str());
+        }
         throw GLSLProgramException (m_programHandle, GL_PROGRAM);
+    }
 
     m_isLinked = GL_TRUE;
+    findUniformLocations();
+
+    if (m_binaryCache)
+    {
+        m_binaryCache->recordBuildTime (m_buildSeconds + secondsSince (start));
+        m_binaryCache->store (m_programHandle, m_binaryKey);
+    }
+}
+
+void GLSLProgram::compileStage (int index, const char *sourse, GLint length, GLenum type,
+                                const char *fileName, bool checkStatus)
+{
+    if (m_shaderHandels[index])
+    {
+        glDetachShader (m_programHandle, m_shaderHandels[index]);
+        glDeleteShader (m_shaderHandels[index]);
+    }
+
+    m_shaderHandels[index] = glCreateShader (type);
+    if (m_shaderHandels[index] == 0)
+        throw GLSLProgramException (std::string (fileName) + "\nCan't create a shader");
+
+    glShaderSource (m_shaderHandels[index], 1, &sourse, length < 0 ? nullptr : &length);
+    glCompileShader (m_shaderHandels[index]);
+
+    if (checkStatus)
+    {
+        glGetShaderiv (m_shaderHandels[index], GL_COMPILE_STATUS, &SUCCESS);
+        if (SUCCESS == GL_FALSE)
+            throw GLSLProgramException (m_shaderHandels[index], type, fileName);
+    }
+
+    glAttachShader (m_programHandle, m_shaderHandels[index]);
+}
+
+void GLSLProgram::compilePendingShaders()
+{
+    for (size_t i = 0; i < ShaderInfo::nShaderTypes; ++i)
+    {
+        if (!m_hasPendingSource[i])
+            continue;
+
+        compileStage (static_cast <int> (i), m_shaderSources[i].data(),
+                      static_cast <GLint> (m_shaderSources[i].size()), STAGE_TYPES[i],
+                      m_shaderFiles[i].c_str(), false);
+    }
+    dropPendingShaders();
+}
+
+// Lets go of the sources and whatever keeps them alive, once compiled or
+// once the program came from the binary cache instead
+void GLSLProgram::dropPendingShaders()
+{
+    for (size_t i = 0; i < ShaderInfo::nShaderTypes; ++i)
+    {
+        m_hasPendingSource[i] = false;
+        m_shaderSources[i]    = std::string_view();
+        m_sourceOwners[i].reset();
+    }
+}
+
+ProgramBinaryCache::Key GLSLProgram::binaryCacheKey() const
+{
+    ProgramBinaryCache::Key key = m_binaryCache->makeKey();
+    for (size_t i = 0; i < ShaderInfo::nShaderTypes; ++i)
+    {
+        if (!m_hasPendingSource[i])
+            continue;
+
+        key.add (static_cast <GLenum> (i)).add (m_shaderSources[i]);
+    }
+    return key;
 }
 
 void GLSLProgram::use() const
@@ -86,7 +288,12 @@ void GLSLProgram::use() const
     if (!m_isLinked || m_programHandle == 0)
         throw GLSLProgramException ("Program was not linked");
     
-    glUseProgram (m_programHandle);
+    GLStateCache::current().useProgram (m_programHandle);
+}
+
+GLuint GLSLProgram::getHandle()
+{
+    return m_programHandle;
 }
 
 bool GLSLProgram::isLinked() const
@@ -94,6 +301,188 @@ bool GLSLProgram::isLinked() const
     return m_isLinked;
 }
 
+void GLSLProgram::findUniformLocations()
+{
+    m_uniforms.clear();
+
+    GLint count = 0, maxLength = 0;
+    glGetProgramiv (m_programHandle, GL_ACTIVE_UNIFORMS, &count);
+    glGetProgramiv (m_programHandle, GL_ACTIVE_UNIFORM_MAX_LENGTH, &maxLength);
+
+    std::string name (std::max (maxLength, 1), '\0');
+    m_uniforms.reserve (count);
+
+    for (GLint i = 0; i < count; ++i)
+    {
+        GLsizei length = 0;
+        UniformInfo info = {};
+        glGetActiveUniform (m_programHandle, i, static_cast <GLsizei> (name.size()), &length,
+                            &info.size, &info.type, &name[0]);
+
+        info.name     = name.substr (0, length);
+        info.location = glGetUniformLocation (m_programHandle, info.name.c_str());
+        if (info.location < 0)
+            continue; // a member of a uniform block
+
+        // "arr[0]" is reported for arrays, the table is keyed by "arr"
+        const size_t subscript = info.name.rfind ("[0]");
+        if (subscript != std::string::npos && subscript + 3 == info.name.size())
+            info.name.erase (subscript);
+
+        m_uniforms.push_back (info);
+    }
+
+    std::sort (m_uniforms.begin(), m_uniforms.end(),
+        [] (const UniformInfo &lhs, const UniformInfo &rhs) { return lhs.name < rhs.name; });
+}
+
+const std::vector <GLSLProgram::UniformInfo> &GLSLProgram::getActiveUniforms() const
+{
+    return m_uniforms;
+}
+
+const GLSLProgram::UniformStats &GLSLProgram::getUniformStats() const
+{
+    return m_uniformStats;
+}
+
+void GLSLProgram::resetUniformStats()
+{
+    m_uniformStats = {};
+}
+
+int GLSLProgram::findUniformIndex (const char *name) const
+{
+    assert (name);
+
+    auto it = std::lower_bound (m_uniforms.begin(), m_uniforms.end(), name,
+        [] (const UniformInfo &info, const char *key) { return strcmp (info.name.c_str(), key) < 0; });
+
+    if (it == m_uniforms.end() || strcmp (it->name.c_str(), name) != 0)
+        return -1;
+
+    return static_cast <int> (it - m_uniforms.begin());
+}
+
+void GLSLProgram::checkUniformType (int index, bool typeMatches) const
+{
+    if (!typeMatches)
+        throw GLSLProgramException ("Uniform " + m_uniforms[index].name + 
+                                    " is set with a value of a different type");
+}
+
+bool GLSLProgram::updateUniformValue (int index, const void *value, size_t size)
+{
+    assert (size <= sizeof (UniformInfo::value));
+
+    UniformInfo &info = m_uniforms[index];
+    if (info.hasValue && memcmp (info.value, value, size) == 0)
+    {
+        ++m_uniformStats.skipped;
+        return false;
+    }
+
+    memcpy (info.value, value, size);
+    info.hasValue = true;
+    ++m_uniformStats.writes;
+    return true;
+}
+
+void GLSLProgram::setUniform (const char *name, float x, float y, float z)
+{
+    setUniform (getUniformHandle <glm::vec3> (name), glm::vec3 (x, y, z));
+}
+
+void GLSLProgram::setUniform (const char *name, const glm::vec2 &v)
+{
+    setUniform (getUniformHandle <glm::vec2> (name), v);
+}
+
+void GLSLProgram::setUniform (const char *name, const glm::vec3 &v)
+{
+    setUniform (getUniformHandle <glm::vec3> (name), v);
+}
+
+void GLSLProgram::setUniform (const char *name, const glm::vec4 &v)
+{
+    setUniform (getUniformHandle <glm::vec4> (name), v);
+}
+
+void GLSLProgram::setUniform (const char *name, const glm::mat4 &m)
+{
+    setUniform (getUniformHandle <glm::mat4> (name), m);
+}
+
+void GLSLProgram::setUniform (const char *name, const glm::mat3 &m)
+{
+    setUniform (getUniformHandle <glm::mat3> (name), m);
+}
+
+void GLSLProgram::setUniform (const char *name, float val)
+{
+    setUniform (getUniformHandle <float> (name), val);
+}
+
+void GLSLProgram::setUniform (const char *name, int val)
+{
+    setUniform (getUniformHandle <int> (name), val);
+}
+
+void GLSLProgram::setUniform (const char *name, bool val)
+{
+    setUniform (getUniformHandle <bool> (name), val);
+}
+
+void GLSLProgram::setUniform (const char *name, GLuint val)
+{
+    setUniform (getUniformHandle <GLuint> (name), val);
+}
+
+void GLSLProgram::uploadUniform (GLint location, float val)
+{
+    glProgramUniform1f (m_programHandle, location, val);
+}
+
+void GLSLProgram::uploadUniform (GLint location, int val)
+{
+    glProgramUniform1i (m_programHandle, location, val);
+}
+
+void GLSLProgram::uploadUniform (GLint location, bool val)
+{
+    glProgramUniform1i (m_programHandle, location, val ? 1 : 0);
+}
+
+void GLSLProgram::uploadUniform (GLint location, GLuint val)
+{
+    glProgramUniform1ui (m_programHandle, location, val);
+}
+
+void GLSLProgram::uploadUniform (GLint location, const glm::vec2 &v)
+{
+    glProgramUniform2f (m_programHandle, location, v.x, v.y);
+}
+
+void GLSLProgram::uploadUniform (GLint location, const glm::vec3 &v)
+{
+    glProgramUniform3f (m_programHandle, location, v.x, v.y, v.z);
+}
+
+void GLSLProgram::uploadUniform (GLint location, const glm::vec4 &v)
+{
+    glProgramUniform4f (m_programHandle, location, v.x, v.y, v.z, v.w);
+}
+
+void GLSLProgram::uploadUniform (GLint location, const glm::mat3 &m)
+{
+    glProgramUniformMatrix3fv (m_programHandle, location, 1, GL_FALSE, &m[0][0]);
+}
+
+void GLSLProgram::uploadUniform (GLint location, const glm::mat4 &m)
+{
+    glProgramUniformMatrix4fv (m_programHandle, location, 1, GL_FALSE, &m[0][0]);
+}
+
 bool isShader (GLenum type)
 {
     return type == GL_VERTEX_SHADER          ||
@@ -144,6 +533,30 @@ bool isProgram (GLenum type)
     return type == GL_PROGRAM;
 }
 
+bool isSamplerType (GLenum type)
+{
+    switch (type)
+    {
+        case GL_SAMPLER_1D                    : case GL_SAMPLER_2D                   :
+        case GL_SAMPLER_3D                    : case GL_SAMPLER_CUBE                 :
+        case GL_SAMPLER_1D_SHADOW             : case GL_SAMPLER_2D_SHADOW            :
+        case GL_SAMPLER_1D_ARRAY              : case GL_SAMPLER_2D_ARRAY             :
+        case GL_SAMPLER_CUBE_MAP_ARRAY        : case GL_SAMPLER_2D_ARRAY_SHADOW      :
+        case GL_SAMPLER_2D_MULTISAMPLE        : case GL_SAMPLER_2D_MULTISAMPLE_ARRAY :
+        case GL_SAMPLER_CUBE_SHADOW           : case GL_SAMPLER_BUFFER               :
+        case GL_SAMPLER_2D_RECT               : case GL_SAMPLER_2D_RECT_SHADOW       :
+        case GL_INT_SAMPLER_2D                : case GL_INT_SAMPLER_3D               :
+        case GL_INT_SAMPLER_CUBE              : case GL_INT_SAMPLER_2D_ARRAY         :
+        case GL_INT_SAMPLER_BUFFER            : case GL_UNSIGNED_INT_SAMPLER_2D      :
+        case GL_UNSIGNED_INT_SAMPLER_3D       : case GL_UNSIGNED_INT_SAMPLER_CUBE    :
+        case GL_UNSIGNED_INT_SAMPLER_2D_ARRAY : case GL_UNSIGNED_INT_SAMPLER_BUFFER  :
+        case GL_IMAGE_2D                      : case GL_IMAGE_3D                     :
+        case GL_IMAGE_2D_ARRAY                : case GL_IMAGE_BUFFER                 :
+            return true;
+    }
+    return false;
+}
+
 int GLSLProgram::getShaderIndex (GLenum type) const
 {
     switch (type)
@@ -191,23 +604,7 @@ std::string matchTypeToError (GLenum type)
     return "ERROR";
 }
 
-static size_t getFileSize (FILE *file)
+static double secondsSince (Clock::time_point start)
 {
-    assert (file);
-    struct stat file_info = {};
-    fstat (_fileno (file), &file_info);
-
-    return file_info.st_size;
-}
-
-static char *readFile (FILE *file)
-{
-    assert (file);
-
-    const size_t fileSize = getFileSize (file);
-    
-    char *sourse = new char [fileSize + 1] {};
-    fread (sourse, sizeof (*sourse), fileSize, file);
-    
-    return sourse;
+    return std::chrono::duration <double> (Clock::now() - start).count();
 }
\ No newline at end of file
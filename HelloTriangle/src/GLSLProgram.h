@@ -2,16 +2,27 @@
 #define GLSL_PROGRAM_INCLUDED
 
 #include <string>
-#include <map>
+#include <vector>
+#include <cstring>
 #include <glm/glm.hpp>
 #include <stdexcept>
 #include <glad/glad.h>
 #include <cassert>
-#include <sys/stat.h>
 #include <algorithm>
+#include <memory>
+#include <string_view>
 
 #include <iostream>
 
+#include "ProgramBinaryCache.h"
+#include "ShaderPreprocessor.h"
+#include "MappedFile.h"
+#include "GLStateCache.h"
+
+#ifndef GL_COMPLETION_STATUS_KHR
+#define GL_COMPLETION_STATUS_KHR 0x91B1
+#endif
+
 namespace ShaderInfo
 {
     struct ShaderFileExtension
@@ -54,10 +65,58 @@ private:
     std::string m_what;
 };
 
+bool isShader      (GLenum type);
+bool isProgram     (GLenum type);
+bool isSamplerType (GLenum type);
+
+template <typename T> struct UniformType;
+template <> struct UniformType <float>     { static bool matches (GLenum t) { return t == GL_FLOAT;             } };
+template <> struct UniformType <bool>      { static bool matches (GLenum t) { return t == GL_BOOL;              } };
+template <> struct UniformType <GLuint>    { static bool matches (GLenum t) { return t == GL_UNSIGNED_INT;      } };
+template <> struct UniformType <glm::vec2> { static bool matches (GLenum t) { return t == GL_FLOAT_VEC2;        } };
+template <> struct UniformType <glm::vec3> { static bool matches (GLenum t) { return t == GL_FLOAT_VEC3;        } };
+template <> struct UniformType <glm::vec4> { static bool matches (GLenum t) { return t == GL_FLOAT_VEC4;        } };
+template <> struct UniformType <glm::mat3> { static bool matches (GLenum t) { return t == GL_FLOAT_MAT3;        } };
+template <> struct UniformType <glm::mat4> { static bool matches (GLenum t) { return t == GL_FLOAT_MAT4;        } };
+template <> struct UniformType <int>       { static bool matches (GLenum t) { return t == GL_INT || isSamplerType (t); } };
+
+// Index into the program's sorted uniform table, valid until the next link()
+template <typename T>
+class UniformHandle
+{
+public:
+    UniformHandle()
+        : m_index (-1) {}
+
+    bool isValid() const { return m_index >= 0; }
+
+private:
+    explicit UniformHandle (int index)
+        : m_index (index) {}
+
+    int m_index;
+
+    friend class GLSLProgram;
+};
+
 class GLSLProgram 
 {
 public:
-    using uniformTable = std::map <std::string, int>;
+    struct UniformInfo
+    {
+        std::string name;
+        GLint       location;
+        GLenum      type;
+        GLint       size;
+        bool        hasValue;
+        alignas (16) unsigned char value [sizeof (glm::mat4)];
+    };
+
+    struct UniformStats
+    {
+        size_t writes;
+        size_t skipped;
+    };
 
     GLSLProgram();
    ~GLSLProgram();
@@ -67,7 +126,21 @@ public:
     void   compileShader (const char *sourse, GLenum type,
            const char *fileName);
 
+    void   addShaderSource (const std::string &sourse, GLenum type,
+           const char *fileName);
+    void   addShaderSource (std::shared_ptr <const MappedFile> file, GLenum type,
+           const char *fileName);
+    void   setBinaryCache (ProgramBinaryCache *cache);
+    void   setPreprocessor (ShaderPreprocessor *preprocessor,
+           const ShaderDefines &defines = ShaderDefines());
+
     void   link();
+    // link() split in two so the driver can compile in the background:
+    // isLinkComplete() needs GL_KHR_parallel_shader_compile,
+    // finishLink() blocks until the result is known and throws on failure
+    void   beginLink();
+    bool   isLinkComplete() const;
+    void   finishLink();
     void   validate();
     void   use() const;
     GLuint getHandle();
@@ -85,7 +158,16 @@ public:
     void   setUniform (const char *name, int val);
     void   setUniform (const char *name, bool val);
     void   setUniform (const char *name, GLuint val);
+
+    template <typename T>
+    UniformHandle <T> getUniformHandle (const char *name) const;
+    template <typename T>
+    void   setUniform (UniformHandle <T> handle, const T &value);
+
     void   findUniformLocations();
+    const std::vector <UniformInfo> &getActiveUniforms() const;
+    const UniformStats &getUniformStats() const;
+    void   resetUniformStats();
     void   printActiveUniforms();
     void   printActiveUniformBlocks();
     void   printActiveAttribs();
@@ -95,17 +177,67 @@ private:
     GLuint       m_programHandle;
     bool         m_isLinked;
     GLuint       m_shaderHandels [ShaderInfo::nShaderTypes];
-    uniformTable m_uniformLocations;
+
+    std::vector <UniformInfo> m_uniforms;
+    UniformStats              m_uniformStats;
+
+    ShaderPreprocessor     *m_preprocessor;
+    ShaderDefines           m_defines;
+    ProgramBinaryCache     *m_binaryCache;
+    ProgramBinaryCache::Key m_binaryKey;
+    std::string_view        m_shaderSources    [ShaderInfo::nShaderTypes];
+    std::shared_ptr <const void> m_sourceOwners [ShaderInfo::nShaderTypes];
+    std::string             m_shaderFiles      [ShaderInfo::nShaderTypes];
+    bool                    m_hasPendingSource [ShaderInfo::nShaderTypes];
+    bool                    m_linkPending;
+    double                  m_buildSeconds;
+
+    void   addShaderSource    (std::string_view sourse, std::shared_ptr <const void> owner,
+                               GLenum type, const char *fileName);
+    void   compileStage       (int index, const char *sourse, GLint length, GLenum type,
+                               const char *fileName, bool checkStatus);
+    void   compilePendingShaders();
+    void   dropPendingShaders();
+    ProgramBinaryCache::Key binaryCacheKey() const;
 
     int    getShaderIndex     (GLenum type) const;
-    GLint  getUniformLocation (const char *name);
+    int    findUniformIndex   (const char *name) const;
+    void   checkUniformType   (int index, bool typeMatches) const;
+    bool   updateUniformValue (int index, const void *value, size_t size);
+
+    void   uploadUniform (GLint location, float val);
+    void   uploadUniform (GLint location, int val);
+    void   uploadUniform (GLint location, bool val);
+    void   uploadUniform (GLint location, GLuint val);
+    void   uploadUniform (GLint location, const glm::vec2 &v);
+    void   uploadUniform (GLint location, const glm::vec3 &v);
+    void   uploadUniform (GLint location, const glm::vec4 &v);
+    void   uploadUniform (GLint location, const glm::mat3 &m);
+    void   uploadUniform (GLint location, const glm::mat4 &m);
     bool   fileExists         (const std::string &fileName);
     
     GLSLProgram             (const GLSLProgram &other) = delete;
     GLSLProgram &operator = (const GLSLProgram &other) = delete;
 };
-                            
-bool isShader  (GLenum type);
-bool isProgram (GLenum type);
+
+template <typename T>
+UniformHandle <T> GLSLProgram::getUniformHandle (const char *name) const
+{
+    int index = findUniformIndex (name);
+    if (index >= 0)
+        checkUniformType (index, UniformType <T>::matches (m_uniforms[index].type));
+
+    return UniformHandle <T> (index);
+}
+
+template <typename T>
+void GLSLProgram::setUniform (UniformHandle <T> handle, const T &value)
+{
+    if (!handle.isValid())
+        return;
+
+    if (updateUniformValue (handle.m_index, &value, sizeof (value)))
+        uploadUniform (m_uniforms[handle.m_index].location, value);
+}
 
 #endif // !GLSL_PROGRAM_INCLUDED
\ No newline at end of file
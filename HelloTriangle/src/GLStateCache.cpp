@@ -0,0 +1,217 @@
+#include "GLStateCache.h"
+
+#include <cassert>
+
+GLStateCache::GLStateCache()
+    : m_stats()
+{
+    invalidate();
+}
+
+void GLStateCache::useProgram (GLuint program)
+{
+    if (update (m_program, program))
+        glUseProgram (program);
+}
+
+// The element array binding belongs to the vertex array object
+void GLStateCache::bindVertexArray (GLuint vertexArray)
+{
+    if (update (m_vertexArray, vertexArray))
+    {
+        glBindVertexArray (vertexArray);
+        m_buffers[ElementArrayBuffer] = UNKNOWN;
+    }
+}
+
+void GLStateCache::bindBuffer (GLenum target, GLuint buffer)
+{
+    const int slot = bufferSlot (target);
+    if (slot < 0)
+    {
+        ++m_stats.issued;
+        glBindBuffer (target, buffer);
+        return;
+    }
+
+    if (update (m_buffers[slot], buffer))
+        glBindBuffer (target, buffer);
+}
+
+void GLStateCache::bindTexture (GLuint unit, GLuint texture)
+{
+    assert (unit < TEXTURE_UNITS);
+
+    if (update (m_textures[unit], texture))
+        glBindTextureUnit (unit, texture);
+}
+
+void GLStateCache::setBlend (bool enabled)
+{
+    setCapability (m_blend, GL_BLEND, enabled);
+}
+
+void GLStateCache::setBlendFunc (GLenum source, GLenum destination)
+{
+    if (m_blendSource == source && m_blendDestination == destination)
+    {
+        ++m_stats.elided;
+        return;
+    }
+
+    ++m_stats.issued;
+    m_blendSource      = source;
+    m_blendDestination = destination;
+    glBlendFunc (source, destination);
+}
+
+void GLStateCache::setDepthTest (bool enabled)
+{
+    setCapability (m_depthTest, GL_DEPTH_TEST, enabled);
+}
+
+void GLStateCache::setDepthWrite (bool enabled)
+{
+    if (update (m_depthWrite, enabled ? GL_TRUE : GL_FALSE))
+        glDepthMask (enabled ? GL_TRUE : GL_FALSE);
+}
+
+void GLStateCache::setDepthFunc (GLenum func)
+{
+    if (update (m_depthFunc, func))
+        glDepthFunc (func);
+}
+
+void GLStateCache::setViewport (GLint x, GLint y, GLsizei width, GLsizei height)
+{
+    if (m_viewport[0] == x && m_viewport[1] == y && m_viewport[2] == width && m_viewport[3] == height)
+    {
+        ++m_stats.elided;
+        return;
+    }
+
+    ++m_stats.issued;
+    m_viewport[0] = x;
+    m_viewport[1] = y;
+    m_viewport[2] = width;
+    m_viewport[3] = height;
+    glViewport (x, y, width, height);
+}
+
+void GLStateCache::forgetProgram (GLuint program)
+{
+    if (m_program == program)
+        m_program = UNKNOWN;
+}
+
+void GLStateCache::forgetVertexArray (GLuint vertexArray)
+{
+    if (m_vertexArray == vertexArray)
+    {
+        m_vertexArray = UNKNOWN;
+        m_buffers[ElementArrayBuffer] = UNKNOWN;
+    }
+}
+
+void GLStateCache::forgetBuffer (GLuint buffer)
+{
+    for (GLuint &bound : m_buffers)
+        if (bound == buffer)
+            bound = UNKNOWN;
+}
+
+void GLStateCache::forgetTexture (GLuint texture)
+{
+    for (GLuint &bound : m_textures)
+        if (bound == texture)
+            bound = UNKNOWN;
+}
+
+void GLStateCache::invalidate()
+{
+    m_program     = UNKNOWN;
+    m_vertexArray = UNKNOWN;
+    for (GLuint &buffer : m_buffers)
+        buffer = UNKNOWN;
+    for (GLuint &texture : m_textures)
+        texture = UNKNOWN;
+
+    m_blend            = -1;
+    m_blendSource      = UNKNOWN;
+    m_blendDestination = UNKNOWN;
+    m_depthTest        = -1;
+    m_depthWrite       = -1;
+    m_depthFunc        = UNKNOWN;
+    for (GLint &value : m_viewport)
+        value = -1;
+}
+
+const GLStateCache::Stats &GLStateCache::stats() const
+{
+    return m_stats;
+}
+
+void GLStateCache::resetStats()
+{
+    m_stats = Stats();
+}
+
+GLStateCache &GLStateCache::current()
+{
+    static thread_local GLStateCache cache;
+    return cache;
+}
+
+bool GLStateCache::update (GLuint &shadow, GLuint value)
+{
+    if (shadow == value)
+    {
+        ++m_stats.elided;
+        return false;
+    }
+
+    ++m_stats.issued;
+    shadow = value;
+    return true;
+}
+
+bool GLStateCache::update (GLint &shadow, GLint value)
+{
+    if (shadow == value)
+    {
+        ++m_stats.elided;
+        return false;
+    }
+
+    ++m_stats.issued;
+    shadow = value;
+    return true;
+}
+
+void GLStateCache::setCapability (GLint &shadow, GLenum capability, bool enabled)
+{
+    if (!update (shadow, enabled ? 1 : 0))
+        return;
+
+    if (enabled)
+        glEnable (capability);
+    else
+        glDisable (capability);
+}
+
+int GLStateCache::bufferSlot (GLenum target)
+{
+    switch (target)
+    {
+        case GL_ARRAY_BUFFER:          return ArrayBuffer;
+        case GL_ELEMENT_ARRAY_BUFFER:  return ElementArrayBuffer;
+        case GL_DRAW_INDIRECT_BUFFER:  return DrawIndirectBuffer;
+        case GL_UNIFORM_BUFFER:        return UniformBuffer;
+        case GL_SHADER_STORAGE_BUFFER: return ShaderStorageBuffer;
+        case GL_COPY_READ_BUFFER:      return CopyReadBuffer;
+        case GL_COPY_WRITE_BUFFER:     return CopyWriteBuffer;
+        case GL_PIXEL_UNPACK_BUFFER:   return PixelUnpackBuffer;
+        case GL_PIXEL_PACK_BUFFER:     return PixelPackBuffer;
+        default:                       return -1;
+    }
+}
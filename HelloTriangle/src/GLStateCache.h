@@ -0,0 +1,86 @@
+#ifndef GL_STATE_CACHE_INCLUDED
+#define GL_STATE_CACHE_INCLUDED
+
+#include <cstddef>
+#include <glad/glad.h>
+
+// Shadows the GL state this project touches and drops calls that would set
+// what is already set. Everything starts unknown, so the first call of each
+// kind is always issued. Code that changes state behind the cache's back
+// (or switches contexts on the thread) has to call invalidate()
+class GLStateCache
+{
+public:
+    static const GLuint TEXTURE_UNITS = 32;
+
+    struct Stats
+    {
+        size_t issued;
+        size_t elided;
+    };
+
+    GLStateCache();
+
+    void   useProgram      (GLuint program);
+    void   bindVertexArray (GLuint vertexArray);
+    void   bindBuffer      (GLenum target, GLuint buffer);
+    void   bindTexture     (GLuint unit, GLuint texture);
+
+    void   setBlend        (bool enabled);
+    void   setBlendFunc    (GLenum source, GLenum destination);
+    void   setDepthTest    (bool enabled);
+    void   setDepthWrite   (bool enabled);
+    void   setDepthFunc    (GLenum func);
+    void   setViewport     (GLint x, GLint y, GLsizei width, GLsizei height);
+
+    // Deleted names may be reused by GL, a stale shadow would elide a real bind
+    void   forgetProgram     (GLuint program);
+    void   forgetVertexArray (GLuint vertexArray);
+    void   forgetBuffer      (GLuint buffer);
+    void   forgetTexture     (GLuint texture);
+    void   invalidate();
+
+    const Stats &stats() const;
+    void   resetStats();
+
+    // One cache per thread, matching GL's one current context per thread
+    static GLStateCache &current();
+
+private:
+    static const GLuint UNKNOWN = 0xFFFFFFFF;
+
+    enum BufferSlot
+    {
+        ArrayBuffer,
+        ElementArrayBuffer,
+        DrawIndirectBuffer,
+        UniformBuffer,
+        ShaderStorageBuffer,
+        CopyReadBuffer,
+        CopyWriteBuffer,
+        PixelUnpackBuffer,
+        PixelPackBuffer,
+        BufferSlotCount
+    };
+
+    GLuint m_program;
+    GLuint m_vertexArray;
+    GLuint m_buffers  [BufferSlotCount];
+    GLuint m_textures [TEXTURE_UNITS];
+    GLint  m_blend;
+    GLenum m_blendSource;
+    GLenum m_blendDestination;
+    GLint  m_depthTest;
+    GLint  m_depthWrite;
+    GLenum m_depthFunc;
+    GLint  m_viewport [4];
+    Stats  m_stats;
+
+    bool   update (GLuint &shadow, GLuint value);
+    bool   update (GLint  &shadow, GLint  value);
+    void   setCapability (GLint &shadow, GLenum capability, bool enabled);
+
+    static int bufferSlot (GLenum target);
+};
+
+#endif // !GL_STATE_CACHE_INCLUDED
@@ -0,0 +1,102 @@
+#include "GpuTimer.h"
+
+#include <cassert>
+
+
+GpuTimer::GpuTimer (size_t capacity)
+    : m_slots (capacity), m_head (0), m_tail (0), m_skipped (0)
+{
+    assert (capacity > 0);
+
+    for (Slot &slot : m_slots)
+    {
+        glGenQueries (2, slot.queries);
+        slot.tag       = 0;
+        slot.isPending = false;
+        slot.isEnded   = false;
+    }
+}
+
+GpuTimer::~GpuTimer()
+{
+    for (Slot &slot : m_slots)
+        glDeleteQueries (2, slot.queries);
+}
+
+int GpuTimer::begin (uint64_t tag)
+{
+    Slot &slot = m_slots[m_head];
+    if (slot.isPending)
+    {
+        ++m_skipped;
+        return -1;
+    }
+
+    glQueryCounter (slot.queries[0], GL_TIMESTAMP);
+    slot.tag       = tag;
+    slot.isPending = true;
+    slot.isEnded   = false;
+
+    const int index = static_cast <int> (m_head);
+    m_head = (m_head + 1) % m_slots.size();
+    return index;
+}
+
+void GpuTimer::end (int slot)
+{
+    if (slot < 0)
+        return;
+
+    assert (static_cast <size_t> (slot) < m_slots.size() && m_slots[slot].isPending);
+
+    glQueryCounter (m_slots[slot].queries[1], GL_TIMESTAMP);
+    m_slots[slot].isEnded = true;
+}
+
+void GpuTimer::collect (std::vector <Interval> &out)
+{
+    while (m_slots[m_tail].isPending && read (m_slots[m_tail], false, out))
+        m_tail = (m_tail + 1) % m_slots.size();
+}
+
+void GpuTimer::drain (std::vector <Interval> &out)
+{
+    while (m_slots[m_tail].isPending && read (m_slots[m_tail], true, out))
+        m_tail = (m_tail + 1) % m_slots.size();
+}
+
+size_t GpuTimer::skipped() const
+{
+    return m_skipped;
+}
+
+uint64_t GpuTimer::timestamp()
+{
+    GLint64 now = 0;
+    glGetInteger64v (GL_TIMESTAMP, &now);
+    return static_cast <uint64_t> (now);
+}
+
+// The end query is issued after the start one, once it is available both are
+bool GpuTimer::read (Slot &slot, bool wait, std::vector <Interval> &out)
+{
+    if (!slot.isEnded)
+        return false;
+
+    if (!wait)
+    {
+        GLuint isAvailable = GL_FALSE;
+        glGetQueryObjectuiv (slot.queries[1], GL_QUERY_RESULT_AVAILABLE, &isAvailable);
+        if (!isAvailable)
+            return false;
+    }
+
+    Interval interval = { slot.tag, 0, 0 };
+    glGetQueryObjectui64v (slot.queries[0], GL_QUERY_RESULT, &interval.start);
+    glGetQueryObjectui64v (slot.queries[1], GL_QUERY_RESULT, &interval.end);
+    out.push_back (interval);
+
+    slot.isPending = false;
+    slot.isEnded   = false;
+    return true;
+}
@@ -0,0 +1,62 @@
+#ifndef GPU_TIMER_INCLUDED
+#define GPU_TIMER_INCLUDED
+
+#include <vector>
+#include <cstddef>
+#include <cstdint>
+#include <glad/glad.h>
+
+// Ring of GL_TIMESTAMP query pairs. begin()/end() bracket GPU work and
+// collect() hands back the intervals the GPU has finished without
+// blocking; timestamps rather than GL_TIME_ELAPSED so intervals may nest.
+// A slot whose previous result is still in flight is skipped, not waited on
+class GpuTimer
+{
+public:
+    struct Interval
+    {
+        uint64_t tag;      // whatever was passed to begin()
+        uint64_t start;    // GL_TIMESTAMP, ns
+        uint64_t end;
+
+        double milliseconds() const { return (end - start) / 1.0e6; }
+    };
+
+    explicit GpuTimer (size_t capacity = 64);
+   ~GpuTimer();
+
+    // Returns the slot to pass to end(), or -1 when the ring is full
+    int    begin (uint64_t tag = 0);
+    void   end   (int slot);
+
+    // Appends finished intervals in the order they were begun
+    void   collect (std::vector <Interval> &out);
+    // Blocks until everything begun so far is finished
+    void   drain   (std::vector <Interval> &out);
+
+    size_t skipped() const;
+
+    // GPU clock now, for lining GPU timestamps up with CPU time
+    static uint64_t timestamp();
+
+private:
+    struct Slot
+    {
+        GLuint   queries[2];
+        uint64_t tag;
+        bool     isPending;
+        bool     isEnded;
+    };
+
+    std::vector <Slot> m_slots;
+    size_t             m_head;     // next slot to begin
+    size_t             m_tail;     // oldest slot not collected yet
+    size_t             m_skipped;
+
+    bool   read (Slot &slot, bool wait, std::vector <Interval> &out);
+
+    GpuTimer             (const GpuTimer &other) = delete;
+    GpuTimer &operator = (const GpuTimer &other) = delete;
+};
+
+#endif // !GPU_TIMER_INCLUDED
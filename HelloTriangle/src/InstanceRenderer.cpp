@@ -0,0 +1,178 @@
+#include "InstanceRenderer.h"
+#include "Profiler.h"
+
+#include <chrono>
+#include <cassert>
+#include <cstring>
+#include <algorithm>
+
+using Clock = std::chrono::steady_clock;
+
+static const GLuint     INSTANCE_BINDING   = 1;
+static const GLsizeiptr INSTANCE_ALIGNMENT = 16;
+static const GLsizeiptr MIN_VERTEX_BYTES   = 1 << 16;
+static const GLsizeiptr MIN_INDEX_COUNT    = 1 << 14;
+
+static_assert (sizeof (InstanceRenderer::Instance) == 52, "instances are packed into 13 floats");
+
+
+const GLuint InstanceRenderer::INSTANCE_LOCATION;
+
+// glm is column major, the rows are gathered across the first three columns and the translation
+InstanceRenderer::Instance InstanceRenderer::Instance::make (const glm::mat4 &transform, const glm::vec4 &color)
+{
+    Instance instance;
+    for (int row = 0; row < 3; ++row)
+        instance.rows[row] = glm::vec4 (transform[0][row], transform[1][row], transform[2][row], transform[3][row]);
+
+    instance.color = 0;
+    for (int channel = 0; channel < 4; ++channel)
+    {
+        const float value = std::min (std::max (color[channel], 0.0f), 1.0f);
+        instance.color   |= static_cast <uint32_t> (value * 255.0f + 0.5f) << (8 * channel);
+    }
+    return instance;
+}
+
+InstanceRenderer::InstanceRenderer (StreamBuffer &stream)
+    : m_stream (stream), m_pools (MIN_VERTEX_BYTES, MIN_INDEX_COUNT), m_meshCount (0), m_stats()
+{
+}
+
+InstanceRenderer::Mesh InstanceRenderer::addMesh (const VertexFormat &format, const void *vertices,
+                                                  size_t vertexCount, const GLuint *indices, size_t indexCount)
+{
+    assert (vertices && indices && vertexCount > 0 && indexCount > 0);
+    PROFILE_SCOPE ("InstanceRenderer::addMesh");
+
+    const unsigned         pool  = findPool (format);
+    const MeshPools::Range range = m_pools.add (pool, vertices, vertexCount, indices, indexCount);
+
+    Mesh mesh = { pool, static_cast <unsigned> (m_meshCount), range.firstIndex, range.indexCount, range.baseVertex };
+    ++m_meshCount;
+
+    return mesh;
+}
+
+void InstanceRenderer::draw (const Mesh &mesh, const GLSLProgram &program, const Instance &instance)
+{
+    assert (mesh.isValid() && mesh.pool < m_pools.size());
+
+    auto key = std::make_pair (&program, mesh.id);
+    auto it  = m_groupIndex.find (key);
+    if (it == m_groupIndex.end())
+    {
+        it = m_groupIndex.emplace (key, m_groups.size()).first;
+        m_groups.push_back ({ &program, mesh, {} });
+    }
+
+    m_groups[it->second].instances.push_back (instance);
+}
+
+void InstanceRenderer::flush (SubmitMode mode)
+{
+    PROFILE_SCOPE ("InstanceRenderer::flush");
+
+    Clock::time_point start = Clock::now();
+    m_stats = Stats();
+
+    for (Group &group : m_groups)
+    {
+        if (group.instances.empty())
+            continue;
+
+        ++m_stats.groups;
+        flushGroup (group, mode);
+        group.instances.clear();
+    }
+
+    m_stats.submitSeconds = std::chrono::duration <double> (Clock::now() - start).count();
+}
+
+size_t InstanceRenderer::meshCount() const
+{
+    return m_meshCount;
+}
+
+const InstanceRenderer::Stats &InstanceRenderer::frameStats() const
+{
+    return m_stats;
+}
+
+// A new pool gets the instance attributes next to the vertices
+unsigned InstanceRenderer::findPool (const VertexFormat &format)
+{
+    unsigned pool = 0;
+    if (m_pools.find (format, pool))
+        return pool;
+
+    assert (std::none_of (format.attributes.begin(), format.attributes.end(),
+                          [] (const VertexAttribute &attribute)
+                          {
+                              return attribute.location >= INSTANCE_LOCATION &&
+                                     attribute.location <= INSTANCE_LOCATION + 3;
+                          }) &&
+            "the mesh format overlaps the instance attributes");
+    pool = m_pools.create (format);
+
+    const GLuint vao = m_pools.vertexArray (pool);
+    for (GLuint row = 0; row < 3; ++row)
+    {
+        glVertexArrayAttribFormat  (vao, INSTANCE_LOCATION + row, 4, GL_FLOAT, GL_FALSE, row * sizeof (glm::vec4));
+        glVertexArrayAttribBinding (vao, INSTANCE_LOCATION + row, INSTANCE_BINDING);
+        glEnableVertexArrayAttrib  (vao, INSTANCE_LOCATION + row);
+    }
+    glVertexArrayAttribFormat   (vao, INSTANCE_LOCATION + 3, 4, GL_UNSIGNED_BYTE, GL_TRUE, offsetof (Instance, color));
+    glVertexArrayAttribBinding  (vao, INSTANCE_LOCATION + 3, INSTANCE_BINDING);
+    glEnableVertexArrayAttrib   (vao, INSTANCE_LOCATION + 3);
+    glVertexArrayBindingDivisor (vao, INSTANCE_BINDING, 1);
+    return pool;
+}
+
+// Instances are split into chunks when the stream region can't take them
+// all at once. Each chunk is bound at the start of the instance binding, so
+// the draws' baseInstance counts from the chunk
+void InstanceRenderer::flushGroup (Group &group, SubmitMode mode)
+{
+    const GLuint     vao     = m_pools.vertexArray (group.mesh.pool);
+    const void      *indices = reinterpret_cast <const void *> (group.mesh.firstIndex * sizeof (GLuint));
+    const GLsizeiptr slack   = INSTANCE_ALIGNMENT;
+
+    GLStateCache &state = GLStateCache::current();
+    group.program->use();
+    state.bindVertexArray (vao);
+
+    const size_t total = group.instances.size();
+    for (size_t first = 0; first < total; )
+    {
+        const GLsizeiptr fits  = std::max <GLsizeiptr> (m_stream.bytesFree() - slack, 0) / sizeof (Instance);
+        const size_t     count = std::min (total - first, static_cast <size_t> (fits));
+        if (count == 0)
+        {
+            m_stats.droppedInstances += total - first;
+            break;
+        }
+
+        StreamBuffer::Allocation data = m_stream.allocate (count * sizeof (Instance), INSTANCE_ALIGNMENT);
+        memcpy (data.data, &group.instances[first], data.size);
+        glVertexArrayVertexBuffer (vao, INSTANCE_BINDING, m_stream.handle(), data.offset, sizeof (Instance));
+
+        if (mode == SubmitMode::Instanced)
+        {
+            glDrawElementsInstancedBaseVertexBaseInstance (GL_TRIANGLES, group.mesh.indexCount, GL_UNSIGNED_INT,
+                indices, static_cast <GLsizei> (count), group.mesh.baseVertex, 0);
+            ++m_stats.drawCalls;
+        }
+        else
+        {
+            for (size_t i = 0; i < count; ++i)
+                glDrawElementsInstancedBaseVertexBaseInstance (GL_TRIANGLES, group.mesh.indexCount, GL_UNSIGNED_INT,
+                    indices, 1, group.mesh.baseVertex, static_cast <GLuint> (i));
+            m_stats.drawCalls += count;
+        }
+
+        m_stats.triangles += count * (group.mesh.indexCount / 3);
+        m_stats.instances += count;
+        first += count;
+    }
+}
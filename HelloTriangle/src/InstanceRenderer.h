@@ -0,0 +1,101 @@
+#ifndef INSTANCE_RENDERER_INCLUDED
+#define INSTANCE_RENDERER_INCLUDED
+
+#include <map>
+#include <vector>
+#include <utility>
+#include <cstddef>
+#include <cstdint>
+#include <glm/glm.hpp>
+#include <glad/glad.h>
+
+#include "GLSLProgram.h"
+#include "StreamBuffer.h"
+#include "GLStateCache.h"
+#include "VertexLayout.h"
+#include "MeshPools.h"
+
+// Draws many copies of a few meshes. Meshes are registered once into shared
+// MeshPools buffers, one pair per vertex format; every frame the
+// instances drawn of the same mesh with the same program are grouped and
+// issued as one glDrawElementsInstancedBaseVertexBaseInstance. Instance data
+// is written into the frame's StreamBuffer region and read as attributes
+// with a divisor of 1: the rows of the transform at INSTANCE_LOCATION and
+// the two after it, the color at INSTANCE_LOCATION + 3
+class InstanceRenderer
+{
+public:
+    static const GLuint INSTANCE_LOCATION = 8;
+
+    // 52 bytes: the top three rows of an affine transform, so a shader gets
+    // the position as dot (row, vec4 (p, 1)) each, and an RGBA8 color
+    struct Instance
+    {
+        glm::vec4 rows[3];
+        uint32_t  color;        // red in the low byte, read back normalized
+
+        static Instance make (const glm::mat4 &transform, const glm::vec4 &color);
+    };
+
+    enum class SubmitMode
+    {
+        Instanced,
+        PerDraw              // one draw call per instance, kept as a baseline
+    };
+
+    struct Mesh
+    {
+        unsigned pool;
+        unsigned id;
+        GLuint   firstIndex;
+        GLuint   indexCount;
+        GLint    baseVertex;
+
+        bool isValid() const { return indexCount > 0; }
+    };
+
+    struct Stats
+    {
+        size_t instances;
+        size_t groups;
+        size_t drawCalls;
+        size_t triangles;
+        size_t droppedInstances;   // didn't fit into the stream buffer region
+        double submitSeconds;
+    };
+
+    explicit InstanceRenderer (StreamBuffer &stream);
+
+    Mesh   addMesh (const VertexFormat &format, const void *vertices, size_t vertexCount,
+                    const GLuint *indices, size_t indexCount);
+
+    void   draw  (const Mesh &mesh, const GLSLProgram &program, const Instance &instance);
+    // Needs the stream buffer to be inside a frame
+    void   flush (SubmitMode mode = SubmitMode::Instanced);
+
+    size_t meshCount() const;
+    const Stats &frameStats() const;
+
+private:
+    struct Group
+    {
+        const GLSLProgram      *program;
+        Mesh                    mesh;
+        std::vector <Instance>  instances;
+    };
+
+    StreamBuffer            &m_stream;
+    MeshPools                m_pools;
+    std::vector <Group>      m_groups;
+    std::map <std::pair <const GLSLProgram *, unsigned>, size_t> m_groupIndex;
+    size_t                   m_meshCount;
+    Stats                    m_stats;
+
+    unsigned findPool   (const VertexFormat &format);
+    void     flushGroup (Group &group, SubmitMode mode);
+
+    InstanceRenderer             (const InstanceRenderer &other) = delete;
+    InstanceRenderer &operator = (const InstanceRenderer &other) = delete;
+};
+
+#endif // !INSTANCE_RENDERER_INCLUDED
@@ -0,0 +1,222 @@
+#include "JobSystem.h"
+#include "Profiler.h"
+
+#include <algorithm>
+
+// Tries a worker makes for a job before it goes to sleep, yielding between them
+static const int SPINS_BEFORE_SLEEP = 64;
+
+static thread_local const JobSystem *t_system = nullptr;
+static thread_local size_t           t_thread = 0;
+
+
+JobSystem::Counter::Counter()
+    : m_count (0)
+{
+}
+
+bool JobSystem::Counter::isDone() const
+{
+    return m_count.load (std::memory_order_acquire) == 0;
+}
+
+JobSystem::JobSystem (size_t threadCount)
+    : m_queued     (0)
+    , m_sleeping   (0)
+    , m_jobCount   (0)
+    , m_stealCount (0)
+    , m_isStopping (false)
+{
+    threadCount = std::max <size_t> (threadCount, 1);
+
+    for (size_t i = 0; i < threadCount; ++i)
+        m_deques.emplace_back (new Deque);
+
+    m_workers.reserve (threadCount - 1);
+    for (size_t i = 1; i < threadCount; ++i)
+        m_workers.emplace_back (&JobSystem::workerLoop, this, i);
+}
+
+JobSystem::~JobSystem()
+{
+    {
+        std::lock_guard <std::mutex> lock (m_sleepMutex);
+        m_isStopping = true;
+    }
+    m_wakeUp.notify_all();
+
+    for (std::thread &worker : m_workers)
+        worker.join();
+}
+
+void JobSystem::wait (Counter &counter)
+{
+    const size_t thread = currentThread();
+    while (!counter.isDone())
+    {
+        Job job;
+        if (take (thread, job))
+            execute (job);
+        else
+            std::this_thread::yield();
+    }
+
+    // The last job takes the counter to zero under its lock and touches it
+    // no more once it lets go, after which the counter may be destroyed
+    std::lock_guard <std::mutex> lock (counter.m_mutex);
+}
+
+size_t JobSystem::threadCount() const
+{
+    return m_deques.size();
+}
+
+size_t JobSystem::currentThread() const
+{
+    return t_system == this ? t_thread : 0;
+}
+
+JobSystem::Stats JobSystem::stats() const
+{
+    return { m_jobCount.load (std::memory_order_relaxed), m_stealCount.load (std::memory_order_relaxed) };
+}
+
+void JobSystem::resetStats()
+{
+    m_jobCount.store   (0, std::memory_order_relaxed);
+    m_stealCount.store (0, std::memory_order_relaxed);
+}
+
+size_t JobSystem::defaultThreadCount()
+{
+    return std::max <size_t> (std::thread::hardware_concurrency(), 1);
+}
+
+// A job started after an unfinished counter waits in the counter's list,
+// for the job that finishes it to push
+void JobSystem::submit (const Job &job, Counter *after)
+{
+    if (after)
+    {
+        std::lock_guard <std::mutex> lock (after->m_mutex);
+        if (!after->isDone())
+        {
+            after->m_waiting.push_back (job);
+            return;
+        }
+    }
+    push (job);
+}
+
+// Onto the back of the calling thread's deque, then wakes a sleeper if any.
+// m_queued and m_sleeping are both sequentially consistent, so either the
+// sleeper sees the new job before it waits or this sees the sleeper
+void JobSystem::push (const Job &job)
+{
+    Deque &deque = *m_deques[currentThread()];
+    {
+        std::lock_guard <std::mutex> lock (deque.mutex);
+        deque.jobs.push_back (job);
+    }
+    m_queued.fetch_add (1);
+
+    if (m_sleeping.load() > 0)
+    {
+        std::lock_guard <std::mutex> lock (m_sleepMutex);
+        m_wakeUp.notify_one();
+    }
+}
+
+// The newest job of the thread's own deque, else the oldest of another's
+bool JobSystem::take (size_t thread, Job &job)
+{
+    if (m_queued.load (std::memory_order_relaxed) == 0)
+        return false;
+
+    const size_t count = m_deques.size();
+    for (size_t i = 0; i < count; ++i)
+    {
+        const size_t victim = (thread + i) % count;
+        Deque       &deque  = *m_deques[victim];
+
+        std::lock_guard <std::mutex> lock (deque.mutex);
+        if (deque.jobs.empty())
+            continue;
+
+        if (i == 0)
+        {
+            job = deque.jobs.back();
+            deque.jobs.pop_back();
+        }
+        else
+        {
+            job = deque.jobs.front();
+            deque.jobs.pop_front();
+            m_stealCount.fetch_add (1, std::memory_order_relaxed);
+        }
+        m_queued.fetch_sub (1);
+        return true;
+    }
+    return false;
+}
+
+void JobSystem::execute (const Job &job)
+{
+    job.invoke (job.storage);
+    m_jobCount.fetch_add (1, std::memory_order_relaxed);
+
+    Counter *counter = job.counter;
+    if (!counter)
+        return;
+
+    // Any but the last job just counts down. The last one does it under the
+    // lock, so submit() either sees the counter done or leaves its job in
+    // the list taken here
+    uint32_t count = counter->m_count.load (std::memory_order_relaxed);
+    while (count > 1)
+    {
+        if (counter->m_count.compare_exchange_weak (count, count - 1, std::memory_order_acq_rel))
+            return;
+    }
+
+    std::vector <Job> waiting;
+    {
+        std::lock_guard <std::mutex> lock (counter->m_mutex);
+        waiting.swap (counter->m_waiting);
+        counter->m_count.fetch_sub (1, std::memory_order_acq_rel);
+    }
+    for (const Job &next : waiting)
+        push (next);
+}
+
+void JobSystem::workerLoop (size_t thread)
+{
+    t_system = this;
+    t_thread = thread;
+    PROFILE_THREAD_NAME ("Job worker");
+
+    int spins = 0;
+    for (;;)
+    {
+        Job job;
+        if (take (thread, job))
+        {
+            execute (job);
+            spins = 0;
+            continue;
+        }
+        if (++spins < SPINS_BEFORE_SLEEP)
+        {
+            std::this_thread::yield();
+            continue;
+        }
+
+        spins = 0;
+        std::unique_lock <std::mutex> lock (m_sleepMutex);
+        m_sleeping.fetch_add (1);
+        m_wakeUp.wait (lock, [this] { return m_isStopping || m_queued.load() > 0; });
+        m_sleeping.fetch_sub (1);
+        if (m_isStopping)
+            return;
+    }
+}
@@ -0,0 +1,148 @@
+#ifndef JOB_SYSTEM_INCLUDED
+#define JOB_SYSTEM_INCLUDED
+
+#include <vector>
+#include <deque>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <atomic>
+#include <memory>
+#include <new>
+#include <type_traits>
+#include <cstddef>
+#include <cstdint>
+
+// Small jobs over a fixed set of threads, for the CPU side of a frame.
+// Every thread has its own deque: it pushes and pops jobs at the back, and
+// a thread with nothing left steals from the front of the others'. The
+// thread that creates the system is thread 0 and runs jobs only while it
+// waits, so the GL thread can replay one frame while the workers build the
+// next. The ThreadPool stays for long blocking tasks like file reads.
+// A job is a lambda kept inline, no allocation: it has to be trivially
+// copyable and fit Job::STORAGE, which capturing pointers, references and
+// a few indices does
+class JobSystem
+{
+public:
+    class Counter;
+
+    struct Job
+    {
+        static const size_t STORAGE = 48;
+
+        void                    (*invoke) (const void *storage);
+        Counter                  *counter;
+        alignas (16) unsigned char storage[STORAGE];
+    };
+
+    // Counts jobs not yet finished: run() adds one, the job takes it off
+    // once it returns. Jobs started after a counter are held until it is
+    // done. Reuse or destroy it only after wait() returns
+    class Counter
+    {
+    public:
+        Counter();
+
+        bool isDone() const;
+
+    private:
+        std::atomic <uint32_t> m_count;
+        std::mutex             m_mutex;
+        std::vector <Job>      m_waiting;
+
+        friend class JobSystem;
+    };
+
+    struct Stats
+    {
+        size_t jobs;
+        size_t steals;
+    };
+
+    // threadCount includes the calling thread, defaultThreadCount() gives
+    // one per core. Jobs left unfinished at destruction are dropped
+    explicit JobSystem (size_t threadCount = defaultThreadCount());
+   ~JobSystem();
+
+    // Runs task on some thread once after is done, counted on counter.
+    // Both may be null
+    template <typename Task>
+    void   run (const Task &task, Counter *counter = nullptr, Counter *after = nullptr);
+
+    // Runs jobs on the calling thread until counter is done
+    void   wait (Counter &counter);
+
+    // Calls body (begin, end) over [0, count) in ranges of grain items
+    // across the threads and waits for all of them
+    template <typename Body>
+    void   parallelFor (size_t count, size_t grain, const Body &body);
+
+    size_t threadCount() const;
+    // The index of the calling thread in this system, 0 for threads not in it
+    size_t currentThread() const;
+
+    Stats  stats() const;
+    void   resetStats();
+
+    static size_t defaultThreadCount();
+
+private:
+    // A cache line each, so the threads' locks don't share one
+    struct alignas (64) Deque
+    {
+        std::mutex        mutex;
+        std::deque <Job>  jobs;
+    };
+
+    std::vector <std::unique_ptr <Deque>> m_deques;
+    std::vector <std::thread>             m_workers;
+    std::atomic <size_t>                  m_queued;
+    std::atomic <size_t>                  m_sleeping;
+    std::atomic <size_t>                  m_jobCount;
+    std::atomic <size_t>                  m_stealCount;
+    std::mutex                            m_sleepMutex;
+    std::condition_variable               m_wakeUp;
+    bool                                  m_isStopping;
+
+    void   submit (const Job &job, Counter *after);
+    void   push (const Job &job);
+    bool   take (size_t thread, Job &job);
+    void   execute (const Job &job);
+    void   workerLoop (size_t thread);
+
+    JobSystem             (const JobSystem &other) = delete;
+    JobSystem &operator = (const JobSystem &other) = delete;
+};
+
+template <typename Task>
+void JobSystem::run (const Task &task, Counter *counter, Counter *after)
+{
+    static_assert (std::is_trivially_copyable <Task>::value, "jobs are copied as bytes, capture by pointer");
+    static_assert (sizeof (Task) <= Job::STORAGE && alignof (Task) <= 16, "job captures more than Job::STORAGE");
+
+    Job job;
+    job.invoke  = [] (const void *storage) { (*std::launder (static_cast <const Task *> (storage))) (); };
+    job.counter = counter;
+    new (job.storage) Task (task);
+
+    if (counter)
+        counter->m_count.fetch_add (1, std::memory_order_relaxed);
+    submit (job, after);
+}
+
+template <typename Body>
+void JobSystem::parallelFor (size_t count, size_t grain, const Body &body)
+{
+    grain = grain > 0 ? grain : 1;
+
+    Counter counter;
+    for (size_t begin = 0; begin < count; begin += grain)
+    {
+        const size_t end = begin + grain < count ? begin + grain : count;
+        run ([&body, begin, end] { body (begin, end); }, &counter);
+    }
+    wait (counter);
+}
+
+#endif // !JOB_SYSTEM_INCLUDED
@@ -0,0 +1,415 @@
+#include "MappedFile.h"
+
+#include <vector>
+#include <utility>
+#include <cassert>
+#include <algorithm>
+
+#ifdef _WIN32
+#ifndef NOMINMAX
+#define NOMINMAX
+#endif
+#include <windows.h>
+#include <sys/types.h>
+#include <sys/stat.h>
+#else
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#endif
+
+static bool   getFileStamp (const std::string &path, int64_t &modified, uint64_t &size);
+static size_t pageSize();
+
+
+MappedFile::MappedFile()
+    : m_data (nullptr), m_size (0), m_isOpen (false), m_access (Access::ReadOnly)
+#ifdef _WIN32
+    , m_file (nullptr), m_mapping (nullptr)
+#endif
+{
+}
+
+MappedFile::MappedFile (const std::string &path, Access access, size_t copyBelow)
+    : MappedFile()
+{
+    open (path, access, copyBelow);
+}
+
+MappedFile::~MappedFile()
+{
+    close();
+}
+
+MappedFile::MappedFile (MappedFile &&other) noexcept
+    : MappedFile()
+{
+    *this = std::move (other);
+}
+
+MappedFile &MappedFile::operator = (MappedFile &&other) noexcept
+{
+    if (this == &other)
+        return *this;
+
+    close();
+
+    m_path   = std::move (other.m_path);
+    m_data   = std::exchange (other.m_data,   nullptr);
+    m_size   = std::exchange (other.m_size,   0);
+    m_isOpen = std::exchange (other.m_isOpen, false);
+    m_access = std::exchange (other.m_access, Access::ReadOnly);
+    m_buffer = std::move (other.m_buffer);
+#ifdef _WIN32
+    m_file    = std::exchange (other.m_file,    nullptr);
+    m_mapping = std::exchange (other.m_mapping, nullptr);
+#endif
+    return *this;
+}
+
+#ifdef _WIN32
+
+bool MappedFile::open (const std::string &path, Access access, size_t copyBelow)
+{
+    close();
+
+    const bool isWritable = access == Access::CopyOnWrite;
+
+    HANDLE file = CreateFileA (path.c_str(), GENERIC_READ, FILE_SHARE_READ | FILE_SHARE_DELETE, nullptr,
+                               OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL | FILE_FLAG_SEQUENTIAL_SCAN, nullptr);
+    if (file == INVALID_HANDLE_VALUE)
+        return false;
+
+    LARGE_INTEGER size = {};
+    if (!GetFileSizeEx (file, &size))
+    {
+        CloseHandle (file);
+        return false;
+    }
+
+    m_path   = path;
+    m_size   = static_cast <size_t> (size.QuadPart);
+    m_isOpen = true;
+    m_access = access;
+    m_file   = file;
+
+    // Empty files can't be mapped, they get an empty view instead
+    if (m_size == 0)
+    {
+        m_buffer.reset (new char [1]());
+        m_data = m_buffer.get();
+        return true;
+    }
+
+    // The zero filled tail of the last page terminates a writable view,
+    // a file that ends on a page boundary has no tail and is copied
+    if (m_size < copyBelow || (isWritable && m_size % pageSize() == 0))
+    {
+        m_buffer.reset (new char [m_size + 1]);
+        m_buffer[m_size] = '\0';
+
+        DWORD read = 0;
+        if (!ReadFile (file, m_buffer.get(), static_cast <DWORD> (m_size), &read, nullptr) || read != m_size)
+        {
+            close();
+            return false;
+        }
+
+        m_data = m_buffer.get();
+        CloseHandle (m_file);
+        m_file = nullptr;
+        return true;
+    }
+
+    m_mapping = CreateFileMappingA (file, nullptr, isWritable ? PAGE_WRITECOPY : PAGE_READONLY, 0, 0, nullptr);
+    if (m_mapping)
+        m_data = static_cast <const char *> (MapViewOfFile (m_mapping, isWritable ? FILE_MAP_COPY : FILE_MAP_READ,
+                                                            0, 0, 0));
+
+    if (!m_data)
+    {
+        close();
+        return false;
+    }
+    return true;
+}
+
+void MappedFile::close()
+{
+    if (m_data && m_size > 0 && !m_buffer)
+        UnmapViewOfFile (m_data);
+    if (m_mapping)
+        CloseHandle (m_mapping);
+    if (m_file)
+        CloseHandle (m_file);
+
+    m_path.clear();
+    m_data    = nullptr;
+    m_size    = 0;
+    m_isOpen  = false;
+    m_access  = Access::ReadOnly;
+    m_file    = nullptr;
+    m_mapping = nullptr;
+    m_buffer.reset();
+}
+
+#else
+
+bool MappedFile::open (const std::string &path, Access access, size_t copyBelow)
+{
+    close();
+
+    const bool isWritable = access == Access::CopyOnWrite;
+
+    int fd = ::open (path.c_str(), O_RDONLY | O_CLOEXEC);
+    if (fd < 0)
+        return false;
+
+    struct stat info = {};
+    if (fstat (fd, &info) != 0 || !S_ISREG (info.st_mode))
+    {
+        ::close (fd);
+        return false;
+    }
+
+    m_path   = path;
+    m_size   = static_cast <size_t> (info.st_size);
+    m_isOpen = true;
+    m_access = access;
+
+    // Empty files can't be mapped, they get an empty view instead
+    if (m_size == 0)
+    {
+        ::close (fd);
+        m_buffer.reset (new char [1]());
+        m_data = m_buffer.get();
+        return true;
+    }
+
+    // The zero filled tail of the last page terminates a writable view,
+    // a file that ends on a page boundary has no tail and is copied
+    if (m_size < copyBelow || (isWritable && m_size % pageSize() == 0))
+    {
+        m_buffer.reset (new char [m_size + 1]);
+        m_buffer[m_size] = '\0';
+
+        size_t total = 0;
+        while (total < m_size)
+        {
+            const ssize_t read = ::read (fd, m_buffer.get() + total, m_size - total);
+            if (read <= 0)
+                break;
+            total += static_cast <size_t> (read);
+        }
+        ::close (fd);
+
+        if (total != m_size)
+        {
+            close();
+            return false;
+        }
+
+        m_data = m_buffer.get();
+        return true;
+    }
+
+    void *data = mmap (nullptr, m_size, isWritable ? PROT_READ | PROT_WRITE : PROT_READ, MAP_PRIVATE, fd, 0);
+    ::close (fd);   // the mapping keeps its own reference to the file
+
+    if (data == MAP_FAILED)
+    {
+        m_path.clear();
+        m_size   = 0;
+        m_isOpen = false;
+        m_access = Access::ReadOnly;
+        return false;
+    }
+
+    madvise (data, m_size, MADV_WILLNEED);
+    m_data = static_cast <const char *> (data);
+    return true;
+}
+
+void MappedFile::close()
+{
+    if (m_data && m_size > 0 && !m_buffer)
+        munmap (const_cast <char *> (m_data), m_size);
+
+    m_path.clear();
+    m_data   = nullptr;
+    m_size   = 0;
+    m_isOpen = false;
+    m_access = Access::ReadOnly;
+    m_buffer.reset();
+}
+
+#endif
+
+void MappedFile::releasePages (size_t offset, size_t length)
+{
+    if (!m_data || m_buffer || offset >= m_size)
+        return;
+
+    // Only whole pages inside the range
+    const size_t page  = pageSize();
+    const size_t begin = (offset + page - 1) / page * page;
+    const size_t end   = std::min (offset + length, m_size) / page * page;
+    if (begin >= end)
+        return;
+
+    char *pages = const_cast <char *> (m_data) + begin;
+#ifdef _WIN32
+    // Unlocking pages that aren't locked takes them out of the working set
+    VirtualUnlock (pages, end - begin);
+#else
+    madvise (pages, end - begin, MADV_DONTNEED);
+#endif
+}
+
+bool MappedFile::isOpen() const
+{
+    return m_isOpen;
+}
+
+char *MappedFile::mutableData()
+{
+    assert (m_access == Access::CopyOnWrite);
+    return const_cast <char *> (m_data);
+}
+
+const char *MappedFile::data() const
+{
+    return m_data;
+}
+
+size_t MappedFile::size() const
+{
+    return m_size;
+}
+
+std::string_view MappedFile::view() const
+{
+    return std::string_view (m_data ? m_data : "", m_size);
+}
+
+const std::string &MappedFile::path() const
+{
+    return m_path;
+}
+
+MappedFileCache::MappedFileCache (size_t capacity)
+    : m_capacity (capacity), m_useCounter (0)
+{
+}
+
+std::shared_ptr <const MappedFile> MappedFileCache::open (const std::string &path)
+{
+    int64_t  modified = 0;
+    uint64_t size     = 0;
+    if (!getFileStamp (path, modified, size))
+        return nullptr;
+
+    {
+        std::lock_guard <std::mutex> lock (m_mutex);
+        auto it = m_entries.find (path);
+        if (it != m_entries.end() && it->second.modified == modified && it->second.size == size)
+        {
+            it->second.lastUse = ++m_useCounter;
+            return it->second.file;
+        }
+    }
+
+    // Mapping happens outside of the lock, a racing open of the same path just maps it twice
+    auto file = std::make_shared <MappedFile> (path);
+    if (!file->isOpen())
+        return nullptr;
+
+    std::lock_guard <std::mutex> lock (m_mutex);
+    m_entries[path] = { file, modified, size, ++m_useCounter };
+    trim();
+
+    return file;
+}
+
+void MappedFileCache::evict (const std::string &path)
+{
+    std::lock_guard <std::mutex> lock (m_mutex);
+    m_entries.erase (path);
+}
+
+void MappedFileCache::clear()
+{
+    std::lock_guard <std::mutex> lock (m_mutex);
+    m_entries.clear();
+}
+
+size_t MappedFileCache::size() const
+{
+    std::lock_guard <std::mutex> lock (m_mutex);
+    return m_entries.size();
+}
+
+MappedFileCache &MappedFileCache::global()
+{
+    static MappedFileCache cache;
+    return cache;
+}
+
+// Drops the least recently used mappings nobody outside the cache holds,
+// down to three quarters of the capacity so trimming isn't paid on every open
+void MappedFileCache::trim()
+{
+    if (m_entries.size() <= m_capacity)
+        return;
+
+    std::vector <std::pair <uint64_t, const std::string *>> unused;
+    for (const auto &entry : m_entries)
+    {
+        if (entry.second.file.use_count() == 1)
+            unused.emplace_back (entry.second.lastUse, &entry.first);
+    }
+    std::sort (unused.begin(), unused.end());
+
+    const size_t excess = m_entries.size() - m_capacity * 3 / 4;
+    std::vector <std::string> victims;
+    for (size_t i = 0; i < unused.size() && i < excess; ++i)
+        victims.push_back (*unused[i].second);
+
+    for (const auto &path : victims)
+        m_entries.erase (path);
+}
+
+static bool getFileStamp (const std::string &path, int64_t &modified, uint64_t &size)
+{
+#ifdef _WIN32
+    struct _stat64 info = {};
+    if (_stat64 (path.c_str(), &info) != 0)
+        return false;
+
+    modified = static_cast <int64_t> (info.st_mtime);
+#else
+    struct stat info = {};
+    if (stat (path.c_str(), &info) != 0)
+        return false;
+
+#ifdef __APPLE__
+    modified = static_cast <int64_t> (info.st_mtimespec.tv_sec) * 1000000000 + info.st_mtimespec.tv_nsec;
+#else
+    modified = static_cast <int64_t> (info.st_mtim.tv_sec) * 1000000000 + info.st_mtim.tv_nsec;
+#endif
+#endif
+    size = static_cast <uint64_t> (info.st_size);
+    return true;
+}
+
+static size_t pageSize()
+{
+#ifdef _WIN32
+    SYSTEM_INFO info = {};
+    GetSystemInfo (&info);
+    return static_cast <size_t> (info.dwPageSize);
+#else
+    return static_cast <size_t> (sysconf (_SC_PAGESIZE));
+#endif
+}
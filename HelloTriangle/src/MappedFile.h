@@ -0,0 +1,101 @@
+#ifndef MAPPED_FILE_INCLUDED
+#define MAPPED_FILE_INCLUDED
+
+#include <string>
+#include <string_view>
+#include <memory>
+#include <mutex>
+#include <cstdint>
+#include <unordered_map>
+
+// Read-only view of a whole file through mmap / MapViewOfFile.
+// The contents are not null terminated, use size() or view().
+// Files below copyBelow, SMALL_FILE_SIZE unless given, are read into memory
+// instead: for them setting up and tearing down a mapping costs more than
+// the copy. A copyBelow of 0 maps every file that isn't empty.
+// CopyOnWrite views are private and writable, and are always followed
+// by a zero byte, which is what in-situ parsers need
+class MappedFile
+{
+public:
+    static const size_t SMALL_FILE_SIZE = 16 * 1024;
+
+    enum class Access
+    {
+        ReadOnly,
+        CopyOnWrite
+    };
+
+    MappedFile();
+    explicit MappedFile (const std::string &path, Access access = Access::ReadOnly,
+                         size_t copyBelow = SMALL_FILE_SIZE);
+   ~MappedFile();
+
+    MappedFile             (MappedFile &&other) noexcept;
+    MappedFile &operator = (MappedFile &&other) noexcept;
+
+    bool   open (const std::string &path, Access access = Access::ReadOnly,
+                 size_t copyBelow = SMALL_FILE_SIZE);
+    void   close();
+
+    // Hands the pages back to the OS; they are read again from the file if
+    // touched later, so writes to them are lost. No-op for in-memory files
+    void   releasePages (size_t offset, size_t length);
+
+    bool   isOpen() const;
+    char            *mutableData();   // CopyOnWrite only
+    const char      *data() const;
+    size_t           size() const;
+    std::string_view view() const;
+    const std::string &path() const;
+
+private:
+    std::string m_path;
+    const char *m_data;
+    size_t      m_size;
+    bool        m_isOpen;
+    Access      m_access;
+    std::unique_ptr <char []> m_buffer;   // owns m_data for small files
+#ifdef _WIN32
+    void       *m_file;
+    void       *m_mapping;
+#endif
+
+    MappedFile             (const MappedFile &other) = delete;
+    MappedFile &operator = (const MappedFile &other) = delete;
+};
+
+// Keeps recently used mappings open; a mapping is reused for as long as the
+// file keeps its size and modification time
+class MappedFileCache
+{
+public:
+    explicit MappedFileCache (size_t capacity = 256);
+
+    // Returns null if the file can't be opened
+    std::shared_ptr <const MappedFile> open (const std::string &path);
+
+    void   evict (const std::string &path);
+    void   clear();
+    size_t size() const;
+
+    static MappedFileCache &global();
+
+private:
+    struct Entry
+    {
+        std::shared_ptr <const MappedFile> file;
+        int64_t                            modified;
+        uint64_t                           size;
+        uint64_t                           lastUse;
+    };
+
+    size_t                                   m_capacity;
+    uint64_t                                 m_useCounter;
+    mutable std::mutex                       m_mutex;
+    std::unordered_map <std::string, Entry>  m_entries;
+
+    void   trim();
+};
+
+#endif // !MAPPED_FILE_INCLUDED
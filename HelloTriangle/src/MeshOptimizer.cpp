@@ -0,0 +1,364 @@
+#include "MeshOptimizer.h"
+#include "Profiler.h"
+
+#include <cmath>
+#include <cassert>
+#include <cstring>
+#include <numeric>
+#include <algorithm>
+
+// The LRU cache the triangle scores model. Larger than any real FIFO, the
+// order it gives holds up for the smaller ones too
+static const size_t   SCORE_CACHE_SIZE  = 32;
+static const unsigned SCORE_MAX_VALENCE = 32;
+
+// Forsyth's constants: the last triangle's vertices get a flat score so it
+// isn't simply repeated, older positions decay, and vertices with few
+// triangles left get a boost so they're finished off rather than stranded
+struct ScoreTables
+{
+    float cache[SCORE_CACHE_SIZE];
+    float valence[SCORE_MAX_VALENCE + 1];
+
+    ScoreTables()
+    {
+        const float LAST_TRIANGLE_SCORE = 0.75f;
+        const float CACHE_DECAY_POWER   = 1.5f;
+        const float VALENCE_BOOST_SCALE = 2.0f;
+        const float VALENCE_BOOST_POWER = 0.5f;
+
+        for (size_t i = 0; i < SCORE_CACHE_SIZE; ++i)
+            cache[i] = i < 3 ? LAST_TRIANGLE_SCORE :
+                       std::pow (1.0f - float (i - 3) / (SCORE_CACHE_SIZE - 3), CACHE_DECAY_POWER);
+
+        valence[0] = 0.0f;
+        for (unsigned i = 1; i <= SCORE_MAX_VALENCE; ++i)
+            valence[i] = VALENCE_BOOST_SCALE * std::pow (float (i), -VALENCE_BOOST_POWER);
+    }
+};
+
+static const ScoreTables SCORES;
+
+static float    vertexScore (int cachePosition, uint32_t remaining);
+static uint32_t hashVertex  (uint32_t vertex, const MeshStream *streams, size_t streamCount);
+static bool     areEqual    (uint32_t lhs, uint32_t rhs, const MeshStream *streams, size_t streamCount);
+
+
+size_t generateVertexRemap (uint32_t *remap, const uint32_t *indices, size_t indexCount, size_t vertexCount,
+                            const MeshStream *streams, size_t streamCount)
+{
+    PROFILE_SCOPE ("generateVertexRemap");
+    assert (indices || indexCount == vertexCount);
+
+    std::fill (remap, remap + vertexCount, UNUSED_VERTEX);
+
+    // Open addressing over vertex numbers, at most half full
+    size_t tableSize = 16;
+    while (tableSize < vertexCount * 2)
+        tableSize *= 2;
+    std::vector <uint32_t> table (tableSize, UNUSED_VERTEX);
+    const size_t mask = tableSize - 1;
+
+    uint32_t unique = 0;
+    for (size_t i = 0; i < indexCount; ++i)
+    {
+        const uint32_t vertex = indices ? indices[i] : static_cast <uint32_t> (i);
+        assert (vertex < vertexCount);
+        if (remap[vertex] != UNUSED_VERTEX)
+            continue;
+
+        size_t slot = hashVertex (vertex, streams, streamCount) & mask;
+        while (table[slot] != UNUSED_VERTEX && !areEqual (table[slot], vertex, streams, streamCount))
+            slot = (slot + 1) & mask;
+
+        if (table[slot] == UNUSED_VERTEX)
+        {
+            table[slot]   = vertex;
+            remap[vertex] = unique++;
+        }
+        else
+        {
+            remap[vertex] = remap[table[slot]];
+        }
+    }
+    return unique;
+}
+
+void remapIndexBuffer (uint32_t *destination, const uint32_t *indices, size_t indexCount, const uint32_t *remap)
+{
+    for (size_t i = 0; i < indexCount; ++i)
+        destination[i] = remap[indices ? indices[i] : i];
+}
+
+void remapVertexBuffer (void *destination, const void *vertices, size_t vertexCount, size_t stride,
+                        const uint32_t *remap)
+{
+    assert (destination != vertices);
+
+    char       *target = static_cast <char *> (destination);
+    const char *source = static_cast <const char *> (vertices);
+    for (size_t i = 0; i < vertexCount; ++i)
+    {
+        if (remap[i] != UNUSED_VERTEX)
+            memcpy (target + remap[i] * stride, source + i * stride, stride);
+    }
+}
+
+void optimizeVertexCache (uint32_t *destination, const uint32_t *indices, size_t indexCount, size_t vertexCount)
+{
+    PROFILE_SCOPE ("optimizeVertexCache");
+    assert (indices && indexCount % 3 == 0);
+
+    const size_t triangleCount = indexCount / 3;
+    const std::vector <uint32_t> source (indices, indices + indexCount);
+
+    // Triangles using each vertex; the first remaining[v] of its list are
+    // the ones not emitted yet
+    std::vector <uint32_t> remaining (vertexCount, 0);
+    for (uint32_t vertex : source)
+        ++remaining[vertex];
+
+    std::vector <uint32_t> offsets (vertexCount + 1, 0);
+    std::partial_sum (remaining.begin(), remaining.end(), offsets.begin() + 1);
+
+    std::vector <uint32_t> adjacency (indexCount);
+    std::vector <uint32_t> filled (offsets.begin(), offsets.end() - 1);
+    for (size_t i = 0; i < indexCount; ++i)
+        adjacency[filled[source[i]]++] = static_cast <uint32_t> (i / 3);
+
+    std::vector <float> vertexScores (vertexCount);
+    for (size_t v = 0; v < vertexCount; ++v)
+        vertexScores[v] = vertexScore (-1, remaining[v]);
+
+    std::vector <float> triangleScores (triangleCount);
+    std::vector <char>  isEmitted      (triangleCount, 0);
+    for (size_t t = 0; t < triangleCount; ++t)
+        triangleScores[t] = vertexScores[source[3 * t]] + vertexScores[source[3 * t + 1]] + vertexScores[source[3 * t + 2]];
+
+    uint32_t cache[SCORE_CACHE_SIZE + 3];
+    size_t   cacheCount = 0;
+    size_t   cursor     = 0;
+    size_t   best       = std::max_element (triangleScores.begin(), triangleScores.end()) - triangleScores.begin();
+
+    for (size_t emitted = 0; emitted < triangleCount; ++emitted)
+    {
+        // Nothing in the cache has triangles left: start over from the next unused one
+        if (best == triangleCount)
+        {
+            while (isEmitted[cursor])
+                ++cursor;
+            best = cursor;
+        }
+
+        const uint32_t *triangle = &source[3 * best];
+        memcpy (destination + 3 * emitted, triangle, 3 * sizeof (uint32_t));
+        isEmitted[best] = 1;
+
+        for (int k = 0; k < 3; ++k)
+        {
+            const uint32_t vertex = triangle[k];
+            uint32_t      *list   = &adjacency[offsets[vertex]];
+            uint32_t      *last   = list + remaining[vertex] - 1;
+            std::swap (*std::find (list, last + 1, static_cast <uint32_t> (best)), *last);
+            --remaining[vertex];
+        }
+
+        // The triangle's vertices move to the front, the rest shift back
+        // and whatever passes SCORE_CACHE_SIZE drops out
+        uint32_t newCache[SCORE_CACHE_SIZE + 3];
+        size_t   newCount = 0;
+        for (int k = 0; k < 3; ++k)
+        {
+            if (std::find (newCache, newCache + newCount, triangle[k]) == newCache + newCount)
+                newCache[newCount++] = triangle[k];
+        }
+        for (size_t i = 0; i < cacheCount; ++i)
+        {
+            if (std::find (triangle, triangle + 3, cache[i]) == triangle + 3)
+                newCache[newCount++] = cache[i];
+        }
+
+        for (size_t i = 0; i < newCount; ++i)
+        {
+            const uint32_t vertex   = newCache[i];
+            const int      position = i < SCORE_CACHE_SIZE ? static_cast <int> (i) : -1;
+            const float    score    = vertexScore (position, remaining[vertex]);
+            const float    delta    = score - vertexScores[vertex];
+
+            vertexScores[vertex] = score;
+
+            const uint32_t *list = &adjacency[offsets[vertex]];
+            for (uint32_t j = 0; j < remaining[vertex]; ++j)
+                triangleScores[list[j]] += delta;
+        }
+
+        // The next triangle comes from those the cache can help with
+        cacheCount = std::min (newCount, SCORE_CACHE_SIZE);
+        best = triangleCount;
+        float bestScore = -1.0f;
+        for (size_t i = 0; i < cacheCount; ++i)
+        {
+            const uint32_t  vertex = newCache[i];
+            const uint32_t *list   = &adjacency[offsets[vertex]];
+            for (uint32_t j = 0; j < remaining[vertex]; ++j)
+            {
+                if (triangleScores[list[j]] > bestScore)
+                {
+                    bestScore = triangleScores[list[j]];
+                    best      = list[j];
+                }
+            }
+        }
+
+        std::copy (newCache, newCache + cacheCount, cache);
+    }
+}
+
+size_t optimizeVertexFetchRemap (uint32_t *remap, const uint32_t *indices, size_t indexCount, size_t vertexCount)
+{
+    std::fill (remap, remap + vertexCount, UNUSED_VERTEX);
+
+    uint32_t next = 0;
+    for (size_t i = 0; i < indexCount; ++i)
+    {
+        assert (indices[i] < vertexCount);
+        if (remap[indices[i]] == UNUSED_VERTEX)
+            remap[indices[i]] = next++;
+    }
+    return next;
+}
+
+// A vertex is in the FIFO if it went in no more than cacheSize misses ago
+VertexCacheStats analyzeVertexCache (const uint32_t *indices, size_t indexCount, size_t vertexCount,
+                                     unsigned cacheSize)
+{
+    std::vector <uint32_t> insertedAt (vertexCount, 0);
+    uint32_t time   = cacheSize + 1;
+    size_t   used   = 0;
+    size_t   misses = 0;
+
+    for (size_t i = 0; i < indexCount; ++i)
+    {
+        uint32_t &inserted = insertedAt[indices[i]];
+        if (inserted == 0)
+            ++used;
+        if (time - inserted > cacheSize)
+        {
+            inserted = time++;
+            ++misses;
+        }
+    }
+
+    VertexCacheStats stats = { misses, 0.0, 0.0 };
+    if (indexCount >= 3)
+        stats.acmr = double (misses) / (indexCount / 3);
+    if (used > 0)
+        stats.atvr = double (misses) / used;
+    return stats;
+}
+
+MeshOptimizeStats optimizeMesh (uint32_t *destination, const uint32_t *indices, size_t indexCount,
+                                size_t vertexCount, const MeshStream *streams, size_t streamCount)
+{
+    PROFILE_SCOPE ("optimizeMesh");
+    assert (indices || indexCount == vertexCount);
+    assert (indexCount % 3 == 0);
+
+    if (!indices)
+    {
+        std::iota (destination, destination + indexCount, 0u);
+        indices = destination;
+    }
+
+    MeshOptimizeStats stats = {};
+    stats.verticesBefore = vertexCount;
+    stats.before         = analyzeVertexCache (indices, indexCount, vertexCount);
+
+    std::vector <uint32_t> remap (vertexCount);
+    const size_t unique = generateVertexRemap (remap.data(), indices, indexCount, vertexCount, streams, streamCount);
+    remapIndexBuffer (destination, indices, indexCount, remap.data());
+
+    optimizeVertexCache (destination, destination, indexCount, unique);
+
+    std::vector <uint32_t> fetch (unique);
+    optimizeVertexFetchRemap (fetch.data(), destination, indexCount, unique);
+    remapIndexBuffer (destination, destination, indexCount, fetch.data());
+
+    // Welding and fetch order in one pass over each stream
+    for (uint32_t &target : remap)
+    {
+        if (target != UNUSED_VERTEX)
+            target = fetch[target];
+    }
+    std::vector <char> optimized;
+    for (size_t s = 0; s < streamCount; ++s)
+    {
+        optimized.resize (unique * streams[s].stride);
+        remapVertexBuffer (optimized.data(), streams[s].data, vertexCount, streams[s].stride, remap.data());
+        memcpy (const_cast <void *> (streams[s].data), optimized.data(), optimized.size());
+    }
+
+    stats.verticesAfter = unique;
+    stats.after         = analyzeVertexCache (destination, indexCount, unique);
+    return stats;
+}
+
+MeshOptimizeStats optimizeMesh (std::vector <char> &vertices, size_t stride, std::vector <uint32_t> &indices)
+{
+    const size_t vertexCount = vertices.size() / stride;
+    if (indices.empty())
+    {
+        indices.resize (vertexCount);
+        std::iota (indices.begin(), indices.end(), 0u);
+    }
+
+    const MeshStream        stream = { vertices.data(), stride, stride };
+    const MeshOptimizeStats stats  = optimizeMesh (indices.data(), indices.data(), indices.size(), vertexCount,
+                                                   &stream, 1);
+    vertices.resize (stats.verticesAfter * stride);
+    return stats;
+}
+
+static float vertexScore (int cachePosition, uint32_t remaining)
+{
+    if (remaining == 0)
+        return -1.0f;
+
+    const float cacheScore = cachePosition >= 0 ? SCORES.cache[cachePosition] : 0.0f;
+    return cacheScore + SCORES.valence[std::min (remaining, SCORE_MAX_VALENCE)];
+}
+
+// Murmur style mixing a 32 bit word at a time, bytes left over one by one
+static uint32_t hashVertex (uint32_t vertex, const MeshStream *streams, size_t streamCount)
+{
+    const uint32_t MULTIPLIER = 0x5bd1e995;
+
+    uint32_t hash = 0;
+    for (size_t s = 0; s < streamCount; ++s)
+    {
+        const unsigned char *bytes = static_cast <const unsigned char *> (streams[s].data) + vertex * streams[s].stride;
+        size_t i = 0;
+        for (; i + 4 <= streams[s].size; i += 4)
+        {
+            uint32_t word;
+            memcpy (&word, bytes + i, sizeof (word));
+            word *= MULTIPLIER;
+            word ^= word >> 24;
+            hash  = (hash * MULTIPLIER) ^ (word * MULTIPLIER);
+        }
+        for (; i < streams[s].size; ++i)
+            hash = (hash ^ bytes[i]) * MULTIPLIER;
+    }
+    return hash ^ (hash >> 15);
+}
+
+static bool areEqual (uint32_t lhs, uint32_t rhs, const MeshStream *streams, size_t streamCount)
+{
+    for (size_t s = 0; s < streamCount; ++s)
+    {
+        const char *data = static_cast <const char *> (streams[s].data);
+        if (memcmp (data + lhs * streams[s].stride, data + rhs * streams[s].stride, streams[s].size) != 0)
+            return false;
+    }
+    return true;
+}
@@ -0,0 +1,75 @@
+#ifndef MESH_OPTIMIZER_INCLUDED
+#define MESH_OPTIMIZER_INCLUDED
+
+#include <vector>
+#include <cstddef>
+#include <cstdint>
+
+// Triangle list processing, all on the CPU. The usual order is weld, then
+// optimizeVertexCache, then optimizeVertexFetch. Functions taking a null
+// indices pointer treat the mesh as unindexed: vertex i is index i.
+// Destination and source may be the same array for the index functions,
+// never for the vertex ones
+
+// One attribute stream of the vertices, compared byte for byte when welding
+struct MeshStream
+{
+    const void *data;
+    size_t      size;     // bytes compared a vertex
+    size_t      stride;
+};
+
+// Post-transform cache behaviour of a triangle order, simulated as a FIFO
+struct VertexCacheStats
+{
+    size_t transformed;   // cache misses
+    double acmr;          // average cache miss ratio, transformed / triangles, 0.5 at best
+    double atvr;          // average transformed vertex ratio, transformed / vertices, 1.0 at best
+};
+
+const uint32_t UNUSED_VERTEX = ~0u;
+
+// Maps every vertex to the first one with the same bytes in all streams,
+// numbered by first use; vertices no index uses map to UNUSED_VERTEX.
+// Returns the number of unique vertices
+size_t generateVertexRemap (uint32_t *remap, const uint32_t *indices, size_t indexCount, size_t vertexCount,
+                            const MeshStream *streams, size_t streamCount);
+
+void   remapIndexBuffer    (uint32_t *destination, const uint32_t *indices, size_t indexCount, const uint32_t *remap);
+void   remapVertexBuffer   (void *destination, const void *vertices, size_t vertexCount, size_t stride,
+                            const uint32_t *remap);
+
+// Reorders triangles for the post-transform cache with Forsyth's linear
+// speed algorithm: the next triangle is the one whose vertices score best
+// on their LRU cache position and on how few triangles they have left
+void   optimizeVertexCache (uint32_t *destination, const uint32_t *indices, size_t indexCount, size_t vertexCount);
+
+// Numbers vertices in the order the indices first use them, so fetches walk
+// the vertex buffer forwards. Returns the number of vertices used
+size_t optimizeVertexFetchRemap (uint32_t *remap, const uint32_t *indices, size_t indexCount, size_t vertexCount);
+
+VertexCacheStats analyzeVertexCache (const uint32_t *indices, size_t indexCount, size_t vertexCount,
+                                     unsigned cacheSize = 16);
+
+// Everything above, weld, cache order and fetch order, with stats of the
+// mesh before and after
+struct MeshOptimizeStats
+{
+    size_t           verticesBefore;
+    size_t           verticesAfter;
+    VertexCacheStats before;
+    VertexCacheStats after;
+};
+
+// On separate vertex streams, welded on all of them together. Each stream
+// is rewritten in place a whole stride a vertex, so streams must not share
+// their memory, and ends up with verticesAfter vertices. The new indices go
+// to destination, which may be indices
+MeshOptimizeStats optimizeMesh (uint32_t *destination, const uint32_t *indices, size_t indexCount,
+                                size_t vertexCount, const MeshStream *streams, size_t streamCount);
+
+// On one interleaved vertex buffer. An empty index buffer means an
+// unindexed mesh and gets filled in
+MeshOptimizeStats optimizeMesh (std::vector <char> &vertices, size_t stride, std::vector <uint32_t> &indices);
+
+#endif // !MESH_OPTIMIZER_INCLUDED
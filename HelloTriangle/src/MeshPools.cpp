@@ -0,0 +1,127 @@
+#include "MeshPools.h"
+#include "GLStateCache.h"
+
+#include <cassert>
+#include <algorithm>
+
+static GLuint growBuffer (GLuint buffer, GLsizeiptr usedBytes, GLsizeiptr newBytes);
+
+
+const GLuint MeshPools::VERTEX_BINDING;
+
+MeshPools::MeshPools (GLsizeiptr minVertexBytes, GLsizeiptr minIndexCount)
+    : m_minVertexBytes (minVertexBytes), m_minIndexCount (minIndexCount)
+{
+}
+
+MeshPools::~MeshPools()
+{
+    GLStateCache &state = GLStateCache::current();
+    for (Pool &pool : m_pools)
+    {
+        state.forgetVertexArray (pool.vao);
+        state.forgetBuffer (pool.vertexBuffer);
+        state.forgetBuffer (pool.indexBuffer);
+        glDeleteVertexArrays (1, &pool.vao);
+        glDeleteBuffers (1, &pool.vertexBuffer);
+        glDeleteBuffers (1, &pool.indexBuffer);
+    }
+}
+
+bool MeshPools::find (const VertexFormat &format, unsigned &pool) const
+{
+    for (size_t i = 0; i < m_pools.size(); ++i)
+    {
+        if (m_pools[i].format == format)
+        {
+            pool = static_cast <unsigned> (i);
+            return true;
+        }
+    }
+    return false;
+}
+
+unsigned MeshPools::create (const VertexFormat &format)
+{
+    Pool pool = { format, 0, 0, 0, 0, 0, 0, 0 };
+    glCreateVertexArrays (1, &pool.vao);
+    setVertexFormat (pool.vao, format, VERTEX_BINDING);
+
+    m_pools.push_back (pool);
+    return static_cast <unsigned> (m_pools.size() - 1);
+}
+
+MeshPools::Range MeshPools::add (unsigned poolIndex, const void *vertices, size_t vertexCount,
+                                 const GLuint *indices, size_t indexCount)
+{
+    assert (poolIndex < m_pools.size() && vertices && indices && vertexCount > 0 && indexCount > 0);
+    Pool &pool = m_pools[poolIndex];
+
+    const GLsizeiptr vertexOffset = static_cast <GLsizeiptr> (pool.vertexCount) * pool.format.stride;
+    const GLsizeiptr vertexBytes  = static_cast <GLsizeiptr> (vertexCount) * pool.format.stride;
+
+    reserveVertices (pool, vertexOffset + vertexBytes);
+    reserveIndices  (pool, pool.indexCount + indexCount);
+
+    glNamedBufferSubData (pool.vertexBuffer, vertexOffset, vertexBytes, vertices);
+    glNamedBufferSubData (pool.indexBuffer, pool.indexCount * sizeof (GLuint),
+                          indexCount * sizeof (GLuint), indices);
+
+    const Range range = { pool.indexCount, static_cast <GLuint> (indexCount), static_cast <GLint> (pool.vertexCount) };
+
+    pool.vertexCount += static_cast <GLuint> (vertexCount);
+    pool.indexCount  += static_cast <GLuint> (indexCount);
+    return range;
+}
+
+GLuint MeshPools::vertexArray (unsigned pool) const
+{
+    return m_pools[pool].vao;
+}
+
+size_t MeshPools::size() const
+{
+    return m_pools.size();
+}
+
+void MeshPools::reserveVertices (Pool &pool, GLsizeiptr bytes)
+{
+    if (bytes <= pool.vertexCapacity)
+        return;
+
+    const GLsizeiptr capacity = std::max ({ bytes, pool.vertexCapacity * 2, m_minVertexBytes });
+    const GLsizeiptr used     = static_cast <GLsizeiptr> (pool.vertexCount) * pool.format.stride;
+
+    pool.vertexBuffer   = growBuffer (pool.vertexBuffer, used, capacity);
+    pool.vertexCapacity = capacity;
+    glVertexArrayVertexBuffer (pool.vao, VERTEX_BINDING, pool.vertexBuffer, 0, pool.format.stride);
+}
+
+void MeshPools::reserveIndices (Pool &pool, GLsizeiptr count)
+{
+    if (count <= pool.indexCapacity)
+        return;
+
+    const GLsizeiptr capacity = std::max ({ count, pool.indexCapacity * 2, m_minIndexCount });
+
+    pool.indexBuffer   = growBuffer (pool.indexBuffer, pool.indexCount * sizeof (GLuint),
+                                     capacity * sizeof (GLuint));
+    pool.indexCapacity = capacity;
+    glVertexArrayElementBuffer (pool.vao, pool.indexBuffer);
+}
+
+static GLuint growBuffer (GLuint buffer, GLsizeiptr usedBytes, GLsizeiptr newBytes)
+{
+    GLuint grown = 0;
+    glCreateBuffers (1, &grown);
+    glNamedBufferStorage (grown, newBytes, nullptr, GL_DYNAMIC_STORAGE_BIT);
+
+    if (buffer)
+    {
+        if (usedBytes > 0)
+            glCopyNamedBufferSubData (buffer, grown, 0, 0, usedBytes);
+        GLStateCache::current().forgetBuffer (buffer);
+        glDeleteBuffers (1, &buffer);
+    }
+    return grown;
+}
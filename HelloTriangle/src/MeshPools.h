@@ -0,0 +1,66 @@
+#ifndef MESH_POOLS_INCLUDED
+#define MESH_POOLS_INCLUDED
+
+#include <vector>
+#include <cstddef>
+#include <glad/glad.h>
+
+#include "VertexLayout.h"
+
+// Shared vertex and index buffers for the renderers, one pair and one VAO
+// per vertex format. Meshes are appended and never removed; a full buffer
+// is replaced by one at least twice its size and the contents copied over
+// on the GPU. The VAO reads the vertices at VERTEX_BINDING and has the
+// index buffer bound, the renderer adds its own attributes at the other
+// bindings when it creates a pool
+class MeshPools
+{
+public:
+    static const GLuint VERTEX_BINDING = 0;
+
+    // Where a mesh landed in its pool
+    struct Range
+    {
+        GLuint firstIndex;
+        GLuint indexCount;
+        GLint  baseVertex;
+    };
+
+    // The buffers start at these sizes, the index one counted in indices
+    MeshPools (GLsizeiptr minVertexBytes, GLsizeiptr minIndexCount);
+   ~MeshPools();
+
+    // False if no pool has format yet
+    bool     find   (const VertexFormat &format, unsigned &pool) const;
+    unsigned create (const VertexFormat &format);
+
+    Range    add    (unsigned pool, const void *vertices, size_t vertexCount, const GLuint *indices, size_t indexCount);
+
+    GLuint   vertexArray (unsigned pool) const;
+    size_t   size() const;
+
+private:
+    struct Pool
+    {
+        VertexFormat format;
+        GLuint       vao;
+        GLuint       vertexBuffer;
+        GLuint       indexBuffer;
+        GLsizeiptr   vertexCapacity;   // in bytes
+        GLsizeiptr   indexCapacity;    // in indices
+        GLuint       vertexCount;
+        GLuint       indexCount;
+    };
+
+    std::vector <Pool> m_pools;
+    GLsizeiptr         m_minVertexBytes;
+    GLsizeiptr         m_minIndexCount;
+
+    void     reserveVertices (Pool &pool, GLsizeiptr bytes);
+    void     reserveIndices  (Pool &pool, GLsizeiptr count);
+
+    MeshPools             (const MeshPools &other) = delete;
+    MeshPools &operator = (const MeshPools &other) = delete;
+};
+
+#endif // !MESH_POOLS_INCLUDED
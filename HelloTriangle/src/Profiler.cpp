@@ -0,0 +1,233 @@
+#include "Profiler.h"
+
+#ifdef PROFILE_ENABLED
+
+#include <chrono>
+#include <cstdio>
+
+#include <rapidjson/writer.h>
+#include <rapidjson/stringbuffer.h>
+
+#include "GpuTimer.h"
+
+static int64_t steadyNanoseconds();
+
+
+Profiler &Profiler::instance()
+{
+    static Profiler profiler;
+    return profiler;
+}
+
+Profiler::Profiler()
+    : m_epoch (steadyNanoseconds()), m_droppedEvents (0), m_gpuOffset (0)
+{
+}
+
+// The GL context is usually gone by now, the queries are left to it
+Profiler::~Profiler()
+{
+    m_gpuTimer.release();
+}
+
+int64_t Profiler::now() const
+{
+    return steadyNanoseconds() - m_epoch;
+}
+
+// Single producer: only this thread moves head, only endFrame() moves tail
+void Profiler::record (const char *name, int64_t start, int64_t end)
+{
+    ThreadRing &ring = threadRing();
+
+    const size_t head = ring.head.load (std::memory_order_relaxed);
+    if (head - ring.tail.load (std::memory_order_acquire) >= RING_CAPACITY)
+    {
+        ring.dropped.fetch_add (1, std::memory_order_relaxed);
+        return;
+    }
+
+    ring.zones[head % RING_CAPACITY] = { name, start, end };
+    ring.head.store (head + 1, std::memory_order_release);
+}
+
+void Profiler::setThreadName (const char *name)
+{
+    threadRing().name.store (name, std::memory_order_release);
+}
+
+int Profiler::beginGpuZone (const char *name)
+{
+    if (!m_gpuTimer)
+    {
+        m_gpuTimer.reset (new GpuTimer (512));
+        m_gpuOffset = now() - static_cast <int64_t> (GpuTimer::timestamp());
+    }
+    return m_gpuTimer->begin (reinterpret_cast <uintptr_t> (name));
+}
+
+void Profiler::endGpuZone (int slot)
+{
+    if (m_gpuTimer)
+        m_gpuTimer->end (slot);
+}
+
+void Profiler::endFrame()
+{
+    PROFILE_SCOPE ("Profiler::endFrame");
+
+    drainRings();
+    collectGpuZones (false);
+}
+
+bool Profiler::writeChromeTrace (const std::string &path)
+{
+    collectGpuZones (true);
+    m_gpuTimer.reset();
+    drainRings();
+
+    rapidjson::StringBuffer buffer;
+    rapidjson::Writer <rapidjson::StringBuffer> writer (buffer);
+    {
+        std::lock_guard <std::mutex> lock (m_mutex);
+
+        writer.StartObject();
+        writer.Key ("displayTimeUnit");
+        writer.String ("ms");
+        writer.Key ("traceEvents");
+        writer.StartArray();
+
+        auto writeThreadName = [&writer] (uint32_t thread, const char *name)
+        {
+            writer.StartObject();
+            writer.Key ("name"); writer.String ("thread_name");
+            writer.Key ("ph");   writer.String ("M");
+            writer.Key ("pid");  writer.Uint (1);
+            writer.Key ("tid");  writer.Uint (thread);
+            writer.Key ("args");
+            writer.StartObject();
+            writer.Key ("name"); writer.String (name);
+            writer.EndObject();
+            writer.EndObject();
+        };
+
+        writeThreadName (GPU_THREAD, "GPU");
+        for (const auto &ring : m_rings)
+        {
+            const char *name = ring->name.load (std::memory_order_acquire);
+            const std::string fallback = "Thread " + std::to_string (ring->id);
+            writeThreadName (ring->id, name ? name : fallback.c_str());
+        }
+
+        // Complete events, Chrome nests them by their time ranges
+        for (const Event &event : m_events)
+        {
+            writer.StartObject();
+            writer.Key ("name"); writer.String (event.zone.name);
+            writer.Key ("cat");  writer.String (event.thread == GPU_THREAD ? "gpu" : "cpu");
+            writer.Key ("ph");   writer.String ("X");
+            writer.Key ("pid");  writer.Uint (1);
+            writer.Key ("tid");  writer.Uint (event.thread);
+            writer.Key ("ts");   writer.Double (event.zone.start / 1000.0);
+            writer.Key ("dur");  writer.Double ((event.zone.end - event.zone.start) / 1000.0);
+            writer.EndObject();
+        }
+
+        writer.EndArray();
+        writer.EndObject();
+    }
+
+    FILE *file = fopen (path.c_str(), "wb");
+    if (!file)
+        return false;
+
+    const bool isWritten = fwrite (buffer.GetString(), 1, buffer.GetSize(), file) == buffer.GetSize();
+    return fclose (file) == 0 && isWritten;
+}
+
+size_t Profiler::droppedZones() const
+{
+    std::lock_guard <std::mutex> lock (m_mutex);
+
+    size_t dropped = m_droppedEvents;
+    for (const auto &ring : m_rings)
+        dropped += ring->dropped.load (std::memory_order_relaxed);
+    return dropped;
+}
+
+Profiler::ThreadRing &Profiler::threadRing()
+{
+    static thread_local ThreadRing *ring = nullptr;
+    if (ring)
+        return *ring;
+
+    std::unique_ptr <ThreadRing> created (new ThreadRing);
+    created->head    = 0;
+    created->tail    = 0;
+    created->dropped = 0;
+    created->name    = nullptr;
+
+    std::lock_guard <std::mutex> lock (m_mutex);
+    created->id = static_cast <uint32_t> (m_rings.size() + 1);   // 0 is the GPU
+    ring = created.get();
+    m_rings.push_back (std::move (created));
+
+    return *ring;
+}
+
+void Profiler::drainRings()
+{
+    std::lock_guard <std::mutex> lock (m_mutex);
+
+    for (const auto &ring : m_rings)
+    {
+        const size_t tail = ring->tail.load (std::memory_order_relaxed);
+        const size_t head = ring->head.load (std::memory_order_acquire);
+
+        for (size_t i = tail; i != head; ++i)
+            store (ring->zones[i % RING_CAPACITY], ring->id);
+
+        ring->tail.store (head, std::memory_order_release);
+    }
+}
+
+// GPU timestamps are moved onto the CPU timeline with the offset measured
+// when the first GPU zone was opened
+void Profiler::collectGpuZones (bool wait)
+{
+    if (!m_gpuTimer)
+        return;
+
+    std::vector <GpuTimer::Interval> intervals;
+    if (wait)
+        m_gpuTimer->drain (intervals);
+    else
+        m_gpuTimer->collect (intervals);
+
+    std::lock_guard <std::mutex> lock (m_mutex);
+    for (const GpuTimer::Interval &interval : intervals)
+    {
+        const Zone zone = { reinterpret_cast <const char *> (static_cast <uintptr_t> (interval.tag)),
+                            static_cast <int64_t> (interval.start) + m_gpuOffset,
+                            static_cast <int64_t> (interval.end)   + m_gpuOffset };
+        store (zone, GPU_THREAD);
+    }
+}
+
+void Profiler::store (const Zone &zone, uint32_t thread)
+{
+    if (m_events.size() >= MAX_EVENTS)
+    {
+        ++m_droppedEvents;
+        return;
+    }
+    m_events.push_back ({ zone, thread });
+}
+
+static int64_t steadyNanoseconds()
+{
+    return std::chrono::duration_cast <std::chrono::nanoseconds> (
+        std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+#endif // PROFILE_ENABLED
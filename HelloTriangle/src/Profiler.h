@@ -0,0 +1,142 @@
+#ifndef PROFILER_INCLUDED
+#define PROFILER_INCLUDED
+
+// PROFILE_SCOPE ("name")      times the enclosing scope on the calling thread
+// PROFILE_GPU_SCOPE ("name")  the same plus a GPU timestamp zone, GL thread only
+// PROFILE_THREAD_NAME ("name") labels the calling thread in the trace
+// PROFILE_FRAME()             drains the per-thread rings, call once a frame on the GL thread
+// PROFILE_EXPORT ("path")     writes a Chrome trace_event JSON, open it in chrome://tracing
+//
+// Names must outlive the profiler, string literals are. Everything compiles
+// to nothing unless PROFILE_ENABLED is defined (HELLOTRIANGLE_PROFILE=ON)
+
+#ifdef PROFILE_ENABLED
+
+#include <atomic>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+#include <cstdint>
+#include <cstddef>
+
+class GpuTimer;
+
+class Profiler
+{
+public:
+    struct Zone
+    {
+        const char *name;
+        int64_t     start;   // ns since the profiler was created
+        int64_t     end;
+    };
+
+    static Profiler &instance();
+
+    int64_t now() const;
+
+    void    record        (const char *name, int64_t start, int64_t end);
+    void    setThreadName (const char *name);
+
+    int     beginGpuZone (const char *name);
+    void    endGpuZone   (int slot);
+
+    void    endFrame();
+    // Waits for outstanding GPU zones and releases the queries, needs the GL context
+    bool    writeChromeTrace (const std::string &path);
+
+    size_t  droppedZones() const;
+
+private:
+    static const size_t RING_CAPACITY = 4096;
+    static const size_t MAX_EVENTS    = 1 << 22;
+    static const uint32_t GPU_THREAD  = 0;
+
+    // Written only by its thread, read only under m_mutex by endFrame()
+    struct ThreadRing
+    {
+        std::atomic <size_t>       head;
+        std::atomic <size_t>       tail;
+        std::atomic <size_t>       dropped;
+        std::atomic <const char *> name;
+        uint32_t                   id;
+        Zone                       zones [RING_CAPACITY];
+    };
+
+    struct Event
+    {
+        Zone     zone;
+        uint32_t thread;
+    };
+
+    const int64_t m_epoch;
+    mutable std::mutex                        m_mutex;
+    std::vector <std::unique_ptr <ThreadRing>> m_rings;
+    std::vector <Event>                       m_events;
+    size_t                                    m_droppedEvents;
+
+    std::unique_ptr <GpuTimer>                m_gpuTimer;
+    int64_t                                   m_gpuOffset;
+
+    Profiler();
+   ~Profiler();
+
+    ThreadRing &threadRing();
+    void    drainRings();
+    void    collectGpuZones (bool wait);
+    void    store (const Zone &zone, uint32_t thread);
+};
+
+class ProfileScope
+{
+public:
+    explicit ProfileScope (const char *name)
+        : m_name (name), m_start (Profiler::instance().now()) {}
+
+   ~ProfileScope() { Profiler::instance().record (m_name, m_start, Profiler::instance().now()); }
+
+private:
+    const char *m_name;
+    int64_t     m_start;
+
+    ProfileScope             (const ProfileScope &other) = delete;
+    ProfileScope &operator = (const ProfileScope &other) = delete;
+};
+
+class GpuProfileScope
+{
+public:
+    explicit GpuProfileScope (const char *name)
+        : m_cpu (name), m_slot (Profiler::instance().beginGpuZone (name)) {}
+
+   ~GpuProfileScope() { Profiler::instance().endGpuZone (m_slot); }
+
+private:
+    ProfileScope m_cpu;
+    int          m_slot;
+
+    GpuProfileScope             (const GpuProfileScope &other) = delete;
+    GpuProfileScope &operator = (const GpuProfileScope &other) = delete;
+};
+
+#define PROFILE_CONCAT_IMPL(a, b) a##b
+#define PROFILE_CONCAT(a, b)      PROFILE_CONCAT_IMPL (a, b)
+
+#define PROFILE_SCOPE(name)       ProfileScope    PROFILE_CONCAT (profileScope_, __LINE__) (name)
+#define PROFILE_GPU_SCOPE(name)   GpuProfileScope PROFILE_CONCAT (profileScope_, __LINE__) (name)
+#define PROFILE_THREAD_NAME(name) Profiler::instance().setThreadName (name)
+#define PROFILE_FRAME()           Profiler::instance().endFrame()
+#define PROFILE_EXPORT(path)      Profiler::instance().writeChromeTrace (path)
+
+#else
+
+#define PROFILE_SCOPE(name)       ((void)0)
+#define PROFILE_GPU_SCOPE(name)   ((void)0)
+#define PROFILE_THREAD_NAME(name) ((void)0)
+#define PROFILE_FRAME()           ((void)0)
+#define PROFILE_EXPORT(path)      ((void)0)
+
+#endif // PROFILE_ENABLED
+
+#endif // !PROFILER_INCLUDED
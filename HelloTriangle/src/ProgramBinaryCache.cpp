@@ -0,0 +1,224 @@
+#include "ProgramBinaryCache.h"
+
+#include <cstdio>
+#include <cstring>
+#include <vector>
+#include <chrono>
+#include <filesystem>
+
+using Clock = std::chrono::steady_clock;
+
+static const uint64_t FNV_OFFSET_BASIS = 0xcbf29ce484222325ull;
+static const uint64_t FNV_PRIME        = 0x100000001b3ull;
+
+static const char     CACHE_MAGIC[4] = { 'H', 'T', 'P', 'B' };
+static const uint32_t CACHE_VERSION  = 1;
+
+struct CacheEntryHeader
+{
+    char     magic[4];
+    uint32_t version;
+    uint64_t key;
+    uint32_t binaryFormat;
+    uint32_t binaryLength;
+};
+
+static double secondsSince (Clock::time_point start);
+static const char *glString (GLenum name);
+
+
+ProgramBinaryCache::Key &ProgramBinaryCache::Key::add (const void *data, size_t size)
+{
+    const unsigned char *bytes = static_cast <const unsigned char *> (data);
+    for (size_t i = 0; i < size; ++i)
+    {
+        m_hash ^= bytes[i];
+        m_hash *= FNV_PRIME;
+    }
+    return *this;
+}
+
+ProgramBinaryCache::Key &ProgramBinaryCache::Key::add (std::string_view str)
+{
+    const uint64_t length = str.size();
+    add (&length, sizeof (length));
+    return add (str.data(), str.size());
+}
+
+ProgramBinaryCache::Key &ProgramBinaryCache::Key::add (GLenum value)
+{
+    return add (&value, sizeof (value));
+}
+
+ProgramBinaryCache::ProgramBinaryCache (const std::string &directory)
+    : m_directory (directory), m_driverHash (FNV_OFFSET_BASIS), m_isSupported (false), m_stats()
+{
+    Key driver (FNV_OFFSET_BASIS);
+    driver.add (std::string (glString (GL_VENDOR)))
+          .add (std::string (glString (GL_RENDERER)))
+          .add (std::string (glString (GL_VERSION)));
+    m_driverHash = driver.value();
+
+    GLint formats = 0;
+    glGetIntegerv (GL_NUM_PROGRAM_BINARY_FORMATS, &formats);
+
+    std::error_code error;
+    std::filesystem::create_directories (m_directory, error);
+
+    m_isSupported = formats > 0 && !error;
+}
+
+ProgramBinaryCache::Key ProgramBinaryCache::makeKey() const
+{
+    return Key (m_driverHash);
+}
+
+bool ProgramBinaryCache::isSupported() const
+{
+    return m_isSupported;
+}
+
+bool ProgramBinaryCache::load (GLuint program, const Key &key)
+{
+    if (!m_isSupported)
+    {
+        ++m_stats.misses;
+        return false;
+    }
+
+    Clock::time_point start = Clock::now();
+    const std::string path = entryPath (key);
+
+    FILE *file = fopen (path.c_str(), "rb");
+    if (!file)
+    {
+        ++m_stats.misses;
+        return false;
+    }
+
+    CacheEntryHeader header = {};
+    std::vector <char> binary;
+
+    bool isValid = fread (&header, sizeof (header), 1, file) == 1 &&
+                   memcmp (header.magic, CACHE_MAGIC, sizeof (CACHE_MAGIC)) == 0 &&
+                   header.version == CACHE_VERSION &&
+                   header.key     == key.value() &&
+                   header.binaryLength > 0;
+    if (isValid)
+    {
+        binary.resize (header.binaryLength);
+        isValid = fread (binary.data(), 1, binary.size(), file) == binary.size();
+    }
+    fclose (file);
+
+    if (isValid)
+    {
+        glProgramBinary (program, header.binaryFormat, binary.data(),
+                         static_cast <GLsizei> (binary.size()));
+
+        GLint status = GL_FALSE;
+        glGetProgramiv (program, GL_LINK_STATUS, &status);
+        isValid = status == GL_TRUE;
+    }
+
+    if (!isValid)
+    {
+        remove (path.c_str());
+        ++m_stats.rejected;
+        ++m_stats.misses;
+        return false;
+    }
+
+    ++m_stats.hits;
+    m_stats.loadSeconds += secondsSince (start);
+    return true;
+}
+
+void ProgramBinaryCache::store (GLuint program, const Key &key)
+{
+    if (!m_isSupported)
+        return;
+
+    GLint length = 0;
+    glGetProgramiv (program, GL_PROGRAM_BINARY_LENGTH, &length);
+    if (length <= 0)
+        return;
+
+    CacheEntryHeader header = {};
+    memcpy (header.magic, CACHE_MAGIC, sizeof (CACHE_MAGIC));
+    header.version = CACHE_VERSION;
+    header.key     = key.value();
+
+    std::vector <char> binary (length);
+    GLenum format  = 0;
+    GLsizei actual = 0;
+    glGetProgramBinary (program, length, &actual, &format, binary.data());
+    if (actual <= 0)
+        return;
+
+    header.binaryFormat = format;
+    header.binaryLength = static_cast <uint32_t> (actual);
+
+    // Written under a temporary name so a crash never leaves a torn entry
+    const std::string path    = entryPath (key);
+    const std::string tmpPath = path + ".tmp";
+
+    FILE *file = fopen (tmpPath.c_str(), "wb");
+    if (!file)
+        return;
+
+    bool isWritten = fwrite (&header, sizeof (header), 1, file) == 1 &&
+                     fwrite (binary.data(), 1, header.binaryLength, file) == header.binaryLength;
+    isWritten = fclose (file) == 0 && isWritten;
+
+    std::error_code error;
+    if (isWritten)
+        std::filesystem::rename (tmpPath, path, error);
+    if (!isWritten || error)
+    {
+        remove (tmpPath.c_str());
+        return;
+    }
+
+    ++m_stats.stores;
+}
+
+void ProgramBinaryCache::recordBuildTime (double seconds)
+{
+    m_stats.buildSeconds += seconds;
+}
+
+const ProgramBinaryCache::Stats &ProgramBinaryCache::stats() const
+{
+    return m_stats;
+}
+
+void ProgramBinaryCache::printStats (std::ostream &out) const
+{
+    out << "Program binary cache: "
+        << m_stats.hits     << " hits, "
+        << m_stats.misses   << " misses ("
+        << m_stats.rejected << " rejected), "
+        << m_stats.stores   << " stored; "
+        << m_stats.loadSeconds  * 1000.0 << " ms loading, "
+        << m_stats.buildSeconds * 1000.0 << " ms compiling" << std::endl;
+}
+
+std::string ProgramBinaryCache::entryPath (const Key &key) const
+{
+    char name[32] = {};
+    snprintf (name, sizeof (name), "%016llx.bin", static_cast <unsigned long long> (key.value()));
+
+    return (std::filesystem::path (m_directory) / name).string();
+}
+
+static double secondsSince (Clock::time_point start)
+{
+    return std::chrono::duration <double> (Clock::now() - start).count();
+}
+
+static const char *glString (GLenum name)
+{
+    const GLubyte *str = glGetString (name);
+    return str ? reinterpret_cast <const char *> (str) : "";
+}
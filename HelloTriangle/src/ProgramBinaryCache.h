@@ -0,0 +1,65 @@
+#ifndef PROGRAM_BINARY_CACHE_INCLUDED
+#define PROGRAM_BINARY_CACHE_INCLUDED
+
+#include <string>
+#include <string_view>
+#include <cstdint>
+#include <cstddef>
+#include <ostream>
+#include <glad/glad.h>
+
+class ProgramBinaryCache
+{
+public:
+    struct Stats
+    {
+        size_t hits;
+        size_t misses;
+        size_t rejected;
+        size_t stores;
+        double loadSeconds;
+        double buildSeconds;
+    };
+
+    // FNV-1a, seeded with the driver identity of the cache that created it
+    class Key
+    {
+    public:
+        explicit Key (uint64_t seed)
+            : m_hash (seed) {}
+
+        Key &add (const void *data, size_t size);
+        Key &add (std::string_view str);
+        Key &add (GLenum value);
+
+        uint64_t value() const { return m_hash; }
+
+    private:
+        uint64_t m_hash;
+    };
+
+    // Needs a current GL context: the driver identity is queried here
+    explicit ProgramBinaryCache (const std::string &directory);
+
+    Key    makeKey() const;
+    bool   isSupported() const;
+
+    // Returns true if the program was restored and linked from the cache,
+    // a blob the driver refuses is dropped and counted as rejected
+    bool   load  (GLuint program, const Key &key);
+    void   store (GLuint program, const Key &key);
+    void   recordBuildTime (double seconds);
+
+    const Stats &stats() const;
+    void   printStats (std::ostream &out) const;
+
+private:
+    std::string m_directory;
+    uint64_t    m_driverHash;
+    bool        m_isSupported;
+    Stats       m_stats;
+
+    std::string entryPath (const Key &key) const;
+};
+
+#endif // !PROGRAM_BINARY_CACHE_INCLUDED
@@ -0,0 +1,609 @@
+#include "Scene.h"
+#include "MappedFile.h"
+#include "Profiler.h"
+
+#include <chrono>
+#include <cstring>
+#include <stdexcept>
+#include <string_view>
+#include <unordered_map>
+
+#include <glm/gtc/matrix_transform.hpp>
+
+#include <rapidjson/reader.h>
+#include <rapidjson/error/en.h>
+
+using Clock = std::chrono::steady_clock;
+
+// Every number takes at least a digit and a separator, so the binary data
+// can't outgrow twice the file; names are copied and take at most its size
+static const size_t ARENA_BYTES_PER_FILE_BYTE = 3;
+// Optimizing adds an index a vertex to unindexed meshes, and a vertex takes
+// at least 6 bytes of file
+static const size_t ARENA_BYTES_PER_FILE_BYTE_OPTIMIZED = 4;
+static const size_t ARENA_SLACK               = 64 * 1024;
+
+// Parsed pages are handed back in steps of this, a multiple of any page size
+static const size_t RELEASE_STEP = 4 * 1024 * 1024;
+
+
+// SAX handler filling a Scene. The nesting depth tells where a value is:
+// 1 the root object, 2 a section array, 3 a record, 4 an array in a record
+class SceneReader : public rapidjson::BaseReaderHandler <rapidjson::UTF8 <>, SceneReader>
+{
+public:
+    explicit SceneReader (Scene &scene);
+
+    bool Null()                 { return scalar ("null"); }
+    bool Bool (bool)            { return scalar ("boolean"); }
+    bool Int (int value)        { return number (value); }
+    bool Uint (unsigned value)  { return number (value); }
+    bool Int64 (int64_t value)  { return number (static_cast <double> (value)); }
+    bool Uint64 (uint64_t value){ return number (static_cast <double> (value)); }
+    bool Double (double value)  { return number (value); }
+
+    bool String      (const char *string, rapidjson::SizeType length, bool copy);
+    bool Key         (const char *string, rapidjson::SizeType length, bool copy);
+    bool StartObject();
+    bool EndObject   (rapidjson::SizeType memberCount);
+    bool StartArray();
+    bool EndArray    (rapidjson::SizeType elementCount);
+
+    // Resolves the references by name, throws on unknown ones
+    void resolve();
+
+    const std::string &error() const { return m_error; }
+
+private:
+    enum class Section { None, Programs, Materials, Meshes, Nodes, Unknown };
+    // Everything from Color on is an array
+    enum class Field
+    {
+        None, Unknown, Name, Vertex, Fragment, Program, Mesh, Material,
+        Color, Translation, Rotation, Scale, Positions, Colors, Indices
+    };
+
+    Scene      &m_scene;
+    Arena      &m_arena;
+    std::string m_error;
+
+    int         m_depth;
+    int         m_skipDepth;   // depth of the container being skipped, 0 if none
+    Section     m_section;
+    Field       m_field;
+
+    // The record being read
+    SceneProgram  m_program;
+    SceneMaterial m_material;
+    SceneMesh     m_mesh;
+    SceneNode     m_node;
+    uint32_t      m_colorCount;
+    const char   *m_references[2];
+
+    // The array being read
+    float        m_fixed[4];
+    void        *m_array;
+    size_t       m_arrayCount;
+
+    std::vector <const char *> m_materialPrograms;
+    std::vector <const char *> m_nodeMeshes;
+    std::vector <const char *> m_nodeMaterials;
+
+    bool   scalar (const char *type);
+    bool   number (double value);
+    bool   isIgnored (int depth) const;
+    bool   fail (const std::string &message);
+
+    void   beginRecord();
+    bool   endRecord();
+    void   beginArray();
+    bool   endArray();
+};
+
+static Scene::Stats makeStats (size_t fileBytes, size_t arenaBytes, const MeshOptimizeStats &meshes,
+                               Clock::time_point start);
+
+
+Scene::Scene (size_t arenaBytes)
+    : m_arena (arenaBytes), m_stats()
+{
+}
+
+Scene Scene::load (const std::string &path, Meshes meshes)
+{
+    PROFILE_SCOPE ("Scene::load");
+    Clock::time_point start = Clock::now();
+
+    MappedFile file (path, MappedFile::Access::CopyOnWrite);
+    if (!file.isOpen())
+        throw std::runtime_error ("Can't open the scene " + path);
+
+    const size_t arenaFactor = meshes == Meshes::Optimized ? ARENA_BYTES_PER_FILE_BYTE_OPTIMIZED :
+                                                             ARENA_BYTES_PER_FILE_BYTE;
+    Scene        scene (file.size() * arenaFactor + ARENA_SLACK);
+    SceneReader handler (scene);
+
+    rapidjson::Reader             reader;
+    rapidjson::InsituStringStream stream (file.mutableData());
+
+    // Token by token, so the pages behind the reader can go back to the OS.
+    // Everything kept from them has been copied into the arena by then
+    size_t released = 0;
+    reader.IterativeParseInit();
+    while (!reader.IterativeParseComplete())
+    {
+        // An error leaves the reader short of complete, it has to be caught here
+        if (!reader.IterativeParseNext <rapidjson::kParseInsituFlag> (stream, handler))
+            break;
+
+        const size_t parsed = stream.Tell() / RELEASE_STEP * RELEASE_STEP;
+        if (parsed > released)
+        {
+            file.releasePages (released, parsed - released);
+            released = parsed;
+        }
+    }
+
+    if (reader.HasParseError())
+    {
+        const std::string message = handler.error().empty() ?
+                                    rapidjson::GetParseError_En (reader.GetParseErrorCode()) : handler.error();
+        throw std::runtime_error (path + ":" + std::to_string (reader.GetErrorOffset()) + ": " + message);
+    }
+
+    try
+    {
+        handler.resolve();
+    }
+    catch (const std::runtime_error &e)
+    {
+        throw std::runtime_error (path + ": " + e.what());
+    }
+
+    MeshOptimizeStats optimized = {};
+    if (meshes == Meshes::Optimized)
+        optimized = scene.optimizeMeshes();
+
+    scene.m_stats = makeStats (file.size(), scene.m_arena.used(), optimized, start);
+    return scene;
+}
+
+// Vertices are welded on position and color together. The compacted arrays
+// are written back over the originals, which they never outgrow; only
+// unindexed meshes need new room, for their indices. The cache ratios are
+// over the triangles and vertices of every mesh
+MeshOptimizeStats Scene::optimizeMeshes()
+{
+    PROFILE_SCOPE ("Scene::optimizeMeshes");
+
+    MeshOptimizeStats total     = {};
+    size_t            triangles = 0;
+    for (SceneMesh &mesh : m_meshes)
+    {
+        const size_t indexCount = mesh.indices ? mesh.indexCount : mesh.vertexCount;
+        if (indexCount % 3 != 0)
+            continue;
+
+        const MeshStream streams[] =
+        {
+            { mesh.positions, 3 * sizeof (float), 3 * sizeof (float) },
+            { mesh.colors,    3 * sizeof (float), 3 * sizeof (float) }
+        };
+        uint32_t *target = mesh.indices ? const_cast <uint32_t *> (mesh.indices) : m_arena.allocate <uint32_t> (indexCount);
+        const MeshOptimizeStats stats = optimizeMesh (target, mesh.indices, indexCount, mesh.vertexCount,
+                                                      streams, mesh.colors ? 2 : 1);
+
+        mesh.vertexCount = static_cast <uint32_t> (stats.verticesAfter);
+        mesh.indices     = target;
+        mesh.indexCount  = static_cast <uint32_t> (indexCount);
+
+        total.verticesBefore     += stats.verticesBefore;
+        total.verticesAfter      += stats.verticesAfter;
+        total.before.transformed += stats.before.transformed;
+        total.after.transformed  += stats.after.transformed;
+        triangles                += indexCount / 3;
+    }
+
+    if (triangles > 0)
+    {
+        total.before.acmr = double (total.before.transformed) / triangles;
+        total.after.acmr  = double (total.after.transformed)  / triangles;
+    }
+    if (total.verticesAfter > 0)
+    {
+        total.before.atvr = double (total.before.transformed) / total.verticesBefore;
+        total.after.atvr  = double (total.after.transformed)  / total.verticesAfter;
+    }
+    return total;
+}
+
+const std::vector <SceneProgram> &Scene::programs() const
+{
+    return m_programs;
+}
+
+const std::vector <SceneMaterial> &Scene::materials() const
+{
+    return m_materials;
+}
+
+const std::vector <SceneMesh> &Scene::meshes() const
+{
+    return m_meshes;
+}
+
+const std::vector <SceneNode> &Scene::nodes() const
+{
+    return m_nodes;
+}
+
+const Scene::Stats &Scene::stats() const
+{
+    return m_stats;
+}
+
+glm::mat4 SceneNode::transform() const
+{
+    return glm::scale (glm::translate (glm::mat4 (1.0f), translation) * glm::mat4_cast (rotation), scale);
+}
+
+SceneReader::SceneReader (Scene &scene)
+    : m_scene (scene), m_arena (scene.m_arena), m_depth (0), m_skipDepth (0),
+      m_section (Section::None), m_field (Field::None), m_program(), m_material(), m_mesh(), m_node(),
+      m_colorCount (0), m_references(), m_fixed(), m_array (nullptr), m_arrayCount (0)
+{
+}
+
+bool SceneReader::String (const char *string, rapidjson::SizeType length, bool)
+{
+    if (m_skipDepth || isIgnored (m_depth + 1))
+        return true;
+    if (m_depth != 3)
+        return fail ("unexpected string");
+
+    // The in-situ string lives in a page that is about to be released
+    const char *copy = m_arena.copyString (string, length);
+    switch (m_field)
+    {
+    case Field::Name:
+        m_program.name = m_material.name = m_mesh.name = copy;
+        return true;
+    case Field::Vertex:   m_program.vertex   = copy; return true;
+    case Field::Fragment: m_program.fragment = copy; return true;
+    case Field::Program:
+    case Field::Mesh:     m_references[0] = copy; return true;
+    case Field::Material: m_references[1] = copy; return true;
+    default:
+        return fail ("unexpected string");
+    }
+}
+
+bool SceneReader::Key (const char *string, rapidjson::SizeType length, bool)
+{
+    if (m_skipDepth)
+        return true;
+
+    const std::string_view key (string, length);
+    if (m_depth == 1)
+    {
+        m_section = key == "programs"  ? Section::Programs  :
+                    key == "materials" ? Section::Materials :
+                    key == "meshes"    ? Section::Meshes    :
+                    key == "nodes"     ? Section::Nodes     : Section::Unknown;
+        return true;
+    }
+
+    struct KeyField
+    {
+        Section          section;
+        std::string_view key;
+        Field            field;
+    };
+
+    static const KeyField FIELDS[] =
+    {
+        { Section::Programs,  "name",        Field::Name        },
+        { Section::Programs,  "vertex",      Field::Vertex      },
+        { Section::Programs,  "fragment",    Field::Fragment    },
+        { Section::Materials, "name",        Field::Name        },
+        { Section::Materials, "program",     Field::Program     },
+        { Section::Materials, "color",       Field::Color       },
+        { Section::Meshes,    "name",        Field::Name        },
+        { Section::Meshes,    "positions",   Field::Positions   },
+        { Section::Meshes,    "colors",      Field::Colors      },
+        { Section::Meshes,    "indices",     Field::Indices     },
+        { Section::Nodes,     "mesh",        Field::Mesh        },
+        { Section::Nodes,     "material",    Field::Material    },
+        { Section::Nodes,     "translation", Field::Translation },
+        { Section::Nodes,     "rotation",    Field::Rotation    },
+        { Section::Nodes,     "scale",       Field::Scale       }
+    };
+
+    m_field = Field::Unknown;
+    for (const KeyField &field : FIELDS)
+    {
+        if (field.section == m_section && field.key == key)
+            m_field = field.field;
+    }
+    return true;
+}
+
+bool SceneReader::StartObject()
+{
+    ++m_depth;
+    if (m_skipDepth)
+        return true;
+
+    if (m_depth == 1)
+        return true;
+    if (m_depth == 3 && m_section != Section::Unknown)
+    {
+        beginRecord();
+        return true;
+    }
+    if (isIgnored (m_depth))
+    {
+        m_skipDepth = m_depth;
+        return true;
+    }
+    return fail ("unexpected object");
+}
+
+bool SceneReader::EndObject (rapidjson::SizeType)
+{
+    const int depth = m_depth--;
+    if (m_skipDepth)
+    {
+        if (depth == m_skipDepth)
+            m_skipDepth = 0;
+        return true;
+    }
+    return depth == 3 ? endRecord() : true;
+}
+
+bool SceneReader::StartArray()
+{
+    ++m_depth;
+    if (m_skipDepth)
+        return true;
+
+    if (m_depth == 2 && m_section != Section::Unknown)
+        return true;
+    if (m_depth == 4 && m_field >= Field::Color)
+    {
+        beginArray();
+        return true;
+    }
+    if (isIgnored (m_depth))
+    {
+        m_skipDepth = m_depth;
+        return true;
+    }
+    return fail ("unexpected array");
+}
+
+bool SceneReader::EndArray (rapidjson::SizeType)
+{
+    const int depth = m_depth--;
+    if (m_skipDepth)
+    {
+        if (depth == m_skipDepth)
+            m_skipDepth = 0;
+        return true;
+    }
+
+    if (depth == 2)
+        m_section = Section::None;
+    return depth == 4 ? endArray() : true;
+}
+
+void SceneReader::resolve()
+{
+    auto index = [] (const auto &records, const char *kind)
+    {
+        std::unordered_map <std::string_view, uint32_t> names;
+        for (uint32_t i = 0; i < records.size(); ++i)
+        {
+            if (!names.emplace (records[i].name, i).second)
+                throw std::runtime_error (std::string ("duplicate ") + kind + " " + records[i].name);
+        }
+        return names;
+    };
+
+    auto find = [] (const std::unordered_map <std::string_view, uint32_t> &names, const char *name, const char *kind)
+    {
+        auto it = names.find (name);
+        if (it == names.end())
+            throw std::runtime_error (std::string ("unknown ") + kind + " " + name);
+        return it->second;
+    };
+
+    const auto programs  = index (m_scene.m_programs,  "program");
+    const auto materials = index (m_scene.m_materials, "material");
+    const auto meshes    = index (m_scene.m_meshes,    "mesh");
+
+    for (size_t i = 0; i < m_scene.m_materials.size(); ++i)
+        m_scene.m_materials[i].program = find (programs, m_materialPrograms[i], "program");
+
+    for (size_t i = 0; i < m_scene.m_nodes.size(); ++i)
+    {
+        m_scene.m_nodes[i].mesh     = find (meshes,    m_nodeMeshes[i],    "mesh");
+        m_scene.m_nodes[i].material = find (materials, m_nodeMaterials[i], "material");
+    }
+}
+
+bool SceneReader::scalar (const char *type)
+{
+    if (m_skipDepth || isIgnored (m_depth + 1))
+        return true;
+    return fail (std::string ("unexpected ") + type);
+}
+
+bool SceneReader::number (double value)
+{
+    if (m_skipDepth || isIgnored (m_depth + 1))
+        return true;
+    if (m_depth != 4)
+        return fail ("unexpected number");
+
+    switch (m_field)
+    {
+    case Field::Positions:
+    case Field::Colors:
+        m_arena.push (static_cast <float> (value));
+        break;
+
+    case Field::Indices:
+        if (value < 0.0 || value > 4294967295.0 || value != static_cast <double> (static_cast <uint32_t> (value)))
+            return fail ("indices must be 32 bit unsigned integers");
+        m_arena.push (static_cast <uint32_t> (value));
+        break;
+
+    default:
+        if (m_arrayCount == 4)
+            return fail ("too many components");
+        m_fixed[m_arrayCount] = static_cast <float> (value);
+        break;
+    }
+
+    ++m_arrayCount;
+    return true;
+}
+
+// A value of an unknown key; depth is the depth the value sits at
+bool SceneReader::isIgnored (int depth) const
+{
+    return (depth == 2 && m_section == Section::Unknown) || (depth == 4 && m_field == Field::Unknown);
+}
+
+bool SceneReader::fail (const std::string &message)
+{
+    m_error = message;
+    return false;
+}
+
+void SceneReader::beginRecord()
+{
+    m_program    = {};
+    m_material   = { nullptr, 0, glm::vec4 (1.0f) };
+    m_mesh       = {};
+    m_node       = { 0, 0, glm::vec3 (0.0f), glm::quat (1.0f, 0.0f, 0.0f, 0.0f), glm::vec3 (1.0f) };
+    m_colorCount = 0;
+    m_field      = Field::None;
+    m_references[0] = m_references[1] = nullptr;
+}
+
+bool SceneReader::endRecord()
+{
+    switch (m_section)
+    {
+    case Section::Programs:
+        if (!m_program.name || !m_program.vertex || !m_program.fragment)
+            return fail ("a program needs a name, a vertex and a fragment shader");
+        m_scene.m_programs.push_back (m_program);
+        break;
+
+    case Section::Materials:
+        if (!m_material.name || !m_references[0])
+            return fail ("a material needs a name and a program");
+        m_scene.m_materials.push_back (m_material);
+        m_materialPrograms.push_back (m_references[0]);
+        break;
+
+    case Section::Meshes:
+        if (!m_mesh.name || !m_mesh.positions)
+            return fail ("a mesh needs a name and positions");
+        if (m_mesh.colors && m_colorCount != m_mesh.vertexCount)
+            return fail ("mesh " + std::string (m_mesh.name) + " has a color count unlike its vertex count");
+        for (uint32_t i = 0; i < m_mesh.indexCount; ++i)
+        {
+            if (m_mesh.indices[i] >= m_mesh.vertexCount)
+                return fail ("mesh " + std::string (m_mesh.name) + " has an index out of range");
+        }
+        m_scene.m_meshes.push_back (m_mesh);
+        break;
+
+    case Section::Nodes:
+        if (!m_references[0] || !m_references[1])
+            return fail ("a node needs a mesh and a material");
+        m_scene.m_nodes.push_back (m_node);
+        m_nodeMeshes.push_back    (m_references[0]);
+        m_nodeMaterials.push_back (m_references[1]);
+        break;
+
+    default:
+        break;
+    }
+    return true;
+}
+
+// Streamed arrays are contiguous: nothing else is allocated until they end
+void SceneReader::beginArray()
+{
+    m_array      = m_arena.allocate (0, 4);
+    m_arrayCount = 0;
+}
+
+bool SceneReader::endArray()
+{
+    const size_t count = m_arrayCount;
+    auto needs = [this, count] (size_t components)
+    {
+        return count == components || fail ("expected " + std::to_string (components) + " components");
+    };
+
+    switch (m_field)
+    {
+    case Field::Positions:
+        if (count % 3 != 0)
+            return fail ("positions must be 3 components a vertex");
+        m_mesh.positions   = static_cast <const float *> (m_array);
+        m_mesh.vertexCount = static_cast <uint32_t> (count / 3);
+        return true;
+
+    case Field::Colors:
+        if (count % 3 != 0)
+            return fail ("colors must be 3 components a vertex");
+        m_mesh.colors = static_cast <const float *> (m_array);
+        m_colorCount  = static_cast <uint32_t> (count / 3);
+        return true;
+
+    case Field::Indices:
+        m_mesh.indices    = static_cast <const uint32_t *> (m_array);
+        m_mesh.indexCount = static_cast <uint32_t> (count);
+        return true;
+
+    case Field::Color:
+        if (!needs (4))
+            return false;
+        m_material.color = glm::vec4 (m_fixed[0], m_fixed[1], m_fixed[2], m_fixed[3]);
+        return true;
+
+    case Field::Translation:
+        if (!needs (3))
+            return false;
+        m_node.translation = glm::vec3 (m_fixed[0], m_fixed[1], m_fixed[2]);
+        return true;
+
+    case Field::Rotation:
+        if (!needs (4))
+            return false;
+        m_node.rotation = glm::normalize (glm::quat (m_fixed[3], m_fixed[0], m_fixed[1], m_fixed[2]));
+        return true;
+
+    case Field::Scale:
+        if (!needs (3))
+            return false;
+        m_node.scale = glm::vec3 (m_fixed[0], m_fixed[1], m_fixed[2]);
+        return true;
+
+    default:
+        return true;
+    }
+}
+
+static Scene::Stats makeStats (size_t fileBytes, size_t arenaBytes, const MeshOptimizeStats &meshes,
+                               Clock::time_point start)
+{
+    return { fileBytes, arenaBytes, std::chrono::duration <double> (Clock::now() - start).count(), meshes };
+}
@@ -0,0 +1,111 @@
+#ifndef SCENE_INCLUDED
+#define SCENE_INCLUDED
+
+#include <string>
+#include <vector>
+#include <cstdint>
+
+#include <glm/glm.hpp>
+#include <glm/gtc/quaternion.hpp>
+
+#include "Arena.h"
+#include "MeshOptimizer.h"
+
+// Shader programs by their stage files, relative to the shader directory
+struct SceneProgram
+{
+    const char *name;
+    const char *vertex;
+    const char *fragment;
+};
+
+struct SceneMaterial
+{
+    const char *name;
+    uint32_t    program;
+    glm::vec4   color;
+};
+
+// Positions and colors are 3 floats a vertex; colors may be null.
+// Without indices the vertices are drawn in order
+struct SceneMesh
+{
+    const char     *name;
+    const float    *positions;
+    const float    *colors;
+    uint32_t        vertexCount;
+    const uint32_t *indices;
+    uint32_t        indexCount;
+};
+
+struct SceneNode
+{
+    uint32_t  mesh;
+    uint32_t  material;
+    glm::vec3 translation;
+    glm::quat rotation;
+    glm::vec3 scale;
+
+    glm::mat4 transform() const;
+};
+
+// A scene read from JSON:
+// {
+//     "programs":  [ { "name", "vertex", "fragment" } ],
+//     "materials": [ { "name", "program", "color": [r, g, b, a] } ],
+//     "meshes":    [ { "name", "positions": [...], "colors": [...], "indices": [...] } ],
+//     "nodes":     [ { "mesh", "material", "translation": [x, y, z],
+//                      "rotation": [x, y, z, w], "scale": [x, y, z] } ]
+// }
+// References are by name and may point forward; unknown keys are skipped.
+//
+// load() parses in-situ on a private mapping with the SAX reader: vertex and
+// index arrays go straight into the arena as they are read, and pages of the
+// file already parsed are handed back, so memory stays at about the size of
+// the binary data no matter how large the file is
+class Scene
+{
+public:
+    struct Stats
+    {
+        size_t            fileBytes;
+        size_t            arenaBytes;
+        double            seconds;
+        MeshOptimizeStats meshes;       // over all meshes together, zero unless Meshes::Optimized
+    };
+
+    enum class Meshes
+    {
+        AsWritten,
+        Optimized      // welded, indexed and reordered with MeshOptimizer
+    };
+
+    // Throws std::runtime_error with the offset of the error
+    static Scene load (const std::string &path, Meshes meshes = Meshes::AsWritten);
+
+    Scene             (Scene &&other) = default;
+    Scene &operator = (Scene &&other) = default;
+
+    const std::vector <SceneProgram>  &programs() const;
+    const std::vector <SceneMaterial> &materials() const;
+    const std::vector <SceneMesh>     &meshes() const;
+    const std::vector <SceneNode>     &nodes() const;
+
+    const Stats &stats() const;
+
+private:
+    friend class SceneReader;
+
+    Arena                        m_arena;   // names, vertices and indices
+    std::vector <SceneProgram>   m_programs;
+    std::vector <SceneMaterial>  m_materials;
+    std::vector <SceneMesh>      m_meshes;
+    std::vector <SceneNode>      m_nodes;
+    Stats                        m_stats;
+
+    explicit Scene (size_t arenaBytes);
+
+    MeshOptimizeStats optimizeMeshes();
+};
+
+#endif // !SCENE_INCLUDED
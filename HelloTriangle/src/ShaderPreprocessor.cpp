@@ -0,0 +1,586 @@
+#include "ShaderPreprocessor.h"
+#include "GLSLProgram.h"
+#include "MappedFile.h"
+#include "Profiler.h"
+
+#include <cstdio>
+#include <cctype>
+#include <algorithm>
+#include <filesystem>
+
+namespace fs = std::filesystem;
+
+struct ShaderPreprocessor::ExpandState
+{
+    Expansion                            &expansion;
+    std::vector <std::string>             stack;
+    std::unordered_set <std::string>      guarded;  // already expanded outside of any #if, defined for sure
+    std::unordered_map <std::string, int> fileIds;
+    bool                                  hasVersion;
+};
+
+static std::string_view nextLine      (std::string_view text, size_t &begin);
+static bool        startsDirective    (std::string_view line, size_t &pos);
+static std::string readWord           (std::string_view line, size_t &pos);
+static void        skipSpaces         (std::string_view line, size_t &pos);
+static void        updateCommentState (std::string_view line, bool &inBlockComment);
+static std::string detectGuardMacro   (std::string_view text);
+static void        collectIdentifiers (std::string_view text, std::unordered_set <std::string> &out);
+static bool        isIdentifierChar   (char c);
+
+
+ShaderDefines &ShaderDefines::set (const std::string &name, const std::string &value)
+{
+    auto it = std::lower_bound (m_entries.begin(), m_entries.end(), name,
+        [] (const Define &define, const std::string &key) { return define.first < key; });
+
+    if (it != m_entries.end() && it->first == name)
+        it->second = value;
+    else
+        m_entries.insert (it, Define (name, value));
+
+    return *this;
+}
+
+const std::vector <ShaderDefines::Define> &ShaderDefines::entries() const
+{
+    return m_entries;
+}
+
+std::string ShaderDefines::key() const
+{
+    std::string key;
+    for (const auto &define : m_entries)
+    {
+        if (define.second.empty())
+            continue;
+
+        if (!key.empty())
+            key += ';';
+        key += define.first + '=' + define.second;
+    }
+    return key;
+}
+
+ShaderPermutations &ShaderPermutations::addAxis (const std::string &name,
+                                                 const std::vector <std::string> &values)
+{
+    assert (!values.empty());
+
+    m_axes.emplace_back (name, values);
+    return *this;
+}
+
+ShaderPermutations &ShaderPermutations::addSwitch (const std::string &name)
+{
+    return addAxis (name, { "", "1" });
+}
+
+std::vector <ShaderDefines> ShaderPermutations::enumerate() const
+{
+    std::vector <ShaderDefines> permutations;
+    permutations.reserve (count());
+
+    std::vector <size_t> choice (m_axes.size(), 0);
+    for (;;)
+    {
+        ShaderDefines defines;
+        for (size_t axis = 0; axis < m_axes.size(); ++axis)
+            defines.set (m_axes[axis].first, m_axes[axis].second[choice[axis]]);
+        permutations.push_back (std::move (defines));
+
+        size_t axis = 0;
+        for (; axis < m_axes.size(); ++axis)
+        {
+            if (++choice[axis] < m_axes[axis].second.size())
+                break;
+            choice[axis] = 0;
+        }
+        if (axis == m_axes.size())
+            break;
+    }
+    return permutations;
+}
+
+size_t ShaderPermutations::count() const
+{
+    size_t total = 1;
+    for (const auto &axis : m_axes)
+        total *= axis.second.size();
+    return total;
+}
+
+std::string ShaderPreprocessor::Result::label() const
+{
+    if (files.empty())
+        return "";
+
+    std::string label = files[0];
+    for (size_t i = 1; i < files.size(); ++i)
+        label += "\nsource " + std::to_string (i) + ": " + files[i];
+    return label;
+}
+
+ShaderPreprocessor::ShaderPreprocessor (const std::string &includeRoot)
+    : m_includeRoot (includeRoot)
+{
+}
+
+ShaderPreprocessor::Result ShaderPreprocessor::process (const std::string &fileName,
+                                                        const ShaderDefines &defines)
+{
+    PROFILE_SCOPE ("ShaderPreprocessor::process");
+    return assemble (expand (fileName), defines);
+}
+
+ShaderPreprocessor::VariantSet ShaderPreprocessor::processPermutations (
+    const std::string &fileName, const ShaderPermutations &permutations)
+{
+    // Defines never change how includes expand, so the file is walked once
+    const Expansion expansion = expand (fileName);
+
+    VariantSet set;
+    std::unordered_map <std::string, size_t> uniqueSources;
+
+    for (const auto &defines : permutations.enumerate())
+    {
+        Result result = assemble (expansion, defines);
+
+        auto inserted = uniqueSources.emplace (result.source, set.sources.size());
+        if (inserted.second)
+            set.sources.push_back (std::move (result));
+
+        set.variants.push_back ({ defines.key(), inserted.first->second });
+    }
+    return set;
+}
+
+void ShaderPreprocessor::clearCache()
+{
+    std::lock_guard <std::mutex> lock (m_cacheMutex);
+    m_files.clear();
+}
+
+void ShaderPreprocessor::invalidate (const std::string &path)
+{
+    std::lock_guard <std::mutex> lock (m_cacheMutex);
+    m_files.erase (fs::path (path).lexically_normal().generic_string());
+}
+
+ShaderPreprocessor::Expansion ShaderPreprocessor::expand (const std::string &fileName)
+{
+    std::string path = fileName;
+    if (!fs::is_regular_file (path) && fs::is_regular_file (fs::path (m_includeRoot) / fileName))
+        path = (fs::path (m_includeRoot) / fileName).string();
+
+    std::shared_ptr <const SourceFile> root = loadFile (fs::path (path).lexically_normal().generic_string());
+
+    Expansion expansion = {};
+    expansion.bodyFirstLine = 1;
+    expansion.files.push_back (root->path);
+    expansion.sources.push_back (root);
+
+    ExpandState state = { expansion, {}, {}, {}, false };
+    state.fileIds.emplace (root->path, 0);
+
+    expandFile (*root, state, false);
+    return expansion;
+}
+
+// Conditionals are left to the driver, so which #if branches are taken is
+// not known here. A guarded file is only skipped when it was expanded before
+// outside of any #if, anywhere else the guard macro decides: files with a
+// classic guard bring their own, #pragma once files get one wrapped around
+// them. A guarded file included in both branches of an #ifdef then ends up
+// in each, and the driver keeps the one it takes
+void ShaderPreprocessor::expandFile (const SourceFile &file, ExpandState &state, bool isConditional)
+{
+    const int   fileId = state.fileIds.at (file.path);
+    const bool  isRoot = state.stack.empty();
+    std::string &out   = state.expansion.body;
+
+    state.stack.push_back (file.path);
+
+    for (const Segment &segment : file.segments)
+    {
+        if (segment.kind == Segment::Kind::Text)
+        {
+            out += segment.text;
+            continue;
+        }
+
+        if (segment.kind == Segment::Kind::Version)
+        {
+            // Only the root file keeps its #version, the defines go right after it
+            if (isRoot && !state.hasVersion)
+            {
+                state.hasVersion = true;
+                state.expansion.header        = out + segment.text + '\n';
+                state.expansion.bodyFirstLine = segment.line + 1;
+                out.clear();
+            }
+            else
+            {
+                out += '\n';
+            }
+            continue;
+        }
+
+        const std::string &path = segment.text;
+        if (state.guarded.count (path))
+        {
+            out += '\n';
+            continue;
+        }
+
+        if (std::find (state.stack.begin(), state.stack.end(), path) != state.stack.end())
+            throw GLSLProgramException (file.path + ":" + std::to_string (segment.line) +
+                                        ": recursive #include of " + path);
+
+        const bool isChildConditional = isConditional || segment.depth > 0;
+
+        std::shared_ptr <const SourceFile> child = loadFile (path);
+        if (child->isGuarded && !isChildConditional)
+            state.guarded.insert (path);
+
+        auto id = state.fileIds.emplace (path, static_cast <int> (state.expansion.files.size()));
+        if (id.second)
+        {
+            state.expansion.files.push_back (path);
+            state.expansion.sources.push_back (child);
+        }
+
+        const std::string onceMacro = "HT_PRAGMA_ONCE_" + std::to_string (id.first->second);
+        if (child->hasPragmaOnce)
+            out += "#ifndef " + onceMacro + "\n#define " + onceMacro + '\n';
+
+        out += "#line 1 " + std::to_string (id.first->second) + '\n';
+        expandFile (*child, state, isChildConditional);
+        if (child->hasPragmaOnce)
+            out += "#endif\n";
+        out += "#line " + std::to_string (segment.line + 1) + ' ' + std::to_string (fileId) + '\n';
+    }
+
+    state.stack.pop_back();
+}
+
+ShaderPreprocessor::Result ShaderPreprocessor::assemble (const Expansion &expansion,
+                                                         const ShaderDefines &defines) const
+{
+    Result result;
+    result.files = expansion.files;
+    result.source.reserve (expansion.header.size() + expansion.body.size() + 256);
+
+    result.source += expansion.header;
+
+    // Defines the shader never mentions are dropped so equivalent variants expand identically
+    for (const auto &define : defines.entries())
+    {
+        if (define.second.empty())
+            continue;
+
+        bool isUsed = false;
+        for (const auto &source : expansion.sources)
+        {
+            if ((isUsed = source->identifiers.count (define.first) > 0))
+                break;
+        }
+
+        if (isUsed)
+            result.source += "#define " + define.first + ' ' + define.second + '\n';
+    }
+
+    result.source += "#line " + std::to_string (expansion.bodyFirstLine) + " 0\n";
+    result.source += expansion.body;
+
+    return result;
+}
+
+std::string ShaderPreprocessor::resolveInclude (const std::string &name, const std::string &includer,
+                                                bool isQuoted) const
+{
+    fs::path candidates[2];
+    size_t   count = 0;
+
+    if (isQuoted)
+        candidates[count++] = fs::path (includer).parent_path() / name;
+    candidates[count++] = fs::path (m_includeRoot) / name;
+
+    for (size_t i = 0; i < count; ++i)
+    {
+        if (fs::is_regular_file (candidates[i]))
+            return candidates[i].lexically_normal().generic_string();
+    }
+    return "";
+}
+
+std::shared_ptr <const ShaderPreprocessor::SourceFile> ShaderPreprocessor::loadFile (const std::string &path)
+{
+    {
+        std::lock_guard <std::mutex> lock (m_cacheMutex);
+        auto it = m_files.find (path);
+        if (it != m_files.end())
+            return it->second;
+    }
+
+    MappedFile mapping (path);
+    if (!mapping.isOpen())
+        throw GLSLProgramException ("Can't open the file " + path);
+
+    std::shared_ptr <const SourceFile> file = parseFile (path, mapping.view());
+
+    std::lock_guard <std::mutex> lock (m_cacheMutex);
+    return m_files.emplace (path, std::move (file)).first->second;
+}
+
+// Splits a file into plain text runs and the directives the expansion acts on,
+// so expanding an already loaded file is only string appends
+std::shared_ptr <const ShaderPreprocessor::SourceFile> ShaderPreprocessor::parseFile (
+    const std::string &path, std::string_view text) const
+{
+    auto file = std::make_shared <SourceFile>();
+    file->path = path;
+
+    bool   hasPragmaOnce  = false;
+    bool   inBlockComment = false;
+    int    lineNumber     = 0;
+    int    depth          = 0;
+    size_t begin          = 0;
+
+    file->segments.push_back ({ Segment::Kind::Text, "", 0, 0 });
+
+    while (begin < text.size())
+    {
+        const std::string_view line = nextLine (text, begin);
+        ++lineNumber;
+
+        const bool isCommented = inBlockComment;
+        updateCommentState (line, inBlockComment);
+
+        size_t pos = 0;
+        std::string directive;
+        if (!isCommented && startsDirective (line, pos))
+            directive = readWord (line, pos);
+
+        if (directive == "if" || directive == "ifdef" || directive == "ifndef")
+            ++depth;
+        else if (directive == "endif")
+            depth = std::max (depth - 1, 0);
+
+        if (directive == "version")
+        {
+            file->segments.push_back ({ Segment::Kind::Version, std::string (line), lineNumber, depth });
+            file->segments.push_back ({ Segment::Kind::Text, "", 0, 0 });
+            continue;
+        }
+
+        if (directive == "pragma")
+        {
+            size_t argPos = pos;
+            skipSpaces (line, argPos);
+            if (readWord (line, argPos) == "once")
+            {
+                hasPragmaOnce = true;
+                file->segments.back().text += '\n';
+                continue;
+            }
+        }
+
+        if (directive != "include")
+        {
+            file->segments.back().text += line;
+            file->segments.back().text += '\n';
+            continue;
+        }
+
+        const std::string where = path + ":" + std::to_string (lineNumber) + ": ";
+
+        skipSpaces (line, pos);
+        const char open = pos < line.size() ? line[pos] : '\0';
+        if (open != '"' && open != '<')
+            throw GLSLProgramException (where + "malformed #include");
+
+        const size_t close = line.find (open == '"' ? '"' : '>', pos + 1);
+        if (close == std::string::npos)
+            throw GLSLProgramException (where + "malformed #include");
+
+        const std::string name     = std::string (line.substr (pos + 1, close - pos - 1));
+        const std::string resolved = resolveInclude (name, path, open == '"');
+        if (resolved.empty())
+            throw GLSLProgramException (where + "can't find include \"" + name + "\"");
+
+        file->segments.push_back ({ Segment::Kind::Include, resolved, lineNumber, depth });
+        file->segments.push_back ({ Segment::Kind::Text, "", 0, 0 });
+    }
+
+    const bool hasGuardMacro = !detectGuardMacro (text).empty();
+    file->isGuarded     = hasPragmaOnce || hasGuardMacro;
+    file->hasPragmaOnce = hasPragmaOnce && !hasGuardMacro;
+    collectIdentifiers (text, file->identifiers);
+
+    // Everything in a file with a classic guard is inside its #ifndef
+    if (hasGuardMacro)
+    {
+        for (Segment &segment : file->segments)
+        {
+            if (segment.kind == Segment::Kind::Include)
+                --segment.depth;
+        }
+    }
+
+    return file;
+}
+
+static std::string_view nextLine (std::string_view text, size_t &begin)
+{
+    size_t end = text.find ('\n', begin);
+    if (end == std::string::npos)
+        end = text.size();
+
+    size_t length = end - begin;
+    if (length > 0 && text[begin + length - 1] == '\r')
+        --length;
+
+    std::string_view line = text.substr (begin, length);
+    begin = end + 1;
+    return line;
+}
+
+static bool startsDirective (std::string_view line, size_t &pos)
+{
+    skipSpaces (line, pos);
+    if (pos >= line.size() || line[pos] != '#')
+        return false;
+
+    ++pos;
+    skipSpaces (line, pos);
+    return true;
+}
+
+static std::string readWord (std::string_view line, size_t &pos)
+{
+    const size_t begin = pos;
+    while (pos < line.size() && isIdentifierChar (line[pos]))
+        ++pos;
+
+    return std::string (line.substr (begin, pos - begin));
+}
+
+static void skipSpaces (std::string_view line, size_t &pos)
+{
+    while (pos < line.size() && (line[pos] == ' ' || line[pos] == '\t'))
+        ++pos;
+}
+
+static void updateCommentState (std::string_view line, bool &inBlockComment)
+{
+    for (size_t i = 0; i + 1 < line.size(); ++i)
+    {
+        if (inBlockComment)
+        {
+            if (line[i] == '*' && line[i + 1] == '/')
+            {
+                inBlockComment = false;
+                ++i;
+            }
+        }
+        else if (line[i] == '/' && line[i + 1] == '/')
+        {
+            return;
+        }
+        else if (line[i] == '/' && line[i + 1] == '*')
+        {
+            inBlockComment = true;
+            ++i;
+        }
+    }
+}
+
+// Recognizes the classic "#ifndef X / #define X ... #endif" wrapper
+static std::string detectGuardMacro (std::string_view text)
+{
+    std::vector <std::pair <std::string, std::string>> directives;
+    bool   inBlockComment = false;
+    bool   hasCode        = false;
+    size_t firstCodeAfter = 0;
+    size_t lastCodeAfter  = 0;
+    size_t begin          = 0;
+
+    while (begin < text.size())
+    {
+        const std::string_view line = nextLine (text, begin);
+
+        const bool isCommented = inBlockComment;
+        updateCommentState (line, inBlockComment);
+
+        size_t pos = 0;
+        if (!isCommented && startsDirective (line, pos))
+        {
+            std::string name = readWord (line, pos);
+            skipSpaces (line, pos);
+            std::string arg = readWord (line, pos);
+
+            directives.emplace_back (std::move (name), std::move (arg));
+            continue;
+        }
+
+        size_t first = line.find_first_not_of (" \t");
+        if (!isCommented && first != std::string::npos && line.compare (first, 2, "//") != 0 &&
+            line.compare (first, 2, "/*") != 0)
+        {
+            if (!hasCode)
+                firstCodeAfter = directives.size();
+            hasCode       = true;
+            lastCodeAfter = directives.size();
+        }
+    }
+
+    // Code before the #define or after the #endif is outside of the guard
+    if (directives.size() < 3 || (hasCode && (lastCodeAfter == directives.size() || firstCodeAfter < 2)))
+        return "";
+
+    const auto &ifndef = directives[0];
+    const auto &define = directives[1];
+    if (ifndef.first != "ifndef" || define.first != "define" || ifndef.second != define.second ||
+        directives.back().first != "endif")
+        return "";
+
+    // The closing #endif must pair with the opening #ifndef
+    int depth = 0;
+    for (size_t i = 0; i + 1 < directives.size(); ++i)
+    {
+        const std::string &name = directives[i].first;
+        if (name == "if" || name == "ifdef" || name == "ifndef")
+            ++depth;
+        else if (name == "endif" && --depth == 0)
+            return "";
+    }
+    return ifndef.second;
+}
+
+static void collectIdentifiers (std::string_view text, std::unordered_set <std::string> &out)
+{
+    size_t i = 0;
+    while (i < text.size())
+    {
+        if (!isIdentifierChar (text[i]) || isdigit (static_cast <unsigned char> (text[i])))
+        {
+            // Skip whole numeric literals so suffixes like 1e5 or 2u are not taken as names
+            while (i < text.size() && isIdentifierChar (text[i]))
+                ++i;
+            if (i < text.size() && !isIdentifierChar (text[i]))
+                ++i;
+            continue;
+        }
+
+        const size_t begin = i;
+        while (i < text.size() && isIdentifierChar (text[i]))
+            ++i;
+        out.emplace (text.substr (begin, i - begin));
+    }
+}
+
+static bool isIdentifierChar (char c)
+{
+    return isalnum (static_cast <unsigned char> (c)) || c == '_';
+}
@@ -0,0 +1,120 @@
+#ifndef SHADER_PREPROCESSOR_INCLUDED
+#define SHADER_PREPROCESSOR_INCLUDED
+
+#include <string>
+#include <string_view>
+#include <vector>
+#include <memory>
+#include <mutex>
+#include <unordered_map>
+#include <unordered_set>
+
+class ShaderDefines
+{
+public:
+    using Define = std::pair <std::string, std::string>;
+
+    // An empty value leaves the macro undefined
+    ShaderDefines &set (const std::string &name, const std::string &value = "1");
+
+    const std::vector <Define> &entries() const;
+    std::string key() const;
+
+private:
+    std::vector <Define> m_entries; // sorted by name
+};
+
+class ShaderPermutations
+{
+public:
+    ShaderPermutations &addAxis   (const std::string &name, const std::vector <std::string> &values);
+    ShaderPermutations &addSwitch (const std::string &name);
+
+    std::vector <ShaderDefines> enumerate() const;
+    size_t count() const;
+
+private:
+    std::vector <std::pair <std::string, std::vector <std::string>>> m_axes;
+};
+
+class ShaderPreprocessor
+{
+public:
+    struct Result
+    {
+        std::string               source;
+        std::vector <std::string> files;   // indexed by the #line source string number
+
+        // File name for error messages, with the source string table when
+        // the shader pulled in includes
+        std::string label() const;
+    };
+
+    struct Variant
+    {
+        std::string key;
+        size_t      sourceIndex;
+    };
+
+    struct VariantSet
+    {
+        std::vector <Result>  sources;     // unique expanded sources
+        std::vector <Variant> variants;    // every permutation, in enumeration order
+    };
+
+    explicit ShaderPreprocessor (const std::string &includeRoot = "res/shaders");
+
+    // Thread safe, included files are read once and kept in memory
+    Result     process (const std::string &fileName, const ShaderDefines &defines = ShaderDefines());
+    VariantSet processPermutations (const std::string &fileName, const ShaderPermutations &permutations);
+
+    void       clearCache();
+    // Drops one file, read again the next time a shader includes it
+    void       invalidate (const std::string &path);
+
+private:
+    struct Segment
+    {
+        enum class Kind { Text, Version, Include };
+
+        Kind        kind;
+        std::string text;   // plain text, the #version line or the resolved include path
+        int         line;
+        int         depth;  // #if blocks open around an include, not counting the file's own guard
+    };
+
+    struct SourceFile
+    {
+        std::string                      path;
+        std::vector <Segment>            segments;
+        std::unordered_set <std::string> identifiers;
+        bool                             isGuarded;      // #pragma once or a classic include guard
+        bool                             hasPragmaOnce;  // wrapped in a guard macro when expanded
+    };
+
+    struct Expansion
+    {
+        std::string                                     header;  // everything up to and including #version
+        std::string                                     body;
+        int                                             bodyFirstLine;
+        std::vector <std::string>                       files;
+        std::vector <std::shared_ptr <const SourceFile>> sources;
+    };
+
+    struct ExpandState;
+
+    std::string m_includeRoot;
+    std::mutex  m_cacheMutex;
+    std::unordered_map <std::string, std::shared_ptr <const SourceFile>> m_files;
+
+    Expansion   expand      (const std::string &fileName);
+    void        expandFile  (const SourceFile &file, ExpandState &state, bool isConditional);
+    Result      assemble    (const Expansion &expansion, const ShaderDefines &defines) const;
+    std::string resolveInclude (const std::string &name, const std::string &includer,
+                                bool isQuoted) const;
+    std::shared_ptr <const SourceFile> loadFile  (const std::string &path);
+    std::shared_ptr <const SourceFile> parseFile (const std::string &path,
+                                                  std::string_view text) const;
+};
+
+#endif // !SHADER_PREPROCESSOR_INCLUDED
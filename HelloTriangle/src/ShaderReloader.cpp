@@ -0,0 +1,83 @@
+#include "ShaderReloader.h"
+#include "ShaderPreprocessor.h"
+#include "MappedFile.h"
+#include "Profiler.h"
+
+#include <algorithm>
+
+
+ShaderReloader::ShaderReloader (AsyncShaderCompiler &compiler, ShaderPreprocessor *preprocessor)
+    : m_compiler (compiler), m_preprocessor (preprocessor)
+{
+}
+
+// The shader files are watched right away, what they include once it's known
+void ShaderReloader::track (const AsyncShaderCompiler::Handle &program)
+{
+    m_programs.push_back ({ program, nullptr, {}, false, false });
+    watch (m_programs.back(), program);
+}
+
+std::vector <ShaderReloader::Reload> ShaderReloader::poll()
+{
+    PROFILE_SCOPE ("ShaderReloader::poll");
+
+    std::vector <Reload> finished;
+    for (Tracked &tracked : m_programs)
+    {
+        if (tracked.reload && tracked.reload->isDone())
+        {
+            finished.push_back ({ tracked.program, tracked.reload->isFailed(), tracked.reload->error() });
+            watch (tracked, tracked.reload);
+            tracked.reload.reset();
+        }
+        if (!tracked.isWatched && tracked.program->isDone())
+        {
+            watch (tracked, tracked.program);
+            tracked.isWatched = true;
+        }
+    }
+
+    for (const std::string &file : m_watcher.poll())
+    {
+        if (m_preprocessor)
+            m_preprocessor->invalidate (file);
+        MappedFileCache::global().evict (file);
+
+        for (Tracked &tracked : m_programs)
+        {
+            if (std::find (tracked.files.begin(), tracked.files.end(), file) != tracked.files.end())
+                tracked.isStale = true;
+        }
+    }
+
+    for (Tracked &tracked : m_programs)
+    {
+        if (tracked.isStale && !tracked.reload && tracked.program->isDone())
+        {
+            tracked.reload  = m_compiler.reload (tracked.program);
+            tracked.isStale = false;
+        }
+    }
+    return finished;
+}
+
+size_t ShaderReloader::watchedFileCount() const
+{
+    return m_watcher.size();
+}
+
+// A failed rebuild's files are watched as well, it may have pulled in a new
+// include whose fix has to trigger the next one
+void ShaderReloader::watch (Tracked &tracked, const AsyncShaderCompiler::Handle &request)
+{
+    for (const std::string &dependency : request->dependencies())
+    {
+        const std::string file = FileWatcher::normalize (dependency);
+        if (std::find (tracked.files.begin(), tracked.files.end(), file) != tracked.files.end())
+            continue;
+
+        tracked.files.push_back (file);
+        m_watcher.watch (file);
+    }
+}
@@ -0,0 +1,58 @@
+#ifndef SHADER_RELOADER_INCLUDED
+#define SHADER_RELOADER_INCLUDED
+
+#include <string>
+#include <vector>
+
+#include "AsyncShaderCompiler.h"
+#include "FileWatcher.h"
+
+// Rebuilds a program when any file it was built from changes, its shaders
+// or what they include. Only the programs depending on a changed file are
+// rebuilt; the files are read on the compiler's pool and the driver links
+// them in the background where it can, so editing one doesn't hold up the
+// frame loop. Through AsyncShaderCompiler::reload() the new program takes
+// the old one's place at the compiler's poll(), and a rebuild that fails
+// leaves the last good program drawing
+class ShaderReloader
+{
+public:
+    struct Reload
+    {
+        AsyncShaderCompiler::Handle program;
+        bool                        isFailed;
+        std::string                 error;      // the GLSLProgramException log when it failed
+    };
+
+    // The preprocessor, if the compiler has one, gets changed files dropped
+    // from its cache
+    explicit ShaderReloader (AsyncShaderCompiler &compiler, ShaderPreprocessor *preprocessor = nullptr);
+
+    void   track (const AsyncShaderCompiler::Handle &program);
+
+    // On the GL thread once a frame, ahead of the compiler's poll(). Starts
+    // rebuilds for the files changed since the last call and returns the
+    // rebuilds that finished
+    std::vector <Reload> poll();
+
+    size_t watchedFileCount() const;
+
+private:
+    struct Tracked
+    {
+        AsyncShaderCompiler::Handle program;
+        AsyncShaderCompiler::Handle reload;        // the rebuild in flight, if any
+        std::vector <std::string>   files;         // normalized, being watched
+        bool                        isWatched;     // includes too, known once the first build is done
+        bool                        isStale;       // rebuilt as soon as no build is in flight
+    };
+
+    AsyncShaderCompiler   &m_compiler;
+    ShaderPreprocessor    *m_preprocessor;
+    FileWatcher            m_watcher;
+    std::vector <Tracked>  m_programs;
+
+    void   watch (Tracked &tracked, const AsyncShaderCompiler::Handle &request);
+};
+
+#endif // !SHADER_RELOADER_INCLUDED
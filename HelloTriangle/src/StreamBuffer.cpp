@@ -0,0 +1,165 @@
+#include "StreamBuffer.h"
+
+#include <chrono>
+#include <cassert>
+#include <stdexcept>
+
+#include "GLStateCache.h"
+#include "Profiler.h"
+
+using Clock = std::chrono::steady_clock;
+
+// Keeps every region start aligned for vertex, index and uniform data
+static const GLsizeiptr REGION_ALIGNMENT = 256;
+static const GLuint64   FENCE_TIMEOUT    = 1000000000ull;   // 1 s in ns
+
+static GLsizeiptr alignUp (GLsizeiptr value, GLsizeiptr alignment);
+static void       accumulate (StreamBuffer::Stats &to, const StreamBuffer::Stats &from);
+
+
+StreamBuffer::StreamBuffer (GLsizeiptr regionSize, unsigned regionCount)
+    : m_buffer (0), m_mapping (nullptr), m_regionSize (alignUp (regionSize, REGION_ALIGNMENT)),
+      m_regionCount (regionCount), m_region (regionCount - 1), m_head (0), m_isInFrame (false),
+      m_fences (regionCount, nullptr), m_current(), m_lastFrame(), m_total()
+{
+    assert (regionSize > 0 && regionCount > 0);
+
+    const GLbitfield flags = GL_MAP_WRITE_BIT | GL_MAP_PERSISTENT_BIT | GL_MAP_COHERENT_BIT;
+    const GLsizeiptr size  = m_regionSize * m_regionCount;
+
+    glCreateBuffers (1, &m_buffer);
+    glNamedBufferStorage (m_buffer, size, nullptr, flags);
+    m_mapping = static_cast <char *> (glMapNamedBufferRange (m_buffer, 0, size, flags));
+
+    if (!m_mapping)
+    {
+        glDeleteBuffers (1, &m_buffer);
+        throw std::runtime_error ("Can't map the stream buffer persistently");
+    }
+}
+
+StreamBuffer::~StreamBuffer()
+{
+    for (GLsync fence : m_fences)
+        if (fence)
+            glDeleteSync (fence);
+
+    GLStateCache::current().forgetBuffer (m_buffer);
+    glUnmapNamedBuffer (m_buffer);
+    glDeleteBuffers (1, &m_buffer);
+}
+
+void StreamBuffer::beginFrame()
+{
+    assert (!m_isInFrame && "StreamBuffer::endFrame wasn't called");
+
+    m_region    = (m_region + 1) % m_regionCount;
+    m_head      = 0;
+    m_isInFrame = true;
+    m_current   = Stats();
+
+    waitForRegion (m_region);
+}
+
+void StreamBuffer::endFrame()
+{
+    assert (m_isInFrame && "StreamBuffer::beginFrame wasn't called");
+
+    m_fences[m_region] = glFenceSync (GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+    m_isInFrame = false;
+
+    m_lastFrame = m_current;
+    accumulate (m_total, m_current);
+}
+
+StreamBuffer::Allocation StreamBuffer::allocate (GLsizeiptr size, GLsizeiptr alignment)
+{
+    assert (m_isInFrame && "Allocating outside of a frame");
+    assert (size > 0 && alignment > 0);
+
+    // Alignment is of the absolute offset, the region start is a multiple of REGION_ALIGNMENT only
+    const GLsizeiptr base  = m_regionSize * m_region;
+    const GLsizeiptr start = alignUp (base + m_head, alignment) - base;
+
+    if (start + size > m_regionSize)
+    {
+        ++m_current.failedAllocations;
+        return { nullptr, 0, 0 };
+    }
+
+    m_head = start + size;
+    ++m_current.allocations;
+    m_current.bytesStreamed += static_cast <size_t> (size);
+
+    return { m_mapping + base + start, base + start, size };
+}
+
+GLuint StreamBuffer::handle() const
+{
+    return m_buffer;
+}
+
+GLsizeiptr StreamBuffer::regionSize() const
+{
+    return m_regionSize;
+}
+
+unsigned StreamBuffer::regionCount() const
+{
+    return m_regionCount;
+}
+
+GLsizeiptr StreamBuffer::bytesFree() const
+{
+    return m_regionSize - m_head;
+}
+
+const StreamBuffer::Stats &StreamBuffer::frameStats() const
+{
+    return m_lastFrame;
+}
+
+const StreamBuffer::Stats &StreamBuffer::totalStats() const
+{
+    return m_total;
+}
+
+// Polls first so a fence that already passed isn't counted as a wait
+void StreamBuffer::waitForRegion (unsigned region)
+{
+    PROFILE_SCOPE ("StreamBuffer::waitForRegion");
+
+    GLsync fence = m_fences[region];
+    if (!fence)
+        return;
+
+    GLenum result = glClientWaitSync (fence, 0, 0);
+    if (result == GL_TIMEOUT_EXPIRED)
+    {
+        Clock::time_point start = Clock::now();
+        ++m_current.fenceWaits;
+
+        do
+            result = glClientWaitSync (fence, GL_SYNC_FLUSH_COMMANDS_BIT, FENCE_TIMEOUT);
+        while (result == GL_TIMEOUT_EXPIRED);
+
+        m_current.stallSeconds += std::chrono::duration <double> (Clock::now() - start).count();
+    }
+
+    glDeleteSync (fence);
+    m_fences[region] = nullptr;
+}
+
+static GLsizeiptr alignUp (GLsizeiptr value, GLsizeiptr alignment)
+{
+    return (value + alignment - 1) / alignment * alignment;
+}
+
+static void accumulate (StreamBuffer::Stats &to, const StreamBuffer::Stats &from)
+{
+    to.bytesStreamed     += from.bytesStreamed;
+    to.allocations       += from.allocations;
+    to.failedAllocations += from.failedAllocations;
+    to.fenceWaits        += from.fenceWaits;
+    to.stallSeconds      += from.stallSeconds;
+}
@@ -0,0 +1,78 @@
+#ifndef STREAM_BUFFER_INCLUDED
+#define STREAM_BUFFER_INCLUDED
+
+#include <vector>
+#include <cstddef>
+#include <glad/glad.h>
+
+// One persistently mapped buffer split into regionCount frame regions.
+// Every frame bump-allocates from its own region; before a region is
+// reused the fence placed at the end of its previous frame is waited on,
+// so the CPU never writes memory the GPU may still be reading
+class StreamBuffer
+{
+public:
+    struct Stats
+    {
+        size_t bytesStreamed;
+        size_t allocations;
+        size_t failedAllocations;
+        size_t fenceWaits;
+        double stallSeconds;
+    };
+
+    struct Allocation
+    {
+        void      *data;
+        GLintptr   offset;   // from the start of the buffer
+        GLsizeiptr size;
+
+        bool isValid() const { return data != nullptr; }
+
+        template <typename T>
+        T *as() const { return static_cast <T *> (data); }
+    };
+
+    // Needs a current GL 4.4+ context
+    explicit StreamBuffer (GLsizeiptr regionSize, unsigned regionCount = 3);
+   ~StreamBuffer();
+
+    // Moves to the next region, waiting for the GPU if it still uses it
+    void       beginFrame();
+    // Fences the current region, call after the frame's last draw reading it
+    void       endFrame();
+
+    // Returns an invalid allocation if the region has no room left
+    Allocation allocate (GLsizeiptr size, GLsizeiptr alignment = 4);
+
+    GLuint     handle() const;
+    GLsizeiptr regionSize() const;
+    unsigned   regionCount() const;
+    GLsizeiptr bytesFree() const;
+
+    // The last finished frame and everything since creation
+    const Stats &frameStats() const;
+    const Stats &totalStats() const;
+
+private:
+    GLuint     m_buffer;
+    char      *m_mapping;
+    GLsizeiptr m_regionSize;
+    unsigned   m_regionCount;
+    unsigned   m_region;
+    GLsizeiptr m_head;
+    bool       m_isInFrame;
+
+    std::vector <GLsync> m_fences;
+
+    Stats      m_current;
+    Stats      m_lastFrame;
+    Stats      m_total;
+
+    void       waitForRegion (unsigned region);
+
+    StreamBuffer             (const StreamBuffer &other) = delete;
+    StreamBuffer &operator = (const StreamBuffer &other) = delete;
+};
+
+#endif // !STREAM_BUFFER_INCLUDED
@@ -0,0 +1,59 @@
+#include "ThreadPool.h"
+#include "Profiler.h"
+
+#include <algorithm>
+
+ThreadPool::ThreadPool (size_t threadCount)
+    : m_isStopping (false)
+{
+    threadCount = std::max <size_t> (threadCount, 1);
+
+    m_workers.reserve (threadCount);
+    for (size_t i = 0; i < threadCount; ++i)
+        m_workers.emplace_back (&ThreadPool::workerLoop, this);
+}
+
+ThreadPool::~ThreadPool()
+{
+    {
+        std::lock_guard <std::mutex> lock (m_mutex);
+        m_isStopping = true;
+    }
+    m_wakeUp.notify_all();
+
+    for (auto &worker : m_workers)
+        worker.join();
+}
+
+size_t ThreadPool::size() const
+{
+    return m_workers.size();
+}
+
+size_t ThreadPool::defaultThreadCount()
+{
+    // One core is left to the render thread
+    const size_t cores = std::thread::hardware_concurrency();
+    return cores > 1 ? cores - 1 : 1;
+}
+
+void ThreadPool::workerLoop()
+{
+    PROFILE_THREAD_NAME ("ThreadPool worker");
+
+    for (;;)
+    {
+        std::function <void()> task;
+        {
+            std::unique_lock <std::mutex> lock (m_mutex);
+            m_wakeUp.wait (lock, [this] { return m_isStopping || !m_tasks.empty(); });
+
+            if (m_tasks.empty())
+                return;
+
+            task = std::move (m_tasks.front());
+            m_tasks.pop();
+        }
+        task();
+    }
+}
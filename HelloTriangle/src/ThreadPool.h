@@ -0,0 +1,56 @@
+#ifndef THREAD_POOL_INCLUDED
+#define THREAD_POOL_INCLUDED
+
+#include <vector>
+#include <queue>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <functional>
+#include <future>
+#include <memory>
+#include <type_traits>
+
+class ThreadPool
+{
+public:
+    explicit ThreadPool (size_t threadCount = defaultThreadCount());
+   ~ThreadPool();
+
+    template <typename Task>
+    auto   submit (Task &&task) -> std::future <std::invoke_result_t <Task>>;
+
+    size_t size() const;
+
+    static size_t defaultThreadCount();
+
+private:
+    std::vector <std::thread>           m_workers;
+    std::queue  <std::function <void()>> m_tasks;
+    std::mutex                          m_mutex;
+    std::condition_variable             m_wakeUp;
+    bool                                m_isStopping;
+
+    void   workerLoop();
+
+    ThreadPool             (const ThreadPool &other) = delete;
+    ThreadPool &operator = (const ThreadPool &other) = delete;
+};
+
+template <typename Task>
+auto ThreadPool::submit (Task &&task) -> std::future <std::invoke_result_t <Task>>
+{
+    using Result = std::invoke_result_t <Task>;
+
+    auto packaged = std::make_shared <std::packaged_task <Result()>> (std::forward <Task> (task));
+    std::future <Result> result = packaged->get_future();
+    {
+        std::lock_guard <std::mutex> lock (m_mutex);
+        m_tasks.emplace ([packaged] { (*packaged)(); });
+    }
+    m_wakeUp.notify_one();
+
+    return result;
+}
+
+#endif // !THREAD_POOL_INCLUDED
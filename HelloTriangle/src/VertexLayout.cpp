@@ -0,0 +1,236 @@
+#include "VertexLayout.h"
+#include "VertexQuantize.h"
+
+#include <cassert>
+#include <cstdint>
+#include <cstring>
+#include <algorithm>
+
+// Vertices encoded a block at a time, so the staging arrays stay in L1 and
+// the output is written once per block rather than once per element
+static const size_t ENCODE_BLOCK = 256;
+
+static size_t elementSize (const VertexElement &element);
+static GLuint alignUp     (size_t value, size_t alignment);
+static void   quantize    (VertexEncoding encoding, const float *values, size_t count, size_t components,
+                           void *output);
+static void   scatter     (const uint8_t *encoded, size_t size, size_t count, char *target, size_t stride);
+
+template <size_t SIZE>
+static void   scatter     (const uint8_t *encoded, size_t count, char *target, size_t stride);
+
+
+bool operator == (const VertexAttribute &lhs, const VertexAttribute &rhs)
+{
+    return lhs.location   == rhs.location   &&
+           lhs.components == rhs.components &&
+           lhs.type       == rhs.type       &&
+           lhs.normalized == rhs.normalized &&
+           lhs.offset     == rhs.offset;
+}
+
+bool operator == (const VertexFormat &lhs, const VertexFormat &rhs)
+{
+    return lhs.stride == rhs.stride && lhs.attributes == rhs.attributes;
+}
+
+void setVertexFormat (GLuint vao, const VertexFormat &format, GLuint binding)
+{
+    for (const VertexAttribute &attribute : format.attributes)
+    {
+        glVertexArrayAttribFormat  (vao, attribute.location, attribute.components, attribute.type,
+                                    attribute.normalized, attribute.offset);
+        glVertexArrayAttribBinding (vao, attribute.location, binding);
+        glEnableVertexArrayAttrib  (vao, attribute.location);
+    }
+}
+
+VertexLayout::VertexLayout (std::initializer_list <VertexElement> elements)
+    : m_elements (elements), m_format()
+{
+    GLuint offset = 0;
+    for (const VertexElement &element : m_elements)
+    {
+        assert (element.components >= 1 && element.components <= 4);
+        assert (element.encoding != VertexEncoding::Octahedral || element.components == 3);
+
+        VertexAttribute attribute = { element.location, element.components, GL_FLOAT, GL_FALSE, offset };
+        switch (element.encoding)
+        {
+        case VertexEncoding::Float:
+            break;
+        case VertexEncoding::Half:
+            attribute.type = GL_HALF_FLOAT;
+            break;
+        case VertexEncoding::Snorm16:
+            attribute.type       = GL_SHORT;
+            attribute.normalized = GL_TRUE;
+            break;
+        case VertexEncoding::Unorm8:
+            attribute.type       = GL_UNSIGNED_BYTE;
+            attribute.normalized = GL_TRUE;
+            break;
+        case VertexEncoding::Octahedral:
+            attribute.type       = GL_SHORT;
+            attribute.normalized = GL_TRUE;
+            attribute.components = 2;
+            break;
+        }
+
+        m_format.attributes.push_back (attribute);
+        offset += alignUp (elementSize (element), 4);
+    }
+    m_format.stride = static_cast <GLsizei> (offset);
+}
+
+const std::vector <VertexElement> &VertexLayout::elements() const
+{
+    return m_elements;
+}
+
+const VertexFormat &VertexLayout::format() const
+{
+    return m_format;
+}
+
+GLsizei VertexLayout::stride() const
+{
+    return m_format.stride;
+}
+
+void VertexLayout::encode (const float *const *sources, size_t count, void *output) const
+{
+    float   scaled[ENCODE_BLOCK * 4];
+    uint8_t packed[ENCODE_BLOCK * 4 * sizeof (float)];
+
+    const size_t stride   = static_cast <size_t> (m_format.stride);
+    char        *vertices = static_cast <char *> (output);
+
+    for (size_t first = 0; first < count; first += ENCODE_BLOCK)
+    {
+        const size_t blockCount = std::min (ENCODE_BLOCK, count - first);
+
+        for (size_t e = 0; e < m_elements.size(); ++e)
+        {
+            const VertexElement &element    = m_elements[e];
+            const size_t         components = static_cast <size_t> (element.components);
+
+            const float *values = sources[e] + first * components;
+            if (element.scale != glm::vec4 (1.0f) || element.bias != glm::vec4 (0.0f))
+            {
+                for (size_t i = 0; i < blockCount * components; i += components)
+                    for (size_t c = 0; c < components; ++c)
+                        scaled[i + c] = values[i + c] * element.scale[c] + element.bias[c];
+                values = scaled;
+            }
+
+            const uint8_t *encoded = reinterpret_cast <const uint8_t *> (values);
+            if (element.encoding != VertexEncoding::Float)
+            {
+                quantize (element.encoding, values, blockCount, components, packed);
+                encoded = packed;
+            }
+
+            scatter (encoded, elementSize (element), blockCount,
+                     vertices + first * stride + m_format.attributes[e].offset, stride);
+        }
+    }
+}
+
+void VertexLayout::apply (GLuint vao) const
+{
+    setVertexFormat (vao, m_format, 0);
+}
+
+void VertexLayout::fitRange (VertexElement &element, const float *values, size_t count)
+{
+    const bool isSigned = element.encoding == VertexEncoding::Snorm16;
+    if (!isSigned && element.encoding != VertexEncoding::Unorm8)
+        return;
+
+    for (int c = 0; c < element.components; ++c)
+    {
+        float low  = count > 0 ? values[c] : 0.0f;
+        float high = low;
+        for (size_t i = 0; i < count; ++i)
+        {
+            low  = std::min (low,  values[i * element.components + c]);
+            high = std::max (high, values[i * element.components + c]);
+        }
+
+        const float extent = high > low ? high - low : 1.0f;
+        element.scale[c] = (isSigned ? 2.0f : 1.0f) / extent;
+        element.bias[c]  = isSigned ? -(high + low) / extent : -low / extent;
+    }
+}
+
+static size_t elementSize (const VertexElement &element)
+{
+    const size_t components = static_cast <size_t> (element.components);
+    switch (element.encoding)
+    {
+    case VertexEncoding::Float:      return components * sizeof (float);
+    case VertexEncoding::Half:       return components * sizeof (uint16_t);
+    case VertexEncoding::Snorm16:    return components * sizeof (int16_t);
+    case VertexEncoding::Unorm8:     return components * sizeof (uint8_t);
+    case VertexEncoding::Octahedral: return 2 * sizeof (int16_t);
+    }
+    return 0;
+}
+
+static GLuint alignUp (size_t value, size_t alignment)
+{
+    return static_cast <GLuint> ((value + alignment - 1) / alignment * alignment);
+}
+
+static void quantize (VertexEncoding encoding, const float *values, size_t count, size_t components, void *output)
+{
+    switch (encoding)
+    {
+    case VertexEncoding::Float:
+        memcpy (output, values, count * components * sizeof (float));
+        break;
+    case VertexEncoding::Half:
+        quantizeHalf (values, static_cast <uint16_t *> (output), count * components);
+        break;
+    case VertexEncoding::Snorm16:
+        quantizeSnorm16 (values, static_cast <int16_t *> (output), count * components);
+        break;
+    case VertexEncoding::Unorm8:
+        quantizeUnorm8 (values, static_cast <uint8_t *> (output), count * components);
+        break;
+    case VertexEncoding::Octahedral:
+        quantizeOctahedral (values, static_cast <int16_t *> (output), count);
+        break;
+    }
+}
+
+// Fixed sizes let every copy compile down to a load and a store or two
+static void scatter (const uint8_t *encoded, size_t size, size_t count, char *target, size_t stride)
+{
+    switch (size)
+    {
+    case 1:  scatter <1>  (encoded, count, target, stride); break;
+    case 2:  scatter <2>  (encoded, count, target, stride); break;
+    case 3:  scatter <3>  (encoded, count, target, stride); break;
+    case 4:  scatter <4>  (encoded, count, target, stride); break;
+    case 6:  scatter <6>  (encoded, count, target, stride); break;
+    case 8:  scatter <8>  (encoded, count, target, stride); break;
+    case 12: scatter <12> (encoded, count, target, stride); break;
+    case 16: scatter <16> (encoded, count, target, stride); break;
+    default: assert (false && "Unexpected element size");
+    }
+}
+
+// Each element goes out padded to 4 bytes with zeros
+template <size_t SIZE>
+static void scatter (const uint8_t *encoded, size_t count, char *target, size_t stride)
+{
+    const size_t PADDED = (SIZE + 3) / 4 * 4;
+    for (size_t i = 0; i < count; ++i, encoded += SIZE, target += stride)
+    {
+        uint8_t element[PADDED] = {};
+        memcpy (element, encoded, SIZE);
+        memcpy (target, element, PADDED);
+    }
+}
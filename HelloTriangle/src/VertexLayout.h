@@ -0,0 +1,79 @@
+#ifndef VERTEX_LAYOUT_INCLUDED
+#define VERTEX_LAYOUT_INCLUDED
+
+#include <vector>
+#include <cstddef>
+#include <initializer_list>
+#include <glm/glm.hpp>
+#include <glad/glad.h>
+
+struct VertexAttribute
+{
+    GLuint    location;
+    GLint     components;
+    GLenum    type;
+    GLboolean normalized;
+    GLuint    offset;
+};
+
+struct VertexFormat
+{
+    std::vector <VertexAttribute> attributes;
+    GLsizei                       stride;
+};
+
+bool operator == (const VertexAttribute &lhs, const VertexAttribute &rhs);
+bool operator == (const VertexFormat    &lhs, const VertexFormat    &rhs);
+
+// Formats, binds and enables every attribute of format on vao, all read from binding
+void setVertexFormat (GLuint vao, const VertexFormat &format, GLuint binding);
+
+enum class VertexEncoding
+{
+    Float,
+    Half,
+    Snorm16,        // [-1, 1], read back normalized
+    Unorm8,         // [0, 1], read back normalized
+    Octahedral      // unit vector of 3 floats as 2 snorm16, the shader unfolds it
+};
+
+// One attribute of a layout, encoded from components floats a vertex.
+// Values go through value * scale + bias first, to bring them into the
+// range of a normalized encoding; the shader applies the inverse
+struct VertexElement
+{
+    GLuint         location;
+    GLint          components;
+    VertexEncoding encoding;
+    glm::vec4      scale = glm::vec4 (1.0f);
+    glm::vec4      bias  = glm::vec4 (0.0f);
+};
+
+// An interleaved vertex described by its elements, laid out in order with
+// each one padded to 4 bytes. It gives the VertexFormat the GL needs and
+// encodes float streams into it with the quantizers of VertexQuantize.h
+class VertexLayout
+{
+public:
+    VertexLayout (std::initializer_list <VertexElement> elements);
+
+    const std::vector <VertexElement> &elements() const;
+    const VertexFormat                &format() const;
+    GLsizei                            stride() const;
+
+    // sources holds one tightly packed stream per element, in order. Writes
+    // count * stride() bytes, padding zeroed
+    void encode (const float *const *sources, size_t count, void *output) const;
+
+    // The format on binding 0 of vao
+    void apply (GLuint vao) const;
+
+    // Sets scale and bias so values span the encoding's range, per component
+    static void fitRange (VertexElement &element, const float *values, size_t count);
+
+private:
+    std::vector <VertexElement> m_elements;
+    VertexFormat                m_format;
+};
+
+#endif // !VERTEX_LAYOUT_INCLUDED
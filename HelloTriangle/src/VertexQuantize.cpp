@@ -0,0 +1,301 @@
+#include "VertexQuantize.h"
+
+#include <cmath>
+#include <cstring>
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define QUANTIZE_SSE2
+#include <emmintrin.h>
+#endif
+
+static uint16_t halfFromFloat  (float value);
+static float    clampFloat     (float value, float low, float high);
+static int16_t  snorm16        (float value);
+static uint32_t bitsOf         (float value);
+static float    floatOf        (uint32_t bits);
+
+#ifdef QUANTIZE_SSE2
+static __m128i  halfFromFloat4 (__m128 value);
+static __m128i  snorm16From4   (__m128 value);
+#endif
+
+
+void quantizeHalfScalar (const float *input, uint16_t *output, size_t count)
+{
+    for (size_t i = 0; i < count; ++i)
+        output[i] = halfFromFloat (input[i]);
+}
+
+void quantizeSnorm16Scalar (const float *input, int16_t *output, size_t count)
+{
+    for (size_t i = 0; i < count; ++i)
+        output[i] = snorm16 (input[i]);
+}
+
+void quantizeUnorm8Scalar (const float *input, uint8_t *output, size_t count)
+{
+    for (size_t i = 0; i < count; ++i)
+        output[i] = static_cast <uint8_t> (lrintf (clampFloat (input[i], 0.0f, 1.0f) * 255.0f));
+}
+
+// Projects onto |x| + |y| + |z| = 1, then folds the lower half over the diagonals
+void quantizeOctahedralScalar (const float *input, int16_t *output, size_t count)
+{
+    for (size_t i = 0; i < count; ++i)
+    {
+        const float *normal = input + 3 * i;
+        const float  scale  = 1.0f / (std::fabs (normal[0]) + std::fabs (normal[1]) + std::fabs (normal[2]));
+
+        float x = normal[0] * scale;
+        float y = normal[1] * scale;
+        if (normal[2] < 0.0f)
+        {
+            const float foldedX = (1.0f - std::fabs (y)) * std::copysign (1.0f, x);
+            const float foldedY = (1.0f - std::fabs (x)) * std::copysign (1.0f, y);
+            x = foldedX;
+            y = foldedY;
+        }
+        output[2 * i]     = snorm16 (x);
+        output[2 * i + 1] = snorm16 (y);
+    }
+}
+
+#ifdef QUANTIZE_SSE2
+
+void quantizeHalf (const float *input, uint16_t *output, size_t count)
+{
+    size_t i = 0;
+    for (; i + 8 <= count; i += 8)
+    {
+        const __m128i low  = halfFromFloat4 (_mm_loadu_ps (input + i));
+        const __m128i high = halfFromFloat4 (_mm_loadu_ps (input + i + 4));
+        // Negative halves are negative 32 bit values here, so the signed pack keeps every bit
+        _mm_storeu_si128 (reinterpret_cast <__m128i *> (output + i), _mm_packs_epi32 (low, high));
+    }
+    quantizeHalfScalar (input + i, output + i, count - i);
+}
+
+void quantizeSnorm16 (const float *input, int16_t *output, size_t count)
+{
+    size_t i = 0;
+    for (; i + 8 <= count; i += 8)
+    {
+        const __m128i low  = snorm16From4 (_mm_loadu_ps (input + i));
+        const __m128i high = snorm16From4 (_mm_loadu_ps (input + i + 4));
+        _mm_storeu_si128 (reinterpret_cast <__m128i *> (output + i), _mm_packs_epi32 (low, high));
+    }
+    quantizeSnorm16Scalar (input + i, output + i, count - i);
+}
+
+void quantizeUnorm8 (const float *input, uint8_t *output, size_t count)
+{
+    const __m128 zero  = _mm_setzero_ps();
+    const __m128 one   = _mm_set1_ps (1.0f);
+    const __m128 scale = _mm_set1_ps (255.0f);
+    auto convert = [&] (const float *values)
+    {
+        const __m128 clamped = _mm_min_ps (_mm_max_ps (_mm_loadu_ps (values), zero), one);
+        return _mm_cvtps_epi32 (_mm_mul_ps (clamped, scale));
+    };
+
+    size_t i = 0;
+    for (; i + 16 <= count; i += 16)
+    {
+        const __m128i low  = _mm_packs_epi32 (convert (input + i),     convert (input + i + 4));
+        const __m128i high = _mm_packs_epi32 (convert (input + i + 8), convert (input + i + 12));
+        _mm_storeu_si128 (reinterpret_cast <__m128i *> (output + i), _mm_packus_epi16 (low, high));
+    }
+    quantizeUnorm8Scalar (input + i, output + i, count - i);
+}
+
+// Four vectors at a time, gathered into x, y and z registers
+void quantizeOctahedral (const float *input, int16_t *output, size_t count)
+{
+    const __m128 sign = _mm_set1_ps (-0.0f);
+    const __m128 one  = _mm_set1_ps (1.0f);
+
+    size_t i = 0;
+    for (; i + 4 <= count; i += 4)
+    {
+        const float *n = input + 3 * i;
+        const __m128 x = _mm_setr_ps (n[0], n[3], n[6], n[9]);
+        const __m128 y = _mm_setr_ps (n[1], n[4], n[7], n[10]);
+        const __m128 z = _mm_setr_ps (n[2], n[5], n[8], n[11]);
+
+        const __m128 absX  = _mm_andnot_ps (sign, x);
+        const __m128 absY  = _mm_andnot_ps (sign, y);
+        const __m128 absZ  = _mm_andnot_ps (sign, z);
+        const __m128 scale = _mm_div_ps (one, _mm_add_ps (_mm_add_ps (absX, absY), absZ));
+
+        const __m128 px = _mm_mul_ps (x, scale);
+        const __m128 py = _mm_mul_ps (y, scale);
+        const __m128 foldedX = _mm_mul_ps (_mm_sub_ps (one, _mm_andnot_ps (sign, py)),
+                                           _mm_or_ps (one, _mm_and_ps (px, sign)));
+        const __m128 foldedY = _mm_mul_ps (_mm_sub_ps (one, _mm_andnot_ps (sign, px)),
+                                           _mm_or_ps (one, _mm_and_ps (py, sign)));
+
+        const __m128 isLower = _mm_cmplt_ps (z, _mm_setzero_ps());
+        const __m128 outX    = _mm_or_ps (_mm_and_ps (isLower, foldedX), _mm_andnot_ps (isLower, px));
+        const __m128 outY    = _mm_or_ps (_mm_and_ps (isLower, foldedY), _mm_andnot_ps (isLower, py));
+
+        // x0 x1 x2 x3 y0 y1 y2 y3, then interleaved into pairs
+        const __m128i packed = _mm_packs_epi32 (snorm16From4 (outX), snorm16From4 (outY));
+        _mm_storeu_si128 (reinterpret_cast <__m128i *> (output + 2 * i),
+                          _mm_unpacklo_epi16 (packed, _mm_srli_si128 (packed, 8)));
+    }
+    quantizeOctahedralScalar (input + 3 * i, output + 2 * i, count - i);
+}
+
+bool isQuantizeVectorized()
+{
+    return true;
+}
+
+#else
+
+void quantizeHalf (const float *input, uint16_t *output, size_t count)
+{
+    quantizeHalfScalar (input, output, count);
+}
+
+void quantizeSnorm16 (const float *input, int16_t *output, size_t count)
+{
+    quantizeSnorm16Scalar (input, output, count);
+}
+
+void quantizeUnorm8 (const float *input, uint8_t *output, size_t count)
+{
+    quantizeUnorm8Scalar (input, output, count);
+}
+
+void quantizeOctahedral (const float *input, int16_t *output, size_t count)
+{
+    quantizeOctahedralScalar (input, output, count);
+}
+
+bool isQuantizeVectorized()
+{
+    return false;
+}
+
+#endif
+
+float dequantizeHalf (uint16_t value)
+{
+    const uint32_t sign     = static_cast <uint32_t> (value & 0x8000) << 16;
+    const uint32_t exponent = (value >> 10) & 0x1f;
+    const uint32_t mantissa = value & 0x3ff;
+
+    if (exponent == 0)
+        return floatOf (sign | bitsOf (std::ldexp (static_cast <float> (mantissa), -24)));
+    if (exponent == 31)
+        return floatOf (sign | 0x7f800000u | (mantissa << 13));
+    return floatOf (sign | ((exponent + 127 - 15) << 23) | (mantissa << 13));
+}
+
+float dequantizeSnorm16 (int16_t value)
+{
+    return std::fmax (value / 32767.0f, -1.0f);
+}
+
+float dequantizeUnorm8 (uint8_t value)
+{
+    return value / 255.0f;
+}
+
+glm::vec3 dequantizeOctahedral (int16_t x, int16_t y)
+{
+    glm::vec3 normal (dequantizeSnorm16 (x), dequantizeSnorm16 (y), 0.0f);
+    normal.z = 1.0f - std::fabs (normal.x) - std::fabs (normal.y);
+    if (normal.z < 0.0f)
+    {
+        const float foldedX = (1.0f - std::fabs (normal.y)) * std::copysign (1.0f, normal.x);
+        const float foldedY = (1.0f - std::fabs (normal.x)) * std::copysign (1.0f, normal.y);
+        normal.x = foldedX;
+        normal.y = foldedY;
+    }
+    return glm::normalize (normal);
+}
+
+// Round to nearest even through integer arithmetic on the float bits:
+// the half mantissa's last bit decides which way a tie goes
+static uint16_t halfFromFloat (float value)
+{
+    const uint32_t SUBNORMAL_MAGIC = ((127 - 15) + (23 - 10) + 1) << 23;
+
+    uint32_t       bits = bitsOf (value);
+    const uint32_t sign = bits & 0x80000000u;
+    bits ^= sign;
+
+    uint32_t half;
+    if (bits >= (127 + 16) << 23)          // overflows to infinity, or is one
+        half = bits > 0x7f800000u ? 0x7e00 : 0x7c00;
+    else if (bits < (127 - 14) << 23)      // a subnormal half or zero
+        half = bitsOf (floatOf (bits) + floatOf (SUBNORMAL_MAGIC)) - SUBNORMAL_MAGIC;
+    else
+        half = (bits + ((15u - 127u) << 23) + 0xfff + ((bits >> 13) & 1)) >> 13;
+
+    return static_cast <uint16_t> (half | (sign >> 16));
+}
+
+// Written as compare and select so NaN clamps to low like _mm_max_ps does
+static float clampFloat (float value, float low, float high)
+{
+    value = value > low  ? value : low;
+    return  value < high ? value : high;
+}
+
+static int16_t snorm16 (float value)
+{
+    return static_cast <int16_t> (lrintf (clampFloat (value, -1.0f, 1.0f) * 32767.0f));
+}
+
+static uint32_t bitsOf (float value)
+{
+    uint32_t bits;
+    memcpy (&bits, &value, sizeof (bits));
+    return bits;
+}
+
+static float floatOf (uint32_t bits)
+{
+    float value;
+    memcpy (&value, &bits, sizeof (value));
+    return value;
+}
+
+#ifdef QUANTIZE_SSE2
+
+// halfFromFloat on four lanes, every branch computed and selected by mask
+static __m128i halfFromFloat4 (__m128 value)
+{
+    const __m128i SUBNORMAL_MAGIC = _mm_set1_epi32 (((127 - 15) + (23 - 10) + 1) << 23);
+    const __m128i NORMAL_BIAS     = _mm_set1_epi32 (0xfff - ((127 - 15) << 23));
+
+    const __m128  sign = _mm_and_ps (value, _mm_set1_ps (-0.0f));
+    const __m128  abs  = _mm_xor_ps (value, sign);
+    const __m128i bits = _mm_castps_si128 (abs);
+
+    const __m128i isNaN       = _mm_castps_si128 (_mm_cmpunord_ps (abs, abs));
+    const __m128i isFinite    = _mm_cmpgt_epi32 (_mm_set1_epi32 ((127 + 16) << 23), bits);
+    const __m128i isSubnormal = _mm_cmpgt_epi32 (_mm_set1_epi32 ((127 - 14) << 23), bits);
+    const __m128i infinity    = _mm_or_si128 (_mm_and_si128 (isNaN, _mm_set1_epi32 (0x200)), _mm_set1_epi32 (0x7c00));
+
+    const __m128i subnormal = _mm_sub_epi32 (_mm_castps_si128 (_mm_add_ps (abs, _mm_castsi128_ps (SUBNORMAL_MAGIC))),
+                                             SUBNORMAL_MAGIC);
+
+    const __m128i isOdd  = _mm_srai_epi32 (_mm_slli_epi32 (bits, 31 - 13), 31);
+    const __m128i normal = _mm_srli_epi32 (_mm_sub_epi32 (_mm_add_epi32 (bits, NORMAL_BIAS), isOdd), 13);
+
+    const __m128i finite = _mm_or_si128 (_mm_and_si128 (isSubnormal, subnormal), _mm_andnot_si128 (isSubnormal, normal));
+    const __m128i half   = _mm_or_si128 (_mm_and_si128 (isFinite, finite), _mm_andnot_si128 (isFinite, infinity));
+    return _mm_or_si128 (half, _mm_srai_epi32 (_mm_castps_si128 (sign), 16));
+}
+
+static __m128i snorm16From4 (__m128 value)
+{
+    const __m128 clamped = _mm_min_ps (_mm_max_ps (value, _mm_set1_ps (-1.0f)), _mm_set1_ps (1.0f));
+    return _mm_cvtps_epi32 (_mm_mul_ps (clamped, _mm_set1_ps (32767.0f)));
+}
+
+#endif
@@ -0,0 +1,35 @@
+#ifndef VERTEX_QUANTIZE_INCLUDED
+#define VERTEX_QUANTIZE_INCLUDED
+
+#include <cstddef>
+#include <cstdint>
+#include <glm/glm.hpp>
+
+// Bulk float to vertex attribute conversions. The plain versions use SSE2
+// when the target has it, the Scalar ones are the reference they must match
+// bit for bit. Rounding is to nearest even, out of range values clamp, the
+// same way the GL reads them back:
+//   half     IEEE binary16, infinities and NaNs kept
+//   snorm16  round (clamp (x, -1, 1) * 32767)
+//   unorm8   round (clamp (x,  0, 1) * 255)
+//   octahedral: a unit vector folded onto the octahedron, two snorm16
+// count is in floats, for octahedral in vectors of 3 floats (2 outputs each)
+void quantizeHalf         (const float *input, uint16_t *output, size_t count);
+void quantizeSnorm16      (const float *input, int16_t  *output, size_t count);
+void quantizeUnorm8       (const float *input, uint8_t  *output, size_t count);
+void quantizeOctahedral   (const float *input, int16_t  *output, size_t count);
+
+void quantizeHalfScalar       (const float *input, uint16_t *output, size_t count);
+void quantizeSnorm16Scalar    (const float *input, int16_t  *output, size_t count);
+void quantizeUnorm8Scalar     (const float *input, uint8_t  *output, size_t count);
+void quantizeOctahedralScalar (const float *input, int16_t  *output, size_t count);
+
+float     dequantizeHalf       (uint16_t value);
+float     dequantizeSnorm16    (int16_t value);
+float     dequantizeUnorm8     (uint8_t value);
+glm::vec3 dequantizeOctahedral (int16_t x, int16_t y);
+
+// Whether the plain versions run vectorized in this build
+bool isQuantizeVectorized();
+
+#endif // !VERTEX_QUANTIZE_INCLUDED
@@ -2,40 +2,61 @@
 #include <GLFW/glfw3.h>
  
 #include <iostream>
-#include <exception>
+#include <stdexcept>
 #include <ctime>
+#include <cmath>
+#include <string>
+#include <vector>
+#include <memory>
+#include <algorithm>
 
 #include "GLSLProgram.h"
+#include "AsyncShaderCompiler.h"
+#include "ShaderReloader.h"
+#include "StreamBuffer.h"
+#include "GLStateCache.h"
+#include "DrawQueue.h"
+#include "Profiler.h"
+#include "BakedScene.h"
+#include "VertexLayout.h"
+#include "FrustumCuller.h"
+#include "JobSystem.h"
  
 const unsigned int SCR_WIDTH  = 800;
 const unsigned int SCR_HEIGHT = 600;
 
+// Visible draws a job turns into commands
+const size_t DRAWS_PER_JOB = 256;
+
+// What the jobs build for one frame while the GL thread draws the one before
+struct FrameWork
+{
+    std::vector <GLuint>                        programs;       // a material's program, 0 until it's linked
+    std::vector <std::shared_ptr <GLSLProgram>> programRefs;    // keep them alive while the frame is in flight
+    std::vector <uint32_t>                      visible;
+    size_t                                      visibleCount = 0;
+    std::vector <CommandBuffer>                 commands;       // one a job thread
+    JobSystem::Counter                          culled;
+    JobSystem::Counter                          done;
+};
+
 void framebuffer_size_callback (GLFWwindow* window, int width, int height);
 void processInput (GLFWwindow* window);
 GLFWwindow *initGLFWwindowAndGlad (
     int major_ver, int minor_ver, int profile, unsigned int width, 
     unsigned int height, const char *w_name, GLFWframebuffersizefun cbfun
 );
+GLuint createStreamVertexArray (const StreamBuffer &stream);
+void   drawStreamedFan (StreamBuffer &stream, GLuint vao, const GLSLProgram &program, float time);
 
-float first_triangle[] = 
-{                          
-    -0.5f, -0.5f, 1.0f,               
-     1.0f,  0.0f, 0.0f,  // color
-     0.5f, -0.5f, 0.0f,                        
-     0.0f,  1.0f, 0.0f,  // color
-    -0.5f,  0.5f, 1.0f,                                 
-     0.0f,  0.0f, 1.0f,  // color
-};
+GLuint createMeshVertexArray (const BakedMesh &mesh, GLuint vertexBuffer, GLuint indexBuffer);
 
-float second_triangle[] =
-{                                        
-    -0.5f,  0.5f, 1.0f,  // vert                        
-     0.0f,  0.0f, 1.0f,  // color
-     0.5f,  0.5f, 0.0f,  // vert                             
-     1.0f,  0.0f, 0.0f,  // color
-     0.5f, -0.5f, 1.0f,  // vert               
-     0.0f,  1.0f, 0.0f,  // color
- };
+void snapshotPrograms (FrameWork &frame, const BakedScene &scene,
+                       const std::vector <AsyncShaderCompiler::Handle> &programs);
+void buildFrame  (JobSystem &jobs, FrameWork &frame, FrustumCuller &culler, const Frustum &frustum,
+                  const BakedScene &scene, const std::vector <GLuint> &meshVAOs);
+void recordDraws (const FrameWork &frame, CommandBuffer &commands, const BakedScene &scene,
+                  const std::vector <GLuint> &meshVAOs, size_t begin, size_t end);
 
 
 int main()
@@ -45,58 +66,154 @@ int main()
         "Huge tiangles", framebuffer_size_callback
     );
 
-    GLSLProgram shaderProgram;
-    try {                                                 
-        shaderProgram.compileShader ("../res/Shaders/triangle.vert");                    
-        shaderProgram.compileShader ("../res/Shaders/triangle.frag");
-        shaderProgram.link();
-        shaderProgram.use();
-    } catch (const GLSLProgramException &ex) {
-        std::cout << ex.what() << std::endl;
+    ProgramBinaryCache  binaryCache ("../res/cache");
+    ShaderPreprocessor  preprocessor ("../res/shaders");
+    ThreadPool          shaderPool;
+    AsyncShaderCompiler shaderCompiler (shaderPool, (GLADloadproc)glfwGetProcAddress, 
+                                        &binaryCache, &preprocessor);
+    ShaderReloader      shaderReloader (shaderCompiler, &preprocessor);
+
+    const BakedScene scene = BakedScene::loadOrBake ("../res/scenes/triangles.json", "../res/cache/triangles.scene");
+
+    std::vector <AsyncShaderCompiler::Handle> programs;
+    for (const BakedProgram &program : scene.programs())
+    {
+        programs.push_back (shaderCompiler.submit (
+            { std::string ("../res/shaders/") + scene.string (program.vertex),
+              std::string ("../res/shaders/") + scene.string (program.fragment) }
+        ));
+        shaderReloader.track (programs.back());
     }
 
-    unsigned int VBO[2] = {}; 
-    unsigned int VAO[2] = {};
-    glGenVertexArrays (2, VAO);
-    glGenBuffers      (2, VBO);
- 
-    glBindVertexArray (VAO[0]);
-    glBindBuffer (GL_ARRAY_BUFFER, VAO[0]);
-    glBufferData (GL_ARRAY_BUFFER, sizeof (first_triangle), first_triangle, GL_STATIC_DRAW);
-    glVertexAttribPointer (0, 3, GL_FLOAT, GL_FALSE, 6 * sizeof (float), (void*)0);
-    glEnableVertexAttribArray (0);
-    glVertexAttribPointer (1, 3, GL_FLOAT, GL_FALSE, 6 * sizeof (float), (void*)(3*sizeof (float)));
-    glEnableVertexAttribArray (1);
-
-    glBindVertexArray (VAO[1]);
-    glBindBuffer (GL_ARRAY_BUFFER, VAO[1]);
-    glBufferData (GL_ARRAY_BUFFER, sizeof (second_triangle), second_triangle, GL_STATIC_DRAW);
-    glVertexAttribPointer (0, 3, GL_FLOAT, GL_FALSE, 2 * 3 * sizeof (float), (void*)0);
-    glEnableVertexAttribArray (0);                                                                     
-    glVertexAttribPointer (1, 3, GL_FLOAT, GL_FALSE, 6 * sizeof (float), (void*)(3*sizeof (float)));
-    glEnableVertexAttribArray (1);
+    GLStateCache &glState = GLStateCache::current();
+
+    // The baked sections go up straight from the mapping
+    GLuint sceneBuffers[2] = {};
+    std::vector <GLuint> meshVAOs;
+    {
+        PROFILE_SCOPE ("Upload");
+        glCreateBuffers (2, sceneBuffers);
+        glNamedBufferStorage (sceneBuffers[0], scene.vertexBytes(), scene.vertices(), 0);
+        glNamedBufferStorage (sceneBuffers[1], scene.indexBytes(),  scene.indices(),  0);
+
+        for (const BakedMesh &mesh : scene.meshes())
+            meshVAOs.push_back (createMeshVertexArray (mesh, sceneBuffers[0], sceneBuffers[1]));
+    }
+
+    // A draw's id in the culler is its index. The scene is in clip space
+    // already, so the frustum is that of the identity
+    FrustumCuller culler;
+    for (const BakedDraw &draw : scene.draws())
+    {
+        const BakedMesh &mesh = scene.meshes()[draw.mesh];
+        culler.add ({ glm::vec3 (mesh.boundsMin[0], mesh.boundsMin[1], mesh.boundsMin[2]),
+                      glm::vec3 (mesh.boundsMax[0], mesh.boundsMax[1], mesh.boundsMax[2]) });
+    }
+    const Frustum frustum = Frustum::fromViewProjection (glm::mat4 (1.0f));
+
+    // Frame N + 1 is culled and recorded on the jobs while this thread
+    // replays frame N, so the two alternate between a pair of FrameWorks
+    JobSystem jobs;
+    FrameWork frames[2];
+    for (FrameWork &frame : frames)
+    {
+        frame.programs.resize    (scene.materials().size());
+        frame.programRefs.resize (scene.materials().size());
+        frame.visible.resize     (culler.capacity());
+        frame.commands.resize    (jobs.threadCount());
+    }
+    size_t current = 0;
+
+    StreamBuffer streamBuffer (64 * 1024);
+    GLuint       streamVAO = createStreamVertexArray (streamBuffer);
+    DrawQueue    drawQueue;
 
     //glPolygonMode (GL_FRONT_AND_BACK, GL_LINE);
     
+    PROFILE_THREAD_NAME ("Main");
+
+    snapshotPrograms (frames[current], scene, programs);
+    buildFrame (jobs, frames[current], culler, frustum, scene, meshVAOs);
+    jobs.wait (frames[current].done);
+    bool isShaderLoadReported = false;
+
     while (!glfwWindowShouldClose(window))
     {
+        PROFILE_SCOPE ("Frame");
         processInput(window);
  
         glClearColor (0.2f, 0.3f, 0.3f, 1.0f);
         glClear (GL_COLOR_BUFFER_BIT);
+        glState.resetStats();
+        streamBuffer.beginFrame();
+
+        for (const ShaderReloader::Reload &reload : shaderReloader.poll())
+        {
+            if (reload.isFailed)
+                std::cout << "Keeping the last good program, the reload failed:\n" << reload.error << std::endl;
+            else
+                std::cout << "Reloaded " << reload.program->files().front() << std::endl;
+        }
+
+        if (shaderCompiler.pendingCount() > 0)
+        {
+            PROFILE_SCOPE ("Compile");
+            shaderCompiler.poll();
+            if (shaderCompiler.pendingCount() == 0 && !isShaderLoadReported)
+            {
+                isShaderLoadReported = true;
+                for (const AsyncShaderCompiler::Handle &program : programs)
+                {
+                    if (program->isFailed())
+                        std::cout << program->error() << std::endl;
+                }
+                binaryCache.printStats (std::cout);
+            }
+        }
+
+        FrameWork &frame = frames[current];
+        FrameWork &next  = frames[current ^ 1];
+        snapshotPrograms (next, scene, programs);
+        buildFrame (jobs, next, culler, frustum, scene, meshVAOs);
 
-        glBindVertexArray (VAO[0]); 
-        glDrawArrays (GL_TRIANGLES, 0, 3);
+        {
+            PROFILE_GPU_SCOPE ("Draw");
+            for (const CommandBuffer &commands : frame.commands)
+                drawQueue.submit (commands);
+            drawQueue.execute (glState);
 
-        glBindVertexArray (VAO[1]); 
-        glDrawArrays (GL_TRIANGLES, 0, 3);
+            if (!programs.empty() && programs[0]->isReady())
+                drawStreamedFan (streamBuffer, streamVAO, *programs[0]->program(), static_cast <float> (glfwGetTime()));
+        }
+
+        streamBuffer.endFrame();
        
-        glfwSwapBuffers (window);
-        glfwPollEvents();
+        {
+            PROFILE_SCOPE ("glfwSwapBuffers");
+            glfwSwapBuffers (window);
+        }
+        {
+            PROFILE_SCOPE ("glfwPollEvents");
+            glfwPollEvents();
+        }
+        {
+            PROFILE_SCOPE ("Wait for jobs");
+            jobs.wait (next.done);
+        }
+        current ^= 1;
+        PROFILE_FRAME();
     }
+    PROFILE_EXPORT ("profile.json");
  
-    glDeleteVertexArrays (2, VAO);
-    glDeleteBuffers (2, VBO);
+    const StreamBuffer::Stats &streamed = streamBuffer.totalStats();
+    std::cout << "Stream buffer: " << streamed.bytesStreamed << " bytes in "
+              << streamed.allocations << " allocations, " << streamed.failedAllocations << " failed, "
+              << streamed.fenceWaits << " fence waits, " << streamed.stallSeconds * 1000.0 << " ms stalled" << std::endl;
+
+    glState.invalidate();
+    glDeleteVertexArrays (1, &streamVAO);
+    glDeleteVertexArrays (static_cast <GLsizei> (meshVAOs.size()), meshVAOs.data());
+    glDeleteBuffers (2, sceneBuffers);
  
     glfwTerminate();
     return 0;
@@ -113,24 +230,159 @@ GLFWwindow *initGLFWwindowAndGlad (int major_ver, int minor_ver, int profile, un
  
     GLFWwindow* window = glfwCreateWindow (width, height, w_name, NULL, NULL);
     if (window == NULL)
-        throw std::exception ("Cant't create a window");
+        throw std::runtime_error ("Cant't create a window");
 
     glfwMakeContextCurrent (window);
     glfwSetFramebufferSizeCallback (window, cbfun);
  
     if (!gladLoadGLLoader((GLADloadproc)glfwGetProcAddress))
-        throw std::exception ("Can't init glad");
+        throw std::runtime_error ("Can't init glad");
 
     return  window;
 }
 
+// Positions and colors interleaved like the static triangles, indices in the same buffer
+GLuint createStreamVertexArray (const StreamBuffer &stream)
+{
+    const VertexLayout layout = { { 0, 3, VertexEncoding::Float }, { 1, 3, VertexEncoding::Float } };
+
+    GLuint vao = 0;
+    glCreateVertexArrays (1, &vao);
+    layout.apply (vao);
+    glVertexArrayElementBuffer (vao, stream.handle());
+    return vao;
+}
+
+// A fan whose rim pulses every frame, rebuilt straight in the mapped stream buffer
+void drawStreamedFan (StreamBuffer &stream, GLuint vao, const GLSLProgram &program, float time)
+{
+    const int   SEGMENTS = 32;
+    const int   STRIDE   = 6 * sizeof (float);
+    const float PI       = 3.14159265f;
+
+    StreamBuffer::Allocation vertices = stream.allocate ((SEGMENTS + 1) * STRIDE, STRIDE);
+    StreamBuffer::Allocation indices  = stream.allocate (SEGMENTS * 3 * sizeof (GLuint), sizeof (GLuint));
+    if (!vertices.isValid() || !indices.isValid())
+        return;
+
+    float *vertex = vertices.as <float>();
+    *vertex++ = 0.6f; *vertex++ = 0.6f; *vertex++ = 0.0f;
+    *vertex++ = 1.0f; *vertex++ = 1.0f; *vertex++ = 1.0f;
+
+    for (int i = 0; i < SEGMENTS; ++i)
+    {
+        const float angle  = 2.0f * PI * i / SEGMENTS;
+        const float radius = 0.2f + 0.05f * std::sin (4.0f * angle + 3.0f * time);
+
+        *vertex++ = 0.6f + radius * std::cos (angle);
+        *vertex++ = 0.6f + radius * std::sin (angle);
+        *vertex++ = 0.0f;
+        *vertex++ = 0.5f + 0.5f * std::cos (angle + time);
+        *vertex++ = 0.5f + 0.5f * std::sin (angle + time);
+        *vertex++ = 0.5f;
+    }
+
+    GLuint *index = indices.as <GLuint>();
+    for (int i = 0; i < SEGMENTS; ++i)
+    {
+        *index++ = 0;
+        *index++ = 1 + i;
+        *index++ = 1 + (i + 1) % SEGMENTS;
+    }
+
+    glVertexArrayVertexBuffer (vao, 0, stream.handle(), vertices.offset, STRIDE);
+    program.use();
+    GLStateCache::current().bindVertexArray (vao);
+    glDrawElements (GL_TRIANGLES, SEGMENTS * 3, GL_UNSIGNED_INT, reinterpret_cast <void *> (indices.offset));
+}
+
+// The vertices of a mesh start at its offset into the shared buffer, so
+// its indices need no base vertex
+GLuint createMeshVertexArray (const BakedMesh &mesh, GLuint vertexBuffer, GLuint indexBuffer)
+{
+    GLuint vao = 0;
+    glCreateVertexArrays (1, &vao);
+    glVertexArrayVertexBuffer  (vao, 0, vertexBuffer, static_cast <GLintptr> (mesh.vertexOffset), mesh.stride);
+    glVertexArrayElementBuffer (vao, indexBuffer);
+    setVertexFormat (vao, BakedScene::vertexFormat (mesh), 0);
+    return vao;
+}
+
+// The handles are read here on the GL thread, the jobs only see the copies.
+// A reload swaps programs at the compiler's poll(), the references keep the
+// ones this frame recorded until it has been drawn
+void snapshotPrograms (FrameWork &frame, const BakedScene &scene,
+                       const std::vector <AsyncShaderCompiler::Handle> &programs)
+{
+    for (size_t i = 0; i < frame.programs.size(); ++i)
+    {
+        const AsyncShaderCompiler::Handle &program = programs[scene.materials()[i].program];
+        frame.programRefs[i] = program->program();
+        frame.programs[i]    = frame.programRefs[i] ? frame.programRefs[i]->getHandle() : 0;
+    }
+}
+
+// One job culls, the next splits what it kept into jobs of DRAWS_PER_JOB,
+// each recording into the command buffer of the thread it runs on. Done
+// once frame.done is
+void buildFrame (JobSystem &jobs, FrameWork &frame, FrustumCuller &culler, const Frustum &frustum,
+                 const BakedScene &scene, const std::vector <GLuint> &meshVAOs)
+{
+    for (CommandBuffer &commands : frame.commands)
+        commands.clear();
+
+    JobSystem                  *system = &jobs;
+    FrameWork                  *work   = &frame;
+    FrustumCuller              *cull   = &culler;
+    const Frustum              *view   = &frustum;
+    const BakedScene           *draws  = &scene;
+    const std::vector <GLuint> *vaos   = &meshVAOs;
+
+    jobs.run ([work, cull, view]
+    {
+        PROFILE_SCOPE ("Cull");
+        work->visibleCount = cull->cull (*view, work->visible.data());
+    }, &frame.culled);
+
+    jobs.run ([system, work, draws, vaos]
+    {
+        for (size_t begin = 0; begin < work->visibleCount; begin += DRAWS_PER_JOB)
+        {
+            const size_t end = std::min (begin + DRAWS_PER_JOB, work->visibleCount);
+            system->run ([system, work, draws, vaos, begin, end]
+            {
+                recordDraws (*work, work->commands[system->currentThread()], *draws, *vaos, begin, end);
+            }, &work->done);
+        }
+    }, &frame.done, &frame.culled);
+}
+
+void recordDraws (const FrameWork &frame, CommandBuffer &commands, const BakedScene &scene,
+                  const std::vector <GLuint> &meshVAOs, size_t begin, size_t end)
+{
+    PROFILE_SCOPE ("Record draws");
+    for (size_t i = begin; i < end; ++i)
+    {
+        const BakedDraw &draw    = scene.draws()[frame.visible[i]];
+        const GLuint     program = frame.programs[draw.material];
+        if (!program)
+            continue;
+
+        const BakedMesh  &mesh    = scene.meshes()[draw.mesh];
+        const DrawCommand command = { { program, meshVAOs[draw.mesh], 0, false, false },
+                                      GL_TRIANGLES, static_cast <GLsizei> (mesh.indexCount), GL_UNSIGNED_INT,
+                                      static_cast <GLintptr> (mesh.indexOffset), 0, 1 };
+        commands.record (DrawQueue::makeKey (program, draw.material, 0.5f), command);
+    }
+}
+
 void processInput(GLFWwindow* window)
 {
     if (glfwGetKey(window, GLFW_KEY_ESCAPE) == GLFW_PRESS)
         glfwSetWindowShouldClose(window, true);
 }
  
-void framebuffer_size_callback(GLFWwindow* window, int width, int height)
+void framebuffer_size_callback(GLFWwindow*, int width, int height)
 {
-    glViewport(0, 0, width, height);
+    GLStateCache::current().setViewport (0, 0, width, height);
 }
\ No newline at end of file
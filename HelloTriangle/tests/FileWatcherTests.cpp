@@ -0,0 +1,111 @@
+#include "Test.h"
+
+#include <string>
+#include <vector>
+#include <chrono>
+#include <thread>
+#include <algorithm>
+#include <filesystem>
+
+#include "FileWatcher.h"
+
+namespace fs = std::filesystem;
+
+using Clock = std::chrono::steady_clock;
+
+// Longest wait for a change to show up, and how long nothing else may,
+// both past the timestamp polling interval of other platforms
+static const std::chrono::milliseconds SETTLE (1500);
+static const std::chrono::milliseconds QUIET  (500);
+
+static std::vector <std::string> pollUntil (FileWatcher &watcher, const std::string &file);
+static std::vector <std::string> pollFor   (FileWatcher &watcher, std::chrono::milliseconds duration);
+
+
+TEST (FileWatcher, seesEdits)
+{
+    const std::string dir = Test::temporaryDirectory ("seesEdits");
+    Test::writeFile (dir + "/tint.glsl", "vec4 tint();\n");
+
+    FileWatcher watcher;
+    REQUIRE (watcher.watch (dir + "/tint.glsl"));
+    CHECK (watcher.watch (dir + "/./tint.glsl"));
+    CHECK (watcher.size() == 1);
+
+    std::this_thread::sleep_for (std::chrono::milliseconds (10));
+    Test::writeFile (dir + "/tint.glsl", "vec4 tint() { return vec4 (1.0); }\n");
+
+    const std::vector <std::string> changed = pollUntil (watcher, FileWatcher::normalize (dir + "/tint.glsl"));
+    CHECK (changed.size() == 1);
+    CHECK (pollFor (watcher, QUIET).empty());
+}
+
+// Editors that save to a temporary file and rename it over the original
+// replace its inode
+TEST (FileWatcher, seesRenameSaves)
+{
+    const std::string dir = Test::temporaryDirectory ("seesRenameSaves");
+    Test::writeFile (dir + "/tint.glsl", "vec4 tint();\n");
+
+    FileWatcher watcher;
+    REQUIRE (watcher.watch (dir + "/tint.glsl"));
+
+    for (int save = 0; save < 2; ++save)
+    {
+        std::this_thread::sleep_for (std::chrono::milliseconds (10));
+        Test::writeFile (dir + "/tint.tmp", "vec4 tint() { return vec4 (" + std::to_string (save) + ".0); }\n");
+        fs::rename (dir + "/tint.tmp", dir + "/tint.glsl");
+
+        const std::vector <std::string> changed = pollUntil (watcher, FileWatcher::normalize (dir + "/tint.glsl"));
+        CHECK (changed.size() == 1);
+    }
+}
+
+TEST (FileWatcher, ignoresOtherFiles)
+{
+    const std::string dir = Test::temporaryDirectory ("ignoresOtherFiles");
+    Test::writeFile (dir + "/watched.glsl", "float watched;\n");
+    Test::writeFile (dir + "/other.glsl",   "float other;\n");
+
+    FileWatcher watcher;
+    REQUIRE (watcher.watch (dir + "/watched.glsl"));
+
+    std::this_thread::sleep_for (std::chrono::milliseconds (10));
+    Test::writeFile (dir + "/other.glsl", "float changed;\n");
+    Test::writeFile (dir + "/new.glsl",   "float created;\n");
+    CHECK (pollFor (watcher, QUIET).empty());
+}
+
+TEST (FileWatcher, normalizesPaths)
+{
+    CHECK (FileWatcher::normalize ("a/./b/../c.glsl") == "a/c.glsl");
+    CHECK (FileWatcher::normalize ("a//c.glsl")       == "a/c.glsl");
+}
+
+// Everything polled until file shows up, or SETTLE has passed
+static std::vector <std::string> pollUntil (FileWatcher &watcher, const std::string &file)
+{
+    std::vector <std::string> changed;
+    const Clock::time_point start = Clock::now();
+    while (std::find (changed.begin(), changed.end(), file) == changed.end() && Clock::now() - start < SETTLE)
+    {
+        const std::vector <std::string> polled = watcher.poll();
+        changed.insert (changed.end(), polled.begin(), polled.end());
+        std::this_thread::sleep_for (std::chrono::milliseconds (1));
+    }
+    CHECK (std::find (changed.begin(), changed.end(), file) != changed.end());
+    return changed;
+}
+
+static std::vector <std::string> pollFor (FileWatcher &watcher, std::chrono::milliseconds duration)
+{
+    std::vector <std::string> changed;
+    const Clock::time_point start = Clock::now();
+    while (Clock::now() - start < duration)
+    {
+        const std::vector <std::string> polled = watcher.poll();
+        changed.insert (changed.end(), polled.begin(), polled.end());
+        std::this_thread::sleep_for (std::chrono::milliseconds (10));
+    }
+    return changed;
+}
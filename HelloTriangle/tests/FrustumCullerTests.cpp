@@ -0,0 +1,147 @@
+#include "Test.h"
+
+#include <random>
+#include <vector>
+#include <cstdint>
+#include <algorithm>
+
+#include <glm/gtc/matrix_transform.hpp>
+
+#include "FrustumCuller.h"
+
+static const float  WORLD_SIZE = 1000.0f;   // objects fill a cube this far either side of the camera
+static const float  NEAR_RANGE = 125.0f;    // far plane of the short range view
+static const size_t VIEW_COUNT = 8;         // directions the camera turns through
+static const size_t OBJECTS    = 20001;     // not a multiple of any SIMD width
+
+static std::vector <BoundingBox> makeBoxes    (size_t count, std::mt19937 &random);
+static Frustum                   makeView     (size_t view, float range);
+static bool                      sameAsScalar (FrustumCuller &culler, const FrustumCuller &reference);
+
+
+TEST (FrustumCuller, simdMatchesScalar)
+{
+    std::mt19937 random (1);
+    FrustumCuller flat;
+    for (const BoundingBox &box : makeBoxes (OBJECTS, random))
+        flat.add (box);
+
+    CHECK (sameAsScalar (flat, flat));
+}
+
+TEST (FrustumCuller, bvhMatchesFlat)
+{
+    std::mt19937 random (2);
+    FrustumCuller flat;
+    FrustumCuller inserted (FrustumCuller::Hierarchy::Bvh);
+    FrustumCuller rebuilt  (FrustumCuller::Hierarchy::Bvh);
+    for (const BoundingBox &box : makeBoxes (OBJECTS, random))
+    {
+        flat.add     (box);
+        inserted.add (box);
+        rebuilt.add  (box);
+    }
+    rebuilt.rebuild();
+
+    CHECK (sameAsScalar (inserted, flat));
+    CHECK (sameAsScalar (rebuilt,  flat));
+}
+
+// Fattened leaves absorb small moves, the cull still has to test the
+// boxes as they are now
+TEST (FrustumCuller, bvhFollowsMoves)
+{
+    std::mt19937 random (3);
+    std::vector <BoundingBox> boxes = makeBoxes (OBJECTS, random);
+
+    FrustumCuller flat;
+    FrustumCuller moving (FrustumCuller::Hierarchy::Bvh, 1.0f);
+    for (const BoundingBox &box : boxes)
+    {
+        flat.add   (box);
+        moving.add (box);
+    }
+    moving.rebuild();
+
+    std::uniform_int_distribution <size_t> pick (0, OBJECTS - 1);
+    std::uniform_real_distribution <float> step (-5.0f, 5.0f);
+    for (size_t i = 0; i < OBJECTS; ++i)
+    {
+        const uint32_t  object = static_cast <uint32_t> (pick (random));
+        const glm::vec3 offset (step (random), step (random), step (random));
+        boxes[object] = { boxes[object].min + offset, boxes[object].max + offset };
+        flat.update   (object, boxes[object]);
+        moving.update (object, boxes[object]);
+    }
+
+    CHECK (sameAsScalar (moving, moving));
+    CHECK (sameAsScalar (moving, flat));
+}
+
+TEST (FrustumCuller, agreesAfterRemovals)
+{
+    std::mt19937 random (4);
+    FrustumCuller flat;
+    FrustumCuller hierarchical (FrustumCuller::Hierarchy::Bvh);
+    for (const BoundingBox &box : makeBoxes (OBJECTS, random))
+    {
+        flat.add         (box);
+        hierarchical.add (box);
+    }
+    hierarchical.rebuild();
+
+    for (uint32_t object = 0; object < OBJECTS; object += 7)
+    {
+        flat.remove         (object);
+        hierarchical.remove (object);
+    }
+
+    CHECK (sameAsScalar (flat,         flat));
+    CHECK (sameAsScalar (hierarchical, flat));
+}
+
+// Boxes from half a unit to five across, centers uniform in the world cube
+static std::vector <BoundingBox> makeBoxes (size_t count, std::mt19937 &random)
+{
+    std::uniform_real_distribution <float> position (-WORLD_SIZE, WORLD_SIZE);
+    std::uniform_real_distribution <float> size (0.25f, 2.5f);
+
+    std::vector <BoundingBox> boxes (count);
+    for (BoundingBox &box : boxes)
+    {
+        const glm::vec3 center (position (random), position (random), position (random));
+        const glm::vec3 extent (size (random), size (random), size (random));
+        box = { center - extent, center + extent };
+    }
+    return boxes;
+}
+
+// A 60 degree camera at the origin, turned a step a view
+static Frustum makeView (size_t view, float range)
+{
+    const float     yaw       = glm::two_pi <float>() * (view % VIEW_COUNT) / VIEW_COUNT;
+    const glm::vec3 direction (std::sin (yaw), 0.2f, -std::cos (yaw));
+    const glm::mat4 projection = glm::perspective (glm::radians (60.0f), 16.0f / 9.0f, 0.1f, range);
+    const glm::mat4 viewMatrix = glm::lookAt (glm::vec3 (0.0f), direction, glm::vec3 (0.0f, 1.0f, 0.0f));
+    return Frustum::fromViewProjection (projection * viewMatrix);
+}
+
+// culler's cull() against reference's cullScalar() in every view, far and
+// short range, and something visible in each
+static bool sameAsScalar (FrustumCuller &culler, const FrustumCuller &reference)
+{
+    std::vector <uint32_t> visible (culler.capacity()), expected (reference.capacity());
+    for (size_t view = 0; view < 2 * VIEW_COUNT; ++view)
+    {
+        const Frustum frustum = makeView (view, view < VIEW_COUNT ? WORLD_SIZE : NEAR_RANGE);
+        visible.resize  (culler.cull (frustum, visible.data()));
+        expected.resize (reference.cullScalar (frustum, expected.data()));
+        std::sort (visible.begin(), visible.end());
+
+        if (visible != expected || expected.empty())
+            return false;
+        visible.resize  (culler.capacity());
+        expected.resize (reference.capacity());
+    }
+    return true;
+}
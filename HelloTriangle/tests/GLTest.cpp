@@ -0,0 +1,18 @@
+#include "GLTest.h"
+#include "Test.h"
+
+#include <stdexcept>
+
+
+std::unique_ptr <BenchContext> Test::createContext (int width, int height)
+{
+    try
+    {
+        return std::unique_ptr <BenchContext> (
+            new BenchContext (BenchContext::Api::Auto, width, height, "HelloTriangleGLTests"));
+    }
+    catch (const std::runtime_error &e)
+    {
+        skip (e.what());
+    }
+}
@@ -0,0 +1,15 @@
+#ifndef GL_TEST_INCLUDED
+#define GL_TEST_INCLUDED
+
+#include <memory>
+
+#include "BenchContext.h"
+
+namespace Test
+{
+    // A hidden GL 4.5 context for the suites that need one, made the way
+    // the benchmarks make theirs. Skips the test where there is none to be had
+    std::unique_ptr <BenchContext> createContext (int width = 64, int height = 64);
+}
+
+#endif // !GL_TEST_INCLUDED
@@ -0,0 +1,144 @@
+#include "Test.h"
+#include "GLTest.h"
+
+#include <random>
+#include <vector>
+#include <memory>
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
+
+#include <glm/gtc/matrix_transform.hpp>
+
+#include "GLSLProgram.h"
+#include "StreamBuffer.h"
+#include "InstanceRenderer.h"
+
+static const int    SIZE      = 128;
+static const size_t INSTANCES = 5000;
+
+// Unit fans of 3 to 8 vertices and the instances drawing them, rotated,
+// scaled to a few pixels and spread over the screen
+struct Instancing
+{
+    Instancing();
+
+    // The image of one frame drawn in mode
+    std::vector <unsigned char> render (InstanceRenderer::SubmitMode mode);
+
+    std::unique_ptr <BenchContext>           context;
+    GLSLProgram                              program;
+    std::unique_ptr <StreamBuffer>           stream;
+    std::unique_ptr <InstanceRenderer>       renderer;
+    std::vector <InstanceRenderer::Mesh>     meshes;
+    std::vector <InstanceRenderer::Instance> instances;
+};
+
+
+// The shader reads the rows as dot (row, vec4 (p, 1)) and the color as
+// normalized bytes, red first
+TEST (InstanceRenderer, packsRowsAndColor)
+{
+    const glm::mat4 transform = glm::scale (glm::translate (glm::mat4 (1.0f), glm::vec3 (1.0f, 2.0f, 3.0f)),
+                                            glm::vec3 (4.0f, 5.0f, 6.0f));
+    const InstanceRenderer::Instance instance =
+        InstanceRenderer::Instance::make (transform, glm::vec4 (1.0f, 0.5f, -1.0f, 2.0f));
+
+    const glm::vec4 point (1.0f, 1.0f, 1.0f, 1.0f);
+    const glm::vec4 moved = transform * point;
+    for (int row = 0; row < 3; ++row)
+        CHECK (glm::dot (instance.rows[row], point) == moved[row]);
+
+    CHECK (instance.color == 0xff0080ffu);
+}
+
+// Instance i is drawn with mesh i % meshes.size(), in the same order in both
+// modes, so with no depth test or blending the images match to the bit
+TEST (InstanceRenderer, instancedMatchesPerDraw)
+{
+    Instancing instancing;
+    const std::vector <unsigned char> perDraw   = instancing.render (InstanceRenderer::SubmitMode::PerDraw);
+    const std::vector <unsigned char> instanced = instancing.render (InstanceRenderer::SubmitMode::Instanced);
+
+    CHECK (instancing.renderer->frameStats().instances == INSTANCES);
+    CHECK (instancing.renderer->frameStats().drawCalls == instancing.meshes.size());
+    CHECK (instancing.renderer->frameStats().droppedInstances == 0);
+
+    size_t covered = 0;
+    for (size_t i = 0; i < instanced.size(); i += 4)
+        covered += (instanced[i] | instanced[i + 1] | instanced[i + 2]) != 0;
+    CHECK (covered > 0);
+    CHECK (instanced == perDraw);
+}
+
+Instancing::Instancing()
+    : context (Test::createContext (SIZE, SIZE))
+{
+    struct Vertex
+    {
+        float position[3];
+        float color[3];
+    };
+    const VertexFormat format = {
+        {
+            { 0, 3, GL_FLOAT, GL_FALSE, offsetof (Vertex, position) },
+            { 1, 3, GL_FLOAT, GL_FALSE, offsetof (Vertex, color) }
+        },
+        sizeof (Vertex)
+    };
+
+    program.compileShader (SHADER_DIR "/instance.vert");
+    program.compileShader (SHADER_DIR "/triangle.frag");
+    program.link();
+
+    stream.reset   (new StreamBuffer (INSTANCES * sizeof (InstanceRenderer::Instance) + 4096));
+    renderer.reset (new InstanceRenderer (*stream));
+
+    std::mt19937 random (42);
+    std::uniform_real_distribution <float> unit (0.0f, 1.0f);
+
+    std::vector <Vertex> vertices;
+    std::vector <GLuint> indices;
+    for (int n = 3; n <= 8; ++n)
+    {
+        vertices.clear();
+        indices.clear();
+        for (int k = 0; k < n; ++k)
+        {
+            const float angle = 6.2831853f * k / n;
+            vertices.push_back ({ { std::cos (angle), std::sin (angle), 0.0f },
+                                  { 0.5f + 0.5f * unit (random), 0.5f + 0.5f * unit (random), 0.5f + 0.5f * unit (random) } });
+        }
+        for (int k = 1; k + 1 < n; ++k)
+            indices.insert (indices.end(), { 0u, GLuint (k), GLuint (k + 1) });
+
+        meshes.push_back (renderer->addMesh (format, vertices.data(), vertices.size(), indices.data(), indices.size()));
+    }
+
+    for (size_t i = 0; i < INSTANCES; ++i)
+    {
+        glm::mat4 transform = glm::translate (glm::mat4 (1.0f),
+                                              glm::vec3 (1.96f * unit (random) - 0.98f, 1.96f * unit (random) - 0.98f, 0.0f));
+        transform = glm::rotate (transform, glm::two_pi <float>() * unit (random), glm::vec3 (0.0f, 0.0f, 1.0f));
+        transform = glm::scale (transform, glm::vec3 (0.02f + 0.03f * unit (random)));
+        instances.push_back (InstanceRenderer::Instance::make (
+            transform, glm::vec4 (unit (random), unit (random), unit (random), 1.0f)));
+    }
+}
+
+std::vector <unsigned char> Instancing::render (InstanceRenderer::SubmitMode mode)
+{
+    stream->beginFrame();
+    glClearColor (0.0f, 0.0f, 0.0f, 1.0f);
+    glClear (GL_COLOR_BUFFER_BIT);
+
+    for (size_t i = 0; i < instances.size(); ++i)
+        renderer->draw (meshes[i % meshes.size()], program, instances[i]);
+    renderer->flush (mode);
+    stream->endFrame();
+
+    std::vector <unsigned char> pixels (SIZE * SIZE * 4);
+    glPixelStorei (GL_PACK_ALIGNMENT, 1);
+    glReadPixels (0, 0, SIZE, SIZE, GL_RGBA, GL_UNSIGNED_BYTE, pixels.data());
+    return pixels;
+}
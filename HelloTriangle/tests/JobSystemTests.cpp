@@ -0,0 +1,150 @@
+#include "Test.h"
+
+#include <random>
+#include <vector>
+#include <memory>
+#include <atomic>
+#include <cmath>
+#include <cstdint>
+#include <algorithm>
+
+#include <glm/gtc/matrix_transform.hpp>
+
+#include "JobSystem.h"
+#include "FrustumCuller.h"
+#include "DrawQueue.h"
+
+static const size_t MAX_THREADS     = 4;
+static const size_t OBJECTS         = 50000;
+static const size_t OBJECTS_PER_JOB = 4096;
+
+static std::vector <uint64_t> buildFrame (size_t threads, size_t frame);
+
+
+TEST (JobSystem, parallelForVisitsEveryIndexOnce)
+{
+    for (size_t threads = 1; threads <= MAX_THREADS; ++threads)
+    {
+        JobSystem jobs (threads);
+        std::vector <uint32_t> hits (1000003);
+        jobs.parallelFor (hits.size(), 1000, [&hits] (size_t begin, size_t end)
+        {
+            for (size_t i = begin; i < end; ++i)
+                ++hits[i];
+        });
+        CHECK (std::all_of (hits.begin(), hits.end(), [] (uint32_t count) { return count == 1; }));
+    }
+}
+
+// Jobs started after a counter see everything the jobs it counted wrote
+TEST (JobSystem, runsJobsAfterTheirCounter)
+{
+    for (size_t threads = 1; threads <= MAX_THREADS; ++threads)
+    {
+        JobSystem jobs (threads);
+        JobSystem::Counter first, second;
+
+        std::vector <uint32_t> values (256, 0);
+        std::atomic <size_t>   early (0);
+        std::vector <uint32_t> *shared  = &values;
+        std::atomic <size_t>   *counted = &early;
+
+        for (size_t i = 0; i < values.size(); ++i)
+            jobs.run ([shared, i] { (*shared)[i] = 1; }, &first);
+        for (size_t i = 0; i < values.size(); ++i)
+        {
+            jobs.run ([shared, counted, i]
+            {
+                if ((*shared)[(i + 1) % shared->size()] == 0)
+                    counted->fetch_add (1);
+                (*shared)[i] += 1;
+            }, &second, &first);
+        }
+        jobs.wait (second);
+
+        CHECK (first.isDone());
+        CHECK (early == 0);
+        CHECK (std::all_of (values.begin(), values.end(), [] (uint32_t value) { return value == 2; }));
+        CHECK (jobs.stats().jobs == 2 * values.size());
+    }
+}
+
+// A camera job, then a culling job per chunk recording into its thread's
+// list: the same frame comes out whichever threads took which chunks
+TEST (JobSystem, buildsTheSameFrameOnAnyThreadCount)
+{
+    for (size_t frame = 0; frame < 3; ++frame)
+    {
+        const std::vector <uint64_t> reference = buildFrame (1, frame);
+        CHECK (!reference.empty());
+        for (size_t threads = 2; threads <= MAX_THREADS; ++threads)
+            CHECK (buildFrame (threads, frame) == reference);
+    }
+}
+
+static std::vector <uint64_t> buildFrame (size_t threads, size_t frame)
+{
+    struct Chunk
+    {
+        size_t        first;
+        size_t        count;
+        FrustumCuller culler;
+    };
+
+    std::mt19937 random (11);
+    std::uniform_real_distribution <float> position (-200.0f, 200.0f);
+
+    std::vector <std::unique_ptr <Chunk>> chunks;
+    for (size_t first = 0; first < OBJECTS; first += OBJECTS_PER_JOB)
+    {
+        std::unique_ptr <Chunk> chunk (new Chunk);
+        chunk->first = first;
+        chunk->count = std::min (OBJECTS_PER_JOB, OBJECTS - first);
+        for (size_t i = 0; i < chunk->count; ++i)
+        {
+            const glm::vec3 center (position (random), position (random), position (random));
+            chunk->culler.add ({ center - glm::vec3 (1.0f), center + glm::vec3 (1.0f) });
+        }
+        chunks.push_back (std::move (chunk));
+    }
+
+    JobSystem jobs (threads);
+    JobSystem::Counter viewed, done;
+    std::vector <std::vector <uint64_t>> keys (jobs.threadCount());
+
+    Frustum    frustum;
+    Frustum   *view   = &frustum;
+    JobSystem *system = &jobs;
+    auto      *lists  = &keys;
+
+    jobs.run ([view, frame]
+    {
+        const float     yaw       = glm::two_pi <float>() * frame / 8.0f;
+        const glm::vec3 direction (std::sin (yaw), -0.1f, -std::cos (yaw));
+        *view = Frustum::fromViewProjection (glm::perspective (glm::radians (60.0f), 16.0f / 9.0f, 0.1f, 300.0f) *
+                                             glm::lookAt (glm::vec3 (0.0f), direction, glm::vec3 (0.0f, 1.0f, 0.0f)));
+    }, &viewed);
+    for (const std::unique_ptr <Chunk> &owned : chunks)
+    {
+        Chunk *chunk = owned.get();
+        jobs.run ([view, system, lists, chunk]
+        {
+            std::vector <uint32_t> visible (chunk->culler.capacity());
+            visible.resize (chunk->culler.cull (*view, visible.data()));
+
+            std::vector <uint64_t> &list = (*lists)[system->currentThread()];
+            for (uint32_t id : visible)
+            {
+                const uint32_t object = static_cast <uint32_t> (chunk->first + id);
+                list.push_back (DrawQueue::makeKey (object % 4, object % 16, float (object) / OBJECTS));
+            }
+        }, &done, &viewed);
+    }
+    jobs.wait (done);
+
+    std::vector <uint64_t> all;
+    for (const std::vector <uint64_t> &list : keys)
+        all.insert (all.end(), list.begin(), list.end());
+    std::sort (all.begin(), all.end());
+    return all;
+}
@@ -0,0 +1,198 @@
+#include "Test.h"
+
+#include <random>
+#include <vector>
+#include <array>
+#include <cstring>
+#include <cstdint>
+#include <algorithm>
+
+#include "MeshOptimizer.h"
+
+using Corner   = std::array <char, 24>;
+using Triangle = std::array <Corner, 3>;
+
+// A mesh as the steps hand it on
+struct Mesh
+{
+    std::vector <char>     vertices;   // position and color, 3 floats each
+    std::vector <uint32_t> indices;
+};
+
+static const size_t STRIDE = 6 * sizeof (float);
+static const size_t GRID   = 64;       // quads a side, two triangles each
+
+static Mesh                   makeGridSoup (size_t grid, bool isShuffled);
+static std::vector <Triangle> triangles    (const Mesh &mesh);
+static std::vector <uint32_t> welded       (const Mesh &soup);
+
+
+// A grid sent as a triangle soup is the worst case of an unindexed mesh:
+// every corner its own vertex
+TEST (MeshOptimizer, weldsEverySharedVertex)
+{
+    for (bool isShuffled : { false, true })
+    {
+        Mesh mesh = makeGridSoup (GRID, isShuffled);
+        const MeshOptimizeStats stats = optimizeMesh (mesh.vertices, STRIDE, mesh.indices);
+
+        CHECK (stats.verticesBefore == 6 * GRID * GRID);
+        CHECK (stats.verticesAfter  == (GRID + 1) * (GRID + 1));
+        CHECK (mesh.vertices.size() == stats.verticesAfter * STRIDE);
+    }
+}
+
+TEST (MeshOptimizer, keepsTrianglesUnchanged)
+{
+    for (bool isShuffled : { false, true })
+    {
+        const Mesh soup = makeGridSoup (GRID, isShuffled);
+        Mesh       mesh = soup;
+        optimizeMesh (mesh.vertices, STRIDE, mesh.indices);
+
+        Mesh indexedSoup = { soup.vertices, std::vector <uint32_t> (soup.vertices.size() / STRIDE) };
+        for (size_t i = 0; i < indexedSoup.indices.size(); ++i)
+            indexedSoup.indices[i] = static_cast <uint32_t> (i);
+
+        std::vector <Triangle> before = triangles (indexedSoup);
+        std::vector <Triangle> after  = triangles (mesh);
+        std::sort (before.begin(), before.end());
+        std::sort (after.begin(),  after.end());
+        CHECK (before == after);
+    }
+}
+
+TEST (MeshOptimizer, ordersVerticesByFirstUse)
+{
+    Mesh mesh = makeGridSoup (GRID, true);
+    optimizeMesh (mesh.vertices, STRIDE, mesh.indices);
+
+    const size_t unique = mesh.vertices.size() / STRIDE;
+    bool isInRange = true, isFirstUseOrder = true;
+    uint32_t next = 0;
+    for (uint32_t index : mesh.indices)
+    {
+        isInRange = isInRange && index < unique;
+        if (index == next)
+            ++next;
+        else
+            isFirstUseOrder = isFirstUseOrder && index < next;
+    }
+    CHECK (isInRange);
+    CHECK (isFirstUseOrder);
+    CHECK (next == unique);
+}
+
+// Positions and colors in arrays of their own, the way Scene keeps them,
+// come out as the two halves of the interleaved result
+TEST (MeshOptimizer, separateStreamsMatchInterleaved)
+{
+    const size_t HALF = STRIDE / 2;
+
+    Mesh interleaved = makeGridSoup (GRID, true);
+    const size_t vertexCount = interleaved.vertices.size() / STRIDE;
+    std::vector <char> positions (vertexCount * HALF), colors (vertexCount * HALF);
+    for (size_t i = 0; i < vertexCount; ++i)
+    {
+        memcpy (&positions[i * HALF], &interleaved.vertices[i * STRIDE],        HALF);
+        memcpy (&colors[i * HALF],    &interleaved.vertices[i * STRIDE + HALF], HALF);
+    }
+
+    const MeshOptimizeStats expected = optimizeMesh (interleaved.vertices, STRIDE, interleaved.indices);
+
+    const MeshStream streams[] = { { positions.data(), HALF, HALF }, { colors.data(), HALF, HALF } };
+    std::vector <uint32_t> indices (vertexCount);
+    const MeshOptimizeStats stats = optimizeMesh (indices.data(), nullptr, indices.size(), vertexCount, streams, 2);
+
+    REQUIRE (stats.verticesAfter == expected.verticesAfter);
+    CHECK (stats.after.transformed == expected.after.transformed);
+    CHECK (indices == interleaved.indices);
+    bool isSame = true;
+    for (size_t i = 0; i < stats.verticesAfter; ++i)
+    {
+        isSame = isSame && memcmp (&positions[i * HALF], &interleaved.vertices[i * STRIDE],        HALF) == 0 &&
+                           memcmp (&colors[i * HALF],    &interleaved.vertices[i * STRIDE + HALF], HALF) == 0;
+    }
+    CHECK (isSame);
+}
+
+// The optimized order never misses more than the welded one it started
+// from, and a regular grid lands well under one miss a triangle; 0.5 is
+// the floor for any mesh
+TEST (MeshOptimizer, lowersAcmr)
+{
+    for (bool isShuffled : { false, true })
+    {
+        const Mesh soup = makeGridSoup (GRID, isShuffled);
+        const std::vector <uint32_t> weldedIndices = welded (soup);
+
+        Mesh mesh = soup;
+        const MeshOptimizeStats stats = optimizeMesh (mesh.vertices, STRIDE, mesh.indices);
+        CHECK (stats.before.acmr == 3.0);
+
+        const size_t unique = mesh.vertices.size() / STRIDE;
+        for (unsigned cacheSize : { 16u, 32u })
+        {
+            const VertexCacheStats before = analyzeVertexCache (weldedIndices.data(), weldedIndices.size(), unique,
+                                                                cacheSize);
+            const VertexCacheStats after  = analyzeVertexCache (mesh.indices.data(), mesh.indices.size(), unique,
+                                                                cacheSize);
+            CHECK (after.acmr <= before.acmr);
+            CHECK (after.acmr >= 0.5 && after.acmr < 0.75);
+            CHECK (after.atvr >= 1.0);
+        }
+    }
+}
+
+// Every triangle carries its own three vertices, no indices
+static Mesh makeGridSoup (size_t grid, bool isShuffled)
+{
+    std::vector <std::array <uint32_t, 3>> order;
+    for (uint32_t y = 0; y < grid; ++y)
+    {
+        for (uint32_t x = 0; x < grid; ++x)
+        {
+            const uint32_t corner = y * static_cast <uint32_t> (grid + 1) + x;
+            const uint32_t below  = corner + static_cast <uint32_t> (grid + 1);
+            order.push_back ({ corner, below, corner + 1 });
+            order.push_back ({ corner + 1, below, below + 1 });
+        }
+    }
+    if (isShuffled)
+        std::shuffle (order.begin(), order.end(), std::mt19937 (42));
+
+    Mesh mesh;
+    for (const std::array <uint32_t, 3> &triangle : order)
+    {
+        for (uint32_t vertex : triangle)
+        {
+            const float x = float (vertex % (grid + 1)) / grid;
+            const float y = float (vertex / (grid + 1)) / grid;
+            const float values[6] = { x, y, 0.0f, x, y, 1.0f - x };
+            mesh.vertices.insert (mesh.vertices.end(), reinterpret_cast <const char *> (values),
+                                  reinterpret_cast <const char *> (values + 6));
+        }
+    }
+    return mesh;
+}
+
+// Triangles by the bytes of their corners, in their own winding
+static std::vector <Triangle> triangles (const Mesh &mesh)
+{
+    std::vector <Triangle> result (mesh.indices.size() / 3);
+    for (size_t i = 0; i < mesh.indices.size(); ++i)
+        memcpy (result[i / 3][i % 3].data(), mesh.vertices.data() + mesh.indices[i] * STRIDE, STRIDE);
+    return result;
+}
+
+// The soup's indices after welding alone, in its own triangle order
+static std::vector <uint32_t> welded (const Mesh &soup)
+{
+    const size_t     vertexCount = soup.vertices.size() / STRIDE;
+    const MeshStream stream      = { soup.vertices.data(), STRIDE, STRIDE };
+
+    std::vector <uint32_t> remap (vertexCount), indices (vertexCount);
+    generateVertexRemap (remap.data(), nullptr, vertexCount, vertexCount, &stream, 1);
+    remapIndexBuffer (indices.data(), nullptr, vertexCount, remap.data());
+    return indices;
+}
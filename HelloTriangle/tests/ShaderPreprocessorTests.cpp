@@ -0,0 +1,174 @@
+#include "Test.h"
+
+#include <string>
+
+#include "ShaderPreprocessor.h"
+#include "GLSLProgram.h"
+
+static size_t countOf (const std::string &text, const std::string &what);
+static bool   throwsWith (ShaderPreprocessor &preprocessor, const std::string &file, const std::string &message);
+
+
+// Quoted includes look next to the including file first, then in the
+// include root; <> includes only in the root
+TEST (ShaderPreprocessor, resolvesIncludes)
+{
+    const std::string dir = Test::temporaryDirectory ("resolvesIncludes");
+    Test::writeFile (dir + "/root/common.glsl",  "float fromRoot;\n");
+    Test::writeFile (dir + "/root/shared.glsl",  "float sharedOnly;\n");
+    Test::writeFile (dir + "/common.glsl",       "float fromLocal;\n");
+    Test::writeFile (dir + "/main.vert",
+        "#version 330 core\n#include \"common.glsl\"\n#include <common.glsl>\n#include \"shared.glsl\"\n");
+    Test::writeFile (dir + "/missing.vert", "#version 330 core\n#include \"nowhere.glsl\"\n");
+
+    ShaderPreprocessor preprocessor (dir + "/root");
+    const ShaderPreprocessor::Result result = preprocessor.process (dir + "/main.vert");
+
+    CHECK (countOf (result.source, "float fromLocal;")  == 1);
+    CHECK (countOf (result.source, "float fromRoot;")   == 1);
+    CHECK (countOf (result.source, "float sharedOnly;") == 1);
+    REQUIRE (result.files.size() == 4);
+    CHECK (result.files[1] == dir + "/common.glsl");
+    CHECK (result.files[2] == dir + "/root/common.glsl");
+    CHECK (result.files[3] == dir + "/root/shared.glsl");
+
+    CHECK (throwsWith (preprocessor, dir + "/missing.vert", "can't find include \"nowhere.glsl\""));
+}
+
+TEST (ShaderPreprocessor, expandsGuardedFilesOnce)
+{
+    const std::string dir = Test::temporaryDirectory ("expandsGuardedFilesOnce");
+    Test::writeFile (dir + "/once.glsl",    "#pragma once\nfloat once;\n");
+    Test::writeFile (dir + "/guarded.glsl", "#ifndef GUARDED_GLSL\n#define GUARDED_GLSL\nfloat guarded;\n#endif\n");
+    Test::writeFile (dir + "/plain.glsl",   "float plain;\n");
+    Test::writeFile (dir + "/main.vert",
+        "#version 330 core\n"
+        "#include \"once.glsl\"\n#include \"guarded.glsl\"\n#include \"plain.glsl\"\n"
+        "#include \"once.glsl\"\n#include \"guarded.glsl\"\n#include \"plain.glsl\"\n");
+
+    ShaderPreprocessor preprocessor (dir);
+    const std::string source = preprocessor.process (dir + "/main.vert").source;
+
+    CHECK (countOf (source, "float once;")    == 1);
+    CHECK (countOf (source, "float guarded;") == 1);
+    CHECK (countOf (source, "float plain;")   == 2);
+    CHECK (countOf (source, "#pragma once")   == 0);
+}
+
+// Which branch is taken is only known to the driver, so a guarded file
+// included in both branches of an #ifdef has to be expanded in each
+TEST (ShaderPreprocessor, expandsGuardedFilesInEveryBranch)
+{
+    const std::string dir = Test::temporaryDirectory ("expandsGuardedFilesInEveryBranch");
+    Test::writeFile (dir + "/once.glsl",    "#pragma once\nfloat once;\n");
+    Test::writeFile (dir + "/guarded.glsl", "#ifndef GUARDED_GLSL\n#define GUARDED_GLSL\nfloat guarded;\n#endif\n");
+    Test::writeFile (dir + "/main.vert",
+        "#version 330 core\n"
+        "#ifdef FANCY\n#include \"once.glsl\"\n#include \"guarded.glsl\"\n"
+        "#else\n#include \"once.glsl\"\n#include \"guarded.glsl\"\n#endif\n"
+        "#include \"once.glsl\"\n#include \"guarded.glsl\"\n");
+
+    ShaderPreprocessor preprocessor (dir);
+    const std::string source = preprocessor.process (dir + "/main.vert").source;
+
+    // Once in each branch and once after them, each copy behind a guard macro
+    CHECK (countOf (source, "float once;")    == 3);
+    CHECK (countOf (source, "float guarded;") == 3);
+    CHECK (countOf (source, "#ifndef HT_PRAGMA_ONCE_1\n#define HT_PRAGMA_ONCE_1\n") == 3);
+    CHECK (countOf (source, "#ifndef GUARDED_GLSL\n") == 3);
+}
+
+// Each included file gets its own source string number, and the includer's
+// numbering resumes on the line after the #include
+TEST (ShaderPreprocessor, renumbersLinesAfterIncludes)
+{
+    const std::string dir = Test::temporaryDirectory ("renumbersLinesAfterIncludes");
+    Test::writeFile (dir + "/a.glsl",    "float a;\n");
+    Test::writeFile (dir + "/b.glsl",    "#include \"a.glsl\"\nfloat b;\n");
+    Test::writeFile (dir + "/main.vert", "// header\n#version 330 core\nfloat first;\n#include \"b.glsl\"\nfloat last;\n");
+
+    ShaderPreprocessor preprocessor (dir);
+    const ShaderPreprocessor::Result result = preprocessor.process (dir + "/main.vert");
+
+    CHECK (result.source.find ("// header\n#version 330 core\n#line 3 0\nfloat first;\n") == 0);
+    CHECK (countOf (result.source, "#line 1 1\n#line 1 2\nfloat a;\n#line 2 1\nfloat b;\n#line 5 0\nfloat last;\n") == 1);
+    REQUIRE (result.files.size() == 3);
+    CHECK (result.files[1] == dir + "/b.glsl");
+    CHECK (result.files[2] == dir + "/a.glsl");
+    CHECK (countOf (result.label(), "source 2: " + dir + "/a.glsl") == 1);
+}
+
+// Defines go right after #version; those no file mentions and empty ones are left out
+TEST (ShaderPreprocessor, injectsDefines)
+{
+    const std::string dir = Test::temporaryDirectory ("injectsDefines");
+    Test::writeFile (dir + "/lighting.glsl", "#ifdef LIGHTING\nfloat light = SCALE;\n#endif\n");
+    Test::writeFile (dir + "/main.vert",     "#version 330 core\n#include \"lighting.glsl\"\n#ifdef FOG\n#endif\n");
+
+    ShaderDefines defines;
+    defines.set ("SCALE", "2.0").set ("LIGHTING").set ("FOG", "").set ("UNUSED");
+
+    ShaderPreprocessor preprocessor (dir);
+    const std::string source = preprocessor.process (dir + "/main.vert", defines).source;
+
+    CHECK (source.find ("#version 330 core\n#define LIGHTING 1\n#define SCALE 2.0\n#line 2 0\n") == 0);
+    CHECK (countOf (source, "#define FOG")    == 0);
+    CHECK (countOf (source, "#define UNUSED") == 0);
+    CHECK (defines.key() == "LIGHTING=1;SCALE=2.0;UNUSED=1");
+}
+
+// Permutations that differ only in defines the shader never reads expand the same
+TEST (ShaderPreprocessor, dedupesPermutations)
+{
+    const std::string dir = Test::temporaryDirectory ("dedupesPermutations");
+    Test::writeFile (dir + "/main.vert", "#version 330 core\n#ifdef SKINNING\n#endif\n#if QUALITY > 1\n#endif\n");
+
+    ShaderPermutations permutations;
+    permutations.addSwitch ("SKINNING").addAxis ("QUALITY", { "1", "2" }).addSwitch ("UNUSED");
+    CHECK (permutations.count() == 8);
+
+    ShaderPreprocessor preprocessor (dir);
+    const ShaderPreprocessor::VariantSet set = preprocessor.processPermutations (dir + "/main.vert", permutations);
+
+    REQUIRE (set.variants.size() == 8);
+    CHECK (set.sources.size() == 4);
+    CHECK (set.variants[0].key == "QUALITY=1");
+    CHECK (set.variants[0].sourceIndex == set.variants[4].sourceIndex);    // UNUSED off and on
+    CHECK (set.variants[0].sourceIndex != set.variants[1].sourceIndex);
+    for (const ShaderPreprocessor::Variant &variant : set.variants)
+        CHECK (variant.sourceIndex < set.sources.size());
+}
+
+TEST (ShaderPreprocessor, rejectsRecursiveIncludes)
+{
+    const std::string dir = Test::temporaryDirectory ("rejectsRecursiveIncludes");
+    Test::writeFile (dir + "/a.glsl",    "#include \"b.glsl\"\n");
+    Test::writeFile (dir + "/b.glsl",    "float b;\n#include \"a.glsl\"\n");
+    Test::writeFile (dir + "/main.vert", "#version 330 core\n#include \"a.glsl\"\n");
+    Test::writeFile (dir + "/self.vert", "#version 330 core\n#include \"self.vert\"\n");
+
+    ShaderPreprocessor preprocessor (dir);
+    CHECK (throwsWith (preprocessor, dir + "/main.vert", dir + "/b.glsl:2: recursive #include of " + dir + "/a.glsl"));
+    CHECK (throwsWith (preprocessor, dir + "/self.vert", "recursive #include"));
+}
+
+static size_t countOf (const std::string &text, const std::string &what)
+{
+    size_t count = 0;
+    for (size_t pos = text.find (what); pos != std::string::npos; pos = text.find (what, pos + what.size()))
+        ++count;
+    return count;
+}
+
+static bool throwsWith (ShaderPreprocessor &preprocessor, const std::string &file, const std::string &message)
+{
+    try
+    {
+        preprocessor.process (file);
+    }
+    catch (const GLSLProgramException &e)
+    {
+        return e.what().find (message) != std::string::npos;
+    }
+    return false;
+}
@@ -0,0 +1,161 @@
+#include "Test.h"
+#include "GLTest.h"
+
+#include <string>
+#include <vector>
+#include <chrono>
+#include <memory>
+#include <filesystem>
+
+#include "AsyncShaderCompiler.h"
+#include "ShaderPreprocessor.h"
+#include "ShaderReloader.h"
+#include "ThreadPool.h"
+
+namespace fs = std::filesystem;
+
+using Clock = std::chrono::steady_clock;
+
+// Longest a reload may take to show up
+static const std::chrono::seconds RELOAD_TIMEOUT (5);
+
+static const char *VERTEX_SOURCE =
+    "#version 330 core\n"
+    "#include \"tint.glsl\"\n"
+    "layout (location = 0) in vec2 position;\n"
+    "out vec4 color;\n"
+    "void main()\n"
+    "{\n"
+    "    gl_Position = vec4 (position, 0.0, 1.0);\n"
+    "    color       = tint();\n"
+    "}\n";
+
+static const char *FRAGMENT_SOURCE =
+    "#version 330 core\n"
+    "in  vec4 color;\n"
+    "out vec4 fragColor;\n"
+    "void main()\n"
+    "{\n"
+    "    fragColor = color;\n"
+    "}\n";
+
+// The second program's, sharing no file with the first
+static const char *PLAIN_VERTEX_SOURCE =
+    "#version 330 core\n"
+    "void main()\n"
+    "{\n"
+    "    gl_Position = vec4 (0.0, 0.0, 0.0, 1.0);\n"
+    "}\n";
+
+static const char *PLAIN_FRAGMENT_SOURCE =
+    "#version 330 core\n"
+    "out vec4 fragColor;\n"
+    "void main()\n"
+    "{\n"
+    "    fragColor = vec4 (1.0);\n"
+    "}\n";
+
+// Two programs built and tracked the way the application does, one of them
+// including tint.glsl
+struct Reloading
+{
+    explicit Reloading (const std::string &directory);
+
+    // Polls the reloader and the compiler a frame at a time until a reload
+    // finishes or RELOAD_TIMEOUT passes
+    std::vector <ShaderReloader::Reload> wait();
+
+    std::string                    directory;
+    std::unique_ptr <BenchContext> context;
+    ThreadPool                     pool;
+    ShaderPreprocessor             preprocessor;
+    AsyncShaderCompiler            compiler;
+    ShaderReloader                 reloader;
+    AsyncShaderCompiler::Handle    tinted;
+    AsyncShaderCompiler::Handle    plain;
+};
+
+static std::string tintSource (float red);
+
+
+TEST (ShaderReloader, rebuildsOnlyTheIncludingProgram)
+{
+    Reloading reloading (Test::temporaryDirectory ("rebuildsOnlyTheIncludingProgram"));
+    const std::shared_ptr <GLSLProgram> tinted = reloading.tinted->program();
+    const std::shared_ptr <GLSLProgram> plain  = reloading.plain->program();
+    REQUIRE (tinted && plain);
+    CHECK (reloading.reloader.watchedFileCount() == 5);
+
+    Test::writeFile (reloading.directory + "/tint.glsl", tintSource (0.5f));
+    const std::vector <ShaderReloader::Reload> reloads = reloading.wait();
+
+    REQUIRE (reloads.size() == 1);
+    CHECK (reloads[0].program == reloading.tinted);
+    CHECK (!reloads[0].isFailed);
+    CHECK (reloading.tinted->program() != tinted);
+    CHECK (reloading.plain->program()  == plain);
+}
+
+// A broken edit reports the compile log and keeps the last good program
+// drawing, the fix saved through a rename takes over again
+TEST (ShaderReloader, keepsTheLastGoodProgramOnErrors)
+{
+    Reloading reloading (Test::temporaryDirectory ("keepsTheLastGoodProgramOnErrors"));
+    const std::shared_ptr <GLSLProgram> good = reloading.tinted->program();
+    REQUIRE (good);
+
+    Test::writeFile (reloading.directory + "/tint.glsl", "vec4 tint() { return oops; }\n");
+    std::vector <ShaderReloader::Reload> reloads = reloading.wait();
+
+    REQUIRE (reloads.size() == 1);
+    CHECK (reloads[0].isFailed);
+    CHECK (!reloads[0].error.empty());
+    CHECK (reloading.tinted->isReady());
+    CHECK (reloading.tinted->program() == good);
+
+    Test::writeFile (reloading.directory + "/tint.tmp", tintSource (0.25f));
+    fs::rename (reloading.directory + "/tint.tmp", reloading.directory + "/tint.glsl");
+    reloads = reloading.wait();
+
+    REQUIRE (reloads.size() == 1);
+    CHECK (!reloads[0].isFailed);
+    CHECK (reloading.tinted->isReady());
+    CHECK (reloading.tinted->program() != good);
+}
+
+Reloading::Reloading (const std::string &directory)
+    : directory (directory), context (Test::createContext()), pool(), preprocessor (directory),
+      compiler (pool, nullptr, nullptr, &preprocessor), reloader (compiler, &preprocessor)
+{
+    Test::writeFile (directory + "/tint.glsl",   tintSource (1.0f));
+    Test::writeFile (directory + "/reload.vert", VERTEX_SOURCE);
+    Test::writeFile (directory + "/reload.frag", FRAGMENT_SOURCE);
+    Test::writeFile (directory + "/plain.vert",  PLAIN_VERTEX_SOURCE);
+    Test::writeFile (directory + "/plain.frag",  PLAIN_FRAGMENT_SOURCE);
+
+    tinted = compiler.submit ({ directory + "/reload.vert", directory + "/reload.frag" });
+    plain  = compiler.submit ({ directory + "/plain.vert",  directory + "/plain.frag" });
+    reloader.track (tinted);
+    reloader.track (plain);
+    compiler.finishAll();
+
+    // The first poll after the builds starts watching the includes
+    reloader.poll();
+}
+
+std::vector <ShaderReloader::Reload> Reloading::wait()
+{
+    std::vector <ShaderReloader::Reload> finished;
+    const Clock::time_point start = Clock::now();
+    while (finished.empty() && Clock::now() - start < RELOAD_TIMEOUT)
+    {
+        finished = reloader.poll();
+        compiler.poll();
+    }
+    return finished;
+}
+
+static std::string tintSource (float red)
+{
+    return "vec4 tint() { return vec4 (" + std::to_string (red) + ", 0.5, 0.5, 1.0); }\n";
+}
@@ -0,0 +1,41 @@
+#ifndef TEST_INCLUDED
+#define TEST_INCLUDED
+
+#include <string>
+
+// A minimal test registry. TEST (Suite, name) defines a test that
+// TestMain runs when its suite is asked for on the command line, or with
+// no arguments at all. CHECK reports a failed condition and carries on,
+// REQUIRE returns from the test, skip() gives up on it without failing
+namespace Test
+{
+    using Function = void (*)();
+
+    // What TestMain exits with when every test it ran was skipped, for
+    // ctest's SKIP_RETURN_CODE
+    const int SKIPPED = 77;
+
+    struct Skipped
+    {
+        std::string reason;
+    };
+
+    bool add   (const char *suite, const char *name, Function function);
+    bool check (bool condition, const char *expression, const char *file, int line);
+    [[noreturn]] void skip (const std::string &reason);
+
+    // A fresh, empty directory under the temporary directory, removed at exit
+    std::string temporaryDirectory (const std::string &name);
+    // Creates the directories on the way
+    void        writeFile (const std::string &path, const std::string &text);
+}
+
+#define TEST(suite, name)                                                                  \
+    static void suite##_##name();                                                         \
+    static const bool suite##_##name##_registered = Test::add (#suite, #name, suite##_##name); \
+    static void suite##_##name()
+
+#define CHECK(condition)   Test::check (static_cast <bool> (condition), #condition, __FILE__, __LINE__)
+#define REQUIRE(condition) do { if (!CHECK (condition)) return; } while (false)
+
+#endif // !TEST_INCLUDED
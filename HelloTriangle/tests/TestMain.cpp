@@ -0,0 +1,145 @@
+#include "Test.h"
+
+#include <iostream>
+#include <fstream>
+#include <vector>
+#include <cstring>
+#include <stdexcept>
+#include <filesystem>
+
+namespace fs = std::filesystem;
+
+struct TestCase
+{
+    const char     *suite;
+    const char     *name;
+    Test::Function  function;
+};
+
+static std::vector <TestCase> &registry();
+static std::vector <fs::path> &directories();
+static bool isSelected (const TestCase &test, int argc, char **argv);
+
+static size_t s_failures = 0;
+
+
+// TestMain [Suite...]: runs the tests of the given suites, or all of them.
+// Exits with 1 if any check failed or a test threw, with Test::SKIPPED if
+// every test was skipped
+int main (int argc, char **argv)
+{
+    size_t ran = 0, failed = 0, skipped = 0;
+    for (const TestCase &test : registry())
+    {
+        if (!isSelected (test, argc, argv))
+            continue;
+
+        const size_t before = s_failures;
+        try
+        {
+            test.function();
+        }
+        catch (const Test::Skipped &skip)
+        {
+            std::cout << "[ SKIP ] " << test.suite << "." << test.name << ": " << skip.reason << std::endl;
+            ++skipped;
+            ++ran;
+            continue;
+        }
+        catch (const std::exception &e)
+        {
+            std::cout << "  threw: " << e.what() << "\n";
+            ++s_failures;
+        }
+        catch (...)
+        {
+            std::cout << "  threw an unknown exception\n";
+            ++s_failures;
+        }
+
+        const bool isPassed = s_failures == before;
+        std::cout << (isPassed ? "[  OK  ] " : "[FAILED] ") << test.suite << "." << test.name << std::endl;
+        failed += isPassed ? 0 : 1;
+        ++ran;
+    }
+
+    std::error_code error;
+    for (const fs::path &directory : directories())
+        fs::remove_all (directory, error);
+
+    if (ran == 0)
+    {
+        std::cout << "No tests selected" << std::endl;
+        return 1;
+    }
+
+    std::cout << ran - failed - skipped << " of " << ran << " tests passed, " << skipped << " skipped" << std::endl;
+    if (failed > 0)
+        return 1;
+    return skipped == ran ? Test::SKIPPED : 0;
+}
+
+bool Test::add (const char *suite, const char *name, Function function)
+{
+    registry().push_back ({ suite, name, function });
+    return true;
+}
+
+bool Test::check (bool condition, const char *expression, const char *file, int line)
+{
+    if (!condition)
+    {
+        std::cout << "  " << file << ":" << line << ": CHECK (" << expression << ") failed\n";
+        ++s_failures;
+    }
+    return condition;
+}
+
+void Test::skip (const std::string &reason)
+{
+    throw Skipped { reason };
+}
+
+std::string Test::temporaryDirectory (const std::string &name)
+{
+    const fs::path directory = fs::temp_directory_path() / ("HelloTriangleTests-" + name);
+    fs::remove_all (directory);
+    fs::create_directories (directory);
+
+    directories().push_back (directory);
+    return directory.generic_string();
+}
+
+void Test::writeFile (const std::string &path, const std::string &text)
+{
+    fs::create_directories (fs::path (path).parent_path());
+
+    std::ofstream file (path, std::ios::binary | std::ios::trunc);
+    file << text;
+    if (!file)
+        throw std::runtime_error ("Can't write " + path);
+}
+
+// Function statics, the TEST registrations run during static initialization
+static std::vector <TestCase> &registry()
+{
+    static std::vector <TestCase> tests;
+    return tests;
+}
+
+static std::vector <fs::path> &directories()
+{
+    static std::vector <fs::path> paths;
+    return paths;
+}
+
+static bool isSelected (const TestCase &test, int argc, char **argv)
+{
+    if (argc < 2)
+        return true;
+
+    for (int i = 1; i < argc; ++i)
+        if (strcmp (argv[i], test.suite) == 0)
+            return true;
+    return false;
+}
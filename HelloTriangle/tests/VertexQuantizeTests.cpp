@@ -0,0 +1,205 @@
+#include "Test.h"
+
+#include <random>
+#include <vector>
+#include <limits>
+#include <cmath>
+#include <cstring>
+#include <cstdint>
+#include <algorithm>
+
+#include "VertexLayout.h"
+#include "VertexQuantize.h"
+
+// Source streams of a generated mesh, one per attribute
+struct Streams
+{
+    std::vector <float> positions;   // 3 a vertex, within +-50
+    std::vector <float> normals;     // 3, unit length
+    std::vector <float> colors;      // 4, in [0, 1]
+};
+
+static const size_t VERTICES = 1 << 16;
+
+static Streams makeStreams  (size_t count);
+static double  worstOfBound (const VertexLayout &layout, const Streams &streams, size_t element);
+
+
+TEST (VertexQuantize, roundTripsEveryHalf)
+{
+    std::vector <float> values;
+    for (uint32_t half = 0; half < 0x10000; ++half)
+        values.push_back (dequantizeHalf (static_cast <uint16_t> (half)));
+
+    std::vector <uint16_t> halves (values.size());
+    quantizeHalf (values.data(), halves.data(), values.size());
+
+    size_t mismatches = 0;
+    for (uint32_t half = 0; half < 0x10000; ++half)
+    {
+        const bool isNaN = (half & 0x7c00) == 0x7c00 && (half & 0x3ff) != 0;
+        mismatches += isNaN ? (halves[half] & 0x7fff) != 0x7e00 : halves[half] != half;
+    }
+    CHECK (mismatches == 0);
+}
+
+// The vectorized kernels match the scalar ones bit for bit, on random
+// values plus the edges: signed zeros, subnormals, rounding ties,
+// overflow, infinities and NaN
+TEST (VertexQuantize, vectorizedMatchesScalar)
+{
+    const float INF = std::numeric_limits <float>::infinity();
+    const float NaN = std::numeric_limits <float>::quiet_NaN();
+    std::vector <float> values = { 0.0f, -0.0f, 1e-8f, -1e-8f, 5.96e-8f, 2.98e-8f, 6.1e-5f, 65504.0f, 65519.0f,
+                                   65520.0f, -65520.0f, 1e10f, INF, -INF, NaN, -NaN, 1.0f, -1.0f, 1.00001f,
+                                   -1.5f, 0.5f / 255.0f, 1.5f / 255.0f, 0.5f / 32767.0f, 2.0f };
+
+    std::mt19937 random (7);
+    std::uniform_real_distribution <float> wide (-4.0f, 4.0f);
+    for (int i = 0; i < 100000; ++i)
+        values.push_back (wide (random));
+    while (values.size() % 3 != 0)
+        values.push_back (0.25f);
+
+    const size_t count = values.size();
+    std::vector <uint16_t> halfSimd   (count), halfScalar   (count);
+    std::vector <int16_t>  snormSimd  (count), snormScalar  (count);
+    std::vector <uint8_t>  unormSimd  (count), unormScalar  (count);
+    std::vector <int16_t>  octSimd    (count), octScalar    (count);
+
+    quantizeHalf             (values.data(), halfSimd.data(),    count);
+    quantizeHalfScalar       (values.data(), halfScalar.data(),  count);
+    quantizeSnorm16          (values.data(), snormSimd.data(),   count);
+    quantizeSnorm16Scalar    (values.data(), snormScalar.data(), count);
+    quantizeUnorm8           (values.data(), unormSimd.data(),   count);
+    quantizeUnorm8Scalar     (values.data(), unormScalar.data(), count);
+    quantizeOctahedral       (values.data(), octSimd.data(),     count / 3);
+    quantizeOctahedralScalar (values.data(), octScalar.data(),   count / 3);
+
+    CHECK (halfSimd  == halfScalar);
+    CHECK (snormSimd == snormScalar);
+    CHECK (unormSimd == unormScalar);
+    CHECK (octSimd   == octScalar);
+}
+
+// Every attribute read back from an encoded layout stays within half a
+// quantization step of its source
+TEST (VertexQuantize, layoutsStayWithinBounds)
+{
+    const Streams streams = makeStreams (VERTICES);
+
+    VertexElement fittedPosition = { 0, 3, VertexEncoding::Snorm16 };
+    VertexLayout::fitRange (fittedPosition, streams.positions.data(), VERTICES);
+
+    const VertexLayout floats = { { 0, 3, VertexEncoding::Float },
+                                  { 1, 3, VertexEncoding::Float },
+                                  { 2, 4, VertexEncoding::Float } };
+    const VertexLayout halves = { { 0, 3, VertexEncoding::Half },
+                                  { 1, 3, VertexEncoding::Octahedral },
+                                  { 2, 4, VertexEncoding::Unorm8 } };
+    const VertexLayout snorms = { fittedPosition,
+                                  { 1, 3, VertexEncoding::Octahedral },
+                                  { 2, 4, VertexEncoding::Unorm8 } };
+
+    for (size_t e = 0; e < 3; ++e)
+    {
+        CHECK (worstOfBound (floats, streams, e) <= 1.0);
+        CHECK (worstOfBound (halves, streams, e) <= 1.0);
+        CHECK (worstOfBound (snorms, streams, e) <= 1.0);
+    }
+}
+
+static Streams makeStreams (size_t count)
+{
+    std::mt19937 random (42);
+    std::uniform_real_distribution <float> position (-50.0f, 50.0f);
+    std::uniform_real_distribution <float> unit     (0.0f, 1.0f);
+    std::normal_distribution <float>       gaussian;
+
+    Streams streams;
+    for (size_t i = 0; i < count; ++i)
+    {
+        const glm::vec3 normal = glm::normalize (glm::vec3 (gaussian (random), gaussian (random), gaussian (random)));
+        streams.positions.insert (streams.positions.end(), { position (random), position (random), position (random) });
+        streams.normals.insert   (streams.normals.end(),   { normal.x, normal.y, normal.z });
+        streams.colors.insert    (streams.colors.end(),    { unit (random), unit (random), unit (random), unit (random) });
+    }
+    return streams;
+}
+
+// Encodes the streams, reads one attribute back the way the GL would and
+// returns its largest error as a fraction of the bound: half a
+// quantization step, plus a little for the float arithmetic of scaling
+static double worstOfBound (const VertexLayout &layout, const Streams &streams, size_t e)
+{
+    const size_t count = streams.positions.size() / 3;
+    const float *sources[] = { streams.positions.data(), streams.normals.data(), streams.colors.data() };
+
+    std::vector <char> vertices (count * layout.stride());
+    layout.encode (sources, count, vertices.data());
+
+    const VertexElement   &element    = layout.elements()[e];
+    const VertexAttribute &attribute  = layout.format().attributes[e];
+    const size_t           components = static_cast <size_t> (element.components);
+
+    double worst = 0.0;
+    for (size_t v = 0; v < count; ++v)
+    {
+        const char  *data   = vertices.data() + v * layout.stride() + attribute.offset;
+        const float *source = sources[e] + v * components;
+
+        if (element.encoding == VertexEncoding::Octahedral)
+        {
+            int16_t encoded[2];
+            memcpy (encoded, data, sizeof (encoded));
+            // atan2 of sine and cosine stays precise for tiny angles where acos doesn't
+            const glm::dvec3 normal = glm::dvec3 (dequantizeOctahedral (encoded[0], encoded[1]));
+            const glm::dvec3 exact  = glm::dvec3 (source[0], source[1], source[2]);
+            const double     angle  = std::atan2 (glm::length (glm::cross (normal, exact)), glm::dot (normal, exact));
+            worst = std::max (worst, angle / 1e-4);   // radians
+            continue;
+        }
+
+        for (size_t c = 0; c < components; ++c)
+        {
+            const float scale = element.scale[c];
+            const float bias  = element.bias[c];
+            float decoded = 0.0f;
+            float step    = 0.0f;
+            switch (element.encoding)
+            {
+            case VertexEncoding::Float:
+                memcpy (&decoded, data + c * sizeof (float), sizeof (float));
+                break;
+            case VertexEncoding::Half:
+            {
+                uint16_t half;
+                memcpy (&half, data + c * sizeof (half), sizeof (half));
+                decoded = dequantizeHalf (half);
+                step    = std::max (std::fabs (source[c]) * std::ldexp (1.0f, -10), std::ldexp (1.0f, -24));
+                break;
+            }
+            case VertexEncoding::Snorm16:
+            {
+                int16_t snorm;
+                memcpy (&snorm, data + c * sizeof (snorm), sizeof (snorm));
+                decoded = dequantizeSnorm16 (snorm);
+                step    = 1.0f / 32767.0f;
+                break;
+            }
+            case VertexEncoding::Unorm8:
+                decoded = dequantizeUnorm8 (static_cast <uint8_t> (data[c]));
+                step    = 1.0f / 255.0f;
+                break;
+            case VertexEncoding::Octahedral:
+                break;
+            }
+
+            // Back to the source's units, where the error is measured
+            decoded = (decoded - bias) / scale;
+            const double bound = (0.5 * step + 1e-6) / scale + 1e-6 * std::fabs (source[c]);
+            worst = std::max (worst, std::fabs (double (decoded) - source[c]) / bound);
+        }
+    }
+    return worst;
+}
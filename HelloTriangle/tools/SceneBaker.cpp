@@ -0,0 +1,181 @@
+#include <iostream>
+#include <chrono>
+#include <string>
+#include <array>
+#include <vector>
+#include <cmath>
+#include <cstring>
+#include <algorithm>
+#include <stdexcept>
+
+#include "Scene.h"
+#include "BakedScene.h"
+#include "MeshOptimizer.h"
+
+using Clock    = std::chrono::steady_clock;
+using Triangle = std::array <float, 9>;
+
+static void                  verify            (const Scene &scene, const BakedScene &baked);
+static void                  reportCache       (const Scene &scene, const BakedScene &baked);
+static const BakedAttribute &positionAttribute (const BakedMesh &mesh);
+static glm::vec3             readPosition      (const BakedAttribute &attribute, const char *vertex);
+
+
+// SceneBaker <scene.json> <output.scene>
+// Bakes a JSON scene, then loads the result back and checks it against the
+// source before reporting success
+int main (int argc, char **argv)
+{
+    if (argc != 3)
+    {
+        std::cerr << "Usage: SceneBaker <scene.json> <output.scene>" << std::endl;
+        return 1;
+    }
+
+    try
+    {
+        Clock::time_point start = Clock::now();
+        const Scene scene = Scene::load (argv[1]);
+        BakedScene::bake (scene, argv[2]);
+        const double seconds = std::chrono::duration <double> (Clock::now() - start).count();
+
+        const BakedScene baked = BakedScene::load (argv[2]);
+        verify (scene, baked);
+
+        std::cout << argv[2] << ": " << baked.meshes().size() << " meshes, " << baked.vertexBytes() << " vertex and "
+                  << baked.indexBytes() << " index bytes, baked in " << seconds * 1000.0 << " ms" << std::endl;
+        reportCache (scene, baked);
+    }
+    catch (const std::exception &e)
+    {
+        std::cerr << e.what() << std::endl;
+        return 1;
+    }
+    return 0;
+}
+
+// Throws on the first difference between the source and what was baked
+static void verify (const Scene &scene, const BakedScene &baked)
+{
+    auto expect = [] (bool condition, const std::string &what)
+    {
+        if (!condition)
+            throw std::runtime_error ("Round trip failed: " + what);
+    };
+
+    expect (baked.programs().size()  == scene.programs().size(),  "program count");
+    expect (baked.materials().size() == scene.materials().size(), "material count");
+    expect (baked.draws().size()     == scene.nodes().size(),     "draw count");
+
+    for (size_t i = 0; i < scene.programs().size(); ++i)
+    {
+        expect (strcmp (baked.string (baked.programs()[i].vertex),   scene.programs()[i].vertex)   == 0 &&
+                strcmp (baked.string (baked.programs()[i].fragment), scene.programs()[i].fragment) == 0,
+                std::string ("program ") + scene.programs()[i].name);
+    }
+
+    // Triangles may be reordered and vertices welded, so each mesh is
+    // compared as a sorted list of triangles against the transformed source
+    // positions
+    for (size_t i = 0; i < scene.nodes().size(); ++i)
+    {
+        const SceneNode      &node      = scene.nodes()[i];
+        const SceneMesh      &source    = scene.meshes()[node.mesh];
+        const BakedDraw      &draw      = baked.draws()[i];
+        const BakedMesh      &mesh      = baked.meshes()[draw.mesh];
+        const BakedAttribute &attribute = positionAttribute (mesh);
+        const std::string     name      = source.name;
+
+        expect (draw.material == node.material && strcmp (baked.string (mesh.name), source.name) == 0, "node of " + name);
+
+        const uint32_t sourceIndexCount = source.indices ? source.indexCount : source.vertexCount;
+        expect (mesh.indexCount == sourceIndexCount && mesh.vertexCount <= source.vertexCount, "counts of " + name);
+
+        const char     *vertices = static_cast <const char *> (baked.vertices()) + mesh.vertexOffset;
+        const uint32_t *indices  = reinterpret_cast <const uint32_t *> (
+                                   static_cast <const char *> (baked.indices()) + mesh.indexOffset);
+
+        const glm::vec3 boundsMin (mesh.boundsMin[0], mesh.boundsMin[1], mesh.boundsMin[2]);
+        const glm::vec3 boundsMax (mesh.boundsMax[0], mesh.boundsMax[1], mesh.boundsMax[2]);
+
+        const glm::mat4 transform = node.transform();
+        std::vector <Triangle> expected (mesh.indexCount / 3), actual (mesh.indexCount / 3);
+        for (uint32_t j = 0; j < mesh.indexCount / 3 * 3; ++j)
+        {
+            const uint32_t  index    = source.indices ? source.indices[j] : j;
+            const glm::vec4 position = transform * glm::vec4 (source.positions[3 * index], source.positions[3 * index + 1],
+                                                              source.positions[3 * index + 2], 1.0f);
+
+            expect (indices[j] < mesh.vertexCount, "indices of " + name);
+            const glm::vec3 read = readPosition (attribute, vertices + indices[j] * mesh.stride);
+            expect (glm::all (glm::greaterThanEqual (read, boundsMin)) && glm::all (glm::lessThanEqual (read, boundsMax)),
+                    "bounds of " + name);
+
+            for (int c = 0; c < 3; ++c)
+            {
+                expected[j / 3][3 * (j % 3) + c] = position[c];
+                actual[j / 3][3 * (j % 3) + c]   = read[c];
+            }
+        }
+
+        std::sort (expected.begin(), expected.end());
+        std::sort (actual.begin(),   actual.end());
+        expect (expected == actual, "triangles of " + name);
+    }
+}
+
+// ACMR and ATVR of the whole scene for a 16 entry FIFO, as written and as baked
+static void reportCache (const Scene &scene, const BakedScene &baked)
+{
+    std::vector <uint32_t> sequential;
+    size_t triangles = 0, verticesBefore = 0, verticesAfter = 0, missesBefore = 0, missesAfter = 0;
+
+    for (size_t i = 0; i < scene.nodes().size(); ++i)
+    {
+        const SceneMesh &source = scene.meshes()[scene.nodes()[i].mesh];
+        const BakedMesh &mesh   = baked.meshes()[baked.draws()[i].mesh];
+
+        const uint32_t *indices = source.indices;
+        if (!indices)
+        {
+            sequential.resize (source.vertexCount);
+            for (uint32_t j = 0; j < source.vertexCount; ++j)
+                sequential[j] = j;
+            indices = sequential.data();
+        }
+        const uint32_t *bakedIndices = reinterpret_cast <const uint32_t *> (
+                                       static_cast <const char *> (baked.indices()) + mesh.indexOffset);
+
+        missesBefore   += analyzeVertexCache (indices, mesh.indexCount, source.vertexCount).transformed;
+        missesAfter    += analyzeVertexCache (bakedIndices, mesh.indexCount, mesh.vertexCount).transformed;
+        triangles      += mesh.indexCount / 3;
+        verticesBefore += source.vertexCount;
+        verticesAfter  += mesh.vertexCount;
+    }
+
+    if (triangles == 0)
+        return;
+    std::cout << "vertices " << verticesBefore << " -> " << verticesAfter
+              << ", ACMR " << double (missesBefore) / triangles << " -> " << double (missesAfter) / triangles
+              << ", ATVR " << double (missesBefore) / verticesBefore << " -> " << double (missesAfter) / verticesAfter
+              << std::endl;
+}
+
+static const BakedAttribute &positionAttribute (const BakedMesh &mesh)
+{
+    for (uint32_t i = 0; i < mesh.attributeCount; ++i)
+    {
+        const BakedAttribute &attribute = mesh.attributes[i];
+        if (attribute.location == 0 && attribute.components == 3 && attribute.type == GL_FLOAT)
+            return attribute;
+    }
+    throw std::runtime_error ("Round trip failed: no position attribute the baker can read");
+}
+
+// Location 0 as the GL reads it
+static glm::vec3 readPosition (const BakedAttribute &attribute, const char *vertex)
+{
+    float position[3];
+    memcpy (position, vertex + attribute.offset, sizeof (position));
+    return glm::vec3 (position[0], position[1], position[2]);
+}